@@ -0,0 +1,160 @@
+#define _GNU_SOURCE
+// ALT (landmark-bounded bidirectional A*) against plain A* on the same cost map.
+//
+// Writes a resolution-9 cost map of BENCH_RADIUS_KM around central Berlin: scattered
+// slow and impassable cells, plus a north-south river east of the center that can only
+// be crossed on a bridge every 8 km. The straight-line heuristic steers A* into the
+// river bank and it floods the area behind it; landmark bounds know about the detour.
+// Builds a landmark table over the map, then routes eastwards across the river with
+// both searches. Costs must agree; the bench counts any that differ. No database
+// needed. Run with:
+//   make bench && ./build/bench_alt
+// Tunables: BENCH_RADIUS_KM (40), BENCH_LANDMARKS (ALT_DEFAULT_LANDMARKS), BENCH_REPEATS (5),
+//           BENCH_MAP_PATH (/tmp/bench_alt_cost_map.bin), BENCH_TABLE_PATH (/tmp/bench_alt.bin)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/routing/alt.h"
+#include "../src/routing/astar.h"
+#include "../src/routing/cost_map.h"
+#include <math.h>
+
+#define BENCH_RES 9
+#define RIVER_OFFSET_KM 2.0      // East of the center
+#define RIVER_WIDTH_KM 0.6
+#define BRIDGE_EVERY_KM 8.0
+
+static const double center_lat = 52.52, center_lng = 13.405;
+
+static H3Index cell_at(double lat, double lng) {
+    LatLng coord = { degsToRads(lat), degsToRads(lng) };
+    H3Index cell = 0;
+    latLngToCell(&coord, BENCH_RES, &cell);
+    return cell;
+}
+
+static const char* env_path(const char *name, const char *fallback) {
+    const char *value = getenv(name);
+    return value && *value ? value : fallback;
+}
+
+// Deterministic terrain; 1 (not stored) for most cells
+static float terrain_cost(H3Index cell) {
+    LatLng c;
+    cellToLatLng(cell, &c);
+    double east_km = (radsToDegs(c.lng) - center_lng) * 111.32 * cos(degsToRads(center_lat));
+    double north_km = (radsToDegs(c.lat) - center_lat) * 110.57;
+    if (east_km > RIVER_OFFSET_KM && east_km < RIVER_OFFSET_KM + RIVER_WIDTH_KM) {
+        double from_bridge = fmod(fabs(north_km) + BRIDGE_EVERY_KM / 2, BRIDGE_EVERY_KM);
+        return from_bridge < 0.3 ? 1.0f : INFINITY;
+    }
+    uint64_t h = cell * 0x9e3779b97f4a7c15ULL;
+    switch ((h >> 59) & 0xF) {
+    case 0: return INFINITY;   // Ponds
+    case 1: case 2: return 3.0f;
+    case 3: return 1.5f;
+    default: return 1.0f;
+    }
+}
+
+// Nearest cell at or just east of the point that is not a pond
+static H3Index passable_cell_at(double lat, double lng) {
+    H3Index cell = cell_at(lat, lng);
+    while (isinf(terrain_cost(cell))) {
+        lng += 0.001;
+        cell = cell_at(lat, lng);
+    }
+    return cell;
+}
+
+static int write_map(const char *path, H3Index center, int k) {
+    int64_t disk_size;
+    maxGridDiskSize(k, &disk_size);
+    H3Index *cells = calloc((size_t)disk_size, sizeof(H3Index));
+    float *costs = malloc((size_t)disk_size * sizeof(float));
+    if (!cells || !costs || gridDisk(center, k, cells) != E_SUCCESS) {
+        fprintf(stderr, "gridDisk failed\n");
+        return -1;
+    }
+    size_t count = 0;
+    for (int64_t i = 0; i < disk_size; i++) {
+        float cost = cells[i] ? terrain_cost(cells[i]) : 1.0f;
+        if (cost != 1.0f) {
+            cells[count] = cells[i];
+            costs[count++] = cost;
+        }
+    }
+    int result = cost_map_write(path, cells, costs, count, 1.0f);
+    free(cells);
+    free(costs);
+    return result;
+}
+
+int main(void) {
+    double radius_km = bench_env_int("BENCH_RADIUS_KM", 40);
+    int landmarks = bench_env_int("BENCH_LANDMARKS", ALT_DEFAULT_LANDMARKS);
+    int repeats = bench_env_int("BENCH_REPEATS", 5);
+    const char *map_path = env_path("BENCH_MAP_PATH", "/tmp/bench_alt_cost_map.bin");
+    const char *table_path = env_path("BENCH_TABLE_PATH", "/tmp/bench_alt.bin");
+    static const double distances_km[] = { 5, 10, 20, 30 };
+
+    double edge_km;
+    getHexagonEdgeLengthAvgKm(BENCH_RES, &edge_km);
+    int k = (int)ceil(radius_km / (edge_km * sqrt(3.0)));
+    H3Index center = cell_at(center_lat, center_lng);
+    if (write_map(map_path, center, k) != 0 || cost_map_load(map_path) != 0) {
+        return 1;
+    }
+    double begin = bench_now();
+    if (alt_build_table(table_path, center, k, landmarks) != 0 || alt_load(table_path) != 0) {
+        return 1;
+    }
+    printf("Landmark table built in %.2f s\n\n", bench_now() - begin);
+
+    printf("%6s %10s %10s %10s %10s %10s %8s\n", "km", "A* exp", "ALT exp", "A* ms", "ALT ms", "cost km", "speedup");
+    int mismatches = 0;
+    for (size_t d = 0; d < sizeof(distances_km) / sizeof(distances_km[0]); d++) {
+        // Start a little north of the center so the straight line misses the bridges
+        double start_lat = center_lat + 1.5 / 110.57;
+        double end_lng = center_lng + distances_km[d] / (111.32 * cos(degsToRads(start_lat)));
+        H3Index start = passable_cell_at(start_lat, center_lng);
+        H3Index end = passable_cell_at(start_lat, end_lng);
+
+        astar_search_t plain, alt;
+        int plain_cells = 0, alt_cells = 0;
+        double t0 = bench_now();
+        for (int r = 0; r < repeats; r++) {
+            arena_t arena;
+            arena_init(&arena);
+            H3Index *path = NULL;
+            plain_cells = astar_h3_path(&arena, start, end, 1000000, &path, &plain);
+            arena_release(&arena);
+        }
+        double t1 = bench_now();
+        for (int r = 0; r < repeats; r++) {
+            arena_t arena;
+            arena_init(&arena);
+            H3Index *path = NULL;
+            alt_cells = alt_h3_path(&arena, start, end, 1000000, &path, &alt);
+            arena_release(&arena);
+        }
+        double t2 = bench_now();
+
+        if (plain_cells < 0 || alt_cells < 0) {
+            printf("%6.0f failed: A* %d, ALT %d\n", distances_km[d], plain_cells, alt_cells);
+            mismatches++;
+            continue;
+        }
+        if (fabs(plain.cost_km - alt.cost_km) > 1e-9 * plain.cost_km) {
+            mismatches++;
+        }
+        double plain_ms = (t1 - t0) * 1000.0 / repeats, alt_ms = (t2 - t1) * 1000.0 / repeats;
+        printf("%6.0f %10zu %10zu %10.2f %10.2f %10.2f %7.1fx\n", distances_km[d], plain.expanded, alt.expanded,
+               plain_ms, alt_ms, alt.cost_km, plain_ms / alt_ms);
+    }
+    printf("\n%d cost mismatches\n", mismatches);
+
+    alt_unload();
+    cost_map_unload();
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+#define _GNU_SOURCE
+// A* over the H3 grid: expansions per second and search time by route length.
+//
+// Routes start in central Berlin and head 1 to 50 kilometres east at
+// resolution BENCH_RES. Each search runs BENCH_REPEATS times with an arena, as the
+// request handlers do. No database needed. Run with:
+//   make bench && ./build/bench_astar
+// Tunables: BENCH_RES (9), BENCH_REPEATS (20), BENCH_MAX_EXPANSIONS (0 = ASTAR_MAX_EXPANSIONS)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/routing/astar.h"
+#include <math.h>
+
+static H3Index cell_at(double lat, double lng, int res) {
+    LatLng coord = { degsToRads(lat), degsToRads(lng) };
+    H3Index cell = 0;
+    latLngToCell(&coord, res, &cell);
+    return cell;
+}
+
+int main(void) {
+    int res = bench_env_int("BENCH_RES", 9);
+    int repeats = bench_env_int("BENCH_REPEATS", 20);
+    size_t max_expansions = (size_t)bench_env_int("BENCH_MAX_EXPANSIONS", 0);
+    static const double distances_km[] = { 1, 5, 10, 25, 50 };
+    const double start_lat = 52.52, start_lng = 13.405;
+
+    printf("A* on the H3 grid, resolution %d, %d searches per route\n\n", res, repeats);
+    printf("%8s %8s %10s %10s %12s %14s\n", "km", "cells", "expanded", "pushed", "ms/search", "expansions/s");
+
+    for (size_t d = 0; d < sizeof(distances_km) / sizeof(distances_km[0]); d++) {
+        // One degree of longitude is 111.32 km * cos(latitude)
+        double end_lng = start_lng + distances_km[d] / (111.32 * cos(degsToRads(start_lat)));
+        H3Index start = cell_at(start_lat, start_lng, res);
+        H3Index end = cell_at(start_lat, end_lng, res);
+
+        astar_search_t search;
+        int cells = 0;
+        double begin = bench_now();
+        for (int r = 0; r < repeats; r++) {
+            arena_t arena;
+            arena_init(&arena);
+            H3Index *path = NULL;
+            cells = astar_h3_path(&arena, start, end, max_expansions, &path, &search);
+            arena_release(&arena);
+        }
+        double elapsed = bench_now() - begin;
+
+        if (cells < 0) {
+            printf("%8.0f %8s %10zu %10zu %12s %14s\n", distances_km[d],
+                   cells == ASTAR_BUDGET_EXCEEDED ? "budget" : "failed", search.expanded, search.pushed, "-", "-");
+            continue;
+        }
+        printf("%8.0f %8d %10zu %10zu %12.3f %14.0f\n", distances_km[d], cells, search.expanded, search.pushed,
+               elapsed * 1000.0 / repeats, search.expanded * (double)repeats / elapsed);
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+#define _GNU_SOURCE
+// Location ingest throughput: one point per request vs. batched uploads.
+//
+// Sends BENCH_POINTS positions to a running server three ways over a single keep-alive
+// connection: POST /api/save-location per point, then POST /api/save-locations with
+// BENCH_BATCH points per request as a JSON array and as newline-delimited JSON. Every
+// point belongs to the user BENCH_TOKEN signs in as, the way a client flushes its own
+// buffered track. Start the server and log in first, then run:
+//   make bench && BENCH_TOKEN=... ./build/bench_batch_ingest
+// Tunables: BENCH_PORT (8080), BENCH_POINTS (20000), BENCH_BATCH (500)
+
+#include "bench_util.h"
+
+typedef struct {
+    int port;
+    int points;
+    int batch;
+    const char *token;
+} ingest_config_t;
+
+static int format_point(char *buf, size_t size, int i, int ndjson) {
+    double lat = 46.0 + (i % 1000) * 1e-4;
+    double lon = 14.5 + (i % 997) * 1e-4;
+    return snprintf(buf, size, "{\"latitude\":%.6f,\"longitude\":%.6f,\"accuracy\":10}%s",
+                    lat, lon, ndjson ? "\n" : "");
+}
+
+// Returns points per second, or -1 when a request fails
+static double run_single(const ingest_config_t *config) {
+    int fd = bench_http_connect(config->port);
+    if (fd < 0) {
+        return -1;
+    }
+
+    char body[256], headers[256];
+    snprintf(headers, sizeof(headers), "Content-Type: application/json\r\nAuthorization: Bearer %s\r\n",
+             config->token);
+    double start = bench_now();
+    for (int i = 0; i < config->points; i++) {
+        int len = format_point(body, sizeof(body), i, 0);
+        int status = bench_http_request(fd, "POST", "/api/save-location", headers, body, (size_t)len, NULL);
+        if (status != 200) {
+            fprintf(stderr, "save-location returned %d at point %d\n", status, i);
+            close(fd);
+            return -1;
+        }
+    }
+    double elapsed = bench_now() - start;
+    close(fd);
+    return config->points / elapsed;
+}
+
+static double run_batched(const ingest_config_t *config, int ndjson) {
+    int fd = bench_http_connect(config->port);
+    if (fd < 0) {
+        return -1;
+    }
+
+    size_t capacity = (size_t)config->batch * 128 + 16;
+    char *body = malloc(capacity);
+    if (!body) {
+        close(fd);
+        return -1;
+    }
+
+    char headers[256];
+    snprintf(headers, sizeof(headers), "Content-Type: %s\r\nAuthorization: Bearer %s\r\n",
+             ndjson ? "application/x-ndjson" : "application/json", config->token);
+
+    double start = bench_now();
+    for (int first = 0; first < config->points; first += config->batch) {
+        int count = config->points - first < config->batch ? config->points - first : config->batch;
+        size_t len = 0;
+        if (!ndjson) {
+            body[len++] = '[';
+        }
+        for (int k = 0; k < count; k++) {
+            if (!ndjson && k > 0) {
+                body[len++] = ',';
+            }
+            len += (size_t)format_point(body + len, capacity - len, first + k, ndjson);
+        }
+        if (!ndjson) {
+            body[len++] = ']';
+        }
+
+        int status = bench_http_request(fd, "POST", "/api/save-locations", headers, body, len, NULL);
+        if (status != 200) {
+            fprintf(stderr, "save-locations returned %d at point %d\n", status, first);
+            free(body);
+            close(fd);
+            return -1;
+        }
+    }
+    double elapsed = bench_now() - start;
+    free(body);
+    close(fd);
+    return config->points / elapsed;
+}
+
+int main(void) {
+    ingest_config_t config = {
+        .port = bench_env_int("BENCH_PORT", 8080),
+        .points = bench_env_int("BENCH_POINTS", 20000),
+        .batch = bench_env_int("BENCH_BATCH", 500),
+        .token = getenv("BENCH_TOKEN"),
+    };
+    if (config.batch < 1 || config.points < 1) {
+        fprintf(stderr, "BENCH_POINTS and BENCH_BATCH must be positive\n");
+        return 1;
+    }
+    if (!config.token || !*config.token) {
+        fprintf(stderr, "Set BENCH_TOKEN to a session token\n");
+        return 1;
+    }
+
+    printf("%d points, batches of %d, port %d\n", config.points, config.batch, config.port);
+
+    double single = run_single(&config);
+    double array = run_batched(&config, 0);
+    double ndjson = run_batched(&config, 1);
+    if (single < 0 || array < 0 || ndjson < 0) {
+        fprintf(stderr, "Benchmark aborted; is the server running on port %d?\n", config.port);
+        return 1;
+    }
+
+    printf("%-24s %12s %10s\n", "mode", "points/s", "speedup");
+    printf("%-24s %12.0f %9.1fx\n", "save-location", single, 1.0);
+    printf("%-24s %12.0f %9.1fx\n", "save-locations (array)", array, array / single);
+    printf("%-24s %12.0f %9.1fx\n", "save-locations (ndjson)", ndjson, ndjson / single);
+    return 0;
+}
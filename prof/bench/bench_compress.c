@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+// CPU cost against bytes saved when compressing friend-location responses.
+//
+// Builds the /api/friends/locations body for several friend-list sizes with the same
+// json_writer calls the server uses, then compresses each one BENCH_ROUNDS times with
+// compress_buffer() (gzip, per-thread stream reuse, request arena) at several levels.
+// Reports microseconds per response, compressed size and the ratio. No server or
+// database needed:
+//   make bench && ./build/bench_compress
+// Tunables: BENCH_ROUNDS (500)
+
+#include "bench_util.h"
+#include "../src/utils/compress.h"
+#include "../src/utils/json_writer.h"
+#include "../src/utils/arena.h"
+#include <pthread.h>
+
+static const int friend_counts[] = { 5, 20, 50, 200, 1000 };
+static const int levels[] = { 1, 6, 9 };
+
+// Same shape as write_friends_locations_live(); positions drift like real reports do
+static char* build_friends_locations(int friends, size_t *len) {
+    json_writer_t out;
+    json_writer_init(&out, 4096);
+    json_writer_begin_array(&out);
+    for (int i = 0; i < friends; i++) {
+        char id[16], username[32], timestamp[32];
+        snprintf(id, sizeof(id), "%d", 1000 + i * 7);
+        snprintf(username, sizeof(username), "user_%d", 1000 + i * 7);
+        snprintf(timestamp, sizeof(timestamp), "2026-10-17T09:%02d:%02d.%03dZ", i % 60, (i * 7) % 60, (i * 37) % 1000);
+        json_writer_begin_object(&out);
+        json_writer_key(&out, "user_id");
+        json_writer_string(&out, id);
+        json_writer_key(&out, "username");
+        json_writer_string(&out, username);
+        json_writer_key(&out, "latitude");
+        json_writer_double(&out, 46.0569 + (i % 97) * 1.37e-4 + i * 3.1e-7);
+        json_writer_key(&out, "longitude");
+        json_writer_double(&out, 14.5058 + (i % 89) * 2.11e-4 + i * 2.3e-7);
+        json_writer_key(&out, "accuracy");
+        json_writer_int(&out, 5 + i % 50);
+        json_writer_key(&out, "timestamp");
+        json_writer_string(&out, timestamp);
+        json_writer_key(&out, "updated_at_ms");
+        json_writer_int(&out, 1792228800000LL + i * 1337);
+        json_writer_end_object(&out);
+    }
+    json_writer_end_array(&out);
+    return json_writer_finish(&out, len);
+}
+
+typedef struct {
+    const char *body;
+    size_t len;
+    int rounds;
+    size_t packed_len;      // 0 when compression did not pay off
+    double seconds;
+} compress_job_t;
+
+// Compress the body `rounds` times the way a request does: arena scratch, reused stream
+static void* run_job(void *arg) {
+    compress_job_t *job = arg;
+    double start = bench_now();
+    for (int r = 0; r < job->rounds; r++) {
+        arena_t arena;
+        arena_init(&arena);
+        void *packed;
+        size_t packed_len;
+        int rc = compress_buffer(COMPRESS_GZIP, job->body, job->len, &arena, &packed, &packed_len);
+        arena_release(&arena);
+        if (rc != 0) {
+            job->packed_len = 0;
+            return NULL;
+        }
+        job->packed_len = packed_len;
+    }
+    job->seconds = bench_now() - start;
+    return NULL;
+}
+
+int main(void) {
+    int rounds = bench_env_int("BENCH_ROUNDS", 500);
+    if (rounds < 1) {
+        fprintf(stderr, "BENCH_ROUNDS must be positive\n");
+        return 1;
+    }
+
+    printf("gzip, %d rounds per cell\n", rounds);
+    printf("%8s %10s %6s %12s %12s %8s\n", "friends", "bytes", "level", "us/response", "gzip bytes", "ratio");
+    for (size_t f = 0; f < sizeof(friend_counts) / sizeof(friend_counts[0]); f++) {
+        size_t len = 0;
+        char *body = build_friends_locations(friend_counts[f], &len);
+        if (!body) {
+            fprintf(stderr, "Failed to build body\n");
+            return 1;
+        }
+
+        for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+            // Streams keep the level they were created with, so each level runs on a fresh thread
+            compress_configure(levels[l], 0);
+            compress_job_t job = { body, len, rounds, 0, 0 };
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, run_job, &job) != 0) {
+                fprintf(stderr, "Failed to start thread\n");
+                return 1;
+            }
+            pthread_join(thread, NULL);
+            if (job.packed_len == 0) {
+                printf("%8d %10zu %6d %12s\n", friend_counts[f], len, levels[l], "no gain");
+                continue;
+            }
+            printf("%8d %10zu %6d %12.1f %12zu %7.1f%%\n", friend_counts[f], len, levels[l],
+                   job.seconds * 1e6 / rounds, job.packed_len, 100.0 * (double)job.packed_len / (double)len);
+        }
+        free(body);
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+// Cost-map lookups and their effect on A*, with a city-sized map.
+//
+// Builds a map of every resolution-10 cell within BENCH_RADIUS rings of central Berlin
+// (3 million cells at the default radius), with a mix of fast, normal, slow and
+// impassable cells, plus resolution-6 cells as regional defaults. It is written to
+// BENCH_MAP_PATH and mapped back in. Then it times lookups that hit a fine cell, fall
+// back to a parent (resolution-11 cells), or miss the map, and runs the same routes with
+// and without the map. No database needed. Run with:
+//   make bench && ./build/bench_cost_map
+// Tunables: BENCH_RADIUS (1000), BENCH_LOOKUPS (2000000), BENCH_MAP_PATH (/tmp/bench_cost_map.bin)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/routing/cost_map.h"
+#include "../src/routing/astar.h"
+#include <math.h>
+
+#define CITY_RES 10
+#define REGION_RES 6
+
+static H3Index cell_at(double lat, double lng, int res) {
+    LatLng coord = { degsToRads(lat), degsToRads(lng) };
+    H3Index cell = 0;
+    latLngToCell(&coord, res, &cell);
+    return cell;
+}
+
+// Deterministic per-cell terrain so runs are comparable
+static float terrain_cost(H3Index cell) {
+    uint64_t h = cell * 0x9e3779b97f4a7c15ULL;
+    switch ((h >> 59) & 0xF) {
+    case 0: return INFINITY;   // Water
+    case 1: case 2: return 3.0f;
+    case 3: case 4: case 5: return 1.5f;
+    case 6: return 0.8f;       // Arterial roads
+    default: return 1.0f;
+    }
+}
+
+static double time_lookups(const H3Index *cells, size_t count, int rounds, float *checksum) {
+    double start = bench_now();
+    float sum = 0;
+    for (int r = 0; r < rounds; r++) {
+        for (size_t i = 0; i < count; i++) {
+            float cost = cost_map_lookup(cells[i]);
+            sum += isinf(cost) ? 0 : cost;
+        }
+    }
+    *checksum += sum;
+    return (bench_now() - start) * 1e9 / ((double)count * rounds);
+}
+
+static void run_route(const char *label, H3Index start, H3Index end) {
+    astar_search_t search;
+    H3Index *path = NULL;
+    double begin = bench_now();
+    int cells = astar_h3_path(NULL, start, end, 0, &path, &search);
+    double elapsed = bench_now() - begin;
+    free(path);
+    printf("  %-12s %8d cells %10zu expanded %10.2f ms   cost %.2f\n", label, cells, search.expanded,
+           elapsed * 1000.0, search.cost_km);
+}
+
+int main(void) {
+    int radius = bench_env_int("BENCH_RADIUS", 1000);
+    int lookups = bench_env_int("BENCH_LOOKUPS", 2000000);
+    const char *path = getenv("BENCH_MAP_PATH");
+    if (!path) {
+        path = "/tmp/bench_cost_map.bin";
+    }
+    const double lat = 52.52, lng = 13.405;
+    H3Index center = cell_at(lat, lng, CITY_RES);
+
+    // Fine cells
+    int64_t disk_size;
+    maxGridDiskSize(radius, &disk_size);
+    H3Index *disk = calloc((size_t)disk_size, sizeof(H3Index));
+    if (!disk || gridDisk(center, radius, disk) != E_SUCCESS) {
+        fprintf(stderr, "gridDisk failed\n");
+        return 1;
+    }
+    size_t fine = 0;
+    for (int64_t i = 0; i < disk_size; i++) {
+        if (disk[i] != 0) {
+            disk[fine++] = disk[i];
+        }
+    }
+
+    // Regional defaults: the resolution-6 parents of the city, a little slower than open ground
+    H3Index region_center;
+    cellToParent(center, REGION_RES, &region_center);
+    H3Index region[19] = { 0 };
+    gridDisk(region_center, 2, region);
+
+    H3Index *cells = malloc((fine + 19) * sizeof(H3Index));
+    float *costs = malloc((fine + 19) * sizeof(float));
+    size_t count = 0;
+    for (size_t i = 0; i < fine; i++) {
+        cells[count] = disk[i];
+        costs[count++] = terrain_cost(disk[i]);
+    }
+    for (int i = 0; i < 19; i++) {
+        if (region[i] != 0) {
+            cells[count] = region[i];
+            costs[count++] = 1.2f;
+        }
+    }
+
+    double begin = bench_now();
+    if (cost_map_write(path, cells, costs, count, 1.0f) != 0) {
+        return 1;
+    }
+    double write_s = bench_now() - begin;
+    begin = bench_now();
+    if (cost_map_load(path) != 0) {
+        return 1;
+    }
+    printf("Cost map: %zu cells, written in %.2f s, mapped in %.3f ms\n\n", count, write_s,
+           (bench_now() - begin) * 1000.0);
+
+    // Lookup sets of BENCH_LOOKUPS cells each
+    size_t sample = (size_t)lookups;
+    H3Index *hits = malloc(sample * sizeof(H3Index));
+    H3Index *children = malloc(sample * sizeof(H3Index));
+    H3Index *misses = malloc(sample * sizeof(H3Index));
+    srand(42);
+    for (size_t i = 0; i < sample; i++) {
+        hits[i] = disk[(size_t)rand() % fine];
+        cellToCenterChild(disk[(size_t)rand() % fine], CITY_RES + 1, &children[i]);
+        misses[i] = cell_at(40.0 + (rand() % 1000) / 100.0, -100.0 + (rand() % 1000) / 100.0, CITY_RES);
+    }
+
+    float checksum = 0;
+    printf("%-28s %10s\n", "lookup", "ns/lookup");
+    printf("%-28s %10.1f\n", "fine cell (res 10)", time_lookups(hits, sample, 1, &checksum));
+    printf("%-28s %10.1f\n", "child of fine cell (res 11)", time_lookups(children, sample, 1, &checksum));
+    printf("%-28s %10.1f\n", "outside the map", time_lookups(misses, sample, 1, &checksum));
+    printf("(checksum %.0f)\n\n", (double)checksum);
+
+    static const double distances_km[] = { 2, 5, 10 };
+    for (size_t d = 0; d < sizeof(distances_km) / sizeof(distances_km[0]); d++) {
+        double end_lng = lng + distances_km[d] / (111.32 * cos(degsToRads(lat)));
+        H3Index start = cell_at(lat, lng, CITY_RES);
+        H3Index end = cell_at(lat, end_lng, CITY_RES);
+        printf("%.0f km route:\n", distances_km[d]);
+        run_route("with map", start, end);
+        cost_map_unload();
+        run_route("uniform", start, end);
+        cost_map_load(path);
+    }
+
+    cost_map_unload();
+    free(disk);
+    free(cells);
+    free(costs);
+    free(hits);
+    free(children);
+    free(misses);
+    return 0;
+}
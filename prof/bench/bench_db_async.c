@@ -0,0 +1,228 @@
+#define _GNU_SOURCE
+// Request latency under load: blocking pooled queries versus db_async.
+//
+// Starts the HTTP engine with BENCH_WORKERS threads and drives it with BENCH_CLIENTS
+// keep-alive clients, every request running the friends-locations query for
+// BENCH_USER_ID. The blocking round holds a worker (and a pooled connection) for the
+// whole query, so once the workers are busy new requests queue behind them; the async
+// round suspends the request and pipelines the query on db_async's connections.
+// Needs a reachable database with the schema loaded. Run with:
+//   make bench && GEO_BENCH_CONN="host=localhost dbname=..." ./build/bench_db_async
+// Tunables: BENCH_WORKERS (4), BENCH_CLIENTS (256), BENCH_SECONDS (5), BENCH_USER_ID (1),
+//           BENCH_ASYNC_CONNECTIONS (4), BENCH_PORT (18084)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/http_engine.h"
+#include "../src/db/db_pool.h"
+#include "../src/db/db_statements.h"
+#include "../src/db/db_async.h"
+#include <pthread.h>
+
+#define MAX_SAMPLES_PER_CLIENT 100000
+
+static int use_async = 0;
+static char user_id[16];
+
+static enum MHD_Result respond(struct MHD_Connection *connection, PGresult *res) {
+    int ok = res && PQresultStatus(res) == PGRES_TUPLES_OK;
+    char body[64];
+    int len = snprintf(body, sizeof(body), "{\"rows\": %d}", ok ? PQntuples(res) : -1);
+    PQclear(res);
+    struct MHD_Response *response = MHD_create_response_from_buffer((size_t)len, body, MHD_RESPMEM_MUST_COPY);
+    enum MHD_Result ret = MHD_queue_response(connection, ok ? MHD_HTTP_OK : MHD_HTTP_INTERNAL_SERVER_ERROR,
+                                             response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static PGresult* exec_blocking(const char *const *params) {
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return NULL;
+    }
+    PGresult *res = db_exec_prepared(conn, STMT_FRIENDS_LOCATIONS, params);
+    db_pool_release(conn);
+    return res;
+}
+
+static enum MHD_Result bench_handler(void *cls, struct MHD_Connection *connection,
+                                     const char *url, const char *method,
+                                     const char *version, const char *upload_data,
+                                     size_t *upload_data_size, void **con_cls) {
+    (void)cls; (void)url; (void)method; (void)version; (void)upload_data; (void)upload_data_size;
+
+    const char *params[1] = { user_id };
+    if (!use_async) {
+        return respond(connection, exec_blocking(params));
+    }
+
+    // Second call, after db_async resumed the connection
+    db_async_call_t *call = *con_cls;
+    if (call) {
+        return respond(connection, db_async_take_result(call));
+    }
+
+    call = calloc(1, sizeof(*call));
+    if (call && db_async_begin(call, connection, STMT_FRIENDS_LOCATIONS, params) == 0) {
+        *con_cls = call;
+        return MHD_YES;
+    }
+    free(call);
+    return respond(connection, exec_blocking(params));
+}
+
+static void bench_completed(void *cls, struct MHD_Connection *connection,
+                            void **con_cls, enum MHD_RequestTerminationCode toe) {
+    (void)cls; (void)connection; (void)toe;
+    if (*con_cls) {
+        db_async_call_release(*con_cls);
+        free(*con_cls);
+        *con_cls = NULL;
+    }
+}
+
+typedef struct {
+    int port;
+    double deadline;
+    long completed;
+    long failed;
+    double *latency_ms;
+} client_state_t;
+
+static void* client_thread(void *arg) {
+    client_state_t *state = arg;
+    int fd = bench_http_connect(state->port);
+
+    while (bench_now() < state->deadline) {
+        if (fd < 0) {
+            fd = bench_http_connect(state->port);
+            if (fd < 0) {
+                state->failed++;
+                usleep(1000);
+                continue;
+            }
+        }
+        double start = bench_now();
+        if (bench_http_request(fd, "GET", "/", NULL, NULL, 0, NULL) == 200) {
+            if (state->completed < MAX_SAMPLES_PER_CLIENT) {
+                state->latency_ms[state->completed] = (bench_now() - start) * 1000.0;
+            }
+            state->completed++;
+        } else {
+            state->failed++;
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run_round(const char *label, int port, int workers, int clients, int seconds) {
+    http_engine_config_t config;
+    http_engine_config_defaults(&config);
+    config.mode = HTTP_ENGINE_THREAD_POOL;
+    config.port = (unsigned int)port;
+    config.thread_pool_size = (unsigned int)workers;
+    config.connection_limit = (unsigned int)clients * 2;
+
+    struct MHD_Daemon *daemon = http_engine_start(&config, &bench_handler, NULL, &bench_completed, NULL);
+    if (!daemon) {
+        fprintf(stderr, "Failed to start daemon on port %d\n", port);
+        return;
+    }
+
+    pthread_t *tids = calloc((size_t)clients, sizeof(pthread_t));
+    client_state_t *states = calloc((size_t)clients, sizeof(client_state_t));
+    double start = bench_now();
+    for (int i = 0; i < clients; i++) {
+        states[i].port = port;
+        states[i].deadline = start + seconds;
+        states[i].latency_ms = malloc(MAX_SAMPLES_PER_CLIENT * sizeof(double));
+        pthread_create(&tids[i], NULL, client_thread, &states[i]);
+    }
+
+    long completed = 0, failed = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tids[i], NULL);
+        completed += states[i].completed;
+        failed += states[i].failed;
+    }
+    double elapsed = bench_now() - start;
+
+    if (use_async) {
+        db_async_stop(); // Resumes anything still parked before the daemon stops
+    }
+    MHD_stop_daemon(daemon);
+
+    size_t samples = 0;
+    double *all = malloc((size_t)(completed > 0 ? completed : 1) * sizeof(double));
+    for (int i = 0; i < clients; i++) {
+        long n = states[i].completed < MAX_SAMPLES_PER_CLIENT ? states[i].completed : MAX_SAMPLES_PER_CLIENT;
+        memcpy(all + samples, states[i].latency_ms, (size_t)n * sizeof(double));
+        samples += (size_t)n;
+        free(states[i].latency_ms);
+    }
+    qsort(all, samples, sizeof(double), compare_double);
+
+    if (samples == 0) {
+        printf("%-10s %12s\n", label, "no requests completed");
+    } else {
+        printf("%-10s %12.0f %10.2f %10.2f %10.2f %8ld\n", label, completed / elapsed,
+               all[samples / 2], all[samples * 9 / 10], all[samples * 99 / 100], failed);
+    }
+    free(all);
+    free(tids);
+    free(states);
+}
+
+int main(void) {
+    const char *conninfo = getenv("GEO_BENCH_CONN");
+    if (!conninfo) {
+        conninfo = CONN_STR;
+    }
+    int workers = bench_env_int("BENCH_WORKERS", 4);
+    int clients = bench_env_int("BENCH_CLIENTS", 256);
+    int seconds = bench_env_int("BENCH_SECONDS", 5);
+    int connections = bench_env_int("BENCH_ASYNC_CONNECTIONS", 4);
+    int port = bench_env_int("BENCH_PORT", 18084);
+    snprintf(user_id, sizeof(user_id), "%d", bench_env_int("BENCH_USER_ID", 1));
+
+    // One pooled connection per worker: the most the blocking path can use at once
+    if (db_pool_init(conninfo, (unsigned int)workers, 5000) != 0) {
+        fprintf(stderr, "Could not connect; set GEO_BENCH_CONN\n");
+        return 1;
+    }
+
+    printf("Friends-locations query: %d workers, %d keep-alive clients, %d s per round\n\n",
+           workers, clients, seconds);
+    printf("%-10s %12s %10s %10s %10s %8s\n", "mode", "req/s", "p50 ms", "p90 ms", "p99 ms", "errors");
+
+    use_async = 0;
+    run_round("blocking", port++, workers, clients, seconds);
+
+    if (db_async_start(conninfo, (unsigned int)connections) != 0) {
+        fprintf(stderr, "db_async could not connect\n");
+        db_pool_shutdown();
+        return 1;
+    }
+    use_async = 1;
+    run_round("async", port++, workers, clients, seconds);
+
+    db_async_stats_t stats;
+    db_async_get_stats(&stats);
+    printf("\nasync: %u connections, %lu completed, %lu failed, %lu refused, max %lu in flight\n",
+           stats.connections, stats.completed, stats.failed, stats.queue_full, stats.max_in_flight);
+
+    db_pool_shutdown();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#define _GNU_SOURCE
+// Friend fan-out latency from the in-memory CSR graph, by user degree.
+//
+// Builds a synthetic graph of BENCH_USERS users with BENCH_DEGREE random friends
+// each, plus hub users with thousands of friends, then times friend_graph_for_each()
+// before and after the delta log fills up. No database needed. Run with:
+//   make bench && ./build/bench_friend_graph
+// Tunables: BENCH_USERS (200000), BENCH_DEGREE (20), BENCH_ITERATIONS (2000)
+// Compare with the SQL path using the "friends list" case in bench_prepared.
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/auth/friend_graph.h"
+
+static void count_friend(int32_t friend_id, const char *username, void *ctx) {
+    (void)username;
+    *(int64_t *)ctx += friend_id;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Time `iterations` fan-outs for user_id and print p50/p99 in microseconds
+static void measure(const char *label, int32_t user_id, int iterations) {
+    double *samples = malloc((size_t)iterations * sizeof(double));
+    int64_t sink = 0;
+    size_t degree = 0;
+    for (int i = 0; i < iterations; i++) {
+        double start = bench_now();
+        degree = friend_graph_for_each(user_id, count_friend, &sink);
+        samples[i] = (bench_now() - start) * 1e6;
+    }
+    qsort(samples, (size_t)iterations, sizeof(double), compare_double);
+    printf("%-22s %8zu %10.2f %10.2f %12.1f\n", label, degree, samples[iterations / 2],
+           samples[iterations * 99 / 100], degree / (samples[iterations / 2] > 0 ? samples[iterations / 2] : 1));
+    free(samples);
+    if (sink == 42) {
+        printf(" ");  // Keep the callback from being optimised away
+    }
+}
+
+int main(void) {
+    int users = bench_env_int("BENCH_USERS", 200000);
+    int degree = bench_env_int("BENCH_DEGREE", 20);
+    int iterations = bench_env_int("BENCH_ITERATIONS", 2000);
+    const int hub_degrees[] = { 100, 1000, 5000, 20000 };
+    const int hubs = sizeof(hub_degrees) / sizeof(hub_degrees[0]);
+
+    size_t max_pairs = (size_t)users * degree / 2 + 30000;
+    int32_t *pairs = malloc(max_pairs * 2 * sizeof(int32_t));
+    if (!pairs) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // Ordinary users: random pairs among ids 100..users; hubs are ids 1..hubs
+    srand(42);
+    size_t n = 0;
+    for (size_t i = 0; i < (size_t)users * degree / 2; i++) {
+        int32_t a = 100 + rand() % (users - 100), b = 100 + rand() % (users - 100);
+        if (a == b) {
+            continue;
+        }
+        pairs[2 * n] = a < b ? a : b;
+        pairs[2 * n + 1] = a < b ? b : a;
+        n++;
+    }
+    for (int h = 0; h < hubs; h++) {
+        for (int i = 0; i < hub_degrees[h] && n < max_pairs; i++) {
+            pairs[2 * n] = h + 1;
+            pairs[2 * n + 1] = 100 + (int32_t)(((int64_t)i * 7919) % (users - 100));
+            n++;
+        }
+    }
+
+    double start = bench_now();
+    if (friend_graph_build(pairs, n) != 0) {
+        fprintf(stderr, "Graph build failed\n");
+        return 1;
+    }
+    printf("Built CSR graph: %d users, %zu friendships in %.1f ms\n\n", users, n, (bench_now() - start) * 1e3);
+    free(pairs);
+
+    printf("%-22s %8s %10s %10s %12s\n", "case", "friends", "p50 us", "p99 us", "friends/us");
+    measure("typical user", 100 + users / 2, iterations);
+    for (int h = 0; h < hubs; h++) {
+        char label[32];
+        snprintf(label, sizeof(label), "hub, %d friends", hub_degrees[h]);
+        measure(label, h + 1, iterations);
+    }
+
+    // Fill the delta log to just below its compaction threshold: every reader now scans it too
+    for (int i = 0; i < FRIEND_GRAPH_DELTA_MAX - 1; i++) {
+        friend_graph_add_edge(50, 100 + i);
+    }
+    printf("\nWith %d edges in the delta log:\n", FRIEND_GRAPH_DELTA_MAX - 1);
+    measure("typical user", 100 + users / 2, iterations);
+    measure("hub, 5000 friends", 3, iterations);
+
+    start = bench_now();
+    friend_graph_add_edge(51, 100);
+    friend_graph_add_edge(51, 101);
+    friend_graph_stats_t stats;
+    friend_graph_get_stats(&stats);
+    printf("\nCompaction of %lu edges took %.1f ms\n", stats.edges, stats.last_compaction_ms);
+    return 0;
+}
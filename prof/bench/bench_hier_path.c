@@ -0,0 +1,89 @@
+#define _GNU_SOURCE
+// Coarse-to-fine H3 planning against full-resolution A* and the grid line.
+//
+// Routes leave central Berlin for cities 30 to 2900 km away at resolution BENCH_RES.
+// For each one it reports the planner's levels, cells expanded, corridor size and
+// time, and gridPathCells() on the same pair (which fails across icosahedron faces).
+// Routes short enough for A* within BENCH_MAX_EXPANSIONS also report how much longer
+// the planner's path is than the optimum. No database needed. Run with:
+//   make bench && ./build/bench_hier_path
+// Tunables: BENCH_RES (9), BENCH_MAX_EXPANSIONS (2000000)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/routing/hier_path.h"
+#include "../src/routing/astar.h"
+#include <math.h>
+
+typedef struct {
+    const char *name;
+    double lat, lng;
+} place_t;
+
+static H3Index cell_at(double lat, double lng, int res) {
+    LatLng coord = { degsToRads(lat), degsToRads(lng) };
+    H3Index cell = 0;
+    latLngToCell(&coord, res, &cell);
+    return cell;
+}
+
+int main(void) {
+    int res = bench_env_int("BENCH_RES", 9);
+    size_t max_expansions = (size_t)bench_env_int("BENCH_MAX_EXPANSIONS", 2000000);
+    static const place_t places[] = {
+        { "Potsdam", 52.40, 13.06 },
+        { "Leipzig", 51.34, 12.37 },
+        { "Hamburg", 53.55, 9.99 },
+        { "Munich", 48.14, 11.58 },
+        { "Paris", 48.86, 2.35 },
+        { "Madrid", 40.42, -3.70 },
+        { "Cairo", 30.04, 31.24 },
+    };
+    H3Index start = cell_at(52.52, 13.405, res);
+
+    printf("Berlin to each city, resolution %d; planner starts at %d, steps %d, corridor %d ring(s)\n\n",
+           res, HIER_COARSE_RES, HIER_RES_STEP, HIER_CORRIDOR_RINGS);
+    printf("%-8s %8s %6s %10s %10s %9s %9s %9s %9s\n", "to", "cells", "levels", "expanded", "corridor",
+           "plan ms", "line", "A* ms", "overhead");
+    for (size_t i = 0; i < sizeof(places) / sizeof(places[0]); i++) {
+        H3Index end = cell_at(places[i].lat, places[i].lng, res);
+
+        hier_search_t plan;
+        H3Index *path = NULL;
+        double begin = bench_now();
+        int cells = hier_h3_path(NULL, start, end, &path, &plan);
+        double plan_ms = (bench_now() - begin) * 1000.0;
+        free(path);
+
+        // The old approach: the whole straight line at full resolution
+        char line[16] = "failed";
+        int64_t line_size;
+        if (gridPathCellsSize(start, end, &line_size) == E_SUCCESS) {
+            H3Index *cells_line = malloc((size_t)line_size * sizeof(H3Index));
+            if (cells_line && gridPathCells(start, end, cells_line) == E_SUCCESS) {
+                snprintf(line, sizeof(line), "%lld", (long long)line_size);
+            }
+            free(cells_line);
+        }
+
+        if (cells < 0) {
+            printf("%-8s %8s %6d %10zu %10zu %9.1f %9s\n", places[i].name,
+                   cells == HIER_BUDGET_EXCEEDED ? "budget" : "failed", plan.levels, plan.expanded,
+                   plan.corridor_cells, plan_ms, line);
+            continue;
+        }
+
+        // Optimal cost for comparison, when full-resolution A* can afford it
+        char astar_ms[16] = "-", overhead[16] = "-";
+        astar_search_t full;
+        begin = bench_now();
+        if (astar_h3_path(NULL, start, end, max_expansions, &path, &full) > 0) {
+            snprintf(astar_ms, sizeof(astar_ms), "%.1f", (bench_now() - begin) * 1000.0);
+            snprintf(overhead, sizeof(overhead), "%.2f%%", (plan.cost_km / full.cost_km - 1) * 100.0);
+            free(path);
+        }
+        printf("%-8s %8d %6d %10zu %10zu %9.1f %9s %9s %9s\n", places[i].name, cells, plan.levels,
+               plan.expanded, plan.corridor_cells, plan_ms, line, astar_ms, overhead);
+    }
+    return 0;
+}
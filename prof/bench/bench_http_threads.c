@@ -0,0 +1,134 @@
+#define _GNU_SOURCE
+// Throughput of the HTTP engine as the worker pool grows.
+//
+// Every request sleeps for BENCH_WORK_US microseconds to stand in for a
+// blocking PQconnectdb/PQexec, which is exactly what serialises the
+// single-threaded daemon. Run with:
+//   make bench && ./build/bench_http_threads
+// Tunables: BENCH_CLIENTS (64), BENCH_SECONDS (3), BENCH_WORK_US (2000), BENCH_PORT (18080)
+
+#include "bench_util.h"
+#include "../src/http_engine.h"
+#include <pthread.h>
+
+static int work_us;
+
+static enum MHD_Result bench_handler(void *cls, struct MHD_Connection *connection,
+                                     const char *url, const char *method,
+                                     const char *version, const char *upload_data,
+                                     size_t *upload_data_size, void **con_cls) {
+    (void)cls; (void)url; (void)method; (void)version; (void)upload_data;
+    (void)upload_data_size; (void)con_cls;
+
+    usleep((useconds_t)work_us);
+
+    static const char body[] = "{\"success\": \"ok\"}";
+    struct MHD_Response *response = MHD_create_response_from_buffer(sizeof(body) - 1, (void *)body,
+                                                                   MHD_RESPMEM_PERSISTENT);
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+typedef struct {
+    int port;
+    double deadline;
+    long completed;
+    long failed;
+} client_state_t;
+
+static void* client_thread(void *arg) {
+    client_state_t *state = arg;
+    int fd = bench_http_connect(state->port);
+
+    while (bench_now() < state->deadline) {
+        if (fd < 0) {
+            fd = bench_http_connect(state->port);
+            if (fd < 0) {
+                state->failed++;
+                usleep(1000);
+                continue;
+            }
+        }
+        if (bench_http_request(fd, "GET", "/", NULL, NULL, 0, NULL) == 200) {
+            state->completed++;
+        } else {
+            state->failed++;
+            close(fd);
+            fd = -1;
+        }
+    }
+
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+static double run_round(http_engine_mode_t mode, unsigned int threads, int port,
+                        int clients, int seconds, long *failed) {
+    http_engine_config_t config;
+    http_engine_config_defaults(&config);
+    config.mode = mode;
+    config.port = (unsigned int)port;
+    config.thread_pool_size = threads;
+    config.connection_limit = (unsigned int)clients * 2;
+
+    struct MHD_Daemon *daemon = http_engine_start(&config, &bench_handler, NULL, NULL, NULL);
+    if (!daemon) {
+        fprintf(stderr, "Failed to start daemon on port %d\n", port);
+        return -1;
+    }
+
+    pthread_t *tids = calloc((size_t)clients, sizeof(pthread_t));
+    client_state_t *states = calloc((size_t)clients, sizeof(client_state_t));
+    double start = bench_now();
+
+    for (int i = 0; i < clients; i++) {
+        states[i].port = port;
+        states[i].deadline = start + seconds;
+        pthread_create(&tids[i], NULL, client_thread, &states[i]);
+    }
+
+    long completed = 0;
+    *failed = 0;
+    for (int i = 0; i < clients; i++) {
+        pthread_join(tids[i], NULL);
+        completed += states[i].completed;
+        *failed += states[i].failed;
+    }
+    double elapsed = bench_now() - start;
+
+    MHD_stop_daemon(daemon);
+    free(tids);
+    free(states);
+    return completed / elapsed;
+}
+
+int main(void) {
+    int clients = bench_env_int("BENCH_CLIENTS", 64);
+    int seconds = bench_env_int("BENCH_SECONDS", 3);
+    int port = bench_env_int("BENCH_PORT", 18080);
+    work_us = bench_env_int("BENCH_WORK_US", 2000);
+
+    printf("HTTP engine scaling: %d keep-alive clients, %d s per round, %d us blocking work per request\n\n",
+           clients, seconds, work_us);
+    printf("%-24s %8s %12s %10s %8s\n", "mode", "workers", "req/s", "speedup", "errors");
+
+    long failed = 0;
+    double baseline = run_round(HTTP_ENGINE_SINGLE_THREAD, 1, port++, clients, seconds, &failed);
+    printf("%-24s %8u %12.0f %9.2fx %8ld\n", "single", 1u, baseline, 1.0, failed);
+
+    static const unsigned int pool_sizes[] = { 1, 2, 4, 8, 16, 32 };
+    for (size_t i = 0; i < sizeof(pool_sizes) / sizeof(pool_sizes[0]); i++) {
+        double rps = run_round(HTTP_ENGINE_THREAD_POOL, pool_sizes[i], port++, clients, seconds, &failed);
+        printf("%-24s %8u %12.0f %9.2fx %8ld\n", "pool", pool_sizes[i], rps,
+               baseline > 0 ? rps / baseline : 0.0, failed);
+    }
+
+    double rps = run_round(HTTP_ENGINE_THREAD_PER_CONNECTION, 1, port++, clients, seconds, &failed);
+    printf("%-24s %8d %12.0f %9.2fx %8ld\n", "thread-per-connection", clients, rps,
+           baseline > 0 ? rps / baseline : 0.0, failed);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#define _GNU_SOURCE
+// Decode cost and size of a location report: JSON vs. the binary record format.
+//
+// Encodes BENCH_REPORTS reports both ways, then decodes them BENCH_ROUNDS times the way
+// the server does: json_tokener_parse() plus object lookups for JSON, and
+// location_wire_parse()/location_wire_decode() for binary records, both as single
+// reports and as one batch. Reports nanoseconds per report and bytes per report. No
+// server or database needed:
+//   make bench && ./build/bench_location_wire
+// Tunables: BENCH_REPORTS (1000), BENCH_ROUNDS (200)
+
+#include "bench_util.h"
+#include "../src/location/location_wire.h"
+#include <json-c/json.h>
+
+// Keeps the optimizer from discarding decoded values
+static volatile double sink;
+
+int main(void) {
+    int reports = bench_env_int("BENCH_REPORTS", 1000);
+    int rounds = bench_env_int("BENCH_ROUNDS", 200);
+    if (reports < 1 || reports > 0xFFFF || rounds < 1) {
+        fprintf(stderr, "BENCH_REPORTS must be 1..65535 and BENCH_ROUNDS positive\n");
+        return 1;
+    }
+
+    char **json = malloc((size_t)reports * sizeof(char *));
+    size_t batch_size = LOCATION_WIRE_HEADER_SIZE + (size_t)reports * LOCATION_WIRE_RECORD_SIZE;
+    unsigned char *batch = malloc(batch_size);
+    size_t json_bytes = 0;
+
+    size_t pos = location_wire_encode_header((uint16_t)reports, batch);
+    for (int i = 0; i < reports; i++) {
+        location_wire_record_t record = {
+            .user_id = 100000 + i,
+            .accuracy = 5 + i % 50,
+            .latitude = 46.0 + (i % 1000) * 1.37e-4,
+            .longitude = 14.5 + (i % 997) * 2.11e-4,
+            .ts_ms = 1760000000000LL + i,
+        };
+        pos += location_wire_encode(&record, batch + pos);
+
+        char buf[256];
+        int len = snprintf(buf, sizeof(buf),
+                           "{\"user_id\":\"%d\",\"latitude\":%.7f,\"longitude\":%.7f,\"accuracy\":%d,\"ts\":%lld}",
+                           record.user_id, record.latitude, record.longitude, record.accuracy,
+                           (long long)record.ts_ms);
+        json[i] = strdup(buf);
+        json_bytes += (size_t)len;
+    }
+
+    // JSON: what handle_post_save_location() does per report
+    double start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < reports; i++) {
+            json_object *obj = json_tokener_parse(json[i]);
+            json_object *user_id_obj, *lat_obj, *lon_obj, *accuracy_obj, *ts_obj;
+            if (!obj ||
+                !json_object_object_get_ex(obj, "user_id", &user_id_obj) ||
+                !json_object_object_get_ex(obj, "latitude", &lat_obj) ||
+                !json_object_object_get_ex(obj, "longitude", &lon_obj) ||
+                !json_object_object_get_ex(obj, "accuracy", &accuracy_obj) ||
+                !json_object_object_get_ex(obj, "ts", &ts_obj)) {
+                fprintf(stderr, "JSON decode failed\n");
+                return 1;
+            }
+            sink = atoi(json_object_get_string(user_id_obj)) + json_object_get_double(lat_obj) +
+                   json_object_get_double(lon_obj) + json_object_get_int(accuracy_obj) +
+                   json_object_get_double(ts_obj);
+            json_object_put(obj);
+        }
+    }
+    double json_ns = (bench_now() - start) * 1e9 / ((double)rounds * reports);
+
+    // Binary, one bare record per message
+    start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        for (int i = 0; i < reports; i++) {
+            const unsigned char *records;
+            location_wire_record_t record;
+            const unsigned char *message = batch + LOCATION_WIRE_HEADER_SIZE + (size_t)i * LOCATION_WIRE_RECORD_SIZE;
+            if (location_wire_parse(message, LOCATION_WIRE_RECORD_SIZE, &records) != 1 ||
+                location_wire_decode(records, &record) != 0) {
+                fprintf(stderr, "Binary decode failed\n");
+                return 1;
+            }
+            sink = record.user_id + record.latitude + record.longitude + record.accuracy + (double)record.ts_ms;
+        }
+    }
+    double single_ns = (bench_now() - start) * 1e9 / ((double)rounds * reports);
+
+    // Binary, the whole set as one batch
+    start = bench_now();
+    for (int r = 0; r < rounds; r++) {
+        const unsigned char *records;
+        int count = location_wire_parse(batch, batch_size, &records);
+        if (count != reports) {
+            fprintf(stderr, "Batch decode failed\n");
+            return 1;
+        }
+        for (int i = 0; i < count; i++) {
+            location_wire_record_t record;
+            location_wire_decode(records + (size_t)i * LOCATION_WIRE_RECORD_SIZE, &record);
+            sink = record.user_id + record.latitude + record.longitude + record.accuracy + (double)record.ts_ms;
+        }
+    }
+    double batch_ns = (bench_now() - start) * 1e9 / ((double)rounds * reports);
+
+    printf("%d reports x %d rounds\n", reports, rounds);
+    printf("%-16s %12s %14s\n", "format", "ns/report", "bytes/report");
+    printf("%-16s %12.1f %14.1f\n", "json", json_ns, (double)json_bytes / reports);
+    printf("%-16s %12.1f %14.1f\n", "binary", single_ns, (double)LOCATION_WIRE_RECORD_SIZE);
+    printf("%-16s %12.1f %14.1f\n", "binary batch", batch_ns, (double)batch_size / reports);
+
+    for (int i = 0; i < reports; i++) {
+        free(json[i]);
+    }
+    free(json);
+    free(batch);
+    return 0;
+}
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE
+// snprintf + PQexec versus the prepared-statement registry on the hot queries.
+//
+// Needs a reachable database with the schema loaded. Run with:
+//   make bench && GEO_BENCH_CONN="host=localhost dbname=..." ./build/bench_prepared
+// Tunables: BENCH_ITERATIONS (5000), BENCH_USER_ID (1)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/db/db_pool.h"
+#include "../src/db/db_statements.h"
+
+typedef struct {
+    const char *label;
+    db_stmt_id_t stmt;
+    const char *legacy_format; // The query as api_server/auth/location used to build it
+} bench_case_t;
+
+static double run_legacy(PGconn *conn, const bench_case_t *c, const char *arg, int iterations) {
+    char query[1024];
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++) {
+        snprintf(query, sizeof(query), c->legacy_format, arg, arg, arg, arg);
+        PGresult *res = PQexec(conn, query);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "%s (legacy) failed: %s", c->label, PQerrorMessage(conn));
+            PQclear(res);
+            return -1;
+        }
+        PQclear(res);
+    }
+    return (bench_now() - start) * 1e6 / iterations;
+}
+
+static double run_prepared(PGconn *conn, const bench_case_t *c, const char *arg, int iterations) {
+    const char *params[1] = { arg };
+    double start = bench_now();
+    for (int i = 0; i < iterations; i++) {
+        PGresult *res = db_exec_prepared(conn, c->stmt, params);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "%s (prepared) failed: %s", c->label, PQerrorMessage(conn));
+            PQclear(res);
+            return -1;
+        }
+        PQclear(res);
+    }
+    return (bench_now() - start) * 1e6 / iterations;
+}
+
+int main(void) {
+    const char *conninfo = getenv("GEO_BENCH_CONN");
+    int iterations = bench_env_int("BENCH_ITERATIONS", 5000);
+    char user_id[16];
+    snprintf(user_id, sizeof(user_id), "%d", bench_env_int("BENCH_USER_ID", 1));
+
+    db_pool_init(conninfo ? conninfo : CONN_STR, 1, 5000);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        fprintf(stderr, "Could not connect; set GEO_BENCH_CONN\n");
+        return 1;
+    }
+
+    // A token that is not in user_sessions still exercises parse, plan and the index probe
+    const char *token = "0000000000000000000000000000000000000000000000000000000000000000";
+
+    const bench_case_t cases[] = {
+        { "session lookup", STMT_SESSION_LOOKUP,
+          "SELECT user_id, expires_at FROM user_sessions WHERE session_token = '%s';" },
+        { "location by user", STMT_LOCATION_BY_USER,
+          "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = %s;" },
+        { "friends list", STMT_FRIENDS_LIST,
+          "SELECT u.id, u.username FROM friendships f JOIN users u ON (CASE "
+          "WHEN f.user_id = %s THEN f.friend_id WHEN f.friend_id = %s THEN f.user_id END) = u.id "
+          "WHERE (f.user_id = %s OR f.friend_id = %s) AND f.status = 'accepted';" },
+        { "friends locations", STMT_FRIENDS_LOCATIONS,
+          "SELECT u.id, u.username, ST_Y(ul.location), ST_X(ul.location), 50, ul.updated_at "
+          "FROM user_locations ul JOIN users u ON ul.user_id = u.id WHERE ul.user_id IN ("
+          "SELECT CASE WHEN f.user_id = %s THEN f.friend_id WHEN f.friend_id = %s THEN f.user_id END "
+          "FROM friendships f WHERE (f.user_id = %s OR f.friend_id = %s) AND f.status = 'accepted') "
+          "AND ul.updated_at > NOW() - INTERVAL '10 minutes' ORDER BY ul.updated_at DESC;" },
+    };
+
+    printf("%d iterations per case, one pooled connection\n\n", iterations);
+    printf("%-20s %14s %14s %10s\n", "query", "PQexec us/op", "prepared us/op", "speedup");
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const char *arg = cases[i].stmt == STMT_SESSION_LOOKUP ? token : user_id;
+        // Warm both paths so the prepare itself is not part of the measurement
+        run_legacy(conn, &cases[i], arg, 10);
+        run_prepared(conn, &cases[i], arg, 10);
+
+        double legacy = run_legacy(conn, &cases[i], arg, iterations);
+        double prepared = run_prepared(conn, &cases[i], arg, iterations);
+        printf("%-20s %14.1f %14.1f %9.2fx\n", cases[i].label, legacy, prepared,
+               prepared > 0 ? legacy / prepared : 0.0);
+    }
+
+    db_pool_release(conn);
+    db_pool_shutdown();
+    return 0;
+}
@@ -0,0 +1,145 @@
+#define _GNU_SOURCE
+// Road-graph query latency: contraction hierarchy against plain Dijkstra.
+//
+// Writes a synthetic city street grid (BENCH_GRID x BENCH_GRID intersections about
+// 100-150 m apart, with gaps and one-way streets) as an edge list, contracts it with
+// ch_build, maps the result and routes the same random node pairs with both
+// algorithms. Distances must agree; the bench counts any that differ. No database
+// needed. Run with:
+//   make bench && ./build/bench_road_graph
+// Tunables: BENCH_GRID (200), BENCH_QUERIES (1000), BENCH_EDGES_PATH (/tmp/bench_road_edges.csv),
+//           BENCH_GRAPH_PATH (/tmp/bench_road_graph.ch)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/routing/road_graph.h"
+#include "../src/routing/ch_build.h"
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static const char* env_path(const char *name, const char *fallback) {
+    const char *value = getenv(name);
+    return value && *value ? value : fallback;
+}
+
+static double jitter(void) {
+    return (rand() % 200 - 100) * 2e-6;
+}
+
+// One line per street segment between neighbouring intersections
+static int write_city(const char *path, int grid) {
+    FILE *f = fopen(path, "w");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    fprintf(f, "from_id,from_lat,from_lng,to_id,to_lat,to_lng,length_m,oneway\n");
+    const double lat0 = 52.45, lng0 = 13.30, lat_step = 0.0011, lng_step = 0.0018;
+    double *lat = malloc((size_t)grid * grid * sizeof(double));
+    double *lng = malloc((size_t)grid * grid * sizeof(double));
+    for (int i = 0; i < grid * grid; i++) {
+        lat[i] = lat0 + (i / grid) * lat_step + jitter();
+        lng[i] = lng0 + (i % grid) * lng_step + jitter();
+    }
+    for (int i = 0; i < grid * grid; i++) {
+        int x = i % grid, y = i / grid;
+        int neighbours[2] = { x + 1 < grid ? i + 1 : -1, y + 1 < grid ? i + grid : -1 };
+        for (int k = 0; k < 2; k++) {
+            int j = neighbours[k];
+            if (j < 0 || rand() % 10 == 0) {
+                continue; // Edge of the map, or a block with no through street
+            }
+            // Every 10th street is an arterial: always there, always two-way
+            int arterial = (k == 0 ? y : x) % 10 == 0;
+            int oneway = !arterial && rand() % 7 == 0;
+            fprintf(f, "%d,%.7f,%.7f,%d,%.7f,%.7f,,%d\n", 1000000 + i, lat[i], lng[i], 1000000 + j, lat[j], lng[j], oneway);
+        }
+    }
+    free(lat);
+    free(lng);
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+static void report(const char *label, double *micros, size_t count, size_t settled) {
+    qsort(micros, count, sizeof(double), compare_double);
+    printf("%-12s %10.1f %10.1f %10.1f %12.0f\n", label, micros[count / 2], micros[count * 99 / 100],
+           micros[count - 1], (double)settled / count);
+}
+
+int main(void) {
+    int grid = bench_env_int("BENCH_GRID", 200);
+    int queries = bench_env_int("BENCH_QUERIES", 1000);
+    const char *edges_path = env_path("BENCH_EDGES_PATH", "/tmp/bench_road_edges.csv");
+    const char *graph_path = env_path("BENCH_GRAPH_PATH", "/tmp/bench_road_graph.ch");
+    srand(42);
+
+    if (write_city(edges_path, grid) != 0) {
+        return 1;
+    }
+    ch_build_stats_t build;
+    double begin = bench_now();
+    if (ch_build_from_csv(edges_path, graph_path, ROAD_GRAPH_SNAP_RES, &build) != 0) {
+        return 1;
+    }
+    printf("Built %lu nodes, %lu road segments, %lu shortcuts in %.2f s (contraction %.2f s)\n",
+           build.nodes, build.segments, build.shortcuts, bench_now() - begin, build.seconds);
+    if (road_graph_load(graph_path) != 0) {
+        return 1;
+    }
+
+    double *ch_us = malloc((size_t)queries * sizeof(double));
+    double *dijkstra_us = malloc((size_t)queries * sizeof(double));
+    size_t ch_settled = 0, dijkstra_settled = 0, done = 0;
+    int mismatches = 0;
+    for (int q = 0; q < queries; q++) {
+        uint32_t start = (uint32_t)rand() % build.nodes, end = (uint32_t)rand() % build.nodes;
+        road_route_t ch, plain;
+        double t0 = bench_now();
+        int ch_result = road_graph_query(NULL, start, end, ROAD_QUERY_CH, &ch);
+        double t1 = bench_now();
+        int plain_result = road_graph_query(NULL, start, end, ROAD_QUERY_DIJKSTRA, &plain);
+        double t2 = bench_now();
+        if (ch_result != plain_result || (ch_result == 0 && ch.distance_m != plain.distance_m)) {
+            mismatches++;
+        }
+        if (ch_result == 0 && plain_result == 0) {
+            ch_us[done] = (t1 - t0) * 1e6;
+            dijkstra_us[done] = (t2 - t1) * 1e6;
+            ch_settled += ch.settled;
+            dijkstra_settled += plain.settled;
+            done++;
+        }
+        free(ch.nodes);
+        free(plain.nodes);
+    }
+    if (done == 0) {
+        fprintf(stderr, "No connected pairs\n");
+        return 1;
+    }
+
+    printf("\n%zu routed pairs, %d distance mismatches\n", done, mismatches);
+    printf("%-12s %10s %10s %10s %12s\n", "algorithm", "p50 us", "p99 us", "max us", "settled");
+    report("ch", ch_us, done, ch_settled);
+    report("dijkstra", dijkstra_us, done, dijkstra_settled);
+
+    // Snapping cost on its own
+    begin = bench_now();
+    int snapped = 0;
+    for (int q = 0; q < queries; q++) {
+        uint32_t node;
+        double meters;
+        double lat = 52.45 + (rand() % 1000) / 1000.0 * grid * 0.0011;
+        double lng = 13.30 + (rand() % 1000) / 1000.0 * grid * 0.0018;
+        snapped += road_graph_snap(lat, lng, &node, &meters) == 0;
+    }
+    printf("\nsnap: %.2f us per point (%d of %d within %d rings)\n", (bench_now() - begin) * 1e6 / queries,
+           snapped, queries, ROAD_GRAPH_SNAP_RINGS);
+
+    road_graph_unload();
+    free(ch_us);
+    free(dijkstra_us);
+    return mismatches ? 1 : 0;
+}
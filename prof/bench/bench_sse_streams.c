@@ -0,0 +1,219 @@
+#define _GNU_SOURCE
+// How many friend-location streams one process holds, and how fast updates fan out.
+//
+// Starts the HTTP engine with the location hub, opens BENCH_STREAMS SSE connections
+// from a single epoll client, then publishes BENCH_ROUNDS updates from each of
+// BENCH_PUBLISHERS users whose friends are spread evenly over the streams. Reports
+// resident memory per open stream (server and client share the process, so this is
+// an upper bound) and publish-to-receive latency. No database needed. Run with:
+//   make bench && ./build/bench_sse_streams
+// Tunables: BENCH_STREAMS (10000), BENCH_PUBLISHERS (100), BENCH_ROUNDS (20),
+//           BENCH_PORT (18081), BENCH_MODE (pool | single | thread-per-connection)
+
+#include "bench_util.h"
+#include "../src/api.h"
+#include "../src/http_engine.h"
+#include "../src/auth/friend_graph.h"
+#include "../src/stream/location_hub.h"
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+
+#define MAX_ROUNDS 1000
+
+static double publish_time[MAX_ROUNDS];
+
+static enum MHD_Result bench_handler(void *cls, struct MHD_Connection *connection,
+                                     const char *url, const char *method,
+                                     const char *version, const char *upload_data,
+                                     size_t *upload_data_size, void **con_cls) {
+    (void)cls; (void)url; (void)method; (void)version; (void)upload_data;
+    (void)upload_data_size; (void)con_cls;
+
+    const char *user = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user");
+    struct MHD_Response *response = location_hub_open_stream(connection, user ? atoi(user) : 0,
+                                                             strdup("event: snapshot\ndata: []\n\n"));
+    if (!response) {
+        return MHD_NO;
+    }
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static long rss_kb(void) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) {
+        return 0;
+    }
+    char line[256];
+    long kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "VmRSS:", 6) == 0) {
+            kb = atol(line + 6);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    int streams = bench_env_int("BENCH_STREAMS", 10000);
+    int publishers = bench_env_int("BENCH_PUBLISHERS", 100);
+    int rounds = bench_env_int("BENCH_ROUNDS", 20);
+    int port = bench_env_int("BENCH_PORT", 18081);
+    if (rounds > MAX_ROUNDS) {
+        rounds = MAX_ROUNDS;
+    }
+
+    // Every stream needs a client and a server descriptor
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+    if ((rlim_t)streams * 2 + 64 > limit.rlim_cur) {
+        streams = (int)((limit.rlim_cur - 64) / 2);
+        printf("Open file limit caps the run at %d streams\n", streams);
+    }
+
+    // Stream users are 1..streams; publisher p is user streams+1+p and befriends every
+    // publishers-th stream user
+    size_t pair_count = (size_t)streams;
+    int32_t *pairs = malloc(pair_count * 2 * sizeof(int32_t));
+    for (int i = 0; i < streams; i++) {
+        pairs[2 * i] = i + 1;
+        pairs[2 * i + 1] = streams + 1 + i % publishers;
+    }
+    if (friend_graph_build(pairs, pair_count) != 0) {
+        fprintf(stderr, "Graph build failed\n");
+        return 1;
+    }
+    free(pairs);
+
+    http_engine_config_t config;
+    http_engine_config_defaults(&config);
+    config.port = (unsigned int)port;
+    config.connection_limit = (unsigned int)streams + 64;
+    config.connection_timeout = 0;
+    const char *mode = getenv("BENCH_MODE");
+    if (mode && http_engine_mode_from_string(mode, &config.mode) != 0) {
+        fprintf(stderr, "Unknown BENCH_MODE %s\n", mode);
+        return 1;
+    }
+
+    if (location_hub_init(config.mode == HTTP_ENGINE_THREAD_PER_CONNECTION) != 0) {
+        return 1;
+    }
+    struct MHD_Daemon *daemon = http_engine_start(&config, &bench_handler, NULL, NULL, NULL);
+    if (!daemon) {
+        fprintf(stderr, "Failed to start daemon on port %d\n", port);
+        return 1;
+    }
+
+    long rss_before = rss_kb();
+    int epfd = epoll_create1(0);
+    int *fds = malloc((size_t)streams * sizeof(int));
+    int opened = 0;
+    double start = bench_now();
+    for (int i = 0; i < streams; i++) {
+        fds[i] = bench_http_connect(port);
+        if (fds[i] < 0) {
+            fprintf(stderr, "Connect failed after %d streams: %s\n", i, strerror(errno));
+            break;
+        }
+        char request[128];
+        int len = snprintf(request, sizeof(request),
+                           "GET /stream?user=%d HTTP/1.1\r\nHost: localhost\r\n\r\n", i + 1);
+        bench_write_all(fds[i], request, (size_t)len);
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)i };
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fds[i], &ev);
+        opened++;
+    }
+
+    // Wait until every stream has delivered its snapshot
+    char buf[65536];
+    struct epoll_event events[512];
+    unsigned char *ready = calloc((size_t)streams, 1);
+    int snapshots = 0;
+    while (snapshots < opened && bench_now() - start < 60) {
+        int n = epoll_wait(epfd, events, 512, 1000);
+        for (int e = 0; e < n; e++) {
+            uint32_t i = events[e].data.u32;
+            ssize_t got = read(fds[i], buf, sizeof(buf) - 1);
+            if (got <= 0) {
+                continue;
+            }
+            buf[got] = '\0';
+            if (!ready[i] && strstr(buf, "event: snapshot")) {
+                ready[i] = 1;
+                snapshots++;
+            }
+        }
+    }
+    double open_secs = bench_now() - start;
+    long rss_after = rss_kb();
+
+    location_hub_stats_t stats;
+    location_hub_get_stats(&stats);
+    printf("Streams open:        %lu of %d (%.2f s)\n", stats.subscribers, streams, open_secs);
+    printf("RSS:                 %ld KiB -> %ld KiB (%.2f KiB per stream)\n", rss_before, rss_after,
+           stats.subscribers ? (double)(rss_after - rss_before) / stats.subscribers : 0.0);
+
+    // Each round every publisher moves once; accuracy carries the round number so the
+    // client can match deliveries to publish times
+    size_t expected = (size_t)rounds * (size_t)snapshots;
+    double *latencies = malloc(expected * sizeof(double));
+    size_t received = 0;
+    for (int round = 0; round < rounds; round++) {
+        publish_time[round] = bench_now();
+        for (int p = 0; p < publishers; p++) {
+            location_hub_publish(streams + 1 + p, 46.05, 14.5, round, 0);
+        }
+
+        size_t target = (size_t)(round + 1) * (size_t)snapshots;
+        double deadline = bench_now() + 10;
+        while (received < target && bench_now() < deadline) {
+            int n = epoll_wait(epfd, events, 512, 100);
+            for (int e = 0; e < n; e++) {
+                uint32_t i = events[e].data.u32;
+                ssize_t got = read(fds[i], buf, sizeof(buf) - 1);
+                if (got <= 0) {
+                    continue;
+                }
+                buf[got] = '\0';
+                double now = bench_now();
+                for (char *p = strstr(buf, "\"accuracy\":"); p; p = strstr(p + 1, "\"accuracy\":")) {
+                    int r = atoi(p + 11);
+                    if (r >= 0 && r < rounds && received < expected) {
+                        latencies[received++] = (now - publish_time[r]) * 1e3;
+                    }
+                }
+            }
+        }
+    }
+
+    location_hub_get_stats(&stats);
+    printf("Events delivered:    %zu of %zu (dropped slow consumers: %lu)\n", received, expected,
+           stats.dropped_slow);
+    if (received > 0) {
+        qsort(latencies, received, sizeof(double), compare_double);
+        printf("Fan-out latency ms:  p50 %.2f  p99 %.2f  max %.2f\n", latencies[received / 2],
+               latencies[received * 99 / 100], latencies[received - 1]);
+    }
+
+    location_hub_shutdown();
+    for (int i = 0; i < opened; i++) {
+        close(fds[i]);
+    }
+    MHD_stop_daemon(daemon);
+    free(latencies);
+    free(ready);
+    free(fds);
+    return 0;
+}
@@ -0,0 +1,117 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+// Small helpers shared by the benchmark programs: a monotonic clock and a
+// minimal blocking HTTP/1.1 keep-alive client.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static inline int bench_env_int(const char *name, int fallback) {
+    const char *value = getenv(name);
+    return value && *value ? atoi(value) : fallback;
+}
+
+// Open a TCP connection to 127.0.0.1:port
+static inline int bench_http_connect(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static inline int bench_write_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n <= 0) {
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Send one request on a keep-alive connection and read the whole response.
+// Returns the HTTP status code, or -1 on a connection error.
+static inline int bench_http_request(int fd, const char *method, const char *path,
+                                     const char *extra_headers,
+                                     const char *body, size_t body_len,
+                                     size_t *response_body_len) {
+    char head[1024];
+    int head_len = snprintf(head, sizeof(head),
+                            "%s %s HTTP/1.1\r\nHost: localhost\r\nContent-Length: %zu\r\n%s\r\n",
+                            method, path, body_len, extra_headers ? extra_headers : "");
+    if (bench_write_all(fd, head, (size_t)head_len) != 0 ||
+        (body_len > 0 && bench_write_all(fd, body, body_len) != 0)) {
+        return -1;
+    }
+
+    char buf[16384];
+    size_t have = 0;
+    char *header_end = NULL;
+    while (!header_end) {
+        if (have == sizeof(buf) - 1) {
+            return -1;
+        }
+        ssize_t n = read(fd, buf + have, sizeof(buf) - 1 - have);
+        if (n <= 0) {
+            return -1;
+        }
+        have += (size_t)n;
+        buf[have] = '\0';
+        header_end = strstr(buf, "\r\n\r\n");
+    }
+
+    int status = atoi(buf + 9); // "HTTP/1.1 200 ..."
+    size_t content_length = 0;
+    const char *cl = strcasestr(buf, "\r\nContent-Length:");
+    if (cl && cl < header_end) {
+        content_length = (size_t)strtoul(cl + 17, NULL, 10);
+    }
+
+    size_t body_have = have - (size_t)(header_end + 4 - buf);
+    while (body_have < content_length) {
+        size_t want = content_length - body_have;
+        ssize_t n = read(fd, buf, want < sizeof(buf) ? want : sizeof(buf));
+        if (n <= 0) {
+            return -1;
+        }
+        body_have += (size_t)n;
+    }
+
+    if (response_body_len) {
+        *response_body_len = content_length;
+    }
+    return status;
+}
+
+#endif // BENCH_UTIL_H
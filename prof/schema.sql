@@ -30,6 +30,9 @@ CREATE INDEX IF NOT EXISTS idx_user_sessions_token ON user_sessions(session_toke
 -- Index on user_id for faster lookups by user
 CREATE INDEX IF NOT EXISTS idx_user_sessions_user_id ON user_sessions(user_id);
 
+-- Index on expires_at so the session sweeper finds expired rows without a full scan
+CREATE INDEX IF NOT EXISTS idx_user_sessions_expires_at ON user_sessions(expires_at);
+
 -- Table: user_locations
 -- Stores the latest known location for each user.
 CREATE TABLE IF NOT EXISTS user_locations (
@@ -15,6 +15,95 @@
 #define PORT 8080
 #define WEB_ROOT "/home/tugmirk/c_/prof/web"
 
+// HTTP engine defaults (overridable via GEO_SERVER_* environment variables)
+#define SERVER_MODE "pool"                 // "single", "pool" or "thread-per-connection"
+#define SERVER_THREAD_POOL_SIZE 0          // 0 = one worker per online CPU
+#define SERVER_CONNECTION_LIMIT 1024
+#define SERVER_PER_IP_CONNECTION_LIMIT 0   // 0 = unlimited
+#define SERVER_CONNECTION_TIMEOUT 30       // Seconds
+#define SERVER_MAX_BODY_SIZE (1024 * 1024) // Largest POST body accepted, in bytes
+
+// Database connection pool (overridable via GEO_DB_POOL_* environment variables)
+#define DB_POOL_SIZE 16
+#define DB_POOL_ACQUIRE_TIMEOUT_MS 2000    // Longest a request waits for a free connection
+#define DB_POOL_HEALTH_CHECK_IDLE_SEC 30   // Ping connections idle longer than this before reuse
+
+// Async database calls (overridable via GEO_DB_ASYNC_* environment variables)
+#define DB_ASYNC_CONNECTIONS 4             // Non-blocking connections driven by one thread; 0 disables
+#define DB_ASYNC_PIPELINE_DEPTH 64         // Statements in flight per connection
+#define DB_ASYNC_QUEUE_LIMIT 4096          // Waiting statements before requests fall back to db_pool
+
+// Sessions
+#define SESSION_LIFETIME_SEC 3600
+#define SESSION_CACHE_CAPACITY 100000      // Sessions held in memory across all shards
+#define SESSION_CACHE_TTL_SEC 300          // Revalidate against the database at least this often
+#define SESSION_SWEEP_INTERVAL_SEC 60      // How often expired sessions are purged
+#define SESSION_SWEEP_BATCH_SIZE 500       // Rows deleted per statement while purging
+
+// Write-behind location buffer (overridable via GEO_LOCATION_* environment variables)
+#define LOCATION_WRITER_CAPACITY 65536       // Users buffered before clients get 503
+#define LOCATION_WRITER_FLUSH_INTERVAL_MS 1000
+#define LOCATION_WRITER_FLUSH_THRESHOLD 4096 // Flush early once this many users are pending
+#define LOCATION_WRITER_BATCH_ROWS 1000      // Rows per upsert statement
+
+// Batch uploads (/api/save-locations)
+#define LOCATION_BATCH_MAX_POINTS 1000       // Points accepted in one request
+#define LOCATION_BATCH_MAX_SKEW_SEC 300      // Reject points stamped further than this in the future
+
+// Friendship graph
+#define FRIEND_GRAPH_DELTA_MAX 1024          // New friendships buffered before the CSR arrays are rebuilt
+
+// Live location store
+#define LIVE_STORE_CAPACITY 1000000          // Users tracked in memory
+#define LOCATION_RECENT_SEC 600              // Friends' positions older than this are not shown
+
+// Friend location streams (Server-Sent Events)
+#define STREAM_MAX_SUBSCRIBERS 100000        // Open streams per process
+#define STREAM_QUEUE_DEPTH 64                // Undelivered events before a client is dropped as too slow
+#define STREAM_KEEPALIVE_SEC 15              // Comment line sent on idle streams to keep proxies from closing them
+#define STREAM_RETRY_MS 3000                 // Reconnect delay suggested to EventSource clients
+
+// WebSocket location channel
+#define WS_MAX_MESSAGE_SIZE 4096             // Largest client message after reassembly
+#define WS_OUT_BUFFER_SIZE 65536             // Unsent bytes per socket before hub events are left queued
+#define WS_PING_INTERVAL_SEC 30
+#define WS_IDLE_TIMEOUT_SEC 90               // Close sockets with no traffic (pongs count) for this long
+
+// Per-request arenas
+#define REQUEST_ARENA_CHUNK_SIZE 16384       // Bytes per arena chunk; larger allocations get their own
+#define REQUEST_ARENA_THREAD_CACHE 32        // Released chunks each thread keeps for reuse
+
+// Static files (web/)
+#define STATIC_CACHE_ENTRIES 64              // Files kept open; more are opened per request
+#define STATIC_CACHE_CHECK_MS 1000           // Re-stat a cached file at most this often
+#define STATIC_CACHE_MAX_AGE_SEC 60          // Cache-Control max-age; clients revalidate with the ETag after
+
+// Response compression (overridable via GEO_COMPRESS_* environment variables)
+#define COMPRESS_LEVEL 6                     // zlib level 1-9; 0 sends every response uncompressed
+#define COMPRESS_MIN_SIZE 1024               // Smaller JSON bodies are not worth the CPU
+
+// Response serialization
+#define JSON_WRITER_RESPONSE_CAPACITY 4096   // Initial buffer for json_writer responses; grows by doubling
+
+// Hex-grid pathfinding
+#define ASTAR_MAX_EXPANSIONS 200000          // Cells one A* search may expand before falling back to the coarse-to-fine planner
+#define HIER_COARSE_RES 5                    // Resolution the coarse-to-fine planner starts at (~8.5 km edges)
+#define HIER_RES_STEP 2                      // Resolutions refined per level; each level searches children of the last path
+#define HIER_CORRIDOR_RINGS 1                // Rings around each level's path that the next level may also enter
+#define HIER_CORRIDOR_MAX_RINGS 4            // A level that finds no path retries with the corridor doubled up to this
+#define HIER_DIRECT_KM 50.0                  // Longer routes skip the full-resolution A*, which would only exhaust its budget
+#define COST_MAP_PATH "./data/cost_map.bin"  // Per-cell traversal costs, mapped at startup when present; GEO_COST_MAP overrides
+#define ALT_TABLE_PATH "./data/alt_landmarks.bin"  // Landmark distances for /api/distance/alt, mapped when present; GEO_ALT_TABLE overrides
+#define ALT_DEFAULT_LANDMARKS 8              // Landmarks alt_build picks when not told; more tighten bounds, cost 4 bytes per cell each
+
+// Road-network routing
+#define ROAD_GRAPH_PATH "./data/road_graph.ch"  // Contraction hierarchy, mapped at startup when present; GEO_ROAD_GRAPH overrides
+#define ROAD_GRAPH_SNAP_RES 9                // Cells the builder buckets nodes by for snapping (~175 m edges)
+#define ROAD_GRAPH_SNAP_RINGS 4              // Rings of snap cells searched for the nearest node before giving up
+
+// Routing
+#define ROUTE_SMALL_BODY_MAX 16384           // Body limit for endpoints taking a single JSON object
+
 // Function declarations
 enum MHD_Result handle_request(void *cls __attribute__((unused)), struct MHD_Connection *connection,
                    const char *url, const char *method,
@@ -22,7 +111,6 @@ enum MHD_Result handle_request(void *cls __attribute__((unused)), struct MHD_Con
                    size_t *upload_data_size, void **con_cls);
 
 // Helper functions
-char* read_file_content(const char *filepath);
 const char* get_content_type(const char *url);
 json_object* get_coordinates_from_db();
 json_object* get_user_locations_from_db();
@@ -35,21 +123,4 @@ int add_friend(const char* user_id, const char* friend_username);
 json_object* get_user_friends(const char* user_id);
 char* get_user_id_by_username(const char* username);
 
-// New functions for friends and locations
-json_object* get_friends_list(const char* user_id);
-json_object* get_friends_locations_from_db(const char* user_id);
-
-// New user authentication and session management functions
-char* generate_session_token();
-int validate_session_token(const char* session_token, char** user_id);
-int hash_password(const char* password, char* hash_buffer, size_t buffer_size);
-int verify_password(const char* password, const char* hash);
-char* register_user(const char* username, const char* password);
-char* login_user(const char* username, const char* password);
-int logout_user(const char* session_token);
-
-// H3 and A* distance calculation functions
-double calculate_h3_distance(const char* user1_id, const char* user2_id);
-double calculate_astar_distance(const char* user1_id, const char* user2_id);
-
 #endif // API_H
\ No newline at end of file
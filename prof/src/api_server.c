@@ -2,222 +2,270 @@
 #include "api_server.h"
 #include "api.h"
 #include "auth/auth.h"
+#include "auth/session_cache.h"
+#include "auth/session_sweeper.h"
+#include "auth/friend_graph.h"
 #include "location/location.h"
+#include "location/location_writer.h"
+#include "location/live_store.h"
+#include "location/location_wire.h"
 #include "routing/routing.h"
+#include "routing/astar.h"
+#include "routing/alt.h"
+#include "routing/hier_path.h"
+#include "routing/cost_map.h"
+#include "routing/road_graph.h"
 #include "utils/utils.h"
+#include "utils/json_writer.h"
+#include "utils/static_files.h"
+#include "utils/compress.h"
 #include "coordinate_logger.h"
+#include "db/db_pool.h"
+#include "db/db_statements.h"
+#include "db/db_async.h"
+#include "request_context.h"
+#include "router.h"
+#include "stream/location_hub.h"
+#include "stream/ws_channel.h"
 #include <json-c/json.h>
+#include <ctype.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <libgen.h>
 #include <time.h>
 
+// Largest POST body accepted; set from the engine config at startup
+static size_t max_body_size = SERVER_MAX_BODY_SIZE;
+
+// Handlers may park requests on db_async; not in thread-per-connection mode, which
+// cannot suspend connections
+static int async_db = 0;
+
+// Every endpoint, keyed on method + path. Flags are applied before the handler runs:
+// ROUTE_AUTH routes reach it with req->user_id set, and max_body caps the upload.
+static const route_t api_routes[] = {
+    { "GET",  "/",                       handle_get_index,              0, 0 },
+    { "GET",  "/web/",                   handle_get_web_file,           ROUTE_PREFIX, 0 },
+    { "GET",  "/api/user",               handle_get_user_info,          ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/friends",            handle_get_friends,            ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/friends/locations",  handle_get_friends_locations,  ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/friends/stream",     handle_get_friends_stream,     ROUTE_AUTH | ROUTE_QUERY_TOKEN, 0 },
+    { "GET",  "/api/ws",                 handle_get_websocket,          ROUTE_AUTH | ROUTE_QUERY_TOKEN, 0 },
+    { "GET",  "/api/route",              handle_get_route,              ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/distance/h3",        handle_get_h3_distance,        ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/distance/astar",     handle_get_astar_distance,     ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/distance/alt",       handle_get_alt_distance,       ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "GET",  "/api/stats",              handle_get_stats,              ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "POST", "/api/register",           handle_post_register,          ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+    { "POST", "/api/login",              handle_post_login,             ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+    { "POST", "/api/logout",             handle_post_logout,            ROUTE_AUTH | ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+    { "POST", "/api/save-location",      handle_post_save_location,     ROUTE_AUTH | ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+    { "POST", "/api/save-locations",     handle_post_save_locations,    ROUTE_AUTH | ROUTE_NO_STORE, 0 },
+    { "POST", "/api/save-locations-bin", handle_post_save_locations_binary, ROUTE_AUTH | ROUTE_NO_STORE,
+      LOCATION_WIRE_HEADER_SIZE + LOCATION_BATCH_MAX_POINTS * LOCATION_WIRE_RECORD_SIZE },
+    { "POST", "/api/add-friend",         handle_post_add_friend,        ROUTE_AUTH | ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+    { "POST", "/calculate-distance",     handle_post_calculate_distance, ROUTE_NO_STORE, ROUTE_SMALL_BODY_MAX },
+};
+
 // Start the API server
 struct MHD_Daemon* start_api_server(void) {
-    printf("DEBUG: Starting API server on port %d\n", PORT);
-    fflush(stdout);
-    
-    struct MHD_Daemon* daemon = MHD_start_daemon(MHD_USE_INTERNAL_POLLING_THREAD, PORT, NULL, NULL,
-                           &handle_request, NULL, MHD_OPTION_END);
+    http_engine_config_t config;
+    http_engine_config_defaults(&config);
+    return start_api_server_with_config(&config);
+}
+
+// Start the API server with an explicit threading/limits configuration
+struct MHD_Daemon* start_api_server_with_config(const http_engine_config_t *config) {
+    max_body_size = config->max_body_size > 0 ? config->max_body_size : SERVER_MAX_BODY_SIZE;
+    async_db = config->mode != HTTP_ENGINE_THREAD_PER_CONNECTION;
+    if (router_init(api_routes, sizeof(api_routes) / sizeof(api_routes[0])) != 0) {
+        return NULL;
+    }
+    struct MHD_Daemon* daemon = http_engine_start(config, &handle_request, NULL,
+                                                  &request_context_completed, NULL);
     
+    // main() prints the port, mode and workers once the server is up
     if (daemon == NULL) {
-        fprintf(stderr, "DEBUG: MHD_start_daemon failed\n");
-        fflush(stderr);
-    } else {
-        printf("DEBUG: API server started successfully\n");
-        fflush(stdout);
+        fprintf(stderr, "Could not start the HTTP daemon on port %u (mode: %s)\n",
+                config->port, http_engine_mode_name(config->mode));
     }
-    
     return daemon;
 }
  
  
  
- // Handle HTTP requests
+static enum MHD_Result queue_post_error(struct MHD_Connection *connection, unsigned int status) {
+    const char *message = status == MHD_HTTP_PAYLOAD_TOO_LARGE ? "Request body too large" : "Internal server error";
+    struct MHD_Response *response = create_error_response(message, status);
+    enum MHD_Result ret = queue_response_with_cors(connection, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+static enum MHD_Result queue_error(struct MHD_Connection *connection, const char *message, unsigned int status) {
+    struct MHD_Response *response = create_error_response(message, status);
+    enum MHD_Result ret = queue_response_with_cors(connection, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Handle HTTP requests. MHD calls this once with the headers, then once per body chunk,
+// then a final time with *upload_data_size == 0. The route is matched, the body limit
+// applied and the session checked on the first call, so rejected uploads are never read.
 enum MHD_Result handle_request(void *cls __attribute__((unused)), struct MHD_Connection *connection,
                    const char *url, const char *method,
                    const char *version __attribute__((unused)), const char *upload_data,
                    size_t *upload_data_size, void **con_cls) {
-    
-    // Debug print
-    printf("Received request: %s %s\n", method, url);
-    fflush(stdout);
-    
-    // Handle GET requests
-    if (strcmp(method, "GET") == 0) {
-        return handle_get_request(connection, url);
-    }
-    
-    // Handle POST requests
-    if (strcmp(method, "POST") == 0) {
-        return handle_post_request(connection, url, upload_data, upload_data_size, con_cls);
-    }
-    
-    // Handle OPTIONS requests for CORS preflight
-    if (strcmp(method, "OPTIONS") == 0) {
-        return handle_options_request(connection);
-    }
-    
-    // Method not allowed
-    struct MHD_Response *response = create_error_response("Method not allowed", MHD_HTTP_METHOD_NOT_ALLOWED);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_METHOD_NOT_ALLOWED, response);
-                MHD_destroy_response(response);
-                return ret;
+    request_context_t *ctx = *con_cls;
+
+    if (ctx == NULL) {
+        // Debug print
+        printf("Received request: %s %s\n", method, url);
+        fflush(stdout);
+
+        // CORS preflight is answered for any path
+        if (strcmp(method, "OPTIONS") == 0) {
+            return handle_options_request(connection);
+        }
+
+        const route_t *route = router_lookup(method, url);
+        if (!route) {
+            // A known path with the wrong method is a 405 that says which methods work
+            char allow[ROUTER_ALLOW_MAX];
+            if (router_allowed_methods(url, allow, sizeof(allow)) == 0) {
+                return queue_error(connection, "Not found", MHD_HTTP_NOT_FOUND);
             }
-            
-// Handle GET requests
-enum MHD_Result handle_get_request(struct MHD_Connection *connection, const char *url) {
-    // Serve index.html for root path
-    if (strcmp(url, "/") == 0) {
-        char filepath[512];
-        snprintf(filepath, sizeof(filepath), "%s/index.html", WEB_ROOT);
-        return serve_static_file(connection, filepath, "text/html");
-    }
-    
-    // API endpoints
-        if (strcmp(url, "/api/user") == 0) {
-        return handle_get_user_info(connection);
-    }
-    
-    if (strcmp(url, "/api/friends") == 0) {
-        return handle_get_friends(connection);
-    }
-    
-    if (strcmp(url, "/api/friends/locations") == 0) {
-        return handle_get_friends_locations(connection);
-    }
-    
-    if (strcmp(url, "/api/route") == 0) {
-        return handle_get_route(connection);
-    }
-    
-    if (strcmp(url, "/api/distance/h3") == 0) {
-        return handle_get_h3_distance(connection);
-    }
-    
-    if (strcmp(url, "/api/distance/astar") == 0) {
-        return handle_get_astar_distance(connection);
-    }
-    
-    // Serve static files from web directory
-    if (strncmp(url, "/web/", 5) == 0) {
-        char filepath[512];
-        snprintf(filepath, sizeof(filepath), "%s%s", WEB_ROOT, url + 4); // Remove /web prefix
-        return serve_static_file(connection, filepath, get_content_type(url));
-    }
-    
-    // Not found
-    struct MHD_Response *response = create_error_response("Not found", MHD_HTTP_NOT_FOUND);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_FOUND, response);
-                MHD_destroy_response(response);
-                return ret;
+            struct MHD_Response *response = create_error_response("Method not allowed", MHD_HTTP_METHOD_NOT_ALLOWED);
+            MHD_add_response_header(response, MHD_HTTP_HEADER_ALLOW, allow);
+            enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_METHOD_NOT_ALLOWED, response);
+            MHD_destroy_response(response);
+            return ret;
+        }
+
+        // Refuse declared oversize bodies before reading a byte of them
+        size_t limit = 0, content_length = 0;
+        int has_body = strcmp(method, "POST") == 0;
+        if (has_body) {
+            limit = route->max_body > 0 && route->max_body < max_body_size ? route->max_body : max_body_size;
+            content_length = request_content_length(connection);
+            if (content_length > limit) {
+                return queue_post_error(connection, MHD_HTTP_PAYLOAD_TOO_LARGE);
             }
-            
+        }
 
+        // Bodiless requests get a context too, so handlers always have an arena to allocate from
+        ctx = request_context_create(limit, content_length);
+        if (!ctx) {
+            return queue_post_error(connection, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        }
+        ctx->route = route;
+        *con_cls = ctx;
 
+        if (route->flags & ROUTE_AUTH) {
+            const char *error = router_authenticate(connection, route, &ctx->arena, &ctx->user_id, &ctx->username,
+                                                    &ctx->session_token);
+            if (error) {
+                return queue_error(connection, error, MHD_HTTP_UNAUTHORIZED);
+            }
+        }
+        if (has_body) {
+            return MHD_YES;
+        }
+    } else if (*upload_data_size > 0) {
+        // Once rejected, keep draining the upload so the 413 can be sent afterwards
+        request_context_append(ctx, upload_data, *upload_data_size);
+        *upload_data_size = 0;
+        return MHD_YES;
+    }
 
+    if (ctx->status != 0) {
+        return queue_post_error(connection, ctx->status);
+    }
 
-// Handle POST requests
-enum MHD_Result handle_post_request(struct MHD_Connection *connection, const char *url, 
-                                   const char *upload_data, size_t *upload_data_size, void **con_cls) {
-    printf("DEBUG: POST request - upload_data_size: %zu, con_cls: %p\n", *upload_data_size, (void*)*con_cls);
-    
-    // For now, just return a success response for testing
-    printf("DEBUG: Returning test success response\n");
-    
-    const char *response_text = "{\"success\": \"Test response\"}";
-    struct MHD_Response *response = MHD_create_response_from_buffer(strlen(response_text), 
-                                                                   (void *)response_text, 
-                                                                   MHD_RESPMEM_PERSISTENT);
-    MHD_add_response_header(response, "Content-Type", "application/json");
-    MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
-    MHD_add_response_header(response, "Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-    MHD_add_response_header(response, "Access-Control-Allow-Headers", "Content-Type, Authorization");
-    MHD_add_response_header(response, "Access-Control-Allow-Credentials", "true");
-    
-    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    printf("DEBUG: Queued test response, result: %d\n", ret);
-    
-    return ret;
+    // request_context_completed() frees the body and arena once the response is sent
+    route_request_t req = {
+        .connection = connection,
+        .route = ctx->route,
+        .url = url,
+        .body = ctx->body,
+        .body_size = ctx->size,
+        .arena = &ctx->arena,
+        .user_id = ctx->user_id,
+        .session_token = ctx->session_token,
+        .username = ctx->username,
+        .state = &ctx->handler_state,
+        .state_free = &ctx->state_free,
+    };
+    return ctx->route->handler(&req);
 }
 
-// Process complete POST data
-enum MHD_Result process_post_data(struct MHD_Connection *connection, const char *url, 
-                                 const char *post_data, size_t post_data_size) {
-    // API endpoints
-    if (strcmp(url, "/api/register") == 0) {
-        return handle_post_register(connection, post_data, post_data_size);
-    }
-    
-    if (strcmp(url, "/api/login") == 0) {
-        return handle_post_login(connection, post_data, post_data_size);
-    }
-    
-    if (strcmp(url, "/api/logout") == 0) {
-        return handle_post_logout(connection);
-    }
-    
-    if (strcmp(url, "/api/save-location") == 0) {
-        return handle_post_save_location(connection, post_data, post_data_size);
-    }
-    
-    if (strcmp(url, "/api/add-friend") == 0) {
-        return handle_post_add_friend(connection, post_data, post_data_size);
-    }
-    
-    if (strcmp(url, "/calculate-distance") == 0) {
-        return handle_post_calculate_distance(connection, post_data, post_data_size);
-    }
-    
-    // Not found
-    struct MHD_Response *response = create_error_response("Not found", MHD_HTTP_NOT_FOUND);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_FOUND, response);
-                    MHD_destroy_response(response);
-                    return ret;
-                }
-                
 // Handle OPTIONS requests
 enum MHD_Result handle_options_request(struct MHD_Connection *connection) {
     struct MHD_Response *response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
     enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
-                MHD_destroy_response(response);
-                return ret;
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Serve index.html for the root path
+enum MHD_Result handle_get_index(route_request_t *req) {
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s/index.html", WEB_ROOT);
+    return serve_static_file(req->connection, filepath, "text/html");
+}
+
+// Serve static files from the web directory
+enum MHD_Result handle_get_web_file(route_request_t *req) {
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s%s", WEB_ROOT, req->url + 4); // Remove /web prefix
+    return serve_static_file(req->connection, filepath, get_content_type(req->url));
 }
 
-// Serve static file
+// Serve static file from the open-file cache (see utils/static_files.h)
 enum MHD_Result serve_static_file(struct MHD_Connection *connection, const char *filepath, const char *content_type) {
-            char *content = read_file_content(filepath);
-            if (!content) {
-        struct MHD_Response *response = create_error_response("File not found", MHD_HTTP_NOT_FOUND);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_FOUND, response);
-                MHD_destroy_response(response);
-                return ret;
-            }
-            
-            struct MHD_Response *response = MHD_create_response_from_buffer(strlen(content), 
-                                                                           (void *)content, 
-                                                                           MHD_RESPMEM_MUST_FREE);
-    MHD_add_response_header(response, "Content-Type", content_type);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
+    return static_files_serve(connection, filepath, content_type);
+}
+
+// Send what a write_* serializer produced, compressed when the client accepts it. The
+// response takes over a heap buffer; an arena buffer is sent in place, since the arena
+// lives until the request completes.
+static enum MHD_Result queue_json_writer(route_request_t *req, json_writer_t *out,
+                                         int result, const char *error_msg) {
+    size_t len = 0;
+    arena_t *arena = out->arena;
+    char *json_str = result == 0 ? json_writer_finish(out, &len) : NULL;
+    struct MHD_Response *response = NULL;
+    if (json_str) {
+        response = create_json_response_negotiated(req->connection, arena, json_str, len, MHD_HTTP_OK);
+    }
+    if (!response) {
+        json_writer_free(out);
+        response = create_error_response(error_msg, MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
 
 // Handle user registration
-enum MHD_Result handle_post_register(struct MHD_Connection *connection, const char *post_data, size_t post_data_size) {
+enum MHD_Result handle_post_register(route_request_t *req) {
+    const char *post_data = req->body;
+    size_t post_data_size = req->body_size;
+    arena_t *arena = req->arena;
     if (!post_data || post_data_size == 0) {
         struct MHD_Response *response = create_error_response("No data received", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
         MHD_destroy_response(response);
         return ret;
     }
     
-    printf("DEBUG: Received post_data: %.*s\n", (int)post_data_size, post_data);
             json_object *json_obj = json_tokener_parse(post_data);
-    printf("DEBUG: JSON parse result: %p\n", (void*)json_obj);
             if (!json_obj) {
         struct MHD_Response *response = create_error_response("Invalid JSON", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 return ret;
             }
@@ -226,7 +274,7 @@ enum MHD_Result handle_post_register(struct MHD_Connection *connection, const ch
             if (!json_object_object_get_ex(json_obj, "username", &username_obj) ||
                 !json_object_object_get_ex(json_obj, "password", &password_obj)) {
         struct MHD_Response *response = create_error_response("Username and password required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 json_object_put(json_obj);
                 return ret;
@@ -235,69 +283,60 @@ enum MHD_Result handle_post_register(struct MHD_Connection *connection, const ch
             const char* username = json_object_get_string(username_obj);
             const char* password = json_object_get_string(password_obj);
             
-            char* user_id = register_user(username, password);
-    printf("DEBUG: register_user returned: %s\n", user_id ? user_id : "NULL");
+            char* user_id = register_user(arena, username, password);
             
             if (!user_id) {
         // Check if it's because user already exists
-        PGconn *conn = PQconnectdb(CONN_STR);
-        if (PQstatus(conn) == CONNECTION_OK) {
-            char query[512];
-            snprintf(query, sizeof(query), 
-                     "SELECT id FROM users WHERE username = '%s';", username);
-            
-            PGresult *res = PQexec(conn, query);
+        PGconn *conn = db_pool_acquire();
+        if (conn) {
+            const char *params[1] = { username };
+            PGresult *res = db_exec_prepared(conn, STMT_USER_BY_USERNAME, params);
             if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) > 0) {
                 // User already exists
                 struct MHD_Response *response = create_error_response("Username already exists", MHD_HTTP_CONFLICT);
-                enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_CONFLICT, response);
+                enum MHD_Result ret = route_queue_response(req, MHD_HTTP_CONFLICT, response);
                 MHD_destroy_response(response);
                 PQclear(res);
-                PQfinish(conn);
+                db_pool_release(conn);
                 json_object_put(json_obj);
                 return ret;
             }
             PQclear(res);
-            PQfinish(conn);
+            db_pool_release(conn);
         }
         
         struct MHD_Response *response = create_error_response("Failed to register user", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
         json_object_put(json_obj);
         return ret;
     }
             
                 // Create success response
-    printf("DEBUG: Creating success response\n");
     const char *response_text = "{\"success\": \"User registered successfully\"}";
     
     struct MHD_Response *response = MHD_create_response_from_buffer(strlen(response_text), 
                                                                    (void *)response_text, 
                                                                    MHD_RESPMEM_PERSISTENT);
     MHD_add_response_header(response, "Content-Type", "application/json");
-    MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
-    MHD_add_response_header(response, "Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
-    MHD_add_response_header(response, "Access-Control-Allow-Headers", "Content-Type, Authorization");
-    MHD_add_response_header(response, "Access-Control-Allow-Credentials", "true");
     
-    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
-    printf("DEBUG: Queued success response, result: %d\n", ret);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
     
     // Clean up
     json_object_put(json_obj);
-    free(user_id);
     
     // Return the result from MHD_queue_response
     return ret;
     }
     
 // Handle user login
-enum MHD_Result handle_post_login(struct MHD_Connection *connection, const char *post_data, size_t post_data_size) {
+enum MHD_Result handle_post_login(route_request_t *req) {
+    const char *post_data = req->body;
+    arena_t *arena = req->arena;
             json_object *json_obj = json_tokener_parse(post_data);
             if (!json_obj) {
         struct MHD_Response *response = create_error_response("Invalid JSON", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 return ret;
             }
@@ -306,7 +345,7 @@ enum MHD_Result handle_post_login(struct MHD_Connection *connection, const char
             if (!json_object_object_get_ex(json_obj, "username", &username_obj) ||
                 !json_object_object_get_ex(json_obj, "password", &password_obj)) {
         struct MHD_Response *response = create_error_response("Username and password required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 json_object_put(json_obj);
                 return ret;
@@ -315,80 +354,82 @@ enum MHD_Result handle_post_login(struct MHD_Connection *connection, const char
             const char* username = json_object_get_string(username_obj);
             const char* password = json_object_get_string(password_obj);
             
-            char* session_token = login_user(username, password);
+            char* session_token = login_user(arena, username, password);
             
             if (!session_token) {
         struct MHD_Response *response = create_error_response("Invalid username or password", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_UNAUTHORIZED, response);
                 MHD_destroy_response(response);
                 json_object_put(json_obj);
                 return ret;
             }
             
             // Create JSON response
-            json_object *response_obj = json_object_new_object();
-            json_object_object_add(response_obj, "session_token", json_object_new_string(session_token));
-            
-            const char *json_str = json_object_to_json_string(response_obj);
-    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
-            MHD_destroy_response(response);
-            json_object_put(response_obj);
+            json_writer_t out;
+            json_writer_init_arena(&out, arena, 128);
+            json_writer_begin_object(&out);
+            json_writer_key(&out, "session_token");
+            json_writer_string(&out, session_token);
+            json_writer_end_object(&out);
             json_object_put(json_obj);
-            free(session_token);
-            return ret;
+            return queue_json_writer(req, &out, 0, "Failed to create session");
     }
     
 // Handle user logout
-enum MHD_Result handle_post_logout(struct MHD_Connection *connection) {
-        const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-        if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-    session_token += 7; // Skip "Bearer " prefix
-        
-        if (logout_user(session_token) != 0) {
+enum MHD_Result handle_post_logout(route_request_t *req) {
+        if (logout_user(req->session_token) != 0) {
         struct MHD_Response *response = create_error_response("Failed to logout", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
             MHD_destroy_response(response);
             return ret;
         }
         
     struct MHD_Response *response = create_success_response("Logged out successfully", MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
         MHD_destroy_response(response);
         return ret;
     }
     
 // Handle save location
-enum MHD_Result handle_post_save_location(struct MHD_Connection *connection, const char *post_data, size_t post_data_size) {
+enum MHD_Result handle_post_save_location(route_request_t *req) {
+    const char *post_data = req->body;
     json_object *json_obj = json_tokener_parse(post_data);
     if (!json_obj) {
         struct MHD_Response *response = create_error_response("Invalid JSON", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
             MHD_destroy_response(response);
             return ret;
         }
         
     json_object *user_id_obj, *lat_obj, *lon_obj, *accuracy_obj;
-    if (!json_object_object_get_ex(json_obj, "user_id", &user_id_obj) ||
-        !json_object_object_get_ex(json_obj, "latitude", &lat_obj) ||
+    if (!json_object_object_get_ex(json_obj, "latitude", &lat_obj) ||
         !json_object_object_get_ex(json_obj, "longitude", &lon_obj)) {
-        struct MHD_Response *response = create_error_response("User ID, latitude and longitude required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        struct MHD_Response *response = create_error_response("Latitude and longitude required", MHD_HTTP_BAD_REQUEST);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
             MHD_destroy_response(response);
         json_object_put(json_obj);
             return ret;
         }
         
-    const char* user_id = json_object_get_string(user_id_obj);
+    // The location is always the signed-in user's; a user_id in the body may only repeat it
+    const char* user_id = req->user_id;
     double latitude = json_object_get_double(lat_obj);
     double longitude = json_object_get_double(lon_obj);
     int accuracy = 50; // Default accuracy
+    const char *error = NULL;
+    if (json_object_object_get_ex(json_obj, "user_id", &user_id_obj) &&
+        json_object_get_int(user_id_obj) != atoi(user_id)) {
+        error = "Invalid user_id";
+    } else if (!location_coordinates_valid(latitude, longitude)) {
+        error = "Coordinates out of range";
+    }
+    if (error) {
+        struct MHD_Response *response = create_error_response(error, MHD_HTTP_BAD_REQUEST);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
+        MHD_destroy_response(response);
+        json_object_put(json_obj);
+        return ret;
+    }
     
     if (json_object_object_get_ex(json_obj, "accuracy", &accuracy_obj)) {
         accuracy = json_object_get_int(accuracy_obj);
@@ -396,297 +437,626 @@ enum MHD_Result handle_post_save_location(struct MHD_Connection *connection, con
     
     int result = save_user_location(user_id, latitude, longitude, accuracy);
     
+    if (result == LOCATION_SAVE_BUSY) {
+        struct MHD_Response *response = create_error_response("Location updates backlogged, retry shortly", MHD_HTTP_SERVICE_UNAVAILABLE);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_RETRY_AFTER, "1");
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_SERVICE_UNAVAILABLE, response);
+        MHD_destroy_response(response);
+        json_object_put(json_obj);
+        return ret;
+    }
+
     if (result != 0) {
         struct MHD_Response *response = create_error_response("Failed to save location", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
             MHD_destroy_response(response);
         json_object_put(json_obj);
             return ret;
         }
         
     struct MHD_Response *response = create_success_response("Location saved successfully", MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
     json_object_put(json_obj);
     return ret;
 }
 
+// Check a decoded point; returns -1 with *error set when it cannot be stored
+static int validate_location_point(const location_point_t *point, double now, const char **error) {
+    if (point->user_id <= 0) {
+        *error = "Invalid user_id";
+        return -1;
+    }
+    if (!location_coordinates_valid(point->latitude, point->longitude)) {
+        *error = "Coordinates out of range";
+        return -1;
+    }
+    // Negated like the coordinate check: a NaN ts would fail the whole batch's upsert
+    if (!(point->ts > 0 && point->ts <= now + LOCATION_BATCH_MAX_SKEW_SEC)) {
+        *error = "Invalid ts";
+        return -1;
+    }
+    return 0;
+}
+
+// Read one uploaded point for the signed-in `owner`; user_id may be left out, but any
+// other user's id is refused. Returns -1 with *error set when it cannot be stored.
+static int parse_location_point(json_object *item, int32_t owner, double now, location_point_t *point,
+                                const char **error) {
+    json_object *user_id_obj, *lat_obj, *lon_obj, *accuracy_obj, *ts_obj;
+    if (!json_object_is_type(item, json_type_object) ||
+        !json_object_object_get_ex(item, "latitude", &lat_obj) ||
+        !json_object_object_get_ex(item, "longitude", &lon_obj)) {
+        *error = "latitude and longitude required";
+        return -1;
+    }
+
+    point->user_id = owner;
+    if (json_object_object_get_ex(item, "user_id", &user_id_obj) && json_object_get_int(user_id_obj) != owner) {
+        *error = "Invalid user_id";
+        return -1;
+    }
+    point->latitude = json_object_get_double(lat_obj);
+    point->longitude = json_object_get_double(lon_obj);
+    point->accuracy = 50; // Default accuracy
+    if (json_object_object_get_ex(item, "accuracy", &accuracy_obj)) {
+        point->accuracy = json_object_get_int(accuracy_obj);
+    }
+    point->ts = now;
+    if (json_object_object_get_ex(item, "ts", &ts_obj)) {
+        point->ts = json_object_get_double(ts_obj);
+        if (point->ts > 1e11) {
+            point->ts /= 1000.0; // Milliseconds
+        }
+    }
+    return validate_location_point(point, now, error);
+}
+
+static const char* location_point_status_name(int status) {
+    switch (status) {
+        case LOCATION_POINT_ACCEPTED: return "accepted";
+        case LOCATION_POINT_SUPERSEDED: return "superseded";
+        case LOCATION_POINT_INVALID: return "invalid";
+        default: return "failed";
+    }
+}
+
+// Store parsed points and answer with per-item statuses in request order
+static enum MHD_Result queue_location_batch(route_request_t *req, location_point_t *points,
+                                            const char **errors, size_t count) {
+    int written = save_user_locations(points, count);
+
+    size_t totals[4] = { 0, 0, 0, 0 }; // accepted, superseded, invalid, failed
+    for (size_t i = 0; i < count; i++) {
+        switch (points[i].status) {
+            case LOCATION_POINT_ACCEPTED: totals[0]++; break;
+            case LOCATION_POINT_SUPERSEDED: totals[1]++; break;
+            case LOCATION_POINT_INVALID: totals[2]++; break;
+            default: totals[3]++; break;
+        }
+    }
+
+    json_writer_t out;
+    json_writer_init_arena(&out, req->arena, 64 + count * 24);
+    json_writer_begin_object(&out);
+    json_writer_key(&out, "accepted");
+    json_writer_int(&out, (int64_t)totals[0]);
+    json_writer_key(&out, "superseded");
+    json_writer_int(&out, (int64_t)totals[1]);
+    json_writer_key(&out, "invalid");
+    json_writer_int(&out, (int64_t)totals[2]);
+    json_writer_key(&out, "failed");
+    json_writer_int(&out, (int64_t)totals[3]);
+    json_writer_key(&out, "results");
+    json_writer_begin_array(&out);
+    for (size_t i = 0; i < count; i++) {
+        json_writer_begin_object(&out);
+        json_writer_key(&out, "status");
+        json_writer_string(&out, location_point_status_name(points[i].status));
+        if (points[i].status == LOCATION_POINT_INVALID && errors[i]) {
+            json_writer_key(&out, "error");
+            json_writer_string(&out, errors[i]);
+        }
+        json_writer_end_object(&out);
+    }
+    json_writer_end_array(&out);
+    json_writer_end_object(&out);
+
+    size_t len = 0;
+    char *json_str = json_writer_finish(&out, &len);
+    if (!json_str) {
+        struct MHD_Response *response = create_error_response("Internal server error", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    // A failed write is worth retrying as a whole; invalid items are reported but not fatal
+    unsigned int status = written < 0 ? MHD_HTTP_SERVICE_UNAVAILABLE : MHD_HTTP_OK;
+    struct MHD_Response *response = create_json_response_negotiated(req->connection, req->arena, json_str, len, status);
+    if (written < 0) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_RETRY_AFTER, "1");
+    }
+    enum MHD_Result ret = route_queue_response(req, status, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+
+static double epoch_now(void) {
+    struct timespec now_ts;
+    clock_gettime(CLOCK_REALTIME, &now_ts);
+    return now_ts.tv_sec + now_ts.tv_nsec / 1e9;
+}
+
+// Handle batch location upload: a JSON array or newline-delimited JSON objects
+enum MHD_Result handle_post_save_locations(route_request_t *req) {
+    const char *post_data = req->body;
+    size_t post_data_size = req->body_size;
+    arena_t *arena = req->arena;
+    location_point_t *points = arena_alloc(arena, LOCATION_BATCH_MAX_POINTS * sizeof(location_point_t));
+    const char **errors = arena_calloc(arena, LOCATION_BATCH_MAX_POINTS, sizeof(const char *));
+    json_tokener *tok = json_tokener_new();
+    if (!points || !errors || !tok) {
+        if (tok) {
+            json_tokener_free(tok);
+        }
+        struct MHD_Response *response = create_error_response("Internal server error", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    double now = epoch_now();
+    int32_t owner = atoi(req->user_id);
+
+    // Items are tokenized one at a time, so a bad NDJSON line costs only that item
+    size_t pos = 0, count = 0;
+    while (pos < post_data_size && isspace((unsigned char)post_data[pos])) {
+        pos++;
+    }
+    int array = pos < post_data_size && post_data[pos] == '[';
+    int done = 0;
+    unsigned int status = MHD_HTTP_OK;
+    const char *request_error = NULL;
+    if (array) {
+        pos++;
+    }
+
+    while (!done && !request_error) {
+        while (pos < post_data_size && isspace((unsigned char)post_data[pos])) {
+            pos++;
+        }
+        if (array && pos < post_data_size && post_data[pos] == ']' && count == 0) {
+            pos++;
+            done = 1;
+            break;
+        }
+        if (pos >= post_data_size) {
+            if (array) {
+                request_error = "Unterminated JSON array";
+            }
+            break;
+        }
+        if (count == LOCATION_BATCH_MAX_POINTS) {
+            status = MHD_HTTP_PAYLOAD_TOO_LARGE;
+            request_error = "Too many points in one request";
+            break;
+        }
+
+        size_t remaining = post_data_size - pos;
+        json_tokener_reset(tok);
+        json_object *item = json_tokener_parse_ex(tok, post_data + pos, remaining > INT32_MAX ? INT32_MAX : (int)remaining);
+        location_point_t *point = &points[count];
+        memset(point, 0, sizeof(*point));
+        if (!item) {
+            if (array) {
+                request_error = "Malformed JSON array";
+                break;
+            }
+            // Skip to the next line and carry on
+            point->status = LOCATION_POINT_INVALID;
+            errors[count++] = "Malformed JSON";
+            const char *newline = memchr(post_data + pos, '\n', remaining);
+            pos = newline ? (size_t)(newline - post_data) + 1 : post_data_size;
+            continue;
+        }
+        pos += json_tokener_get_parse_end(tok);
+
+        if (parse_location_point(item, owner, now, point, &errors[count]) != 0) {
+            point->status = LOCATION_POINT_INVALID;
+        }
+        json_object_put(item);
+        count++;
+
+        if (array) {
+            while (pos < post_data_size && isspace((unsigned char)post_data[pos])) {
+                pos++;
+            }
+            if (pos < post_data_size && post_data[pos] == ',') {
+                pos++;
+            } else if (pos < post_data_size && post_data[pos] == ']') {
+                pos++;
+                done = 1;
+            } else {
+                request_error = "Malformed JSON array";
+            }
+        }
+    }
+    json_tokener_free(tok);
+
+    if (!request_error && count == 0) {
+        request_error = "No points in request";
+    }
+    if (request_error) {
+        struct MHD_Response *response = create_error_response(request_error,
+                                                              status == MHD_HTTP_OK ? MHD_HTTP_BAD_REQUEST : status);
+        enum MHD_Result ret = route_queue_response(req, status == MHD_HTTP_OK ? MHD_HTTP_BAD_REQUEST : status, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    return queue_location_batch(req, points, errors, count);
+}
+
+// Handle binary location upload: one record or a batch (see location/location_wire.h)
+enum MHD_Result handle_post_save_locations_binary(route_request_t *req) {
+    const char *post_data = req->body;
+    size_t post_data_size = req->body_size;
+    arena_t *arena = req->arena;
+    const unsigned char *records;
+    int count = location_wire_parse(post_data, post_data_size, &records);
+    if (count < 0 || count > LOCATION_BATCH_MAX_POINTS) {
+        unsigned int status = count < 0 ? MHD_HTTP_BAD_REQUEST : MHD_HTTP_PAYLOAD_TOO_LARGE;
+        struct MHD_Response *response = create_error_response(count < 0 ? "Malformed binary location message"
+                                                                        : "Too many points in one request", status);
+        enum MHD_Result ret = route_queue_response(req, status, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    location_point_t *points = arena_alloc(arena, (size_t)count * sizeof(location_point_t));
+    const char **errors = arena_calloc(arena, (size_t)count, sizeof(const char *));
+    if (!points || !errors) {
+        struct MHD_Response *response = create_error_response("Internal server error", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    // Records are decoded in place from the request body; user id 0 means the signed-in user
+    double now = epoch_now();
+    int32_t owner = atoi(req->user_id);
+    for (int i = 0; i < count; i++) {
+        location_wire_record_t record;
+        location_point_t *point = &points[i];
+        memset(point, 0, sizeof(*point));
+        if (location_wire_decode(records + (size_t)i * LOCATION_WIRE_RECORD_SIZE, &record) != 0) {
+            point->status = LOCATION_POINT_INVALID;
+            errors[i] = "Unsupported record version";
+            continue;
+        }
+        if (record.user_id != 0 && record.user_id != owner) {
+            point->status = LOCATION_POINT_INVALID;
+            errors[i] = "Invalid user_id";
+            continue;
+        }
+        point->user_id = owner;
+        point->latitude = record.latitude;
+        point->longitude = record.longitude;
+        point->accuracy = record.accuracy;
+        point->ts = record.ts_ms ? record.ts_ms / 1000.0 : now;
+        if (validate_location_point(point, now, &errors[i]) != 0) {
+            point->status = LOCATION_POINT_INVALID;
+        }
+    }
+
+    return queue_location_batch(req, points, errors, (size_t)count);
+}
+
 // Handle add friend
-enum MHD_Result handle_post_add_friend(struct MHD_Connection *connection, const char *post_data, size_t post_data_size) {
+enum MHD_Result handle_post_add_friend(route_request_t *req) {
+    const char *post_data = req->body;
     json_object *json_obj = json_tokener_parse(post_data);
     if (!json_obj) {
         struct MHD_Response *response = create_error_response("Invalid JSON", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
             MHD_destroy_response(response);
             return ret;
         }
         
-    json_object *user_id_obj, *friend_username_obj;
-    if (!json_object_object_get_ex(json_obj, "user_id", &user_id_obj) ||
-        !json_object_object_get_ex(json_obj, "friend_username", &friend_username_obj)) {
-        struct MHD_Response *response = create_error_response("User ID and friend username required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+    json_object *friend_username_obj;
+    if (!json_object_object_get_ex(json_obj, "friend_username", &friend_username_obj)) {
+        struct MHD_Response *response = create_error_response("Friend username required", MHD_HTTP_BAD_REQUEST);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
         MHD_destroy_response(response);
         json_object_put(json_obj);
         return ret;
     }
     
-    const char* user_id = json_object_get_string(user_id_obj);
+    const char* user_id = req->user_id;
     const char* friend_username = json_object_get_string(friend_username_obj);
     
     int result = add_friend(user_id, friend_username);
     
     if (result != 0) {
         struct MHD_Response *response = create_error_response("Failed to add friend", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
         json_object_put(json_obj);
         return ret;
     }
     
     struct MHD_Response *response = create_success_response("Friend added successfully", MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
     json_object_put(json_obj);
     return ret;
 }
 
+// Run a read statement for a handler. With db_async running the request is suspended
+// and 1 is returned: the handler returns MHD_YES and, when MHD calls it again, the same
+// call lands here and returns 0 with *res set. Otherwise the statement runs on a pooled
+// connection. *res is NULL when no connection was available; the caller PQclear()s it.
+static int route_db_exec(route_request_t *req, db_stmt_id_t stmt, const char *const *params, PGresult **res) {
+    db_async_call_t *call = *req->state;
+    if (call) {
+        *res = db_async_take_result(call);
+        *req->state = NULL;
+        *req->state_free = NULL;
+        return 0;
+    }
+
+    if (async_db && db_async_enabled()) {
+        call = arena_alloc(req->arena, sizeof(*call));
+        if (call && db_async_begin(call, req->connection, stmt, params) == 0) {
+            *req->state = call;
+            *req->state_free = db_async_call_release;
+            return 1;
+        }
+    }
+
+    *res = NULL;
+    PGconn *conn = db_pool_acquire();
+    if (conn) {
+        *res = db_exec_prepared(conn, stmt, params);
+        db_pool_release(conn);
+    }
+    return 0;
+}
+
 // Handle get user info
-enum MHD_Result handle_get_user_info(struct MHD_Connection *connection) {
-        const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-        if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+enum MHD_Result handle_get_user_info(route_request_t *req) {
+    arena_t *arena = req->arena;
+    const char *user_id = req->user_id;
+    const char *username = req->username;
+
+    // A session cache miss already fetched the name along with the session
+    PGresult *res = NULL;
+    if (!username) {
+        const char *params[1] = { user_id };
+        if (route_db_exec(req, STMT_USERNAME_BY_ID, params, &res)) {
+            return MHD_YES;
+        }
+        if (!res) {
+            struct MHD_Response *response = create_error_response("Database connection failed", MHD_HTTP_INTERNAL_SERVER_ERROR);
+            enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
             MHD_destroy_response(response);
             return ret;
         }
-        
-    session_token += 7; // Skip "Bearer " prefix
-        
-        char* user_id = NULL;
-        if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "Query failed: %s", PQresultErrorMessage(res));
+            PQclear(res);
+            struct MHD_Response *response = create_error_response("Failed to retrieve user info", MHD_HTTP_INTERNAL_SERVER_ERROR);
+            enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
             MHD_destroy_response(response);
             return ret;
         }
-        
-    // Get user info from database
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-            free(user_id);
-        struct MHD_Response *response = create_error_response("Database connection failed", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
-        MHD_destroy_response(response);
+        if (PQntuples(res) == 0) {
+            PQclear(res);
+            struct MHD_Response *response = create_error_response("User not found", MHD_HTTP_NOT_FOUND);
+            enum MHD_Result ret = route_queue_response(req, MHD_HTTP_NOT_FOUND, response);
+            MHD_destroy_response(response);
             return ret;
         }
+        username = PQgetvalue(res, 0, 0);
+    }
         
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT username FROM users WHERE id = %s;", user_id);
+    // Create JSON response
+    json_writer_t out;
+    json_writer_init_arena(&out, arena, 128);
+    json_writer_begin_object(&out);
+    json_writer_key(&out, "user_id");
+    json_writer_string(&out, user_id);
+    json_writer_key(&out, "username");
+    json_writer_string(&out, username);
+    json_writer_end_object(&out);
+    PQclear(res);
+    return queue_json_writer(req, &out, 0, "Failed to retrieve user info");
+}
     
-    PGresult *res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
+// Handle get friends
+enum MHD_Result handle_get_friends(route_request_t *req) {
+    arena_t *arena = req->arena;
+    const char *user_id = req->user_id;
+    json_writer_t out;
+    json_writer_init_arena(&out, arena, JSON_WRITER_RESPONSE_CAPACITY);
+    int result;
+    if (friend_graph_enabled()) {
+        result = write_friends_list(&out, user_id);
+    } else {
+        const char *params[1] = { user_id };
+        PGresult *res = NULL;
+        if (route_db_exec(req, STMT_FRIENDS_LIST, params, &res)) {
+            return MHD_YES;
+        }
+        result = write_friends_list_result(&out, res);
         PQclear(res);
-        PQfinish(conn);
-        free(user_id);
-        struct MHD_Response *response = create_error_response("Failed to retrieve user info", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
-            MHD_destroy_response(response);
-        return ret;
     }
+    return queue_json_writer(req, &out, result, "Failed to retrieve friends list");
+}
     
-    if (PQntuples(res) == 0) {
-        PQclear(res);
-        PQfinish(conn);
-            free(user_id);
-        struct MHD_Response *response = create_error_response("User not found", MHD_HTTP_NOT_FOUND);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_FOUND, response);
-        MHD_destroy_response(response);
-            return ret;
+// Handle get friends locations
+enum MHD_Result handle_get_friends_locations(route_request_t *req) {
+    arena_t *arena = req->arena;
+    const char *user_id = req->user_id;
+    json_writer_t out;
+    json_writer_init_arena(&out, arena, JSON_WRITER_RESPONSE_CAPACITY);
+    int result;
+    if (live_store_enabled()) {
+        result = write_friends_locations(&out, user_id);
+    } else {
+        const char *params[1] = { user_id };
+        PGresult *res = NULL;
+        if (route_db_exec(req, STMT_FRIENDS_LOCATIONS, params, &res)) {
+            return MHD_YES;
         }
+        result = write_friends_locations_result(&out, res);
+        PQclear(res);
+    }
+    return queue_json_writer(req, &out, result, "Failed to retrieve friends locations");
+}
     
-    const char* username = PQgetvalue(res, 0, 0);
-        
-        // Create JSON response
-    json_object *response_obj = json_object_new_object();
-    json_object_object_add(response_obj, "user_id", json_object_new_string(user_id));
-    json_object_object_add(response_obj, "username", json_object_new_string(username));
-    
-    const char *json_str = json_object_to_json_string(response_obj);
-    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+// Handle friends location stream (Server-Sent Events)
+enum MHD_Result handle_get_friends_stream(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
+    const char *user_id = req->user_id;
+    if (!location_hub_enabled()) {
+        struct MHD_Response *response = create_error_response("Location streaming is disabled", MHD_HTTP_SERVICE_UNAVAILABLE);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_SERVICE_UNAVAILABLE, response);
         MHD_destroy_response(response);
-    json_object_put(response_obj);
-    PQclear(res);
-    PQfinish(conn);
-        free(user_id);
         return ret;
     }
-    
-// Handle get friends
-enum MHD_Result handle_get_friends(struct MHD_Connection *connection) {
-        const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-        if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-    session_token += 7; // Skip "Bearer " prefix
-        
-        char* user_id = NULL;
-        if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-        json_object *friends = get_friends_list(user_id);
-        
-        if (!friends) {
-        struct MHD_Response *response = create_error_response("Failed to retrieve friends list", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
-            MHD_destroy_response(response);
-            free(user_id);
-            return ret;
-        }
-        
-        const char *json_str = json_object_to_json_string(friends);
-    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+
+    // The first event carries the current positions; later ones are per-friend deltas
+    // The event is framed around the array in the same buffer
+    json_writer_t out;
+    json_writer_init(&out, JSON_WRITER_RESPONSE_CAPACITY);
+    char prefix[64];
+    int prefix_len = snprintf(prefix, sizeof(prefix), "retry: %d\nevent: snapshot\ndata: ", STREAM_RETRY_MS);
+    json_writer_append(&out, prefix, (size_t)prefix_len);
+    if (write_friends_locations(&out, user_id) != 0) {
+        json_writer_free(&out);
+        struct MHD_Response *response = create_error_response("Failed to retrieve friends locations", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
-        json_object_put(friends);
-        free(user_id);
         return ret;
     }
-    
-// Handle get friends locations
-enum MHD_Result handle_get_friends_locations(struct MHD_Connection *connection) {
-        const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-        if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-    session_token += 7; // Skip "Bearer " prefix
-        
-        char* user_id = NULL;
-        if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-        json_object *locations = get_friends_locations_from_db(user_id);
-        
-        if (!locations) {
-        struct MHD_Response *response = create_error_response("Failed to retrieve friends locations", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
-            MHD_destroy_response(response);
-            free(user_id);
-            return ret;
+    json_writer_append(&out, "\n\n", 2);
+    char *snapshot = json_writer_finish(&out, NULL);
+
+    struct MHD_Response *response = snapshot ? location_hub_open_stream(connection, atoi(user_id), snapshot) : NULL;
+    if (!response) {
+        response = create_error_response("Too many open streams", MHD_HTTP_SERVICE_UNAVAILABLE);
+        MHD_add_response_header(response, MHD_HTTP_HEADER_RETRY_AFTER, "5");
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_SERVICE_UNAVAILABLE, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Handle WebSocket upgrade for the bidirectional location channel
+enum MHD_Result handle_get_websocket(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
+    const char *user_id = req->user_id;
+    if (!ws_channel_enabled()) {
+        struct MHD_Response *response = create_error_response("WebSocket channel is disabled", MHD_HTTP_SERVICE_UNAVAILABLE);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_SERVICE_UNAVAILABLE, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    unsigned int status = ws_channel_check_handshake(connection);
+    if (status != 0) {
+        struct MHD_Response *response = create_error_response("WebSocket handshake required", status);
+        if (status == MHD_HTTP_UPGRADE_REQUIRED) {
+            MHD_add_response_header(response, MHD_HTTP_HEADER_UPGRADE, "websocket");
+            MHD_add_response_header(response, "Sec-WebSocket-Version", "13");
         }
-        
-        const char *json_str = json_object_to_json_string(locations);
-    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+        enum MHD_Result ret = route_queue_response(req, status, response);
         MHD_destroy_response(response);
-        json_object_put(locations);
-        free(user_id);
         return ret;
     }
-    
+
+    // The auth stage ran on the upgrade request; frames on the socket carry no token
+    struct MHD_Response *response = ws_channel_create_response(connection, atoi(user_id));
+    if (!response) {
+        response = create_error_response("Failed to accept WebSocket", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    // Browsers do not apply CORS to WebSockets, so the 101 goes out without those headers
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_SWITCHING_PROTOCOLS, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
 // Handle get route
-enum MHD_Result handle_get_route(struct MHD_Connection *connection) {
-        const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-        if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
-    session_token += 7; // Skip "Bearer " prefix
-        
-        char* user_id = NULL;
-        if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
-            MHD_destroy_response(response);
-            return ret;
-        }
-        
+enum MHD_Result handle_get_route(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
+    arena_t *arena = req->arena;
         const char* start_lat_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "start_lat");
         const char* start_lon_str = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "start_lon");
         const char* end_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "end_id");
         
         if (!start_lat_str || !start_lon_str || !end_id) {
         struct MHD_Response *response = create_error_response("start_lat, start_lon, and end_id query parameters required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
             MHD_destroy_response(response);
-            free(user_id);
             return ret;
         }
         
         double start_lat = atof(start_lat_str);
         double start_lon = atof(start_lon_str);
         
-    json_object *route = calculate_route(start_lat, start_lon, end_id);
-    
-    if (!route) {
-        struct MHD_Response *response = create_error_response("Failed to calculate route", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
-            MHD_destroy_response(response);
-            free(user_id);
-            return ret;
-        }
-        
-    const char *json_str = json_object_to_json_string(route);
-    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
-            MHD_destroy_response(response);
-    json_object_put(route);
-            free(user_id);
-            return ret;
-        }
-        
-// Handle get H3 distance
-enum MHD_Result handle_get_h3_distance(struct MHD_Connection *connection) {
-    const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-    if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+    // mode=road follows the road graph; the default walks hexagons
+    const char *mode = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "mode");
+    int road = mode && strcmp(mode, "road") == 0;
+    if (mode && !road && strcmp(mode, "hex") != 0) {
+        struct MHD_Response *response = create_error_response("mode must be hex or road", MHD_HTTP_BAD_REQUEST);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
         MHD_destroy_response(response);
         return ret;
     }
-    
-    session_token += 7; // Skip "Bearer " prefix
-    
-    char* user_id = NULL;
-    if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+    if (road && !road_graph_loaded()) {
+        struct MHD_Response *response = create_error_response("Road graph not loaded", MHD_HTTP_SERVICE_UNAVAILABLE);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_SERVICE_UNAVAILABLE, response);
         MHD_destroy_response(response);
         return ret;
     }
-    
+
+    json_writer_t out;
+    json_writer_init_arena(&out, arena, JSON_WRITER_RESPONSE_CAPACITY);
+    int result = road ? write_road_route(arena, &out, start_lat, start_lon, end_id)
+                      : write_route(arena, &out, start_lat, start_lon, end_id);
+    if (result == ROAD_GRAPH_NO_SNAP || result == ROAD_GRAPH_NO_PATH) {
+        json_writer_free(&out);
+        const char *message = result == ROAD_GRAPH_NO_SNAP ? "No road near the start or end point"
+                                                           : "No road route between these points";
+        struct MHD_Response *response = create_error_response(message, MHD_HTTP_NOT_FOUND);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_NOT_FOUND, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    return queue_json_writer(req, &out, result, "Failed to calculate route");
+}
+        
+// Handle get H3 distance
+enum MHD_Result handle_get_h3_distance(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
     const char* user1_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user1");
     const char* user2_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user2");
     
     if (!user1_id || !user2_id) {
         struct MHD_Response *response = create_error_response("user1 and user2 query parameters required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
             MHD_destroy_response(response);
-            free(user_id);
             return ret;
         }
         
@@ -694,9 +1064,8 @@ enum MHD_Result handle_get_h3_distance(struct MHD_Connection *connection) {
     
     if (distance < 0) {
         struct MHD_Response *response = create_error_response("Failed to calculate H3 distance", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
-        free(user_id);
         return ret;
     }
     
@@ -705,70 +1074,92 @@ enum MHD_Result handle_get_h3_distance(struct MHD_Connection *connection) {
              "{\"distance\": %.2f, \"unit\": \"meters\", \"algorithm\": \"H3\"}", distance);
     
     struct MHD_Response *response = create_json_response(response_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
-    free(user_id);
     return ret;
 }
 
 // Handle get A* distance
-enum MHD_Result handle_get_astar_distance(struct MHD_Connection *connection) {
-    const char* session_token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
-    if (!session_token || strncmp(session_token, "Bearer ", 7) != 0) {
-        struct MHD_Response *response = create_error_response("Missing or invalid Authorization header", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+enum MHD_Result handle_get_astar_distance(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
+    arena_t *arena = req->arena;
+    const char* user1_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user1");
+    const char* user2_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user2");
+    
+    if (!user1_id || !user2_id) {
+        struct MHD_Response *response = create_error_response("user1 and user2 query parameters required", MHD_HTTP_BAD_REQUEST);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
         MHD_destroy_response(response);
         return ret;
     }
     
-    session_token += 7; // Skip "Bearer " prefix
+    double distance = calculate_astar_distance(arena, user1_id, user2_id);
     
-    char* user_id = NULL;
-    if (validate_session_token(session_token, &user_id) != 0) {
-        struct MHD_Response *response = create_error_response("Invalid or expired session token", MHD_HTTP_UNAUTHORIZED);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_UNAUTHORIZED, response);
+    if (distance < 0) {
+        struct MHD_Response *response = create_error_response("Failed to calculate A* distance", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
         return ret;
     }
     
+    char response_str[256];
+    snprintf(response_str, sizeof(response_str), 
+             "{\"distance\": %.2f, \"unit\": \"meters\", \"algorithm\": \"A*\"}", distance);
+    
+    struct MHD_Response *response = create_json_response(response_str, MHD_HTTP_OK);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Handle get ALT distance: A* with landmark bounds, A* outside the landmark region
+enum MHD_Result handle_get_alt_distance(route_request_t *req) {
+    struct MHD_Connection *connection = req->connection;
     const char* user1_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user1");
     const char* user2_id = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "user2");
-    
+
     if (!user1_id || !user2_id) {
         struct MHD_Response *response = create_error_response("user1 and user2 query parameters required", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
         MHD_destroy_response(response);
-        free(user_id);
         return ret;
     }
-    
-    double distance = calculate_astar_distance(user1_id, user2_id);
-    
+
+    int used_alt;
+    size_t expanded;
+    double distance = calculate_alt_distance(req->arena, user1_id, user2_id, &used_alt, &expanded);
+
     if (distance < 0) {
-        struct MHD_Response *response = create_error_response("Failed to calculate A* distance", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        struct MHD_Response *response = create_error_response("Failed to calculate ALT distance", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
         MHD_destroy_response(response);
-        free(user_id);
         return ret;
     }
-    
+
+    // The coarse-to-fine fallback's expansions are not comparable, so they are left out
     char response_str[256];
-    snprintf(response_str, sizeof(response_str), 
-             "{\"distance\": %.2f, \"unit\": \"meters\", \"algorithm\": \"A*\"}", distance);
-    
+    if (used_alt < 0) {
+        snprintf(response_str, sizeof(response_str),
+                 "{\"distance\": %.2f, \"unit\": \"meters\", \"algorithm\": \"hierarchical\"}", distance);
+    } else {
+        snprintf(response_str, sizeof(response_str),
+                 "{\"distance\": %.2f, \"unit\": \"meters\", \"algorithm\": \"%s\", \"expanded\": %zu}",
+                 distance, used_alt ? "ALT" : "A*", expanded);
+    }
+
     struct MHD_Response *response = create_json_response(response_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
     MHD_destroy_response(response);
-    free(user_id);
     return ret;
 }
 
 // Handle calculate distance (legacy endpoint)
-enum MHD_Result handle_post_calculate_distance(struct MHD_Connection *connection, const char *post_data, size_t post_data_size) {
+enum MHD_Result handle_post_calculate_distance(route_request_t *req) {
+    const char *post_data = req->body;
     json_object *json_obj = json_tokener_parse(post_data);
             if (!json_obj) {
         struct MHD_Response *response = create_error_response("Invalid JSON", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 return ret;
             }
@@ -782,7 +1173,7 @@ enum MHD_Result handle_post_calculate_distance(struct MHD_Connection *connection
                 !json_object_object_get_ex(json_obj, "lon2", &lon2_obj)) {
                 
         struct MHD_Response *response = create_error_response("Missing required fields", MHD_HTTP_BAD_REQUEST);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_BAD_REQUEST, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_BAD_REQUEST, response);
                 MHD_destroy_response(response);
                 json_object_put(json_obj);
                 return ret;
@@ -797,26 +1188,55 @@ enum MHD_Result handle_post_calculate_distance(struct MHD_Connection *connection
 
             double distance = haversine_distance(lat1, lon1, lat2, lon2);
 
-            PGconn *conn = PQconnectdb(CONN_STR);
-            if (PQstatus(conn) != CONNECTION_OK) {
+            PGconn *conn = db_pool_acquire();
+            if (!conn) {
         struct MHD_Response *response = create_error_response("Database connection failed", MHD_HTTP_INTERNAL_SERVER_ERROR);
-        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        enum MHD_Result ret = route_queue_response(req, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
                 MHD_destroy_response(response);
-                PQfinish(conn);
                 json_object_put(json_obj);
                 return ret;
             }
 
             save_location_pair_to_db(conn, name1, lat1, lon1, name2, lat2, lon2, distance);
-            PQfinish(conn);
+            db_pool_release(conn);
 
             char response_str[256];
             snprintf(response_str, sizeof(response_str), 
                      "{\"distance\": %.2f, \"unit\": \"km\"}", distance);
 
     struct MHD_Response *response = create_json_response(response_str, MHD_HTTP_OK);
-    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_OK, response);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
             MHD_destroy_response(response);
             json_object_put(json_obj);
             return ret;
         }
+
+// Handle get server stats
+enum MHD_Result handle_get_stats(route_request_t *req) {
+    json_object *stats_obj = json_object_new_object();
+    json_object_object_add(stats_obj, "db_pool", db_pool_stats_to_json());
+    json_object_object_add(stats_obj, "session_cache", session_cache_stats_to_json());
+    json_object_object_add(stats_obj, "session_sweeper", session_sweeper_stats_to_json());
+    json_object_object_add(stats_obj, "location_writer", location_writer_stats_to_json());
+    json_object_object_add(stats_obj, "live_store", live_store_stats_to_json());
+    json_object_object_add(stats_obj, "friend_graph", friend_graph_stats_to_json());
+    json_object_object_add(stats_obj, "location_hub", location_hub_stats_to_json());
+    json_object_object_add(stats_obj, "ws_channel", ws_channel_stats_to_json());
+    json_object_object_add(stats_obj, "request_arena", arena_stats_to_json());
+    json_object_object_add(stats_obj, "static_files", static_files_stats_to_json());
+    json_object_object_add(stats_obj, "compression", compress_stats_to_json());
+    json_object_object_add(stats_obj, "router", router_stats_to_json());
+    json_object_object_add(stats_obj, "db_async", db_async_stats_to_json());
+    json_object_object_add(stats_obj, "astar", astar_stats_to_json());
+    json_object_object_add(stats_obj, "alt", alt_stats_to_json());
+    json_object_object_add(stats_obj, "hier_path", hier_path_stats_to_json());
+    json_object_object_add(stats_obj, "cost_map", cost_map_stats_to_json());
+    json_object_object_add(stats_obj, "road_graph", road_graph_stats_to_json());
+    
+    const char *json_str = json_object_to_json_string(stats_obj);
+    struct MHD_Response *response = create_json_response(json_str, MHD_HTTP_OK);
+    enum MHD_Result ret = route_queue_response(req, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    json_object_put(stats_obj);
+    return ret;
+}
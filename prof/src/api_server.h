@@ -2,9 +2,12 @@
 #define API_SERVER_H
 
 #include <microhttpd.h>
+#include "http_engine.h"
+#include "router.h"
 
 // Start the API server
 struct MHD_Daemon* start_api_server(void);
+struct MHD_Daemon* start_api_server_with_config(const http_engine_config_t *config);
 
 // Handle HTTP requests
 enum MHD_Result handle_request(void *cls, struct MHD_Connection *connection,
@@ -12,29 +15,32 @@ enum MHD_Result handle_request(void *cls, struct MHD_Connection *connection,
                               const char *version, const char *upload_data,
                               size_t *upload_data_size, void **con_cls);
 
-// Request handler function prototypes
-enum MHD_Result handle_get_request(struct MHD_Connection *connection, const char *url);
-enum MHD_Result handle_post_request(struct MHD_Connection *connection, const char *url, 
-                                   const char *upload_data, size_t *upload_data_size, void **con_cls);
-enum MHD_Result process_post_data(struct MHD_Connection *connection, const char *url, 
-                                 const char *post_data, size_t post_data_size);
+// Request handler function prototypes; each is reached through the route table
 enum MHD_Result handle_options_request(struct MHD_Connection *connection);
 enum MHD_Result serve_static_file(struct MHD_Connection *connection, const char *filepath, const char *content_type);
+enum MHD_Result handle_get_index(route_request_t *req);
+enum MHD_Result handle_get_web_file(route_request_t *req);
 
 // POST request handlers
-enum MHD_Result handle_post_register(struct MHD_Connection *connection, const char *post_data, size_t post_data_size);
-enum MHD_Result handle_post_login(struct MHD_Connection *connection, const char *post_data, size_t post_data_size);
-enum MHD_Result handle_post_logout(struct MHD_Connection *connection);
-enum MHD_Result handle_post_save_location(struct MHD_Connection *connection, const char *post_data, size_t post_data_size);
-enum MHD_Result handle_post_add_friend(struct MHD_Connection *connection, const char *post_data, size_t post_data_size);
-enum MHD_Result handle_post_calculate_distance(struct MHD_Connection *connection, const char *post_data, size_t post_data_size);
+enum MHD_Result handle_post_register(route_request_t *req);
+enum MHD_Result handle_post_login(route_request_t *req);
+enum MHD_Result handle_post_logout(route_request_t *req);
+enum MHD_Result handle_post_save_location(route_request_t *req);
+enum MHD_Result handle_post_save_locations(route_request_t *req);
+enum MHD_Result handle_post_save_locations_binary(route_request_t *req);
+enum MHD_Result handle_post_add_friend(route_request_t *req);
+enum MHD_Result handle_post_calculate_distance(route_request_t *req);
 
 // GET request handlers
-enum MHD_Result handle_get_user_info(struct MHD_Connection *connection);
-enum MHD_Result handle_get_friends(struct MHD_Connection *connection);
-enum MHD_Result handle_get_friends_locations(struct MHD_Connection *connection);
-enum MHD_Result handle_get_route(struct MHD_Connection *connection);
-enum MHD_Result handle_get_h3_distance(struct MHD_Connection *connection);
-enum MHD_Result handle_get_astar_distance(struct MHD_Connection *connection);
+enum MHD_Result handle_get_user_info(route_request_t *req);
+enum MHD_Result handle_get_friends(route_request_t *req);
+enum MHD_Result handle_get_friends_locations(route_request_t *req);
+enum MHD_Result handle_get_friends_stream(route_request_t *req);
+enum MHD_Result handle_get_websocket(route_request_t *req);
+enum MHD_Result handle_get_route(route_request_t *req);
+enum MHD_Result handle_get_h3_distance(route_request_t *req);
+enum MHD_Result handle_get_astar_distance(route_request_t *req);
+enum MHD_Result handle_get_alt_distance(route_request_t *req);
+enum MHD_Result handle_get_stats(route_request_t *req);
 
 #endif // API_SERVER_H
@@ -1,6 +1,13 @@
 #define _GNU_SOURCE
 #include "auth.h"
+#include "session_cache.h"
+#include "friend_graph.h"
 #include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include "../stream/location_hub.h"
+#include "../utils/json_writer.h"
+#include "../utils/arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,14 +17,14 @@
 #include <libpq-fe.h>
 
 // Generate a random session token
-char* generate_session_token(void) {
+char* generate_session_token(arena_t *arena) {
     unsigned char random_bytes[32];
     if (RAND_bytes(random_bytes, sizeof(random_bytes)) != 1) {
         fprintf(stderr, "Failed to generate random bytes\n");
         return NULL;
     }
     
-    char* token = malloc(65); // 64 hex chars + null terminator
+    char* token = arena_alloc(arena, 65); // 64 hex chars + null terminator
     if (!token) {
         return NULL;
     }
@@ -66,29 +73,24 @@ int verify_password(const char* password, const char* hash) {
 }
 
 // Register a new user
-char* register_user(const char* username, const char* password) {
+char* register_user(arena_t *arena, const char* username, const char* password) {
     if (!username || !password) {
         fprintf(stderr, "Username or password is NULL\n");
         return NULL;
     }
 
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
         return NULL;
     }
 
     // Check if user already exists
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT id FROM users WHERE username = '%s';", username);
-    
-    PGresult *res = PQexec(conn, query);
+    const char *lookup_params[1] = { username };
+    PGresult *res = db_exec_prepared(conn, STMT_USER_BY_USERNAME, lookup_params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
@@ -96,7 +98,7 @@ char* register_user(const char* username, const char* password) {
         // User already exists
         fprintf(stderr, "User '%s' already exists\n", username);
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
     PQclear(res);
@@ -105,83 +107,69 @@ char* register_user(const char* username, const char* password) {
     char password_hash[65];
     if (hash_password(password, password_hash, sizeof(password_hash)) != 0) {
         fprintf(stderr, "Failed to hash password\n");
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
     // Insert new user
-    snprintf(query, sizeof(query), 
-             "INSERT INTO users (username, password_hash) VALUES ('%s', '%s') RETURNING id;", 
-             username, password_hash);
-    
-    printf("DEBUG: Executing query: %s\n", query);
-    
-    res = PQexec(conn, query);
-    printf("DEBUG: Query result status: %d\n", PQresultStatus(res));
+    const char *insert_params[2] = { username, password_hash };
+    res = db_exec_prepared(conn, STMT_USER_INSERT, insert_params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Insert failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
     if (PQntuples(res) == 0) {
         fprintf(stderr, "Insert returned no rows\n");
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
     // Get the new user's ID
-    printf("DEBUG: Getting user ID from result\n");
     const char* db_user_id = PQgetvalue(res, 0, 0);
-    printf("DEBUG: db_user_id: %s\n", db_user_id ? db_user_id : "NULL");
     if (!db_user_id) {
         fprintf(stderr, "Failed to get user ID from database\n");
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
-    printf("DEBUG: About to strdup\n");
-    char* user_id = strdup(db_user_id);
-    printf("DEBUG: strdup result: %s\n", user_id ? user_id : "NULL");
+    friend_graph_set_username(atoi(db_user_id), username);
+    char* user_id = arena_strdup(arena, db_user_id);
     PQclear(res);
-    PQfinish(conn);
+    db_pool_release(conn);
 
     return user_id;
 }
 
 // Login a user
-char* login_user(const char* username, const char* password) {
+char* login_user(arena_t *arena, const char* username, const char* password) {
     if (!username || !password) {
         fprintf(stderr, "Username or password is NULL\n");
         return NULL;
     }
 
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
         return NULL;
     }
 
     // Get user's password hash
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT id, password_hash FROM users WHERE username = '%s';", username);
-    
-    PGresult *res = PQexec(conn, query);
+    const char *lookup_params[1] = { username };
+    PGresult *res = db_exec_prepared(conn, STMT_USER_BY_USERNAME, lookup_params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
     if (PQntuples(res) == 0) {
         // User not found
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
@@ -190,51 +178,48 @@ char* login_user(const char* username, const char* password) {
     if (!stored_hash || !db_user_id) {
         fprintf(stderr, "Failed to get user data from database\n");
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
-    char* user_id = strdup(db_user_id);
-    PQclear(res);
+    char user_id[SESSION_CACHE_USER_ID_LEN];
+    snprintf(user_id, sizeof(user_id), "%s", db_user_id);
 
-    // Verify password
-    if (verify_password(password, stored_hash) != 0) {
+    // Verify password (stored_hash points into res, so clear it afterwards)
+    int password_ok = verify_password(password, stored_hash) == 0;
+    PQclear(res);
+    if (!password_ok) {
         // Password incorrect
-        free(user_id);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
     // Generate session token
-    char* session_token = generate_session_token();
+    char* session_token = generate_session_token(arena);
     if (!session_token) {
-        free(user_id);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
 
-    // Insert session into database (expires in 1 hour)
-    time_t now = time(NULL);
-    time_t expires_at = now + 3600; // 1 hour
+    // Insert session into database (expires in 1 hour, computed server-side)
+    char lifetime_str[16];
+    snprintf(lifetime_str, sizeof(lifetime_str), "%d", SESSION_LIFETIME_SEC);
+    const char *session_params[3] = { session_token, user_id, lifetime_str };
     
-    char expires_at_str[20];
-    strftime(expires_at_str, sizeof(expires_at_str), "%Y-%m-%d %H:%M:%S", gmtime(&expires_at));
-
-    snprintf(query, sizeof(query), 
-             "INSERT INTO user_sessions (session_token, user_id, expires_at) VALUES ('%s', %s, '%s');", 
-             session_token, user_id, expires_at_str);
-    
-    res = PQexec(conn, query);
+    res = db_exec_prepared(conn, STMT_SESSION_INSERT, session_params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "Insert session failed: %s", PQerrorMessage(conn));
-        free(session_token);
-        free(user_id);
+        if (!arena) {
+            free(session_token);
+        }
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
     PQclear(res);
-    PQfinish(conn);
-    free(user_id); // We don't need user_id anymore, we return session_token
+    db_pool_release(conn);
+
+    // Later requests with this token skip the database entirely
+    session_cache_insert(session_token, user_id, time(NULL) + SESSION_LIFETIME_SEC);
 
     return session_token;
 }
@@ -245,111 +230,93 @@ int logout_user(const char* session_token) {
         return -1; // Invalid input
     }
 
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    // Drop the cached copy first so the token stops working even if the delete fails
+    session_cache_remove(session_token);
+
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
         return -1;
     }
 
     // Delete session from database
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "DELETE FROM user_sessions WHERE session_token = '%s';", session_token);
-    
-    PGresult *res = PQexec(conn, query);
+    const char *params[1] = { session_token };
+    PGresult *res = db_exec_prepared(conn, STMT_SESSION_DELETE, params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "Delete session failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
     PQclear(res);
-    PQfinish(conn);
+    db_pool_release(conn);
 
     return 0; // Success
 }
 
 // Validate a session token and get user ID
-int validate_session_token(const char* session_token, char** user_id) {
+int validate_session_token(arena_t *arena, const char* session_token, char** user_id, char** username) {
     if (!session_token || !user_id) {
         return -1; // Invalid input
     }
+    if (username) {
+        *username = NULL;
+    }
     
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return -1;
+    // Fast path: sessions validated recently are answered from memory
+    char cached_user_id[SESSION_CACHE_USER_ID_LEN];
+    if (session_cache_lookup(session_token, cached_user_id, sizeof(cached_user_id)) == 0) {
+        *user_id = arena_strdup(arena, cached_user_id);
+        return *user_id ? 0 : -1;
     }
     
-    // Get user ID and expiration time from database
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT user_id, expires_at FROM user_sessions WHERE session_token = '%s';", session_token);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
     
-    PGresult *res = PQexec(conn, query);
+    // Get user ID and expiration time (as epoch seconds, so no strptime) from database
+    const char *params[1] = { session_token };
+    PGresult *res = db_exec_prepared(conn, STMT_SESSION_LOOKUP, params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
     
     if (PQntuples(res) == 0) {
         // Session token not found
         PQclear(res);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    const char* db_user_id = PQgetvalue(res, 0, 0);
-    const char* expires_at_str = PQgetvalue(res, 0, 1);
-    PQclear(res);
-    
-    // Parse expiration time
-    struct tm tm_expires;
-    memset(&tm_expires, 0, sizeof(struct tm));
-    if (strptime(expires_at_str, "%Y-%m-%d %H:%M:%S", &tm_expires) == NULL) {
-        fprintf(stderr, "Failed to parse expiration time: %s\n", expires_at_str);
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
     
-    time_t expires_at = timegm(&tm_expires);
-    if (expires_at == -1) {
-        fprintf(stderr, "Failed to convert expiration time to time_t\n");
-        PQfinish(conn);
-        return -1;
-    }
+    time_t expires_at = (time_t)strtoll(PQgetvalue(res, 0, 1), NULL, 10);
     
     // Check if session has expired
     time_t now = time(NULL);
     if (now > expires_at) {
-        // Session expired, delete it from database
-        snprintf(query, sizeof(query), 
-                 "DELETE FROM user_sessions WHERE session_token = '%s';", session_token);
-        
-        PGresult *del_res = PQexec(conn, query);
-        if (PQresultStatus(del_res) != PGRES_COMMAND_OK) {
-            fprintf(stderr, "Delete expired session failed: %s", PQerrorMessage(conn));
-            PQclear(del_res);
-            PQfinish(conn);
-            return -1;
-        }
-        PQclear(del_res);
-        PQfinish(conn);
+        // The session sweeper deletes expired rows; keep writes off the request path
+        PQclear(res);
+        db_pool_release(conn);
         return -1; // Session expired
     }
+    char* db_user_id = arena_strdup(arena, PQgetvalue(res, 0, 0));
+    if (username) {
+        *username = arena_strdup(arena, PQgetvalue(res, 0, 2));
+    }
+    PQclear(res);
     
     // Session is valid, return user ID
     if (!db_user_id) {
         fprintf(stderr, "Failed to get user ID from database\n");
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
-    *user_id = strdup(db_user_id);
-    PQfinish(conn);
+    *user_id = db_user_id;
+    db_pool_release(conn);
+    
+    session_cache_insert(session_token, db_user_id, expires_at);
     
     return 0; // Success
 }
@@ -360,126 +327,108 @@ int add_friend(const char* user_id, const char* friend_username) {
         return -1;
     }
 
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
         return -1;
     }
 
-    // Get friend's user ID
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT id FROM users WHERE username = '%s';", friend_username);
-    
-    PGresult *res = PQexec(conn, query);
+    // Resolve the username, check for an existing friendship and insert in one round trip;
+    // no row comes back when the user is unknown or the two are already friends
+    const char *params[2] = { user_id, friend_username };
+    PGresult *res = db_exec_prepared(conn, STMT_FRIENDSHIP_ADD_BY_USERNAME, params);
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
+        fprintf(stderr, "Insert friendship failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
-
     if (PQntuples(res) == 0) {
-        // Friend not found
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return -1;
     }
 
-    const char* friend_id = PQgetvalue(res, 0, 0);
+    char friend_id[32];
+    snprintf(friend_id, sizeof(friend_id), "%s", PQgetvalue(res, 0, 0));
     PQclear(res);
+    db_pool_release(conn);
 
-    // Check if friendship already exists
-    snprintf(query, sizeof(query), 
-             "SELECT id FROM friendships WHERE (user_id = %s AND friend_id = %s) OR (user_id = %s AND friend_id = %s);", 
-             user_id, friend_id, friend_id, user_id);
-    
-    res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
-        PQclear(res);
-        PQfinish(conn);
-        return -1;
+    if (friend_graph_enabled()) {
+        friend_graph_add_edge(atoi(user_id), atoi(friend_id));
     }
 
-    if (PQntuples(res) > 0) {
-        // Friendship already exists
-        PQclear(res);
-        PQfinish(conn);
+    // Open streams refetch their snapshot so the new friend shows up right away
+    location_hub_notify_friends_changed(atoi(user_id));
+    location_hub_notify_friends_changed(atoi(friend_id));
+
+    return 0; // Success
+}
+
+static void append_friend(int32_t friend_id, const char *username, void *ctx) {
+    json_writer_t *out = ctx;
+    char id[16];
+    snprintf(id, sizeof(id), "%d", friend_id);
+    json_writer_begin_object(out);
+    json_writer_key(out, "id");
+    json_writer_string(out, id);
+    json_writer_key(out, "username");
+    json_writer_string(out, username);
+    json_writer_key(out, "online");
+    json_writer_bool(out, 0);
+    json_writer_end_object(out);
+}
+
+// Write the rows of a STMT_FRIENDS_LIST result to `out` as a JSON array
+int write_friends_list_result(json_writer_t *out, const PGresult *res) {
+    if (!res || PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Query failed: %s", res ? PQresultErrorMessage(res) : "no result\n");
         return -1;
     }
-    PQclear(res);
-
-    // Insert friendship
-    snprintf(query, sizeof(query), 
-             "INSERT INTO friendships (user_id, friend_id, status) VALUES (%s, %s, 'accepted');", 
-             user_id, friend_id);
     
-    res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "Insert friendship failed: %s", PQerrorMessage(conn));
-        PQclear(res);
-        PQfinish(conn);
-        return -1;
+    int rows = PQntuples(res);
+    json_writer_begin_array(out);
+    
+    for (int i = 0; i < rows; i++) {
+        json_writer_begin_object(out);
+        json_writer_key(out, "id");
+        json_writer_string(out, PQgetvalue(res, i, 0));
+        json_writer_key(out, "username");
+        json_writer_string(out, PQgetvalue(res, i, 1));
+        // For simplicity, we'll assume all friends are offline
+        // In a real application, you would check their last location update time
+        json_writer_key(out, "online");
+        json_writer_bool(out, 0);
+        json_writer_end_object(out);
     }
-    PQclear(res);
-    PQfinish(conn);
-
-    return 0; // Success
+    json_writer_end_array(out);
+    return 0;
 }
 
-// Get friends list for a user
-json_object* get_friends_list(const char* user_id) {
+// Write a user's friends to `out` as a JSON array
+int write_friends_list(json_writer_t *out, const char* user_id) {
     if (!user_id) {
         fprintf(stderr, "User ID is NULL\n");
-        return NULL;
-    }
-    
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return NULL;
+        return -1;
     }
     
-    // Get accepted friends (where user is either user_id or friend_id)
-    char query[1024];
-    snprintf(query, sizeof(query), 
-             "SELECT u.id, u.username "
-             "FROM friendships f "
-             "JOIN users u ON (CASE "
-             "    WHEN f.user_id = %s THEN f.friend_id "
-             "    WHEN f.friend_id = %s THEN f.user_id "
-             "END) = u.id "
-             "WHERE (f.user_id = %s OR f.friend_id = %s) "
-             "AND f.status = 'accepted';", 
-             user_id, user_id, user_id, user_id);
-    
-    PGresult *res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
-        PQclear(res);
-        PQfinish(conn);
-        return NULL;
+    // Served from the in-memory graph once it is loaded
+    if (friend_graph_enabled()) {
+        json_writer_begin_array(out);
+        friend_graph_for_each(atoi(user_id), append_friend, out);
+        json_writer_end_array(out);
+        return 0;
     }
     
-    int rows = PQntuples(res);
-    json_object *friends_array = json_object_new_array();
-    
-    for (int i = 0; i < rows; i++) {
-        json_object *friend_obj = json_object_new_object();
-        json_object_object_add(friend_obj, "id", json_object_new_string(PQgetvalue(res, i, 0)));
-        json_object_object_add(friend_obj, "username", json_object_new_string(PQgetvalue(res, i, 1)));
-        // For simplicity, we'll assume all friends are offline
-        // In a real application, you would check their last location update time
-        json_object_object_add(friend_obj, "online", json_object_new_boolean(0));
-        
-        json_object_array_add(friends_array, friend_obj);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
     }
     
+    // Get accepted friends (where user is either user_id or friend_id)
+    const char *params[1] = { user_id };
+    PGresult *res = db_exec_prepared(conn, STMT_FRIENDS_LIST, params);
+    db_pool_release(conn);
+    int result = write_friends_list_result(out, res);
     PQclear(res);
-    PQfinish(conn);
-    
-    return friends_array;
+    return result;
 }
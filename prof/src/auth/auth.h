@@ -2,22 +2,31 @@
 #define AUTH_H
 
 #include <json-c/json.h>
+#include <libpq-fe.h>
+#include "../utils/json_writer.h"
+#include "../utils/arena.h"
 
-// User registration and authentication functions
-char* register_user(const char* username, const char* password);
-char* login_user(const char* username, const char* password);
+// User registration and authentication functions. Returned strings are allocated from
+// `arena` (the request's), or from the heap when arena is NULL.
+char* register_user(arena_t *arena, const char* username, const char* password);
+char* login_user(arena_t *arena, const char* username, const char* password);
 int logout_user(const char* session_token);
-int validate_session_token(const char* session_token, char** user_id);
+// *username is set (or NULL) when non-NULL: a session cache miss fetches it with the
+// session, so handlers that show it need no second query
+int validate_session_token(arena_t *arena, const char* session_token, char** user_id, char** username);
 
 // Password utilities
 int hash_password(const char* password, char* hash_buffer, size_t buffer_size);
 int verify_password(const char* password, const char* hash);
 
 // Session token generation
-char* generate_session_token(void);
+char* generate_session_token(arena_t *arena);
 
 // Friend management
 int add_friend(const char* user_id, const char* friend_username);
-json_object* get_friends_list(const char* user_id);
+// Write the user's friends to `out` as a JSON array; 0 on success
+int write_friends_list(json_writer_t *out, const char* user_id);
+// Same, from a STMT_FRIENDS_LIST result the caller ran (e.g. through db_async)
+int write_friends_list_result(json_writer_t *out, const PGresult *res);
 
 #endif // AUTH_H
@@ -0,0 +1,386 @@
+#define _GNU_SOURCE
+#include "friend_graph.h"
+#include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Adjacency in compressed sparse row form: the friends of user u are
+// targets[offsets[u] .. offsets[u + 1]), sorted. User ids are SERIAL and dense, so
+// they index the arrays directly. Friendships added after the build go to a small
+// delta log that readers scan as well. Once it holds FRIEND_GRAPH_DELTA_MAX edges it is
+// merged into new arrays, built outside the write lock so readers are never held up.
+static pthread_rwlock_t graph_lock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t compaction_lock = PTHREAD_MUTEX_INITIALIZER;
+static int graph_enabled = 0;
+static uint32_t *offsets = NULL;
+static int32_t *targets = NULL;
+static int32_t node_count = 0;   // offsets has node_count + 1 entries
+static size_t edge_count = 0;
+
+static int32_t (*delta)[2] = NULL;
+static size_t delta_count = 0;
+static size_t delta_capacity = 0;
+
+// Usernames indexed by user id
+static char **usernames = NULL;
+static int32_t username_capacity = 0;
+
+static unsigned long stat_compactions = 0;
+static unsigned long stat_lookups = 0;
+static double stat_last_compaction_ms = 0.0;
+
+static int compare_int32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Build CSR arrays for `count` undirected pairs; returns 0 and fills the out parameters
+static int build_csr(const int32_t *pairs, size_t count, uint32_t **out_offsets,
+                     int32_t **out_targets, int32_t *out_nodes) {
+    int32_t max_id = 0;
+    for (size_t i = 0; i < count * 2; i++) {
+        if (pairs[i] > max_id) {
+            max_id = pairs[i];
+        }
+    }
+
+    int32_t nodes = max_id + 1;
+    uint32_t *new_offsets = calloc((size_t)nodes + 1, sizeof(uint32_t));
+    int32_t *new_targets = malloc((count * 2 + 1) * sizeof(int32_t));
+    uint32_t *cursor = malloc(((size_t)nodes + 1) * sizeof(uint32_t));
+    if (!new_offsets || !new_targets || !cursor) {
+        free(new_offsets);
+        free(new_targets);
+        free(cursor);
+        return -1;
+    }
+
+    // Counting sort by source: degrees, prefix sums, then scatter both directions
+    for (size_t i = 0; i < count; i++) {
+        new_offsets[pairs[2 * i] + 1]++;
+        new_offsets[pairs[2 * i + 1] + 1]++;
+    }
+    for (int32_t u = 0; u < nodes; u++) {
+        new_offsets[u + 1] += new_offsets[u];
+    }
+    memcpy(cursor, new_offsets, ((size_t)nodes + 1) * sizeof(uint32_t));
+    for (size_t i = 0; i < count; i++) {
+        int32_t a = pairs[2 * i], b = pairs[2 * i + 1];
+        new_targets[cursor[a]++] = b;
+        new_targets[cursor[b]++] = a;
+    }
+    for (int32_t u = 0; u < nodes; u++) {
+        size_t degree = new_offsets[u + 1] - new_offsets[u];
+        if (degree > 1) {
+            qsort(new_targets + new_offsets[u], degree, sizeof(int32_t), compare_int32);
+        }
+    }
+    free(cursor);
+
+    *out_offsets = new_offsets;
+    *out_targets = new_targets;
+    *out_nodes = nodes;
+    return 0;
+}
+
+static int csr_has_edge(int32_t a, int32_t b) {
+    if (a < 0 || a >= node_count) {
+        return 0;
+    }
+    return bsearch(&b, targets + offsets[a], offsets[a + 1] - offsets[a],
+                   sizeof(int32_t), compare_int32) != NULL;
+}
+
+static int delta_has_edge(int32_t a, int32_t b) {
+    for (size_t i = 0; i < delta_count; i++) {
+        if ((delta[i][0] == a && delta[i][1] == b) || (delta[i][0] == b && delta[i][1] == a)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int friend_graph_build(const int32_t *pairs, size_t count) {
+    for (size_t i = 0; i < count * 2; i++) {
+        if (pairs[i] < 0) {
+            return -1;
+        }
+    }
+
+    uint32_t *new_offsets;
+    int32_t *new_targets;
+    int32_t nodes;
+    if (build_csr(pairs, count, &new_offsets, &new_targets, &nodes) != 0) {
+        fprintf(stderr, "Failed to allocate friend graph\n");
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&graph_lock);
+    free(offsets);
+    free(targets);
+    offsets = new_offsets;
+    targets = new_targets;
+    node_count = nodes;
+    edge_count = count * 2;
+    delta_count = 0;
+    graph_enabled = 1;
+    pthread_rwlock_unlock(&graph_lock);
+    return 0;
+}
+
+// Merge the delta log into fresh CSR arrays. Snapshots under the read lock, builds with
+// no lock held, then swaps under the write lock, keeping edges added in the meantime.
+static int compact(void) {
+    pthread_mutex_lock(&compaction_lock);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_rwlock_rdlock(&graph_lock);
+    size_t merged = delta_count;
+    if (merged < FRIEND_GRAPH_DELTA_MAX) {
+        // Another thread compacted while we waited
+        pthread_rwlock_unlock(&graph_lock);
+        pthread_mutex_unlock(&compaction_lock);
+        return 0;
+    }
+    size_t count = edge_count / 2 + merged;
+    int32_t *pairs = malloc((count + 1) * 2 * sizeof(int32_t));
+    size_t n = 0;
+    if (pairs) {
+        for (int32_t u = 0; u < node_count; u++) {
+            for (uint32_t i = offsets[u]; i < offsets[u + 1]; i++) {
+                if (u < targets[i]) {
+                    pairs[2 * n] = u;
+                    pairs[2 * n + 1] = targets[i];
+                    n++;
+                }
+            }
+        }
+        memcpy(pairs + 2 * n, delta, merged * 2 * sizeof(int32_t));
+        n += merged;
+    }
+    pthread_rwlock_unlock(&graph_lock);
+
+    uint32_t *new_offsets;
+    int32_t *new_targets;
+    int32_t nodes;
+    int rc = pairs ? build_csr(pairs, n, &new_offsets, &new_targets, &nodes) : -1;
+    free(pairs);
+    if (rc != 0) {
+        pthread_mutex_unlock(&compaction_lock);
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&graph_lock);
+    uint32_t *old_offsets = offsets;
+    int32_t *old_targets = targets;
+    offsets = new_offsets;
+    targets = new_targets;
+    node_count = nodes;
+    edge_count = n * 2;
+    memmove(delta, delta + merged, (delta_count - merged) * sizeof(delta[0]));
+    delta_count -= merged;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    stat_compactions++;
+    stat_last_compaction_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1e6;
+    pthread_rwlock_unlock(&graph_lock);
+
+    free(old_offsets);
+    free(old_targets);
+    pthread_mutex_unlock(&compaction_lock);
+    return 0;
+}
+
+int friend_graph_add_edge(int32_t a, int32_t b) {
+    if (a <= 0 || b <= 0 || a == b) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&graph_lock);
+    if (!graph_enabled) {
+        pthread_rwlock_unlock(&graph_lock);
+        return -1;
+    }
+    if (csr_has_edge(a, b) || delta_has_edge(a, b)) {
+        pthread_rwlock_unlock(&graph_lock);
+        return 0;
+    }
+    if (delta_count == delta_capacity) {
+        size_t capacity = delta_capacity ? delta_capacity * 2 : FRIEND_GRAPH_DELTA_MAX;
+        int32_t (*grown)[2] = realloc(delta, capacity * sizeof(delta[0]));
+        if (!grown) {
+            pthread_rwlock_unlock(&graph_lock);
+            return -1;
+        }
+        delta = grown;
+        delta_capacity = capacity;
+    }
+    delta[delta_count][0] = a;
+    delta[delta_count][1] = b;
+    delta_count++;
+    int full = delta_count >= FRIEND_GRAPH_DELTA_MAX;
+    pthread_rwlock_unlock(&graph_lock);
+
+    if (full && compact() != 0) {
+        fprintf(stderr, "Friend graph compaction failed; new friendships stay in the delta log\n");
+    }
+    return 0;
+}
+
+int friend_graph_has_edge(int32_t a, int32_t b) {
+    pthread_rwlock_rdlock(&graph_lock);
+    int found = graph_enabled && (csr_has_edge(a, b) || delta_has_edge(a, b));
+    pthread_rwlock_unlock(&graph_lock);
+    return found;
+}
+
+static const char* username_locked(int32_t user_id) {
+    if (user_id >= 0 && user_id < username_capacity && usernames[user_id]) {
+        return usernames[user_id];
+    }
+    return "";
+}
+
+size_t friend_graph_for_each(int32_t user_id, friend_graph_visit_fn visit, void *ctx) {
+    size_t visited = 0;
+    pthread_rwlock_rdlock(&graph_lock);
+    __atomic_fetch_add(&stat_lookups, 1, __ATOMIC_RELAXED);
+
+    if (user_id >= 0 && user_id < node_count) {
+        for (uint32_t i = offsets[user_id]; i < offsets[user_id + 1]; i++) {
+            visit(targets[i], username_locked(targets[i]), ctx);
+            visited++;
+        }
+    }
+    for (size_t i = 0; i < delta_count; i++) {
+        int32_t other = delta[i][0] == user_id ? delta[i][1] : delta[i][1] == user_id ? delta[i][0] : 0;
+        if (other > 0) {
+            visit(other, username_locked(other), ctx);
+            visited++;
+        }
+    }
+
+    pthread_rwlock_unlock(&graph_lock);
+    return visited;
+}
+
+int friend_graph_set_username(int32_t user_id, const char *username) {
+    if (user_id <= 0 || !username) {
+        return -1;
+    }
+    char *copy = strdup(username);
+    if (!copy) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&graph_lock);
+    if (user_id >= username_capacity) {
+        int32_t capacity = username_capacity > 0 ? username_capacity : 1024;
+        while (capacity <= user_id) {
+            capacity *= 2;
+        }
+        char **grown = realloc(usernames, (size_t)capacity * sizeof(char *));
+        if (!grown) {
+            pthread_rwlock_unlock(&graph_lock);
+            free(copy);
+            return -1;
+        }
+        memset(grown + username_capacity, 0, (size_t)(capacity - username_capacity) * sizeof(char *));
+        usernames = grown;
+        username_capacity = capacity;
+    }
+    free(usernames[user_id]);
+    usernames[user_id] = copy;
+    pthread_rwlock_unlock(&graph_lock);
+    return 0;
+}
+
+int friend_graph_username(int32_t user_id, char *buf, size_t size) {
+    pthread_rwlock_rdlock(&graph_lock);
+    const char *name = username_locked(user_id);
+    snprintf(buf, size, "%s", name);
+    pthread_rwlock_unlock(&graph_lock);
+    return name[0] ? 0 : -1;
+}
+
+int friend_graph_load_from_db(void) {
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
+
+    PGresult *res = db_exec_prepared(conn, STMT_USER_ALL, NULL);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Loading users failed: %s", PQerrorMessage(conn));
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+    for (int i = 0; i < PQntuples(res); i++) {
+        friend_graph_set_username(atoi(PQgetvalue(res, i, 0)), PQgetvalue(res, i, 1));
+    }
+    PQclear(res);
+
+    res = db_exec_prepared(conn, STMT_FRIENDSHIP_ALL, NULL);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Loading friendships failed: %s", PQerrorMessage(conn));
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+    int rows = PQntuples(res);
+    int32_t *pairs = malloc(((size_t)rows + 1) * 2 * sizeof(int32_t));
+    if (!pairs) {
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+    for (int i = 0; i < rows; i++) {
+        pairs[2 * i] = atoi(PQgetvalue(res, i, 0));
+        pairs[2 * i + 1] = atoi(PQgetvalue(res, i, 1));
+    }
+    PQclear(res);
+    db_pool_release(conn);
+
+    int rc = friend_graph_build(pairs, (size_t)rows);
+    free(pairs);
+    return rc;
+}
+
+int friend_graph_enabled(void) {
+    pthread_rwlock_rdlock(&graph_lock);
+    int enabled = graph_enabled;
+    pthread_rwlock_unlock(&graph_lock);
+    return enabled;
+}
+
+void friend_graph_get_stats(friend_graph_stats_t *stats) {
+    pthread_rwlock_rdlock(&graph_lock);
+    stats->users = node_count > 0 ? (unsigned long)node_count : 0;
+    stats->edges = edge_count;
+    stats->delta_edges = delta_count;
+    stats->compactions = stat_compactions;
+    stats->last_compaction_ms = stat_last_compaction_ms;
+    pthread_rwlock_unlock(&graph_lock);
+    stats->lookups = __atomic_load_n(&stat_lookups, __ATOMIC_RELAXED);
+}
+
+json_object* friend_graph_stats_to_json(void) {
+    friend_graph_stats_t stats;
+    friend_graph_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(friend_graph_enabled()));
+    json_object_object_add(obj, "users", json_object_new_int64((int64_t)stats.users));
+    json_object_object_add(obj, "edges", json_object_new_int64((int64_t)stats.edges));
+    json_object_object_add(obj, "delta_edges", json_object_new_int64((int64_t)stats.delta_edges));
+    json_object_object_add(obj, "compactions", json_object_new_int64((int64_t)stats.compactions));
+    json_object_object_add(obj, "last_compaction_ms", json_object_new_double(stats.last_compaction_ms));
+    json_object_object_add(obj, "lookups", json_object_new_int64((int64_t)stats.lookups));
+    return obj;
+}
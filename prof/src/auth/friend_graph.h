@@ -0,0 +1,45 @@
+#ifndef FRIEND_GRAPH_H
+#define FRIEND_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json-c/json.h>
+
+// Called once per friend; username is only valid for the duration of the call
+typedef void (*friend_graph_visit_fn)(int32_t friend_id, const char *username, void *ctx);
+
+typedef struct {
+    unsigned long users;         // Ids covered by the CSR arrays
+    unsigned long edges;         // Directed edges in the CSR arrays (two per friendship)
+    unsigned long delta_edges;   // Friendships added since the last compaction
+    unsigned long compactions;
+    unsigned long lookups;
+    double last_compaction_ms;
+} friend_graph_stats_t;
+
+// Build the graph from `count` undirected (a, b) pairs and mark it authoritative
+int friend_graph_build(const int32_t *pairs, size_t count);
+
+// Load accepted friendships and usernames from the database; returns 0 on success
+int friend_graph_load_from_db(void);
+
+// Non-zero once the graph has been built or loaded
+int friend_graph_enabled(void);
+
+// Record a new friendship; duplicates are ignored
+int friend_graph_add_edge(int32_t a, int32_t b);
+int friend_graph_has_edge(int32_t a, int32_t b);
+
+// Call visit for each friend of user_id; returns the number of friends
+size_t friend_graph_for_each(int32_t user_id, friend_graph_visit_fn visit, void *ctx);
+
+// User directory used to name friends without a join
+int friend_graph_set_username(int32_t user_id, const char *username);
+
+// Copy a username into buf; returns -1 if the id is unknown
+int friend_graph_username(int32_t user_id, char *buf, size_t size);
+
+void friend_graph_get_stats(friend_graph_stats_t *stats);
+json_object* friend_graph_stats_to_json(void);
+
+#endif // FRIEND_GRAPH_H
@@ -0,0 +1,361 @@
+#define _GNU_SOURCE
+#include "session_cache.h"
+#include "../api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <openssl/sha.h>
+
+#define SESSION_CACHE_SHARDS 64 // Power of two; one lock per shard keeps workers off each other
+
+// Entries are keyed by SHA-256(token) so raw tokens never sit in process memory
+typedef struct session_entry {
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    char user_id[SESSION_CACHE_USER_ID_LEN];
+    time_t expires_at;
+    struct session_entry *next;
+} session_entry_t;
+
+// Min-heap node ordering entries by expiry. Nodes are never removed eagerly: when an
+// entry is refreshed or invalidated its old node goes stale and is skipped on pop.
+typedef struct {
+    time_t expires_at;
+    unsigned char key[SHA256_DIGEST_LENGTH];
+} expiry_node_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    session_entry_t **buckets;
+    size_t bucket_mask;
+    size_t count;
+    size_t capacity;
+    expiry_node_t *heap;
+    size_t heap_size;
+    size_t heap_capacity;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long inserts;
+    unsigned long invalidations;
+    unsigned long evictions;
+    unsigned long expirations;
+} session_shard_t;
+
+static session_shard_t shards[SESSION_CACHE_SHARDS];
+static unsigned int cache_ttl_sec;
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static size_t requested_capacity = SESSION_CACHE_CAPACITY;
+static unsigned int requested_ttl = SESSION_CACHE_TTL_SEC;
+
+static void cache_init_once(void) {
+    size_t per_shard = requested_capacity / SESSION_CACHE_SHARDS;
+    if (per_shard == 0) {
+        per_shard = 1;
+    }
+    size_t buckets = 1;
+    while (buckets < per_shard) {
+        buckets <<= 1;
+    }
+
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+        shards[i].buckets = calloc(buckets, sizeof(session_entry_t *));
+        shards[i].bucket_mask = shards[i].buckets ? buckets - 1 : 0;
+        shards[i].capacity = shards[i].buckets ? per_shard : 0;
+    }
+    cache_ttl_sec = requested_ttl;
+}
+
+// Size the cache; only the first call (or first use) takes effect
+void session_cache_init(size_t capacity, unsigned int ttl_sec) {
+    requested_capacity = capacity;
+    requested_ttl = ttl_sec;
+    pthread_once(&cache_once, cache_init_once);
+}
+
+static void hash_token(const char *session_token, unsigned char key[SHA256_DIGEST_LENGTH]) {
+    SHA256((const unsigned char *)session_token, strlen(session_token), key);
+}
+
+// The digest is uniformly distributed, so its bytes double as shard and bucket selectors
+static session_shard_t* shard_for(const unsigned char *key) {
+    return &shards[key[0] & (SESSION_CACHE_SHARDS - 1)];
+}
+
+static size_t bucket_for(const session_shard_t *shard, const unsigned char *key) {
+    uint64_t h;
+    memcpy(&h, key + 8, sizeof(h));
+    return (size_t)h & shard->bucket_mask;
+}
+
+// Unlink and free the entry *link points at. Caller holds the shard lock.
+static void unlink_entry(session_shard_t *shard, session_entry_t **link) {
+    session_entry_t *entry = *link;
+    *link = entry->next;
+    free(entry);
+    shard->count--;
+}
+
+static session_entry_t** find_link(session_shard_t *shard, const unsigned char *key) {
+    session_entry_t **link = &shard->buckets[bucket_for(shard, key)];
+    while (*link && memcmp((*link)->key, key, SHA256_DIGEST_LENGTH) != 0) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+static void heap_swap(expiry_node_t *a, expiry_node_t *b) {
+    expiry_node_t tmp = *a;
+    *a = *b;
+    *b = tmp;
+}
+
+static void heap_sift_down(session_shard_t *shard, size_t i) {
+    expiry_node_t *heap = shard->heap;
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        size_t smallest = i;
+        if (left < shard->heap_size && heap[left].expires_at < heap[smallest].expires_at) {
+            smallest = left;
+        }
+        if (right < shard->heap_size && heap[right].expires_at < heap[smallest].expires_at) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        heap_swap(&heap[i], &heap[smallest]);
+        i = smallest;
+    }
+}
+
+// Rebuild the heap from live entries once stale nodes dominate it
+static void heap_compact(session_shard_t *shard) {
+    size_t n = 0;
+    for (size_t b = 0; b <= shard->bucket_mask; b++) {
+        for (session_entry_t *entry = shard->buckets[b]; entry; entry = entry->next) {
+            shard->heap[n].expires_at = entry->expires_at;
+            memcpy(shard->heap[n].key, entry->key, SHA256_DIGEST_LENGTH);
+            n++;
+        }
+    }
+    shard->heap_size = n;
+    for (size_t i = n / 2; i-- > 0;) {
+        heap_sift_down(shard, i);
+    }
+}
+
+static int heap_push(session_shard_t *shard, const unsigned char *key, time_t expires_at) {
+    if (shard->heap_size > 2 * shard->count + 64) {
+        heap_compact(shard);
+    }
+    if (shard->heap_size == shard->heap_capacity) {
+        size_t capacity = shard->heap_capacity ? shard->heap_capacity * 2 : 64;
+        expiry_node_t *heap = realloc(shard->heap, capacity * sizeof(expiry_node_t));
+        if (!heap) {
+            return -1;
+        }
+        shard->heap = heap;
+        shard->heap_capacity = capacity;
+    }
+
+    size_t i = shard->heap_size++;
+    shard->heap[i].expires_at = expires_at;
+    memcpy(shard->heap[i].key, key, SHA256_DIGEST_LENGTH);
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (shard->heap[parent].expires_at <= shard->heap[i].expires_at) {
+            break;
+        }
+        heap_swap(&shard->heap[parent], &shard->heap[i]);
+        i = parent;
+    }
+    return 0;
+}
+
+// Pop heap nodes until one matches a live entry; returns that entry's link or NULL.
+// Only entries expiring at or before `until` are considered.
+static session_entry_t** heap_pop_live(session_shard_t *shard, time_t until) {
+    while (shard->heap_size > 0 && shard->heap[0].expires_at <= until) {
+        expiry_node_t top = shard->heap[0];
+        shard->heap[0] = shard->heap[--shard->heap_size];
+        heap_sift_down(shard, 0);
+
+        session_entry_t **link = find_link(shard, top.key);
+        if (*link && (*link)->expires_at == top.expires_at) {
+            return link;
+        }
+    }
+    return NULL;
+}
+
+// Look up a session token; returns 0 and copies the user id on a hit, -1 on a miss
+int session_cache_lookup(const char *session_token, char *user_id, size_t user_id_size) {
+    if (!session_token || !user_id || user_id_size == 0) {
+        return -1;
+    }
+    pthread_once(&cache_once, cache_init_once);
+
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    hash_token(session_token, key);
+    session_shard_t *shard = shard_for(key);
+    time_t now = time(NULL);
+    int found = -1;
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->capacity > 0) {
+        // Expired entries are left for session_cache_expire(); the caller revalidates
+        session_entry_t *entry = *find_link(shard, key);
+        if (entry && now <= entry->expires_at) {
+            snprintf(user_id, user_id_size, "%s", entry->user_id);
+            found = 0;
+        }
+    }
+    if (found == 0) {
+        shard->hits++;
+    } else {
+        shard->misses++;
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    return found;
+}
+
+// Remember a validated session until expires_at (bounded by the cache TTL)
+void session_cache_insert(const char *session_token, const char *user_id, time_t expires_at) {
+    if (!session_token || !user_id || strlen(user_id) >= SESSION_CACHE_USER_ID_LEN) {
+        return;
+    }
+    pthread_once(&cache_once, cache_init_once);
+
+    // The TTL bounds how long a session revoked by another process can stay usable here
+    time_t ttl_limit = time(NULL) + (time_t)cache_ttl_sec;
+    if (expires_at > ttl_limit) {
+        expires_at = ttl_limit;
+    }
+
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    hash_token(session_token, key);
+    session_shard_t *shard = shard_for(key);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->capacity == 0) {
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    session_entry_t *entry = *find_link(shard, key);
+    if (entry) {
+        snprintf(entry->user_id, sizeof(entry->user_id), "%s", user_id);
+        if (entry->expires_at != expires_at) {
+            entry->expires_at = expires_at;
+            heap_push(shard, key, expires_at);
+        }
+        pthread_mutex_unlock(&shard->lock);
+        return;
+    }
+
+    if (shard->count >= shard->capacity) {
+        // Full: drop whichever entry would have expired first
+        session_entry_t **victim = heap_pop_live(shard, (time_t)INT64_MAX);
+        if (victim) {
+            unlink_entry(shard, victim);
+            shard->evictions++;
+        }
+    }
+
+    entry = malloc(sizeof(session_entry_t));
+    if (entry && heap_push(shard, key, expires_at) == 0) {
+        size_t bucket = bucket_for(shard, key);
+        memcpy(entry->key, key, sizeof(key));
+        snprintf(entry->user_id, sizeof(entry->user_id), "%s", user_id);
+        entry->expires_at = expires_at;
+        entry->next = shard->buckets[bucket];
+        shard->buckets[bucket] = entry;
+        shard->count++;
+        shard->inserts++;
+    } else {
+        free(entry);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Forget a session, e.g. on logout
+void session_cache_remove(const char *session_token) {
+    if (!session_token) {
+        return;
+    }
+    pthread_once(&cache_once, cache_init_once);
+
+    unsigned char key[SHA256_DIGEST_LENGTH];
+    hash_token(session_token, key);
+    session_shard_t *shard = shard_for(key);
+
+    pthread_mutex_lock(&shard->lock);
+    if (shard->capacity > 0) {
+        session_entry_t **link = find_link(shard, key);
+        if (*link) {
+            unlink_entry(shard, link); // Its heap node goes stale and is skipped later
+            shard->invalidations++;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Drop every entry that expired before `now`, cheapest-first off each shard's heap
+size_t session_cache_expire(time_t now) {
+    pthread_once(&cache_once, cache_init_once);
+    size_t expired = 0;
+
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        session_shard_t *shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        session_entry_t **link;
+        while (shard->capacity > 0 && (link = heap_pop_live(shard, now - 1)) != NULL) {
+            unlink_entry(shard, link);
+            shard->expirations++;
+            expired++;
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+
+    return expired;
+}
+
+void session_cache_get_stats(session_cache_stats_t *stats) {
+    pthread_once(&cache_once, cache_init_once);
+    memset(stats, 0, sizeof(*stats));
+
+    for (int i = 0; i < SESSION_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        stats->hits += shards[i].hits;
+        stats->misses += shards[i].misses;
+        stats->inserts += shards[i].inserts;
+        stats->invalidations += shards[i].invalidations;
+        stats->evictions += shards[i].evictions;
+        stats->expirations += shards[i].expirations;
+        stats->entries += shards[i].count;
+        stats->capacity += shards[i].capacity;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+}
+
+json_object* session_cache_stats_to_json(void) {
+    session_cache_stats_t stats;
+    session_cache_get_stats(&stats);
+    unsigned long lookups = stats.hits + stats.misses;
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "hits", json_object_new_int64((int64_t)stats.hits));
+    json_object_object_add(obj, "misses", json_object_new_int64((int64_t)stats.misses));
+    json_object_object_add(obj, "hit_ratio", json_object_new_double(lookups ? (double)stats.hits / lookups : 0.0));
+    json_object_object_add(obj, "inserts", json_object_new_int64((int64_t)stats.inserts));
+    json_object_object_add(obj, "invalidations", json_object_new_int64((int64_t)stats.invalidations));
+    json_object_object_add(obj, "evictions", json_object_new_int64((int64_t)stats.evictions));
+    json_object_object_add(obj, "expirations", json_object_new_int64((int64_t)stats.expirations));
+    json_object_object_add(obj, "entries", json_object_new_int64((int64_t)stats.entries));
+    json_object_object_add(obj, "capacity", json_object_new_int64((int64_t)stats.capacity));
+    return obj;
+}
@@ -0,0 +1,42 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+#include <stddef.h>
+#include <time.h>
+#include <json-c/json.h>
+
+#define SESSION_CACHE_USER_ID_LEN 24
+
+// Counters summed over all shards
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long inserts;
+    unsigned long invalidations; // Removed by logout
+    unsigned long evictions;     // Dropped to stay within capacity
+    unsigned long expirations;   // Dropped by session_cache_expire()
+    unsigned long entries;
+    unsigned long capacity;
+} session_cache_stats_t;
+
+// Size the cache. Entries live until the session expires or ttl_sec passes,
+// whichever comes first. Other calls initialize it with the api.h defaults.
+void session_cache_init(size_t capacity, unsigned int ttl_sec);
+
+// Look up a session token; returns 0 and copies the user id on a hit, -1 on a miss
+int session_cache_lookup(const char *session_token, char *user_id, size_t user_id_size);
+
+// Remember a validated session until expires_at (bounded by the cache TTL)
+void session_cache_insert(const char *session_token, const char *user_id, time_t expires_at);
+
+// Forget a session, e.g. on logout
+void session_cache_remove(const char *session_token);
+
+// Drop entries that expired before `now`; returns how many were removed.
+// Driven by the session sweeper so request threads never do cleanup work.
+size_t session_cache_expire(time_t now);
+
+void session_cache_get_stats(session_cache_stats_t *stats);
+json_object* session_cache_stats_to_json(void);
+
+#endif // SESSION_CACHE_H
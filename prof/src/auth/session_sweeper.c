@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+#include "session_sweeper.h"
+#include "session_cache.h"
+#include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+// Upper bound on batches per pass so a large backlog cannot hold a pooled connection for long
+#define SESSION_SWEEP_MAX_BATCHES 100
+
+static pthread_t sweeper_thread;
+static pthread_mutex_t sweeper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sweeper_wake;
+static int sweeper_running = 0;
+static int sweeper_stopping = 0;
+static unsigned int sweep_interval_sec = SESSION_SWEEP_INTERVAL_SEC;
+static unsigned int sweep_batch_size = SESSION_SWEEP_BATCH_SIZE;
+static session_sweeper_stats_t sweeper_stats;
+
+static double monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Delete one batch of expired rows; returns rows deleted or -1 on error
+static long sweep_batch(const char *batch_param) {
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
+
+    const char *params[1] = { batch_param };
+    PGresult *res = db_exec_prepared(conn, STMT_SESSION_SWEEP, params);
+    long deleted = -1;
+    if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+        deleted = strtol(PQcmdTuples(res), NULL, 10);
+    } else {
+        fprintf(stderr, "Session sweep failed: %s", PQerrorMessage(conn));
+    }
+    PQclear(res);
+    db_pool_release(conn);
+    return deleted;
+}
+
+long session_sweeper_run_once(void) {
+    double start = monotonic_ms();
+    size_t cache_expired = session_cache_expire(time(NULL));
+
+    pthread_mutex_lock(&sweeper_lock);
+    unsigned int batch_size = sweep_batch_size;
+    pthread_mutex_unlock(&sweeper_lock);
+
+    char batch_param[16];
+    snprintf(batch_param, sizeof(batch_param), "%u", batch_size);
+
+    // Keep going while batches come back full; release the connection between them
+    long total = 0;
+    int failed = 0;
+    for (int i = 0; i < SESSION_SWEEP_MAX_BATCHES; i++) {
+        long deleted = sweep_batch(batch_param);
+        if (deleted < 0) {
+            failed = 1;
+            break;
+        }
+        total += deleted;
+        if ((unsigned long)deleted < batch_size) {
+            break;
+        }
+    }
+
+    pthread_mutex_lock(&sweeper_lock);
+    sweeper_stats.runs++;
+    sweeper_stats.rows_deleted += (unsigned long)total;
+    sweeper_stats.cache_expired += cache_expired;
+    sweeper_stats.last_run_ms = monotonic_ms() - start;
+    if (failed) {
+        sweeper_stats.errors++;
+    }
+    pthread_mutex_unlock(&sweeper_lock);
+
+    return failed ? -1 : total;
+}
+
+static void* sweeper_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&sweeper_lock);
+    while (!sweeper_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += sweep_interval_sec;
+        while (!sweeper_stopping &&
+               pthread_cond_timedwait(&sweeper_wake, &sweeper_lock, &deadline) == 0) {
+            // Woken early without a stop request; keep waiting out the interval
+        }
+        if (sweeper_stopping) {
+            break;
+        }
+
+        pthread_mutex_unlock(&sweeper_lock);
+        session_sweeper_run_once();
+        pthread_mutex_lock(&sweeper_lock);
+    }
+    pthread_mutex_unlock(&sweeper_lock);
+    return NULL;
+}
+
+int session_sweeper_start(unsigned int interval_sec, unsigned int batch_size) {
+    pthread_mutex_lock(&sweeper_lock);
+    if (sweeper_running) {
+        pthread_mutex_unlock(&sweeper_lock);
+        return 0;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&sweeper_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    sweep_interval_sec = interval_sec > 0 ? interval_sec : SESSION_SWEEP_INTERVAL_SEC;
+    sweep_batch_size = batch_size > 0 ? batch_size : SESSION_SWEEP_BATCH_SIZE;
+    sweeper_stopping = 0;
+
+    if (pthread_create(&sweeper_thread, NULL, sweeper_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start session sweeper thread\n");
+        pthread_cond_destroy(&sweeper_wake);
+        pthread_mutex_unlock(&sweeper_lock);
+        return -1;
+    }
+    sweeper_running = 1;
+    pthread_mutex_unlock(&sweeper_lock);
+    return 0;
+}
+
+void session_sweeper_stop(void) {
+    pthread_mutex_lock(&sweeper_lock);
+    if (!sweeper_running) {
+        pthread_mutex_unlock(&sweeper_lock);
+        return;
+    }
+    sweeper_stopping = 1;
+    pthread_cond_signal(&sweeper_wake);
+    pthread_mutex_unlock(&sweeper_lock);
+
+    pthread_join(sweeper_thread, NULL);
+
+    pthread_mutex_lock(&sweeper_lock);
+    sweeper_running = 0;
+    pthread_cond_destroy(&sweeper_wake);
+    pthread_mutex_unlock(&sweeper_lock);
+}
+
+void session_sweeper_get_stats(session_sweeper_stats_t *stats) {
+    pthread_mutex_lock(&sweeper_lock);
+    *stats = sweeper_stats;
+    pthread_mutex_unlock(&sweeper_lock);
+}
+
+json_object* session_sweeper_stats_to_json(void) {
+    session_sweeper_stats_t stats;
+    session_sweeper_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "interval_sec", json_object_new_int((int)sweep_interval_sec));
+    json_object_object_add(obj, "batch_size", json_object_new_int((int)sweep_batch_size));
+    json_object_object_add(obj, "runs", json_object_new_int64((int64_t)stats.runs));
+    json_object_object_add(obj, "rows_deleted", json_object_new_int64((int64_t)stats.rows_deleted));
+    json_object_object_add(obj, "cache_expired", json_object_new_int64((int64_t)stats.cache_expired));
+    json_object_object_add(obj, "errors", json_object_new_int64((int64_t)stats.errors));
+    json_object_object_add(obj, "last_run_ms", json_object_new_double(stats.last_run_ms));
+    return obj;
+}
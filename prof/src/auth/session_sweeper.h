@@ -0,0 +1,28 @@
+#ifndef SESSION_SWEEPER_H
+#define SESSION_SWEEPER_H
+
+#include <json-c/json.h>
+
+// Counters reported by session_sweeper_get_stats()
+typedef struct {
+    unsigned long runs;            // Completed sweep passes
+    unsigned long rows_deleted;    // Expired rows removed from user_sessions
+    unsigned long cache_expired;   // Entries dropped from the session cache
+    unsigned long errors;          // Passes cut short by a database error
+    double last_run_ms;
+} session_sweeper_stats_t;
+
+// Start the background thread that purges expired sessions every interval_sec,
+// deleting at most batch_size rows per statement. Returns 0 on success.
+int session_sweeper_start(unsigned int interval_sec, unsigned int batch_size);
+
+// Run one sweep pass on the calling thread; returns rows deleted or -1 on error
+long session_sweeper_run_once(void);
+
+// Wake the thread, let it finish its current batch and join it
+void session_sweeper_stop(void);
+
+void session_sweeper_get_stats(session_sweeper_stats_t *stats);
+json_object* session_sweeper_stats_to_json(void);
+
+#endif // SESSION_SWEEPER_H
@@ -5,6 +5,8 @@
 #include <libpq-fe.h>
 #include <h3/h3api.h>
 #include "coordinate_logger.h"
+#include "db/db_statements.h"
+#include "routing/hier_path.h"
 
 #define CONN_STR "host=localhost dbname=mydb user=myuser password=mypassword"
 
@@ -33,8 +35,18 @@ double haversine_distance(double lat1, double lon1, double lat2, double lon2) {
 
 // Note: latlng_to_h3 function moved to location.c to avoid conflicts
 
-// Get path between two H3 indexes using A* algorithm
+// Get path between two H3 indexes with the coarse-to-fine planner (routing/hier_path.h),
+// which only allocates a corridor's worth of cells per level. The straight grid line is
+// the fallback if no level finds a way.
 int get_h3_path(H3Index start, H3Index end, H3Index **path) {
+    int size = hier_h3_path(NULL, start, end, path, NULL);
+    if (size > 0) {
+        return size;
+    }
+    if (size == HIER_NO_MEMORY) {
+        return -2;
+    }
+
     // First get the size of the path
     int64_t pathSize;
     H3Error err = gridPathCellsSize(start, end, &pathSize);
@@ -60,83 +72,6 @@ int get_h3_path(H3Index start, H3Index end, H3Index **path) {
     return (int)pathSize; // Return the size of the path
 }
 
-// A* pathfinding using H3 grid
-typedef struct {
-    H3Index index;
-    double g_score;  // Cost from start to current node
-    double f_score;  // Estimated total cost from start to goal through current node
-} AStarNode;
-
-// Simple priority queue implementation (for demonstration purposes)
-typedef struct {
-    AStarNode* nodes;
-    int size;
-    int capacity;
-} PriorityQueue;
-
-PriorityQueue* create_priority_queue(int capacity) {
-    PriorityQueue* pq = malloc(sizeof(PriorityQueue));
-    pq->nodes = malloc(capacity * sizeof(AStarNode));
-    pq->size = 0;
-    pq->capacity = capacity;
-    return pq;
-}
-
-void destroy_priority_queue(PriorityQueue* pq) {
-    free(pq->nodes);
-    free(pq);
-}
-
-void push_priority_queue(PriorityQueue* pq, AStarNode node) {
-    if (pq->size >= pq->capacity) return;
-    
-    pq->nodes[pq->size++] = node;
-    
-    // Simple bubble up for min-heap based on f_score
-    int i = pq->size - 1;
-    while (i > 0) {
-        int parent = (i - 1) / 2;
-        if (pq->nodes[parent].f_score <= pq->nodes[i].f_score) break;
-        AStarNode temp = pq->nodes[parent];
-        pq->nodes[parent] = pq->nodes[i];
-        pq->nodes[i] = temp;
-        i = parent;
-    }
-}
-
-AStarNode pop_priority_queue(PriorityQueue* pq) {
-    if (pq->size <= 0) {
-        AStarNode empty = {0, 0, 0};
-        return empty;
-    }
-    
-    AStarNode result = pq->nodes[0];
-    pq->nodes[0] = pq->nodes[--pq->size];
-    
-    // Bubble down
-    int i = 0;
-    while (1) {
-        int left = 2 * i + 1;
-        int right = 2 * i + 2;
-        int smallest = i;
-        
-        if (left < pq->size && pq->nodes[left].f_score < pq->nodes[smallest].f_score)
-            smallest = left;
-            
-        if (right < pq->size && pq->nodes[right].f_score < pq->nodes[smallest].f_score)
-            smallest = right;
-            
-        if (smallest == i) break;
-        
-        AStarNode temp = pq->nodes[i];
-        pq->nodes[i] = pq->nodes[smallest];
-        pq->nodes[smallest] = temp;
-        i = smallest;
-    }
-    
-    return result;
-}
-
 // Calculate distance between two H3 indexes using Haversine formula
 double h3_distance(H3Index h1, H3Index h2) {
     LatLng coord1, coord2;
@@ -152,7 +87,8 @@ double h3_distance(H3Index h1, H3Index h2) {
     return haversine_distance(lat1, lon1, lat2, lon2);
 }
 
-// Note: get_astar_path function moved to location.c to avoid conflicts
+// Note: get_astar_path function moved to location.c to avoid conflicts; the search
+// itself is in routing/astar.c
 
 // Save both locations and distance in a single row, including H3 indices
 void save_location_pair_to_db(PGconn *conn, const char *name1, double lat1, double lon1, 
@@ -173,14 +109,16 @@ void save_location_pair_to_db(PGconn *conn, const char *name1, double lat1, doub
     h3ToString(h3_1, h3_1_str, 17);
     h3ToString(h3_2, h3_2_str, 17);
     
-    char query[1200];
-    
-    snprintf(query, sizeof(query),
-             "INSERT INTO coordinates (first_name, first_lat, first_lon, first_h3, second_name, second_lat, second_lon, second_h3, distance) "
-             "VALUES ('%s', %f, %f, '%s', '%s', %f, %f, '%s', %f);",
-             name1, lat1, lon1, h3_1_str, name2, lat2, lon2, h3_2_str, distance);
-
-    PGresult *res = PQexec(conn, query);
+    char lat1_str[32], lon1_str[32], lat2_str[32], lon2_str[32], distance_str[32];
+    snprintf(lat1_str, sizeof(lat1_str), "%f", lat1);
+    snprintf(lon1_str, sizeof(lon1_str), "%f", lon1);
+    snprintf(lat2_str, sizeof(lat2_str), "%f", lat2);
+    snprintf(lon2_str, sizeof(lon2_str), "%f", lon2);
+    snprintf(distance_str, sizeof(distance_str), "%f", distance);
+    const char *params[9] = { name1, lat1_str, lon1_str, h3_1_str,
+                              name2, lat2_str, lon2_str, h3_2_str, distance_str };
+
+    PGresult *res = db_exec_prepared(conn, STMT_COORDINATE_PAIR_INSERT, params);
     if (PQresultStatus(res) != PGRES_COMMAND_OK) {
         fprintf(stderr, "Insert failed: %s", PQerrorMessage(conn));
     }
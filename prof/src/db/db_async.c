@@ -0,0 +1,499 @@
+#define _GNU_SOURCE
+#include "db_async.h"
+#include "../api.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define DB_ASYNC_EPOLL_BATCH 64
+#define DB_ASYNC_RETRY_SEC 1          // Wait between attempts to reopen a lost connection
+
+typedef struct {
+    PGconn *conn;
+    int fd;
+    uint64_t prepared;                // Statements prepared when the connection was opened
+    int pipelined;                    // Several statements in flight at once (libpq 14+)
+    int want_write;                   // EPOLLOUT registered because PQflush() left data queued
+    unsigned int in_flight;
+    db_async_call_t *head;            // Sent, in order; results arrive in the same order
+    db_async_call_t *tail;
+    time_t retry_at;
+} async_conn_t;
+
+static async_conn_t *conns = NULL;
+static unsigned int conn_count = 0;
+static char *async_conninfo = NULL;
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static int async_running = 0;
+static pthread_t loop_thread;
+
+// Submissions waiting for a pipeline slot; appended by HTTP workers, drained by the loop
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static db_async_call_t *queue_head = NULL;
+static db_async_call_t *queue_tail = NULL;
+
+static db_async_stats_t async_stats;
+
+static inline void stat_sub(unsigned long *counter, unsigned long value) {
+    __atomic_fetch_sub(counter, value, __ATOMIC_RELAXED);
+}
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void signal_loop(void) {
+    uint64_t one = 1;
+    ssize_t n = write(wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+// Publish the result and wake the request. Nothing may touch `call` afterwards: once
+// resumed, the request can complete and free it.
+static void finish_call(db_async_call_t *call, PGresult *res) {
+    call->result = res;
+    if (res) {
+        stat_add(&async_stats.completed, 1);
+        async_stats.total_latency_ms += now_ms() - call->queued_at; // Loop thread only
+    } else {
+        stat_add(&async_stats.failed, 1);
+    }
+    struct MHD_Connection *connection = call->connection;
+    if (__atomic_exchange_n(&call->state, DB_ASYNC_CALL_DONE, __ATOMIC_ACQ_REL) == DB_ASYNC_CALL_PARKED) {
+        MHD_resume_connection(connection);
+    }
+}
+
+static void set_write_interest(async_conn_t *c, int want_write) {
+    if (c->want_write == want_write) {
+        return;
+    }
+    struct epoll_event ev = { .events = EPOLLIN | (want_write ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_write = want_write;
+}
+
+// Drop a connection; its in-flight calls fail and, unless stopping, it is reopened later
+static void close_connection(async_conn_t *c, int lost) {
+    if (lost) {
+        fprintf(stderr, "Async database connection lost: %s", PQerrorMessage(c->conn));
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    while (c->head) {
+        db_async_call_t *call = c->head;
+        c->head = call->next;
+        stat_sub(&async_stats.in_flight, 1);
+        if (call->result) {
+            PQclear(call->result);
+        }
+        finish_call(call, NULL);
+    }
+    c->tail = NULL;
+    c->in_flight = 0;
+    PQfinish(c->conn);
+    c->conn = NULL;
+    c->fd = -1;
+    c->want_write = 0;
+    c->retry_at = time(NULL) + DB_ASYNC_RETRY_SEC;
+    __atomic_fetch_sub(&async_stats.open, 1, __ATOMIC_RELAXED);
+}
+
+// Connect and prepare synchronously; only done at startup and after a failure
+static int open_connection(async_conn_t *c) {
+    c->conn = PQconnectdb(async_conninfo);
+    if (PQstatus(c->conn) != CONNECTION_OK) {
+        fprintf(stderr, "Async database connection failed: %s", PQerrorMessage(c->conn));
+        PQfinish(c->conn);
+        c->conn = NULL;
+        c->retry_at = time(NULL) + DB_ASYNC_RETRY_SEC;
+        return -1;
+    }
+
+    c->prepared = db_prepare_all(c->conn);
+    c->pipelined = 0;
+    if (PQsetnonblocking(c->conn, 1) != 0) {
+        fprintf(stderr, "Failed to make async database connection non-blocking\n");
+        PQfinish(c->conn);
+        c->conn = NULL;
+        c->retry_at = time(NULL) + DB_ASYNC_RETRY_SEC;
+        return -1;
+    }
+#ifdef LIBPQ_HAS_PIPELINING
+    c->pipelined = PQenterPipelineMode(c->conn) == 1;
+#endif
+
+    c->fd = PQsocket(c->conn);
+    c->want_write = 0;
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+        fprintf(stderr, "Async database epoll_ctl failed: %s\n", strerror(errno));
+        PQfinish(c->conn);
+        c->conn = NULL;
+        c->retry_at = time(NULL) + DB_ASYNC_RETRY_SEC;
+        return -1;
+    }
+    __atomic_fetch_add(&async_stats.open, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+static db_async_call_t* pop_queued(void) {
+    pthread_mutex_lock(&queue_lock);
+    db_async_call_t *call = queue_head;
+    if (call) {
+        queue_head = call->next;
+        if (!queue_head) {
+            queue_tail = NULL;
+        }
+        call->next = NULL;
+        stat_sub(&async_stats.queued, 1);
+    }
+    pthread_mutex_unlock(&queue_lock);
+    return call;
+}
+
+// Fail everything still waiting for a slot (no connection, or shutting down)
+static void fail_queued(void) {
+    db_async_call_t *call;
+    while ((call = pop_queued()) != NULL) {
+        finish_call(call, NULL);
+    }
+}
+
+static void complete_head(async_conn_t *c) {
+    db_async_call_t *call = c->head;
+    c->head = call->next;
+    if (!c->head) {
+        c->tail = NULL;
+    }
+    c->in_flight--;
+    stat_sub(&async_stats.in_flight, 1);
+    finish_call(call, call->result);
+}
+
+// Send queued statements to the least loaded connections until every pipeline is full
+static void dispatch_queued(void) {
+    unsigned int depth_limit = DB_ASYNC_PIPELINE_DEPTH > 0 ? DB_ASYNC_PIPELINE_DEPTH : 1;
+    for (;;) {
+        async_conn_t *best = NULL;
+        for (unsigned int i = 0; i < conn_count; i++) {
+            async_conn_t *c = &conns[i];
+            unsigned int depth = c->pipelined ? depth_limit : 1;
+            if (c->conn && c->in_flight < depth && (!best || c->in_flight < best->in_flight)) {
+                best = c;
+            }
+        }
+        if (!best) {
+            return;
+        }
+        db_async_call_t *call = pop_queued();
+        if (!call) {
+            return;
+        }
+
+        call->result = NULL;
+        int sent = db_send_prepared(best->conn, best->prepared, call->stmt, call->params);
+#ifdef LIBPQ_HAS_PIPELINING
+        // A sync after each statement keeps one failure from aborting its neighbours
+        if (sent && best->pipelined) {
+            sent = PQpipelineSync(best->conn);
+        }
+#endif
+        if (best->tail) {
+            best->tail->next = call;
+        } else {
+            best->head = call;
+        }
+        best->tail = call;
+        best->in_flight++;
+        unsigned long in_flight = __atomic_add_fetch(&async_stats.in_flight, 1, __ATOMIC_RELAXED);
+        if (in_flight > async_stats.max_in_flight) {
+            async_stats.max_in_flight = in_flight;
+        }
+
+        int flushed = sent ? PQflush(best->conn) : -1;
+        if (flushed < 0) {
+            close_connection(best, 1);
+            continue;
+        }
+        set_write_interest(best, flushed == 1);
+    }
+}
+
+static void read_results(async_conn_t *c) {
+    if (!PQconsumeInput(c->conn)) {
+        close_connection(c, 1);
+        return;
+    }
+
+    int nulls = 0;
+    while (c->head && !PQisBusy(c->conn)) {
+        PGresult *res = PQgetResult(c->conn);
+        if (!res) {
+            // End of the head statement's results. A pipeline still owes its sync
+            // marker; two NULLs in a row mean nothing more has arrived yet.
+            if (!c->pipelined) {
+                complete_head(c);
+            } else if (++nulls > 1) {
+                break;
+            }
+            continue;
+        }
+        nulls = 0;
+#ifdef LIBPQ_HAS_PIPELINING
+        if (PQresultStatus(res) == PGRES_PIPELINE_SYNC) {
+            PQclear(res);
+            complete_head(c);
+            continue;
+        }
+#endif
+        // Keep the first result of each statement, as PQexec would
+        if (c->head->result) {
+            PQclear(res);
+        } else {
+            c->head->result = res;
+        }
+    }
+}
+
+static void reopen_due(void) {
+    time_t now = time(NULL);
+    int open = 0;
+    for (unsigned int i = 0; i < conn_count; i++) {
+        async_conn_t *c = &conns[i];
+        if (!c->conn && c->retry_at <= now && open_connection(c) == 0) {
+            stat_add(&async_stats.reconnects, 1);
+        }
+        open += c->conn != NULL;
+    }
+    // Better a quick 500 than requests parked until the database returns
+    if (open == 0) {
+        fail_queued();
+    }
+}
+
+static void* loop_main(void *arg) {
+    (void)arg;
+    struct epoll_event events[DB_ASYNC_EPOLL_BATCH];
+
+    while (__atomic_load_n(&async_running, __ATOMIC_ACQUIRE)) {
+        reopen_due();
+        dispatch_queued();
+
+        int n = epoll_wait(epoll_fd, events, DB_ASYNC_EPOLL_BATCH, 1000);
+        if (n < 0 && errno != EINTR) {
+            fprintf(stderr, "Async database epoll_wait failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            async_conn_t *c = events[i].data.ptr;
+            if (!c) {
+                uint64_t value;
+                ssize_t r = read(wake_fd, &value, sizeof(value));
+                (void)r;
+                continue;
+            }
+            if (!c->conn) {
+                continue; // Closed earlier in this batch
+            }
+            if (events[i].events & EPOLLOUT) {
+                int flushed = PQflush(c->conn);
+                if (flushed < 0) {
+                    close_connection(c, 1);
+                    continue;
+                }
+                set_write_interest(c, flushed == 1);
+            }
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                read_results(c);
+            }
+        }
+    }
+    return NULL;
+}
+
+int db_async_start(const char *conninfo, unsigned int connections) {
+    if (async_running) {
+        return 0;
+    }
+    if (connections == 0) {
+        return -1;
+    }
+
+    conns = calloc(connections, sizeof(async_conn_t));
+    async_conninfo = strdup(conninfo);
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!conns || !async_conninfo || epoll_fd < 0 || wake_fd < 0) {
+        fprintf(stderr, "Failed to set up async database layer\n");
+        db_async_stop();
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    conn_count = connections;
+    async_stats.connections = connections;
+    unsigned int opened = 0;
+    for (unsigned int i = 0; i < connections; i++) {
+        conns[i].fd = -1;
+        opened += open_connection(&conns[i]) == 0;
+    }
+    if (opened == 0) {
+        db_async_stop();
+        return -1;
+    }
+
+    async_running = 1;
+    if (pthread_create(&loop_thread, NULL, loop_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start async database thread\n");
+        async_running = 0;
+        db_async_stop();
+        return -1;
+    }
+    return 0;
+}
+
+int db_async_enabled(void) {
+    return __atomic_load_n(&async_running, __ATOMIC_ACQUIRE);
+}
+
+int db_async_begin(db_async_call_t *call, struct MHD_Connection *connection,
+                   db_stmt_id_t stmt, const char *const *params) {
+    int nparams = db_statement_param_count(stmt);
+    if (nparams < 0 || nparams > DB_ASYNC_MAX_PARAMS) {
+        return -1;
+    }
+
+    memset(call, 0, sizeof(*call));
+    call->connection = connection;
+    call->stmt = stmt;
+    for (int i = 0; i < nparams; i++) {
+        call->params[i] = params[i];
+    }
+    call->state = DB_ASYNC_CALL_QUEUED;
+    call->queued_at = now_ms();
+
+    pthread_mutex_lock(&queue_lock);
+    if (!async_running || async_stats.queued >= DB_ASYNC_QUEUE_LIMIT) {
+        int running = async_running;
+        pthread_mutex_unlock(&queue_lock);
+        if (running) {
+            stat_add(&async_stats.queue_full, 1);
+        }
+        call->state = DB_ASYNC_CALL_IDLE;
+        return -1;
+    }
+    if (queue_tail) {
+        queue_tail->next = call;
+    } else {
+        queue_head = call;
+    }
+    queue_tail = call;
+    stat_add(&async_stats.queued, 1);
+    pthread_mutex_unlock(&queue_lock);
+    stat_add(&async_stats.submitted, 1);
+    signal_loop();
+
+    // Suspend first and only then mark the call parked, so the loop resumes a connection
+    // that is really suspended; if the result beat us to it, resume here instead
+    MHD_suspend_connection(connection);
+    int expected = DB_ASYNC_CALL_QUEUED;
+    if (!__atomic_compare_exchange_n(&call->state, &expected, DB_ASYNC_CALL_PARKED, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        MHD_resume_connection(connection);
+    }
+    return 0;
+}
+
+PGresult* db_async_take_result(db_async_call_t *call) {
+    if (__atomic_load_n(&call->state, __ATOMIC_ACQUIRE) != DB_ASYNC_CALL_DONE) {
+        return NULL;
+    }
+    PGresult *res = call->result;
+    call->result = NULL;
+    call->state = DB_ASYNC_CALL_IDLE;
+    return res;
+}
+
+void db_async_call_release(void *arg) {
+    db_async_call_t *call = arg;
+    if (call && __atomic_load_n(&call->state, __ATOMIC_ACQUIRE) == DB_ASYNC_CALL_DONE && call->result) {
+        PQclear(call->result);
+        call->result = NULL;
+    }
+}
+
+void db_async_stop(void) {
+    pthread_mutex_lock(&queue_lock);
+    int was_running = async_running;
+    __atomic_store_n(&async_running, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&queue_lock);
+    if (was_running) {
+        signal_loop();
+        pthread_join(loop_thread, NULL);
+    }
+
+    // Every parked request gets resumed with a failure so the daemon can stop
+    fail_queued();
+    for (unsigned int i = 0; i < conn_count; i++) {
+        if (conns[i].conn) {
+            close_connection(&conns[i], 0);
+        }
+    }
+    free(conns);
+    free(async_conninfo);
+    conns = NULL;
+    async_conninfo = NULL;
+    conn_count = 0;
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+    epoll_fd = wake_fd = -1;
+}
+
+void db_async_get_stats(db_async_stats_t *stats) {
+    stats->connections = async_stats.connections;
+    stats->open = __atomic_load_n(&async_stats.open, __ATOMIC_RELAXED);
+    stats->submitted = __atomic_load_n(&async_stats.submitted, __ATOMIC_RELAXED);
+    stats->completed = __atomic_load_n(&async_stats.completed, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&async_stats.failed, __ATOMIC_RELAXED);
+    stats->queue_full = __atomic_load_n(&async_stats.queue_full, __ATOMIC_RELAXED);
+    stats->queued = __atomic_load_n(&async_stats.queued, __ATOMIC_RELAXED);
+    stats->in_flight = __atomic_load_n(&async_stats.in_flight, __ATOMIC_RELAXED);
+    stats->max_in_flight = __atomic_load_n(&async_stats.max_in_flight, __ATOMIC_RELAXED);
+    stats->reconnects = __atomic_load_n(&async_stats.reconnects, __ATOMIC_RELAXED);
+    stats->total_latency_ms = async_stats.total_latency_ms;
+}
+
+json_object* db_async_stats_to_json(void) {
+    db_async_stats_t stats;
+    db_async_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(db_async_enabled()));
+    json_object_object_add(obj, "connections", json_object_new_int((int)stats.connections));
+    json_object_object_add(obj, "open", json_object_new_int((int)stats.open));
+    json_object_object_add(obj, "submitted", json_object_new_int64((int64_t)stats.submitted));
+    json_object_object_add(obj, "completed", json_object_new_int64((int64_t)stats.completed));
+    json_object_object_add(obj, "failed", json_object_new_int64((int64_t)stats.failed));
+    json_object_object_add(obj, "queue_full", json_object_new_int64((int64_t)stats.queue_full));
+    json_object_object_add(obj, "queued", json_object_new_int64((int64_t)stats.queued));
+    json_object_object_add(obj, "in_flight", json_object_new_int64((int64_t)stats.in_flight));
+    json_object_object_add(obj, "max_in_flight", json_object_new_int64((int64_t)stats.max_in_flight));
+    json_object_object_add(obj, "reconnects", json_object_new_int64((int64_t)stats.reconnects));
+    json_object_object_add(obj, "avg_latency_ms", json_object_new_double(
+        stats.completed ? stats.total_latency_ms / (double)stats.completed : 0.0));
+    return obj;
+}
@@ -0,0 +1,72 @@
+#ifndef DB_ASYNC_H
+#define DB_ASYNC_H
+
+#include <libpq-fe.h>
+#include <microhttpd.h>
+#include <json-c/json.h>
+#include "db_statements.h"
+
+#define DB_ASYNC_MAX_PARAMS 8
+
+// One statement run on behalf of a suspended HTTP request. The caller owns the memory
+// (typically the request arena) from db_async_begin() until db_async_take_result();
+// the parameter strings must stay valid for as long.
+typedef struct db_async_call {
+    struct MHD_Connection *connection;
+    db_stmt_id_t stmt;
+    const char *params[DB_ASYNC_MAX_PARAMS];
+    PGresult *result;                 // NULL when the statement could not be run
+    int state;                        // DB_ASYNC_CALL_* below; changed atomically
+    double queued_at;
+    struct db_async_call *next;       // Submission queue, then the connection's in-flight list
+} db_async_call_t;
+
+#define DB_ASYNC_CALL_IDLE 0
+#define DB_ASYNC_CALL_QUEUED 1        // Submitted; the handler has not parked the request yet
+#define DB_ASYNC_CALL_PARKED 2        // The request is suspended until the result arrives
+#define DB_ASYNC_CALL_DONE 3
+
+typedef struct {
+    unsigned int connections;         // Dedicated connections configured
+    unsigned int open;                // Currently connected
+    unsigned long submitted;
+    unsigned long completed;
+    unsigned long failed;             // Finished without a result (connection lost, shutdown)
+    unsigned long queue_full;         // Refused; the caller ran the statement blocking instead
+    unsigned long queued;             // Waiting for a pipeline slot
+    unsigned long in_flight;          // Sent and awaiting results
+    unsigned long max_in_flight;
+    unsigned long reconnects;
+    double total_latency_ms;          // Submission to result, summed over completed calls
+} db_async_stats_t;
+
+// Open `connections` non-blocking connections outside db_pool (statements are prepared
+// once on each) and start the thread that drives them. Up to DB_ASYNC_PIPELINE_DEPTH
+// statements are pipelined on each connection. Needs a daemon started with
+// MHD_ALLOW_SUSPEND_RESUME. Returns -1 when no connection could be opened.
+int db_async_start(const char *conninfo, unsigned int connections);
+
+// Non-zero while statements can be submitted
+int db_async_enabled(void);
+
+// Queue `stmt` for the request on `connection` and suspend it. The handler returns
+// MHD_YES; MHD calls it again once the result is in, and it then calls
+// db_async_take_result(). Returns -1 (without suspending) when the layer is stopped or
+// its queue is full, in which case the caller should run the statement itself.
+int db_async_begin(db_async_call_t *call, struct MHD_Connection *connection,
+                   db_stmt_id_t stmt, const char *const *params);
+
+// Hand the finished call's result to the caller, who must PQclear() it
+PGresult* db_async_take_result(db_async_call_t *call);
+
+// Drop a result that was never taken (the request ended before its handler ran again)
+void db_async_call_release(void *call);
+
+// Fail every pending call, resuming its request, and close the connections; call
+// before MHD_stop_daemon()
+void db_async_stop(void);
+
+void db_async_get_stats(db_async_stats_t *stats);
+json_object* db_async_stats_to_json(void);
+
+#endif // DB_ASYNC_H
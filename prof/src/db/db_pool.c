@@ -0,0 +1,336 @@
+#define _GNU_SOURCE
+#include "db_pool.h"
+#include "../api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+typedef struct {
+    PGconn *conn;
+    int in_use;
+    time_t last_used;
+    uint64_t prepared; // Statements prepared on this connection
+} db_slot_t;
+
+typedef struct {
+    char *conninfo;
+    unsigned int acquire_timeout_ms;
+    db_slot_t *slots;
+    unsigned int size;
+    pthread_mutex_t lock;
+    pthread_cond_t available;
+    db_pool_stats_t stats;
+    int initialized;
+} db_pool_t;
+
+static db_pool_t pool = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+// Slot this thread checked out last. Only the holder touches a checked-out slot's
+// connection and prepared mask, so db_pool_prepared_mask() reads it without the lock.
+static __thread db_slot_t *held_slot = NULL;
+
+static double elapsed_ms(const struct timespec *start, const struct timespec *end) {
+    return (end->tv_sec - start->tv_sec) * 1000.0 + (end->tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Caller must hold pool.lock
+static int pool_init_locked(const char *conninfo, unsigned int size, unsigned int acquire_timeout_ms) {
+    if (pool.initialized) {
+        return 0;
+    }
+    if (size == 0) {
+        size = 1;
+    }
+
+    pool.slots = calloc(size, sizeof(db_slot_t));
+    pool.conninfo = strdup(conninfo);
+    if (!pool.slots || !pool.conninfo) {
+        free(pool.slots);
+        free(pool.conninfo);
+        pool.slots = NULL;
+        pool.conninfo = NULL;
+        return -1;
+    }
+
+    // Waits are measured against the monotonic clock so wall-clock jumps cannot stretch them
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool.available, &attr);
+    pthread_condattr_destroy(&attr);
+
+    pool.size = size;
+    pool.acquire_timeout_ms = acquire_timeout_ms;
+    memset(&pool.stats, 0, sizeof(pool.stats));
+    pool.stats.size = size;
+    pool.initialized = 1;
+    return 0;
+}
+
+// Initialize the shared pool. Connections are opened lazily on first use.
+int db_pool_init(const char *conninfo, unsigned int size, unsigned int acquire_timeout_ms) {
+    pthread_mutex_lock(&pool.lock);
+    int ret = pool_init_locked(conninfo, size, acquire_timeout_ms);
+    pthread_mutex_unlock(&pool.lock);
+    return ret;
+}
+
+// Make sure a freshly checked-out connection can run queries, reconnecting if needed
+static int ensure_healthy(db_slot_t *slot, int *reconnected) {
+    if (!slot->conn) {
+        slot->prepared = 0;
+        slot->conn = PQconnectdb(pool.conninfo);
+        if (PQstatus(slot->conn) != CONNECTION_OK) {
+            fprintf(stderr, "Database connection failed: %s", PQerrorMessage(slot->conn));
+            PQfinish(slot->conn);
+            slot->conn = NULL;
+            return -1;
+        }
+        return 0;
+    }
+
+    // A connection that sat idle for a while may have been dropped by the server or a proxy
+    int healthy = PQstatus(slot->conn) == CONNECTION_OK;
+    if (healthy && time(NULL) - slot->last_used >= DB_POOL_HEALTH_CHECK_IDLE_SEC) {
+        PGresult *res = PQexec(slot->conn, "SELECT 1;");
+        healthy = PQresultStatus(res) == PGRES_TUPLES_OK;
+        PQclear(res);
+    }
+    if (healthy) {
+        return 0;
+    }
+
+    *reconnected = 1;
+    slot->prepared = 0; // Prepared statements do not survive a new server session
+    PQreset(slot->conn);
+    if (PQstatus(slot->conn) != CONNECTION_OK) {
+        fprintf(stderr, "Database reconnect failed: %s", PQerrorMessage(slot->conn));
+        PQfinish(slot->conn);
+        slot->conn = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+// Check out a healthy connection; returns NULL on timeout or connection failure
+PGconn* db_pool_acquire(void) {
+    struct timespec start, deadline, now;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    pthread_mutex_lock(&pool.lock);
+    if (pool_init_locked(CONN_STR, DB_POOL_SIZE, DB_POOL_ACQUIRE_TIMEOUT_MS) != 0) {
+        pthread_mutex_unlock(&pool.lock);
+        return NULL;
+    }
+
+    deadline = start;
+    deadline.tv_sec += pool.acquire_timeout_ms / 1000;
+    deadline.tv_nsec += (long)(pool.acquire_timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    db_slot_t *slot = NULL;
+    while (!slot) {
+        // Prefer an already-open idle connection, then an empty slot we can connect
+        db_slot_t *empty = NULL;
+        for (unsigned int i = 0; i < pool.size; i++) {
+            if (pool.slots[i].in_use) {
+                continue;
+            }
+            if (pool.slots[i].conn) {
+                slot = &pool.slots[i];
+                break;
+            }
+            if (!empty) {
+                empty = &pool.slots[i];
+            }
+        }
+        if (!slot) {
+            slot = empty;
+        }
+        if (slot) {
+            break;
+        }
+
+        if (pthread_cond_timedwait(&pool.available, &pool.lock, &deadline) == ETIMEDOUT) {
+            pool.stats.timeouts++;
+            pthread_mutex_unlock(&pool.lock);
+            fprintf(stderr, "Timed out waiting for a database connection\n");
+            return NULL;
+        }
+    }
+
+    slot->in_use = 1;
+    pool.stats.in_use++;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double waited = elapsed_ms(&start, &now);
+    pool.stats.total_wait_ms += waited;
+    if (waited > pool.stats.max_wait_ms) {
+        pool.stats.max_wait_ms = waited;
+    }
+    int was_open = slot->conn != NULL;
+    pthread_mutex_unlock(&pool.lock);
+
+    // Connecting and health checks happen outside the lock so they never stall other callers
+    int reconnected = 0;
+    int ok = ensure_healthy(slot, &reconnected) == 0;
+
+    pthread_mutex_lock(&pool.lock);
+    if (reconnected) {
+        pool.stats.reconnects++;
+    }
+    if (ok) {
+        pool.stats.acquisitions++;
+        if (!was_open) {
+            pool.stats.open++;
+        }
+    } else {
+        pool.stats.connect_failures++;
+        if (was_open) {
+            pool.stats.open--;
+        }
+        slot->in_use = 0;
+        pool.stats.in_use--;
+        pthread_cond_signal(&pool.available);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    if (!ok) {
+        return NULL;
+    }
+    held_slot = slot;
+    return slot->conn;
+}
+
+// Return a connection obtained from db_pool_acquire()
+void db_pool_release(PGconn *conn) {
+    if (!conn) {
+        return;
+    }
+
+    // Never hand the next caller a connection stuck inside a transaction or a broken socket
+    int broken = PQstatus(conn) != CONNECTION_OK;
+    if (!broken) {
+        PGTransactionStatusType tx = PQtransactionStatus(conn);
+        if (tx == PQTRANS_INTRANS || tx == PQTRANS_INERROR) {
+            PGresult *res = PQexec(conn, "ROLLBACK;");
+            broken = PQresultStatus(res) != PGRES_COMMAND_OK;
+            PQclear(res);
+        } else if (tx != PQTRANS_IDLE) {
+            broken = 1;
+        }
+#ifdef LIBPQ_HAS_PIPELINING
+        // A batch that could not be drained leaves the connection in pipeline mode
+        if (PQpipelineStatus(conn) != PQ_PIPELINE_OFF) {
+            broken = 1;
+        }
+#endif
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    for (unsigned int i = 0; i < pool.size; i++) {
+        db_slot_t *slot = &pool.slots[i];
+        if (slot->conn != conn || !slot->in_use) {
+            continue;
+        }
+        if (held_slot == slot) {
+            held_slot = NULL;
+        }
+
+        if (broken) {
+            // The next checkout of this slot opens a fresh connection
+            PQfinish(slot->conn);
+            slot->conn = NULL;
+            slot->prepared = 0;
+            pool.stats.open--;
+            pool.stats.reconnects++;
+        }
+        slot->in_use = 0;
+        slot->last_used = time(NULL);
+        pool.stats.in_use--;
+        pthread_cond_signal(&pool.available);
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    fprintf(stderr, "db_pool_release: connection does not belong to the pool\n");
+    PQfinish(conn);
+}
+
+// Bitmask of statements already prepared on a checked-out connection
+uint64_t* db_pool_prepared_mask(PGconn *conn) {
+    db_slot_t *held = held_slot;
+    if (held && held->conn == conn) {
+        return &held->prepared;
+    }
+
+    // Checked out on another thread, or not the last of several this thread holds
+    uint64_t *mask = NULL;
+    pthread_mutex_lock(&pool.lock);
+    for (unsigned int i = 0; i < pool.size; i++) {
+        if (pool.slots[i].in_use && pool.slots[i].conn == conn) {
+            mask = &pool.slots[i].prepared;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return mask;
+}
+
+// Close every idle connection and free the pool
+void db_pool_shutdown(void) {
+    pthread_mutex_lock(&pool.lock);
+    if (!pool.initialized) {
+        pthread_mutex_unlock(&pool.lock);
+        return;
+    }
+
+    for (unsigned int i = 0; i < pool.size; i++) {
+        if (pool.slots[i].in_use) {
+            fprintf(stderr, "db_pool_shutdown: connection %u still checked out\n", i);
+            continue;
+        }
+        if (pool.slots[i].conn) {
+            PQfinish(pool.slots[i].conn);
+        }
+    }
+    free(pool.slots);
+    free(pool.conninfo);
+    pool.slots = NULL;
+    pool.conninfo = NULL;
+    pool.size = 0;
+    pthread_cond_destroy(&pool.available);
+    pool.initialized = 0;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+void db_pool_get_stats(db_pool_stats_t *stats) {
+    pthread_mutex_lock(&pool.lock);
+    *stats = pool.stats;
+    pthread_mutex_unlock(&pool.lock);
+}
+
+json_object* db_pool_stats_to_json(void) {
+    db_pool_stats_t stats;
+    db_pool_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "size", json_object_new_int((int)stats.size));
+    json_object_object_add(obj, "open", json_object_new_int((int)stats.open));
+    json_object_object_add(obj, "in_use", json_object_new_int((int)stats.in_use));
+    json_object_object_add(obj, "acquisitions", json_object_new_int64((int64_t)stats.acquisitions));
+    json_object_object_add(obj, "timeouts", json_object_new_int64((int64_t)stats.timeouts));
+    json_object_object_add(obj, "connect_failures", json_object_new_int64((int64_t)stats.connect_failures));
+    json_object_object_add(obj, "reconnects", json_object_new_int64((int64_t)stats.reconnects));
+    json_object_object_add(obj, "avg_wait_ms", json_object_new_double(
+        stats.acquisitions ? stats.total_wait_ms / stats.acquisitions : 0.0));
+    json_object_object_add(obj, "max_wait_ms", json_object_new_double(stats.max_wait_ms));
+    return obj;
+}
@@ -0,0 +1,43 @@
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include <libpq-fe.h>
+#include <json-c/json.h>
+#include <stdint.h>
+
+// Counters reported by db_pool_get_stats()
+typedef struct {
+    unsigned int size;             // Maximum number of connections
+    unsigned int open;             // Connections currently established
+    unsigned int in_use;           // Connections currently checked out
+    unsigned long acquisitions;    // Successful checkouts
+    unsigned long timeouts;        // Checkouts that gave up waiting
+    unsigned long connect_failures;
+    unsigned long reconnects;      // Broken connections reset or replaced
+    double total_wait_ms;          // Time spent waiting for a free slot
+    double max_wait_ms;
+} db_pool_stats_t;
+
+// Initialize the shared pool. Connections are opened lazily on first use.
+// Calling any other db_pool function first initializes it with the api.h defaults.
+int db_pool_init(const char *conninfo, unsigned int size, unsigned int acquire_timeout_ms);
+
+// Check out a healthy connection; returns NULL on timeout or connection failure
+PGconn* db_pool_acquire(void);
+
+// Return a connection obtained from db_pool_acquire()
+void db_pool_release(PGconn *conn);
+
+// Bitmask of statements already prepared on a checked-out connection (see db_statements.h).
+// Cleared whenever the pool reconnects or resets the connection; NULL for foreign connections.
+// The calling thread's most recent checkout is found without taking the pool lock, so
+// release connections on the thread that acquired them.
+uint64_t* db_pool_prepared_mask(PGconn *conn);
+
+// Close every idle connection and free the pool
+void db_pool_shutdown(void);
+
+void db_pool_get_stats(db_pool_stats_t *stats);
+json_object* db_pool_stats_to_json(void);
+
+#endif // DB_POOL_H
@@ -0,0 +1,319 @@
+#include "db_statements.h"
+#include "db_pool.h"
+#include <stdio.h>
+#include <string.h>
+
+// Built-in type OIDs from pg_type.h, which is not part of the client headers
+#define INT4OID 23
+#define TEXTOID 25
+#define FLOAT8OID 701
+#define INT4ARRAYOID 1007
+#define TEXTARRAYOID 1009
+#define FLOAT8ARRAYOID 1022
+
+#define MAX_STMT_PARAMS 10
+
+typedef struct {
+    const char *name;
+    const char *sql;
+    int nparams;
+    Oid types[MAX_STMT_PARAMS];
+} db_statement_t;
+
+// Indexed by db_stmt_id_t; keep in the same order as the enum
+static const db_statement_t statements[STMT_COUNT] = {
+    [STMT_SESSION_LOOKUP] = { "session_lookup",
+        "SELECT s.user_id, EXTRACT(EPOCH FROM s.expires_at)::bigint, u.username "
+        "FROM user_sessions s JOIN users u ON u.id = s.user_id WHERE s.session_token = $1;",
+        1, { TEXTOID } },
+    [STMT_SESSION_INSERT] = { "session_insert",
+        "INSERT INTO user_sessions (session_token, user_id, expires_at) "
+        "VALUES ($1, $2, NOW() + $3 * INTERVAL '1 second');",
+        3, { TEXTOID, INT4OID, INT4OID } },
+    [STMT_SESSION_DELETE] = { "session_delete",
+        "DELETE FROM user_sessions WHERE session_token = $1;",
+        1, { TEXTOID } },
+    // SKIP LOCKED lets several server instances sweep the same table without blocking
+    [STMT_SESSION_SWEEP] = { "session_sweep",
+        "DELETE FROM user_sessions WHERE session_token IN ("
+        "    SELECT session_token FROM user_sessions "
+        "    WHERE expires_at < NOW() "
+        "    LIMIT $1 FOR UPDATE SKIP LOCKED"
+        ");",
+        1, { INT4OID } },
+    [STMT_USER_BY_USERNAME] = { "user_by_username",
+        "SELECT id, password_hash FROM users WHERE username = $1;",
+        1, { TEXTOID } },
+    [STMT_USER_INSERT] = { "user_insert",
+        "INSERT INTO users (username, password_hash) VALUES ($1, $2) RETURNING id;",
+        2, { TEXTOID, TEXTOID } },
+    [STMT_USERNAME_BY_ID] = { "username_by_id",
+        "SELECT username FROM users WHERE id = $1;",
+        1, { INT4OID } },
+    [STMT_USER_ALL] = { "user_all",
+        "SELECT id, username FROM users;",
+        0, { 0 } },
+    [STMT_LOCATION_UPSERT] = { "location_upsert",
+        "INSERT INTO user_locations (user_id, location, h3_index, accuracy, updated_at) "
+        "VALUES ($1, ST_SetSRID(ST_MakePoint($2, $3), 4326), $4, $5, NOW()) "
+        "ON CONFLICT (user_id) DO UPDATE SET "
+        "location = EXCLUDED.location, "
+        "h3_index = EXCLUDED.h3_index, "
+        "accuracy = EXCLUDED.accuracy, "
+        "updated_at = NOW();",
+        5, { INT4OID, FLOAT8OID, FLOAT8OID, TEXTOID, INT4OID } },
+    // The WHERE keeps a late flush from overwriting a newer row written by another instance
+    [STMT_LOCATION_UPSERT_BATCH] = { "location_upsert_batch",
+        "INSERT INTO user_locations (user_id, location, h3_index, accuracy, updated_at) "
+        "SELECT u.user_id, ST_SetSRID(ST_MakePoint(u.lon, u.lat), 4326), u.h3_index, u.accuracy, to_timestamp(u.ts) "
+        "FROM unnest($1::int[], $2::float8[], $3::float8[], $4::text[], $5::int[], $6::float8[]) "
+        "    AS u(user_id, lon, lat, h3_index, accuracy, ts) "
+        "ON CONFLICT (user_id) DO UPDATE SET "
+        "location = EXCLUDED.location, "
+        "h3_index = EXCLUDED.h3_index, "
+        "accuracy = EXCLUDED.accuracy, "
+        "updated_at = EXCLUDED.updated_at "
+        "WHERE user_locations.updated_at <= EXCLUDED.updated_at;",
+        6, { INT4ARRAYOID, FLOAT8ARRAYOID, FLOAT8ARRAYOID, TEXTARRAYOID, INT4ARRAYOID, FLOAT8ARRAYOID } },
+    [STMT_LOCATION_BY_USER] = { "location_by_user",
+        "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = $1;",
+        1, { INT4OID } },
+    [STMT_LOCATION_ALL] = { "location_all",
+        "SELECT user_id, ST_Y(location), ST_X(location), h3_index, accuracy, "
+        "(EXTRACT(EPOCH FROM updated_at) * 1000)::bigint FROM user_locations;",
+        0, { 0 } },
+    [STMT_FRIENDS_LOCATIONS] = { "friends_locations",
+        "SELECT u.id, u.username, ST_Y(ul.location) as latitude, ST_X(ul.location) as longitude, "
+        "50 as accuracy, ul.updated_at as timestamp " // Using default accuracy of 50 meters
+        "FROM user_locations ul "
+        "JOIN users u ON ul.user_id = u.id "
+        "WHERE ul.user_id IN ("
+        "    SELECT CASE "
+        "        WHEN f.user_id = $1 THEN f.friend_id "
+        "        WHEN f.friend_id = $1 THEN f.user_id "
+        "    END "
+        "    FROM friendships f "
+        "    WHERE (f.user_id = $1 OR f.friend_id = $1) "
+        "    AND f.status = 'accepted'"
+        ") "
+        "AND ul.updated_at > NOW() - INTERVAL '10 minutes' " // Only recent locations
+        "ORDER BY ul.updated_at DESC;",
+        1, { INT4OID } },
+    [STMT_FRIENDS_LIST] = { "friends_list",
+        "SELECT u.id, u.username "
+        "FROM friendships f "
+        "JOIN users u ON (CASE "
+        "    WHEN f.user_id = $1 THEN f.friend_id "
+        "    WHEN f.friend_id = $1 THEN f.user_id "
+        "END) = u.id "
+        "WHERE (f.user_id = $1 OR f.friend_id = $1) "
+        "AND f.status = 'accepted';",
+        1, { INT4OID } },
+    [STMT_FRIENDSHIP_EXISTS] = { "friendship_exists",
+        "SELECT 1 FROM friendships WHERE (user_id = $1 AND friend_id = $2) OR (user_id = $2 AND friend_id = $1);",
+        2, { INT4OID, INT4OID } },
+    // friendships enforces user_id < friend_id, so store the pair ordered
+    [STMT_FRIENDSHIP_INSERT] = { "friendship_insert",
+        "INSERT INTO friendships (user_id, friend_id, status) "
+        "VALUES (LEAST($1::int, $2::int), GREATEST($1::int, $2::int), 'accepted');",
+        2, { INT4OID, INT4OID } },
+    // Lookup, duplicate check and insert of add_friend() in one statement, since each
+    // step needs the previous one's result and so cannot share a pipeline
+    [STMT_FRIENDSHIP_ADD_BY_USERNAME] = { "friendship_add_by_username",
+        "WITH friend AS (SELECT id FROM users WHERE username = $2 AND id <> $1::int) "
+        "INSERT INTO friendships (user_id, friend_id, status) "
+        "SELECT LEAST($1::int, friend.id), GREATEST($1::int, friend.id), 'accepted' FROM friend "
+        "WHERE NOT EXISTS (SELECT 1 FROM friendships f WHERE (f.user_id = $1::int AND f.friend_id = friend.id) "
+        "OR (f.user_id = friend.id AND f.friend_id = $1::int)) "
+        "RETURNING CASE WHEN user_id = $1::int THEN friend_id ELSE user_id END;",
+        2, { INT4OID, TEXTOID } },
+    [STMT_FRIENDSHIP_ALL] = { "friendship_all",
+        "SELECT user_id, friend_id FROM friendships WHERE status = 'accepted';",
+        0, { 0 } },
+    [STMT_COORDINATE_PAIR_INSERT] = { "coordinate_pair_insert",
+        "INSERT INTO coordinates (first_name, first_lat, first_lon, first_h3, second_name, second_lat, second_lon, second_h3, distance) "
+        "VALUES ($1, $2, $3, $4, $5, $6, $7, $8, $9);",
+        9, { TEXTOID, FLOAT8OID, FLOAT8OID, TEXTOID, TEXTOID, FLOAT8OID, FLOAT8OID, TEXTOID, FLOAT8OID } },
+};
+
+static int prepare_statement(PGconn *conn, const db_statement_t *stmt) {
+    PGresult *res = PQprepare(conn, stmt->name, stmt->sql, stmt->nparams, stmt->types);
+    int ok = PQresultStatus(res) == PGRES_COMMAND_OK;
+    if (!ok) {
+        fprintf(stderr, "Prepare %s failed: %s", stmt->name, PQerrorMessage(conn));
+    }
+    PQclear(res);
+    return ok ? 0 : -1;
+}
+
+// Run a registered statement, preparing it on this connection first if needed
+PGresult* db_exec_prepared(PGconn *conn, db_stmt_id_t id, const char *const *params) {
+    if (id < 0 || id >= STMT_COUNT) {
+        return NULL;
+    }
+    const db_statement_t *stmt = &statements[id];
+
+    uint64_t *prepared = db_pool_prepared_mask(conn);
+    if (!prepared) {
+        return PQexecParams(conn, stmt->sql, stmt->nparams, stmt->types, params, NULL, NULL, 0);
+    }
+
+    uint64_t bit = 1ULL << id;
+    if (!(*prepared & bit)) {
+        if (prepare_statement(conn, stmt) != 0) {
+            return PQexecParams(conn, stmt->sql, stmt->nparams, stmt->types, params, NULL, NULL, 0);
+        }
+        *prepared |= bit;
+    }
+
+    PGresult *res = PQexecPrepared(conn, stmt->name, stmt->nparams, params, NULL, NULL, 0);
+
+    // Something (DISCARD ALL, a pooler) dropped the statement server-side: prepare again once
+    const char *sqlstate = PQresultErrorField(res, PG_DIAG_SQLSTATE);
+    if (sqlstate && strcmp(sqlstate, "26000") == 0) {
+        PQclear(res);
+        *prepared &= ~bit;
+        if (prepare_statement(conn, stmt) != 0) {
+            return PQexecParams(conn, stmt->sql, stmt->nparams, stmt->types, params, NULL, NULL, 0);
+        }
+        *prepared |= bit;
+        res = PQexecPrepared(conn, stmt->name, stmt->nparams, params, NULL, NULL, 0);
+    }
+
+    return res;
+}
+
+uint64_t db_prepare_all(PGconn *conn) {
+    uint64_t prepared = 0;
+    for (int id = 0; id < STMT_COUNT; id++) {
+        if (prepare_statement(conn, &statements[id]) == 0) {
+            prepared |= 1ULL << id;
+        }
+    }
+    return prepared;
+}
+
+int db_send_prepared(PGconn *conn, uint64_t prepared, db_stmt_id_t id, const char *const *params) {
+    if (id < 0 || id >= STMT_COUNT) {
+        return 0;
+    }
+    const db_statement_t *stmt = &statements[id];
+    if (prepared & (1ULL << id)) {
+        return PQsendQueryPrepared(conn, stmt->name, stmt->nparams, params, NULL, NULL, 0);
+    }
+    return PQsendQueryParams(conn, stmt->sql, stmt->nparams, stmt->types, params, NULL, NULL, 0);
+}
+
+#ifdef LIBPQ_HAS_PIPELINING
+// Read each statement's results, keeping the first, then the sync marker
+static int read_pipeline(PGconn *conn, db_batch_stmt_t *batch, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        PGresult *res;
+        while ((res = PQgetResult(conn)) != NULL) {
+            if (batch[i].result) {
+                PQclear(res);
+            } else {
+                batch[i].result = res;
+            }
+        }
+        if (!batch[i].result) {
+            return -1;
+        }
+    }
+    PGresult *sync = PQgetResult(conn);
+    int ok = PQresultStatus(sync) == PGRES_PIPELINE_SYNC;
+    PQclear(sync);
+    return ok ? 0 : -1;
+}
+
+// Send the whole batch behind one sync; returns -1 (with nothing left in batch) when the
+// caller should fall back to running the statements one at a time
+static int exec_pipelined(PGconn *conn, uint64_t *prepared, db_batch_stmt_t *batch, size_t count) {
+    // Preparing is a round trip of its own, but only the first time a connection sees a statement
+    for (size_t i = 0; i < count; i++) {
+        uint64_t bit = 1ULL << batch[i].id;
+        if (!(*prepared & bit)) {
+            if (prepare_statement(conn, &statements[batch[i].id]) != 0) {
+                return -1;
+            }
+            *prepared |= bit;
+        }
+    }
+
+    if (PQenterPipelineMode(conn) != 1) {
+        return -1;
+    }
+    int sent = 1;
+    for (size_t i = 0; i < count && sent; i++) {
+        const db_statement_t *stmt = &statements[batch[i].id];
+        sent = PQsendQueryPrepared(conn, stmt->name, stmt->nparams, batch[i].params, NULL, NULL, 0);
+    }
+    if (sent) {
+        sent = PQpipelineSync(conn);
+    }
+    int result = sent ? read_pipeline(conn, batch, count) : -1;
+    if (PQexitPipelineMode(conn) != 1) {
+        // Results still pending: db_pool_release() replaces the connection
+        fprintf(stderr, "Pipeline left unfinished: %s", PQerrorMessage(conn));
+    }
+
+    // A statement dropped server-side (DISCARD ALL, a pooler) aborts the batch; clear its
+    // bit and let the sequential path prepare it again
+    int dropped = 0;
+    for (size_t i = 0; i < count; i++) {
+        const char *sqlstate = batch[i].result ? PQresultErrorField(batch[i].result, PG_DIAG_SQLSTATE) : NULL;
+        if (sqlstate && strcmp(sqlstate, "26000") == 0) {
+            *prepared &= ~(1ULL << batch[i].id);
+            dropped = 1;
+        }
+    }
+    if (dropped && PQstatus(conn) == CONNECTION_OK && PQpipelineStatus(conn) == PQ_PIPELINE_OFF) {
+        for (size_t i = 0; i < count; i++) {
+            PQclear(batch[i].result);
+            batch[i].result = NULL;
+        }
+        return -1;
+    }
+    return result == 0 ? 0 : 1;
+}
+#endif
+
+int db_exec_pipeline(PGconn *conn, db_batch_stmt_t *batch, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        batch[i].result = NULL;
+        if (batch[i].id < 0 || batch[i].id >= STMT_COUNT) {
+            return -1;
+        }
+    }
+
+#ifdef LIBPQ_HAS_PIPELINING
+    uint64_t *prepared = db_pool_prepared_mask(conn);
+    if (count > 1 && prepared) {
+        int sent = exec_pipelined(conn, prepared, batch, count);
+        if (sent >= 0) {
+            return sent == 0 ? 0 : -1;
+        }
+    }
+#endif
+
+    int result = 0;
+    for (size_t i = 0; i < count; i++) {
+        batch[i].result = db_exec_prepared(conn, batch[i].id, batch[i].params);
+        if (!batch[i].result) {
+            result = -1;
+        }
+    }
+    return result;
+}
+
+const char* db_statement_name(db_stmt_id_t id) {
+    return id >= 0 && id < STMT_COUNT ? statements[id].name : NULL;
+}
+
+const char* db_statement_sql(db_stmt_id_t id) {
+    return id >= 0 && id < STMT_COUNT ? statements[id].sql : NULL;
+}
+
+int db_statement_param_count(db_stmt_id_t id) {
+    return id >= 0 && id < STMT_COUNT ? statements[id].nparams : -1;
+}
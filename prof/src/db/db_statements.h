@@ -0,0 +1,66 @@
+#ifndef DB_STATEMENTS_H
+#define DB_STATEMENTS_H
+
+#include <libpq-fe.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Statements used on hot request paths. Each one is prepared lazily, once per
+// pooled connection, and executed with PQexecPrepared() and typed parameters.
+typedef enum {
+    STMT_SESSION_LOOKUP,       // $1 token -> user_id, expires_at (epoch seconds), username
+    STMT_SESSION_INSERT,       // $1 token, $2 user_id, $3 lifetime in seconds
+    STMT_SESSION_DELETE,       // $1 token
+    STMT_SESSION_SWEEP,        // $1 batch size; deletes up to that many expired sessions
+    STMT_USER_BY_USERNAME,     // $1 username -> id, password_hash
+    STMT_USER_INSERT,          // $1 username, $2 password_hash -> id
+    STMT_USERNAME_BY_ID,       // $1 user_id -> username
+    STMT_USER_ALL,             // -> id, username
+    STMT_LOCATION_UPSERT,      // $1 user_id, $2 lon, $3 lat, $4 h3 index, $5 accuracy
+    STMT_LOCATION_UPSERT_BATCH,// Same columns as arrays, plus $6 epoch timestamps; one row per user
+    STMT_LOCATION_BY_USER,     // $1 user_id -> ST_X (lon), ST_Y (lat)
+    STMT_LOCATION_ALL,         // -> user_id, lat, lon, h3 index, accuracy, updated_at (epoch ms)
+    STMT_FRIENDS_LOCATIONS,    // $1 user_id -> id, username, lat, lon, accuracy, timestamp
+    STMT_FRIENDS_LIST,         // $1 user_id -> id, username
+    STMT_FRIENDSHIP_EXISTS,    // $1 user_id, $2 friend_id
+    STMT_FRIENDSHIP_INSERT,    // $1 user_id, $2 friend_id
+    STMT_FRIENDSHIP_ADD_BY_USERNAME, // $1 user_id, $2 friend username -> friend id; no row if unknown or already friends
+    STMT_FRIENDSHIP_ALL,       // -> user_id, friend_id of accepted friendships
+    STMT_COORDINATE_PAIR_INSERT,
+    STMT_COUNT
+} db_stmt_id_t;
+
+// Run a registered statement, preparing it on this connection first if needed.
+// params must hold as many entries as the statement has placeholders.
+// Connections that did not come from db_pool run the same SQL through PQexecParams().
+PGresult* db_exec_prepared(PGconn *conn, db_stmt_id_t id, const char *const *params);
+
+// Prepare every registered statement on a connection outside the pool; returns the
+// bitmask of those that succeeded (a statement whose table is missing stays unprepared)
+uint64_t db_prepare_all(PGconn *conn);
+
+// Queue a statement on a non-blocking connection without waiting for the result, as a
+// prepared statement when its bit is set in `prepared`, else with its SQL text.
+// Returns PQsendQuery*()'s result: 1 when queued, 0 on error.
+int db_send_prepared(PGconn *conn, uint64_t prepared, db_stmt_id_t id, const char *const *params);
+
+// One statement of a db_exec_pipeline() batch
+typedef struct {
+    db_stmt_id_t id;
+    const char *const *params;
+    PGresult *result;              // Set by db_exec_pipeline(); the caller PQclear()s it
+} db_batch_stmt_t;
+
+// Run independent statements on a pooled connection in one network flight: all are
+// sent in pipeline mode followed by a single sync, then the results are read back in
+// order. Without pipelining (libpq < 14, or a connection outside the pool) they run one
+// after another. A failed statement does not stop the others from being tried, but
+// those after it in a pipeline come back PGRES_PIPELINE_ABORTED. Returns -1 if any
+// statement got no result at all.
+int db_exec_pipeline(PGconn *conn, db_batch_stmt_t *batch, size_t count);
+
+const char* db_statement_name(db_stmt_id_t id);
+const char* db_statement_sql(db_stmt_id_t id);
+int db_statement_param_count(db_stmt_id_t id);
+
+#endif // DB_STATEMENTS_H
@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include "http_engine.h"
+#include "api.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define HTTP_ENGINE_MAX_OPTIONS 8
+
+// Fill a config with the compile-time defaults from api.h
+void http_engine_config_defaults(http_engine_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    if (http_engine_mode_from_string(SERVER_MODE, &config->mode) != 0) {
+        config->mode = HTTP_ENGINE_THREAD_POOL;
+    }
+    config->port = PORT;
+    config->thread_pool_size = SERVER_THREAD_POOL_SIZE;
+    config->connection_limit = SERVER_CONNECTION_LIMIT;
+    config->per_ip_connection_limit = SERVER_PER_IP_CONNECTION_LIMIT;
+    config->connection_timeout = SERVER_CONNECTION_TIMEOUT;
+    config->max_body_size = SERVER_MAX_BODY_SIZE;
+}
+
+// Read a non-negative integer from the environment, keeping the old value on errors
+static void env_uint(const char *name, unsigned int *value) {
+    const char *str = getenv(name);
+    if (!str || *str == '\0') {
+        return;
+    }
+
+    char *end = NULL;
+    long parsed = strtol(str, &end, 10);
+    if (*end != '\0' || parsed < 0) {
+        fprintf(stderr, "Ignoring invalid %s=%s\n", name, str);
+        return;
+    }
+    *value = (unsigned int)parsed;
+}
+
+// Override config fields from GEO_SERVER_* environment variables
+void http_engine_config_from_env(http_engine_config_t *config) {
+    const char *mode = getenv("GEO_SERVER_MODE");
+    if (mode && http_engine_mode_from_string(mode, &config->mode) != 0) {
+        fprintf(stderr, "Ignoring unknown GEO_SERVER_MODE=%s\n", mode);
+    }
+
+    env_uint("GEO_SERVER_PORT", &config->port);
+    env_uint("GEO_SERVER_THREADS", &config->thread_pool_size);
+    env_uint("GEO_SERVER_MAX_CONNECTIONS", &config->connection_limit);
+    env_uint("GEO_SERVER_MAX_CONNECTIONS_PER_IP", &config->per_ip_connection_limit);
+    env_uint("GEO_SERVER_TIMEOUT", &config->connection_timeout);
+    env_uint("GEO_SERVER_MAX_BODY", &config->max_body_size);
+}
+
+int http_engine_mode_from_string(const char *name, http_engine_mode_t *mode) {
+    if (strcmp(name, "single") == 0) {
+        *mode = HTTP_ENGINE_SINGLE_THREAD;
+    } else if (strcmp(name, "pool") == 0) {
+        *mode = HTTP_ENGINE_THREAD_POOL;
+    } else if (strcmp(name, "thread-per-connection") == 0) {
+        *mode = HTTP_ENGINE_THREAD_PER_CONNECTION;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char* http_engine_mode_name(http_engine_mode_t mode) {
+    switch (mode) {
+        case HTTP_ENGINE_SINGLE_THREAD: return "single";
+        case HTTP_ENGINE_THREAD_POOL: return "pool";
+        case HTTP_ENGINE_THREAD_PER_CONNECTION: return "thread-per-connection";
+    }
+    return "unknown";
+}
+
+// Number of worker threads the config resolves to
+unsigned int http_engine_worker_count(const http_engine_config_t *config) {
+    if (config->mode != HTTP_ENGINE_THREAD_POOL) {
+        return 1;
+    }
+    if (config->thread_pool_size > 0) {
+        return config->thread_pool_size;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (unsigned int)cpus : 1;
+}
+
+// Start a daemon with the given config and request handler
+struct MHD_Daemon* http_engine_start(const http_engine_config_t *config,
+                                     MHD_AccessHandlerCallback handler, void *handler_cls,
+                                     MHD_RequestCompletedCallback completed, void *completed_cls) {
+    unsigned int flags = MHD_USE_ERROR_LOG;
+    struct MHD_OptionItem options[HTTP_ENGINE_MAX_OPTIONS];
+    int n = 0;
+
+    switch (config->mode) {
+        case HTTP_ENGINE_SINGLE_THREAD:
+            flags |= MHD_USE_INTERNAL_POLLING_THREAD;
+            break;
+        case HTTP_ENGINE_THREAD_POOL:
+            // MHD_USE_AUTO picks epoll on Linux and poll/select elsewhere
+            flags |= MHD_USE_AUTO_INTERNAL_THREAD;
+            options[n++] = (struct MHD_OptionItem){ MHD_OPTION_THREAD_POOL_SIZE,
+                                                    (intptr_t)http_engine_worker_count(config), NULL };
+            break;
+        case HTTP_ENGINE_THREAD_PER_CONNECTION:
+            flags |= MHD_USE_THREAD_PER_CONNECTION | MHD_USE_INTERNAL_POLLING_THREAD;
+            break;
+    }
+
+    // Long-lived streams park idle connections instead of holding an event-loop slot busy
+    if (config->mode != HTTP_ENGINE_THREAD_PER_CONNECTION) {
+        flags |= MHD_ALLOW_SUSPEND_RESUME;
+    }
+    flags |= MHD_ALLOW_UPGRADE; // WebSocket handshakes hand the socket to the application
+
+    if (config->connection_limit > 0) {
+        options[n++] = (struct MHD_OptionItem){ MHD_OPTION_CONNECTION_LIMIT,
+                                                (intptr_t)config->connection_limit, NULL };
+    }
+    if (config->per_ip_connection_limit > 0) {
+        options[n++] = (struct MHD_OptionItem){ MHD_OPTION_PER_IP_CONNECTION_LIMIT,
+                                                (intptr_t)config->per_ip_connection_limit, NULL };
+    }
+    if (config->connection_timeout > 0) {
+        options[n++] = (struct MHD_OptionItem){ MHD_OPTION_CONNECTION_TIMEOUT,
+                                                (intptr_t)config->connection_timeout, NULL };
+    }
+    if (completed) {
+        options[n++] = (struct MHD_OptionItem){ MHD_OPTION_NOTIFY_COMPLETED,
+                                                (intptr_t)completed, completed_cls };
+    }
+    options[n] = (struct MHD_OptionItem){ MHD_OPTION_END, 0, NULL };
+
+    return MHD_start_daemon(flags, (uint16_t)config->port, NULL, NULL,
+                            handler, handler_cls,
+                            MHD_OPTION_ARRAY, options,
+                            MHD_OPTION_END);
+}
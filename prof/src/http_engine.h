@@ -0,0 +1,43 @@
+#ifndef HTTP_ENGINE_H
+#define HTTP_ENGINE_H
+
+#include <microhttpd.h>
+
+// Threading model used by the HTTP daemon
+typedef enum {
+    HTTP_ENGINE_SINGLE_THREAD,        // One internal polling thread (legacy behaviour)
+    HTTP_ENGINE_THREAD_POOL,          // Fixed pool of epoll/poll worker threads
+    HTTP_ENGINE_THREAD_PER_CONNECTION // One thread per client connection
+} http_engine_mode_t;
+
+// Startup configuration for the HTTP daemon
+typedef struct {
+    http_engine_mode_t mode;
+    unsigned int port;
+    unsigned int thread_pool_size;         // 0 = one worker per online CPU
+    unsigned int connection_limit;         // 0 = libmicrohttpd default
+    unsigned int per_ip_connection_limit;  // 0 = unlimited
+    unsigned int connection_timeout;       // Idle timeout in seconds, 0 = none
+    unsigned int max_body_size;            // Largest request body in bytes
+} http_engine_config_t;
+
+// Fill a config with the compile-time defaults from api.h
+void http_engine_config_defaults(http_engine_config_t *config);
+
+// Override config fields from GEO_SERVER_* environment variables
+void http_engine_config_from_env(http_engine_config_t *config);
+
+// Parse "single", "pool" or "thread-per-connection"; returns -1 on unknown names
+int http_engine_mode_from_string(const char *name, http_engine_mode_t *mode);
+const char* http_engine_mode_name(http_engine_mode_t mode);
+
+// Number of worker threads the config resolves to
+unsigned int http_engine_worker_count(const http_engine_config_t *config);
+
+// Start a daemon with the given config and request handler.
+// completed (may be NULL) runs when each request ends, to release per-request state.
+struct MHD_Daemon* http_engine_start(const http_engine_config_t *config,
+                                     MHD_AccessHandlerCallback handler, void *handler_cls,
+                                     MHD_RequestCompletedCallback completed, void *completed_cls);
+
+#endif // HTTP_ENGINE_H
@@ -0,0 +1,248 @@
+#define _GNU_SOURCE
+#include "live_store.h"
+#include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// One slot per user. Keys are claimed once with a CAS and never removed, so readers can
+// probe without locks. Each entry carries a sequence counter: odd while a writer is inside,
+// bumped by two per update, so a reader that sees it change simply copies again.
+typedef struct {
+    int32_t user_id;        // 0 = empty
+    uint32_t seq;
+    live_location_t location;
+} __attribute__((aligned(64))) live_entry_t;
+
+static live_entry_t *table = NULL;
+static size_t table_mask = 0;
+static size_t max_entries = 0;
+static int store_enabled = 0;
+
+static unsigned long entry_count = 0;
+static unsigned long stat_updates = 0;
+static unsigned long stat_reads = 0;
+static unsigned long stat_read_retries = 0;
+static unsigned long stat_misses = 0;
+static unsigned long stat_rejected = 0;
+
+static inline size_t hash_user(int32_t user_id) {
+    uint64_t h = (uint32_t)user_id;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 32);
+}
+
+int live_store_init(size_t max_users) {
+    if (store_enabled) {
+        return 0;
+    }
+    if (max_users == 0) {
+        max_users = LIVE_STORE_CAPACITY;
+    }
+
+    // Keep the load factor at or below one half so probe sequences stay short
+    size_t slots = 16;
+    while (slots < max_users * 2) {
+        slots <<= 1;
+    }
+    table = aligned_alloc(64, slots * sizeof(live_entry_t));
+    if (!table) {
+        fprintf(stderr, "Failed to allocate live location store\n");
+        return -1;
+    }
+    memset(table, 0, slots * sizeof(live_entry_t));
+    table_mask = slots - 1;
+    max_entries = max_users;
+    store_enabled = 1;
+    return 0;
+}
+
+int live_store_enabled(void) {
+    return store_enabled;
+}
+
+static live_entry_t* find_entry(int32_t user_id) {
+    size_t slot = hash_user(user_id) & table_mask;
+    for (size_t probes = 0; probes <= table_mask; probes++) {
+        int32_t key = __atomic_load_n(&table[slot].user_id, __ATOMIC_ACQUIRE);
+        if (key == user_id) {
+            return &table[slot];
+        }
+        if (key == 0) {
+            return NULL;
+        }
+        slot = (slot + 1) & table_mask;
+    }
+    return NULL;
+}
+
+static live_entry_t* find_or_claim_entry(int32_t user_id) {
+    size_t slot = hash_user(user_id) & table_mask;
+    for (size_t probes = 0; probes <= table_mask; probes++) {
+        int32_t key = __atomic_load_n(&table[slot].user_id, __ATOMIC_ACQUIRE);
+        if (key == user_id) {
+            return &table[slot];
+        }
+        if (key == 0) {
+            if (__atomic_add_fetch(&entry_count, 1, __ATOMIC_RELAXED) > max_entries) {
+                __atomic_sub_fetch(&entry_count, 1, __ATOMIC_RELAXED);
+                return NULL;
+            }
+            int32_t expected = 0;
+            if (__atomic_compare_exchange_n(&table[slot].user_id, &expected, user_id, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                return &table[slot];
+            }
+            __atomic_sub_fetch(&entry_count, 1, __ATOMIC_RELAXED);
+            if (expected == user_id) {
+                return &table[slot]; // Another writer claimed it for the same user
+            }
+        }
+        slot = (slot + 1) & table_mask;
+    }
+    return NULL;
+}
+
+int live_store_update(int user_id, double latitude, double longitude, H3Index h3_index,
+                      int accuracy, int64_t updated_at_ms) {
+    if (!store_enabled || user_id <= 0) {
+        return -1;
+    }
+    live_entry_t *entry = find_or_claim_entry(user_id);
+    if (!entry) {
+        stat_add(&stat_rejected, 1);
+        return -1;
+    }
+
+    // Writers for the same user serialize on the counter: move it from even to odd
+    uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_RELAXED);
+    for (;;) {
+        if (seq & 1) {
+            seq = __atomic_load_n(&entry->seq, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (__atomic_compare_exchange_n(&entry->seq, &seq, seq + 1, 1,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    // Out-of-order arrivals (e.g. a requeued batch) never move a user backwards in time
+    if (updated_at_ms >= entry->location.updated_at_ms) {
+        entry->location.latitude = latitude;
+        entry->location.longitude = longitude;
+        entry->location.h3_index = h3_index;
+        entry->location.accuracy = accuracy;
+        entry->location.updated_at_ms = updated_at_ms;
+    }
+
+    __atomic_store_n(&entry->seq, seq + 2, __ATOMIC_RELEASE);
+    stat_add(&stat_updates, 1);
+    return 0;
+}
+
+int live_store_get(int user_id, live_location_t *out) {
+    if (!store_enabled || user_id <= 0) {
+        return -1;
+    }
+    stat_add(&stat_reads, 1);
+
+    live_entry_t *entry = find_entry(user_id);
+    if (!entry) {
+        stat_add(&stat_misses, 1);
+        return -1;
+    }
+
+    for (;;) {
+        uint32_t before = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            stat_add(&stat_read_retries, 1);
+            continue;
+        }
+        *out = entry->location;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&entry->seq, __ATOMIC_RELAXED) == before) {
+            break;
+        }
+        stat_add(&stat_read_retries, 1);
+    }
+
+    // Claimed but not yet written (a writer is between the CAS and its first update)
+    if (out->updated_at_ms == 0) {
+        stat_add(&stat_misses, 1);
+        return -1;
+    }
+    return 0;
+}
+
+long live_store_load_from_db(void) {
+    if (!store_enabled) {
+        return -1;
+    }
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
+
+    PGresult *res = db_exec_prepared(conn, STMT_LOCATION_ALL, NULL);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Loading live locations failed: %s", PQerrorMessage(conn));
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+
+    long loaded = 0;
+    int rows = PQntuples(res);
+    for (int i = 0; i < rows; i++) {
+        int user_id = atoi(PQgetvalue(res, i, 0));
+        double latitude = atof(PQgetvalue(res, i, 1));
+        double longitude = atof(PQgetvalue(res, i, 2));
+        H3Index h3_index = 0;
+        if (PQgetisnull(res, i, 3) || stringToH3(PQgetvalue(res, i, 3), &h3_index) != E_SUCCESS) {
+            LatLng coord = { degsToRads(latitude), degsToRads(longitude) };
+            latLngToCell(&coord, 9, &h3_index);
+        }
+        int accuracy = PQgetisnull(res, i, 4) ? 50 : atoi(PQgetvalue(res, i, 4));
+        int64_t updated_at_ms = strtoll(PQgetvalue(res, i, 5), NULL, 10);
+
+        if (live_store_update(user_id, latitude, longitude, h3_index, accuracy, updated_at_ms) == 0) {
+            loaded++;
+        }
+    }
+
+    PQclear(res);
+    db_pool_release(conn);
+    return loaded;
+}
+
+void live_store_get_stats(live_store_stats_t *stats) {
+    stats->entries = __atomic_load_n(&entry_count, __ATOMIC_RELAXED);
+    stats->capacity = max_entries;
+    stats->updates = __atomic_load_n(&stat_updates, __ATOMIC_RELAXED);
+    stats->reads = __atomic_load_n(&stat_reads, __ATOMIC_RELAXED);
+    stats->read_retries = __atomic_load_n(&stat_read_retries, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&stat_misses, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&stat_rejected, __ATOMIC_RELAXED);
+}
+
+json_object* live_store_stats_to_json(void) {
+    live_store_stats_t stats;
+    live_store_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(store_enabled));
+    json_object_object_add(obj, "entries", json_object_new_int64((int64_t)stats.entries));
+    json_object_object_add(obj, "capacity", json_object_new_int64((int64_t)stats.capacity));
+    json_object_object_add(obj, "updates", json_object_new_int64((int64_t)stats.updates));
+    json_object_object_add(obj, "reads", json_object_new_int64((int64_t)stats.reads));
+    json_object_object_add(obj, "read_retries", json_object_new_int64((int64_t)stats.read_retries));
+    json_object_object_add(obj, "misses", json_object_new_int64((int64_t)stats.misses));
+    json_object_object_add(obj, "rejected", json_object_new_int64((int64_t)stats.rejected));
+    return obj;
+}
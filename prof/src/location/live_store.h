@@ -0,0 +1,48 @@
+#ifndef LIVE_STORE_H
+#define LIVE_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json-c/json.h>
+#include <h3/h3api.h>
+
+// Latest known position of one user
+typedef struct {
+    double latitude;
+    double longitude;
+    H3Index h3_index;
+    int accuracy;
+    int64_t updated_at_ms;  // Epoch milliseconds
+} live_location_t;
+
+typedef struct {
+    unsigned long entries;
+    unsigned long capacity;
+    unsigned long updates;
+    unsigned long reads;
+    unsigned long read_retries;  // Reads that raced a writer and copied the entry again
+    unsigned long misses;
+    unsigned long rejected;      // New users refused because the table was full
+} live_store_stats_t;
+
+// Size the table for up to max_users users and mark the store authoritative.
+// Must run before any other live_store call and before worker threads start.
+int live_store_init(size_t max_users);
+
+// Non-zero once live_store_init() succeeded
+int live_store_enabled(void);
+
+// Fill the store from user_locations; returns rows loaded or -1 on error
+long live_store_load_from_db(void);
+
+// Record a new position; returns -1 if the user is new and the table is full
+int live_store_update(int user_id, double latitude, double longitude, H3Index h3_index,
+                      int accuracy, int64_t updated_at_ms);
+
+// Copy a user's position without taking any lock; returns -1 if unknown
+int live_store_get(int user_id, live_location_t *out);
+
+void live_store_get_stats(live_store_stats_t *stats);
+json_object* live_store_stats_to_json(void);
+
+#endif // LIVE_STORE_H
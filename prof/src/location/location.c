@@ -1,9 +1,23 @@
+#define _GNU_SOURCE
 #include "location.h"
 #include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include "location_writer.h"
+#include "live_store.h"
+#include "../auth/friend_graph.h"
+#include "../stream/location_hub.h"
+#include "../routing/astar.h"
+#include "../routing/alt.h"
+#include "../routing/hier_path.h"
+#include "../coordinate_logger.h"
+#include "../utils/json_writer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
+#include <time.h>
 #include <libpq-fe.h>
 #define _USE_MATH_DEFINES
 
@@ -13,47 +27,246 @@ int save_user_location(const char* user_id, double latitude, double longitude, i
         return -1;
     }
 
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    char *end = NULL;
+    long uid = strtol(user_id, &end, 10);
+    if (end == user_id || *end != '\0' || uid <= 0 || uid > INT32_MAX) {
+        return -1;
+    }
+    if (!location_coordinates_valid(latitude, longitude)) {
         return -1;
     }
 
     // Convert coordinates to H3 index
     H3Index h3_index = latlng_to_h3(latitude, longitude, 9);
+    if (h3_index == 0) {
+        return -1;
+    }
 
-    // Insert or update user location
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "INSERT INTO user_locations (user_id, location, h3_index, accuracy, updated_at) "
-             "VALUES (%s, ST_SetSRID(ST_MakePoint(%f, %f), 4326), '%llx', %d, NOW()) "
-             "ON CONFLICT (user_id) DO UPDATE SET "
-             "location = EXCLUDED.location, "
-             "h3_index = EXCLUDED.h3_index, "
-             "accuracy = EXCLUDED.accuracy, "
-             "updated_at = NOW();", 
-             user_id, longitude, latitude, h3_index, accuracy);
+    // Acknowledge right away and let the background flusher batch the write
+    if (location_writer_enabled()) {
+        if (location_writer_submit((int)uid, latitude, longitude, h3_index, accuracy) != 0) {
+            return LOCATION_SAVE_BUSY;
+        }
+    } else {
+        PGconn *conn = db_pool_acquire();
+        if (!conn) {
+            return -1;
+        }
 
-    PGresult *res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_COMMAND_OK) {
-        fprintf(stderr, "Insert/update location failed: %s", PQerrorMessage(conn));
+        // Insert or update user location
+        char lon_str[32], lat_str[32], h3_str[17], accuracy_str[16];
+        snprintf(lon_str, sizeof(lon_str), "%.17g", longitude);
+        snprintf(lat_str, sizeof(lat_str), "%.17g", latitude);
+        h3ToString(h3_index, h3_str, sizeof(h3_str));
+        snprintf(accuracy_str, sizeof(accuracy_str), "%d", accuracy);
+        const char *params[5] = { user_id, lon_str, lat_str, h3_str, accuracy_str };
+
+        PGresult *res = db_exec_prepared(conn, STMT_LOCATION_UPSERT, params);
+        if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+            fprintf(stderr, "Insert/update location failed: %s", PQerrorMessage(conn));
+            PQclear(res);
+            db_pool_release(conn);
+            return -1;
+        }
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    int64_t updated_at_ms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+    // Readers go to the live store, so it must see every accepted update
+    if (live_store_enabled()) {
+        live_store_update((int)uid, latitude, longitude, h3_index, accuracy, updated_at_ms);
+    }
+
+    // Push the new position to friends holding an open stream
+    location_hub_publish((int32_t)uid, latitude, longitude, accuracy, updated_at_ms);
+
+    return 0; // Success
+}
+
+// Save a batch of points, keeping the newest per user
+int save_user_locations(location_point_t* points, size_t count) {
+    location_row_t *rows = malloc(count * sizeof(location_row_t) + 1);
+    size_t *owners = malloc(count * sizeof(size_t) + 1);   // Point each row came from
+    size_t slots = 16;
+    while (slots < count * 2) {
+        slots <<= 1;
+    }
+    int32_t *index = malloc(slots * sizeof(int32_t));      // User id -> row, open addressing
+    if (!rows || !owners || !index) {
+        free(rows);
+        free(owners);
+        free(index);
         return -1;
     }
+    memset(index, 0xff, slots * sizeof(int32_t));
+
+    size_t row_count = 0;
+    for (size_t i = 0; i < count; i++) {
+        location_point_t *point = &points[i];
+        if (point->status == LOCATION_POINT_INVALID) {
+            continue;
+        }
+        size_t slot = ((uint32_t)point->user_id * 0x9e3779b1U) & (slots - 1);
+        while (index[slot] >= 0 && rows[index[slot]].user_id != point->user_id) {
+            slot = (slot + 1) & (slots - 1);
+        }
+
+        size_t row = (size_t)index[slot];
+        if (index[slot] < 0) {
+            row = row_count++;
+            index[slot] = (int32_t)row;
+        } else if (point->ts < rows[row].updated_at) {
+            point->status = LOCATION_POINT_SUPERSEDED;
+            continue;
+        } else {
+            points[owners[row]].status = LOCATION_POINT_SUPERSEDED;
+        }
+        rows[row] = (location_row_t){
+            .user_id = point->user_id,
+            .accuracy = point->accuracy,
+            .latitude = point->latitude,
+            .longitude = point->longitude,
+            .updated_at = point->ts,
+        };
+        owners[row] = i;
+        point->status = LOCATION_POINT_ACCEPTED;
+    }
+    free(index);
+
+    // H3 cells for every surviving row in one pass, then one statement for all of them
+    for (size_t r = 0; r < row_count; r++) {
+        rows[r].h3_index = latlng_to_h3(rows[r].latitude, rows[r].longitude, 9);
+    }
+
+    int result = (int)row_count;
+    if (row_count > 0) {
+        PGconn *conn = db_pool_acquire();
+        if (!conn || location_upsert_rows(conn, rows, row_count) != 0) {
+            result = -1;
+        }
+        if (conn) {
+            db_pool_release(conn);
+        }
+    }
+
+    if (result < 0) {
+        for (size_t r = 0; r < row_count; r++) {
+            points[owners[r]].status = LOCATION_POINT_FAILED;
+        }
+    } else {
+        // Replayed points older than what readers already see stay out of the live view
+        for (size_t r = 0; r < row_count; r++) {
+            const location_row_t *row = &rows[r];
+            int64_t updated_at_ms = (int64_t)(row->updated_at * 1000.0);
+            live_location_t current;
+            if (live_store_enabled()) {
+                if (live_store_get(row->user_id, &current) == 0 && current.updated_at_ms > updated_at_ms) {
+                    continue;
+                }
+                live_store_update(row->user_id, row->latitude, row->longitude, row->h3_index,
+                                  row->accuracy, updated_at_ms);
+            }
+            location_hub_publish(row->user_id, row->latitude, row->longitude, row->accuracy, updated_at_ms);
+        }
+    }
+
+    free(rows);
+    free(owners);
+    return result;
+}
+
+// Look up a user's latest position: from the live store when it runs, else from user_locations
+int get_user_position(const char* user_id, double* latitude, double* longitude) {
+    if (!user_id) {
+        return -1;
+    }
+
+    if (live_store_enabled()) {
+        live_location_t location;
+        if (live_store_get(atoi(user_id), &location) != 0) {
+            return -1;
+        }
+        *latitude = location.latitude;
+        *longitude = location.longitude;
+        return 0;
+    }
+
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
+
+    const char *params[1] = { user_id };
+    PGresult *res = db_exec_prepared(conn, STMT_LOCATION_BY_USER, params);
+    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Location query failed: %s", PQerrorMessage(conn));
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+    if (PQntuples(res) == 0) {
+        PQclear(res);
+        db_pool_release(conn);
+        return -1;
+    }
+
+    *longitude = atof(PQgetvalue(res, 0, 0));
+    *latitude = atof(PQgetvalue(res, 0, 1));
     PQclear(res);
-    PQfinish(conn);
+    db_pool_release(conn);
+    return 0;
+}
 
-    return 0; // Success
+// Both positions in one round trip: the two lookups go out as a single pipeline
+int get_user_position_pair(const char* user1_id, const char* user2_id,
+                           double* lat1, double* lon1, double* lat2, double* lon2) {
+    if (!user1_id || !user2_id) {
+        return -1;
+    }
+    if (live_store_enabled()) {
+        return get_user_position(user1_id, lat1, lon1) == 0 &&
+               get_user_position(user2_id, lat2, lon2) == 0 ? 0 : -1;
+    }
+
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
+
+    const char *params1[1] = { user1_id };
+    const char *params2[1] = { user2_id };
+    db_batch_stmt_t batch[2] = {
+        { STMT_LOCATION_BY_USER, params1, NULL },
+        { STMT_LOCATION_BY_USER, params2, NULL },
+    };
+    int result = db_exec_pipeline(conn, batch, 2);
+    double *lats[2] = { lat1, lat2 };
+    double *lons[2] = { lon1, lon2 };
+    for (int i = 0; i < 2; i++) {
+        PGresult *res = batch[i].result;
+        if (result == 0 && PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "Location query failed: %s", PQresultErrorMessage(res));
+            result = -1;
+        } else if (result == 0 && PQntuples(res) == 0) {
+            result = -1;
+        } else if (result == 0) {
+            *lons[i] = atof(PQgetvalue(res, 0, 0));
+            *lats[i] = atof(PQgetvalue(res, 0, 1));
+        }
+        PQclear(res);
+    }
+    db_pool_release(conn);
+    return result;
 }
 
 // Get user locations from database
 json_object* get_user_locations_from_db() {
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
         return NULL;
     }
     
@@ -69,7 +282,7 @@ json_object* get_user_locations_from_db() {
     if (PQresultStatus(res) != PGRES_TUPLES_OK) {
         fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
         PQclear(res);
-        PQfinish(conn);
+        db_pool_release(conn);
         return NULL;
     }
     
@@ -90,82 +303,214 @@ json_object* get_user_locations_from_db() {
     }
     
     PQclear(res);
-    PQfinish(conn);
+    db_pool_release(conn);
     
     return locations_array;
 }
 
-// Get friends locations from database
-json_object* get_friends_locations_from_db(const char* user_id) {
+// One friend serialized into the scratch writer, kept aside until the rows are sorted
+typedef struct {
+    size_t offset;
+    size_t len;
+    int64_t updated_at_ms;
+} friend_location_row_t;
+
+typedef struct {
+    arena_t *arena;             // The caller's request arena, or NULL for the heap
+    json_writer_t scratch;
+    friend_location_row_t *rows;
+    size_t count;
+    size_t capacity;
+    int64_t cutoff_ms;
+    int failed;
+} friend_locations_ctx_t;
+
+static int compare_updated_desc(const void *a, const void *b) {
+    int64_t va = ((const friend_location_row_t *)a)->updated_at_ms;
+    int64_t vb = ((const friend_location_row_t *)b)->updated_at_ms;
+    return (va < vb) - (va > vb);
+}
+
+// Append one friend's live position if it is recent enough
+static void append_friend_location(int32_t friend_id, const char *username, void *arg) {
+    friend_locations_ctx_t *ctx = arg;
+    live_location_t location;
+    if (ctx->failed || live_store_get(friend_id, &location) != 0 || location.updated_at_ms < ctx->cutoff_ms) {
+        return;
+    }
+    if (ctx->count == ctx->capacity) {
+        size_t capacity = ctx->capacity ? ctx->capacity * 2 : 64;
+        friend_location_row_t *rows;
+        if (ctx->arena) {
+            rows = arena_alloc(ctx->arena, capacity * sizeof(friend_location_row_t));
+            if (rows && ctx->count) {
+                memcpy(rows, ctx->rows, ctx->count * sizeof(friend_location_row_t));
+            }
+        } else {
+            rows = realloc(ctx->rows, capacity * sizeof(friend_location_row_t));
+        }
+        if (!rows) {
+            ctx->failed = 1;
+            return;
+        }
+        ctx->rows = rows;
+        ctx->capacity = capacity;
+    }
+
+    char id[16], timestamp[32];
+    snprintf(id, sizeof(id), "%d", friend_id);
+    time_t seconds = (time_t)(location.updated_at_ms / 1000);
+    struct tm tm_utc;
+    gmtime_r(&seconds, &tm_utc);
+    snprintf(timestamp + strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm_utc),
+             8, ".%03dZ", (int)(location.updated_at_ms % 1000));
+
+    // Each row is a standalone object; commas are added when the rows are copied out
+    json_writer_t *w = &ctx->scratch;
+    size_t offset = w->len;
+    w->has_items = 0;
+    json_writer_begin_object(w);
+    json_writer_key(w, "user_id");
+    json_writer_string(w, id);
+    json_writer_key(w, "username");
+    json_writer_string(w, username);
+    json_writer_key(w, "latitude");
+    json_writer_double(w, location.latitude);
+    json_writer_key(w, "longitude");
+    json_writer_double(w, location.longitude);
+    json_writer_key(w, "accuracy");
+    json_writer_int(w, location.accuracy);
+    json_writer_key(w, "timestamp");
+    json_writer_string(w, timestamp);
+    json_writer_key(w, "updated_at_ms");
+    json_writer_int(w, location.updated_at_ms);
+    json_writer_end_object(w);
+
+    friend_location_row_t *row = &ctx->rows[ctx->count++];
+    row->offset = offset;
+    row->len = w->len - offset;
+    row->updated_at_ms = location.updated_at_ms;
+}
+
+// Friends' positions from the live store. The friend list comes from the in-memory
+// graph when it is loaded, otherwise from one indexed query.
+static int write_friends_locations_live(json_writer_t *out, const char* user_id) {
+    friend_locations_ctx_t ctx = {
+        .arena = out->arena,
+        .cutoff_ms = ((int64_t)time(NULL) - LOCATION_RECENT_SEC) * 1000,
+    };
+    json_writer_init_arena(&ctx.scratch, out->arena, 0);
+
+    if (friend_graph_enabled()) {
+        friend_graph_for_each(atoi(user_id), append_friend_location, &ctx);
+    } else {
+        PGconn *conn = db_pool_acquire();
+        if (!conn) {
+            return -1;
+        }
+
+        const char *params[1] = { user_id };
+        PGresult *res = db_exec_prepared(conn, STMT_FRIENDS_LIST, params);
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
+            PQclear(res);
+            db_pool_release(conn);
+            return -1;
+        }
+        db_pool_release(conn);
+
+        for (int i = 0; i < PQntuples(res); i++) {
+            append_friend_location(atoi(PQgetvalue(res, i, 0)), PQgetvalue(res, i, 1), &ctx);
+        }
+        PQclear(res);
+    }
+
+    int result = ctx.failed || ctx.scratch.failed ? -1 : 0;
+    if (result == 0) {
+        // Same order as the SQL path: newest first
+        qsort(ctx.rows, ctx.count, sizeof(friend_location_row_t), compare_updated_desc);
+        json_writer_begin_array(out);
+        for (size_t i = 0; i < ctx.count; i++) {
+            json_writer_raw(out, ctx.scratch.buf + ctx.rows[i].offset, ctx.rows[i].len);
+        }
+        json_writer_end_array(out);
+    }
+    if (!ctx.arena) {
+        free(ctx.rows);
+    }
+    json_writer_free(&ctx.scratch);
+    return result;
+}
+
+// Write friends' locations to `out` as a JSON array; returns 0 on success
+int write_friends_locations(json_writer_t *out, const char* user_id) {
     if (!user_id) {
         fprintf(stderr, "User ID is NULL\n");
-        return NULL;
+        return -1;
     }
     
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return NULL;
+    if (live_store_enabled()) {
+        return write_friends_locations_live(out, user_id);
     }
     
-    // Get locations of friends (users who are friends with the given user)
-    char query[1024];
-    snprintf(query, sizeof(query), 
-             "SELECT u.id, u.username, ST_Y(ul.location) as latitude, ST_X(ul.location) as longitude, "
-             "50 as accuracy, ul.updated_at as timestamp " // Using default accuracy of 50 meters
-             "FROM user_locations ul "
-             "JOIN users u ON ul.user_id = u.id "
-             "WHERE ul.user_id IN ("
-             "    SELECT CASE "
-             "        WHEN f.user_id = %s THEN f.friend_id "
-             "        WHEN f.friend_id = %s THEN f.user_id "
-             "    END "
-             "    FROM friendships f "
-             "    WHERE (f.user_id = %s OR f.friend_id = %s) "
-             "    AND f.status = 'accepted'"
-             ") "
-             "AND ul.updated_at > NOW() - INTERVAL '10 minutes' " // Only recent locations
-             "ORDER BY ul.updated_at DESC;", 
-             user_id, user_id, user_id, user_id);
+    PGconn *conn = db_pool_acquire();
+    if (!conn) {
+        return -1;
+    }
     
-    PGresult *res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query failed: %s", PQerrorMessage(conn));
-        PQclear(res);
-        PQfinish(conn);
-        return NULL;
+    // Get locations of friends (users who are friends with the given user)
+    const char *params[1] = { user_id };
+    PGresult *res = db_exec_prepared(conn, STMT_FRIENDS_LOCATIONS, params);
+    db_pool_release(conn);
+    int result = write_friends_locations_result(out, res);
+    PQclear(res);
+    return result;
+}
+
+// Write the rows of a STMT_FRIENDS_LOCATIONS result to `out` as a JSON array
+int write_friends_locations_result(json_writer_t *out, const PGresult *res) {
+    if (!res || PQresultStatus(res) != PGRES_TUPLES_OK) {
+        fprintf(stderr, "Query failed: %s", res ? PQresultErrorMessage(res) : "no result\n");
+        return -1;
     }
     
     int rows = PQntuples(res);
-    json_object *locations_array = json_object_new_array();
+    json_writer_begin_array(out);
     
     for (int i = 0; i < rows; i++) {
-        json_object *location_obj = json_object_new_object();
-        
-        json_object_object_add(location_obj, "user_id", json_object_new_string(PQgetvalue(res, i, 0)));
-        json_object_object_add(location_obj, "username", json_object_new_string(PQgetvalue(res, i, 1)));
-        json_object_object_add(location_obj, "latitude", json_object_new_double(atof(PQgetvalue(res, i, 2))));
-        json_object_object_add(location_obj, "longitude", json_object_new_double(atof(PQgetvalue(res, i, 3))));
-        json_object_object_add(location_obj, "accuracy", json_object_new_int(atoi(PQgetvalue(res, i, 4))));
-        json_object_object_add(location_obj, "timestamp", json_object_new_string(PQgetvalue(res, i, 5)));
-        
-        json_object_array_add(locations_array, location_obj);
+        json_writer_begin_object(out);
+        json_writer_key(out, "user_id");
+        json_writer_string(out, PQgetvalue(res, i, 0));
+        json_writer_key(out, "username");
+        json_writer_string(out, PQgetvalue(res, i, 1));
+        json_writer_key(out, "latitude");
+        json_writer_double(out, atof(PQgetvalue(res, i, 2)));
+        json_writer_key(out, "longitude");
+        json_writer_double(out, atof(PQgetvalue(res, i, 3)));
+        json_writer_key(out, "accuracy");
+        json_writer_int(out, atoi(PQgetvalue(res, i, 4)));
+        json_writer_key(out, "timestamp");
+        json_writer_string(out, PQgetvalue(res, i, 5));
+        json_writer_end_object(out);
     }
-    
-    PQclear(res);
-    PQfinish(conn);
-    
-    return locations_array;
+    json_writer_end_array(out);
+    return 0;
 }
 
-// Convert lat/lng to H3 index
+int location_coordinates_valid(double latitude, double longitude) {
+    // Written so NaN fails every comparison
+    return latitude >= -90.0 && latitude <= 90.0 && longitude >= -180.0 && longitude <= 180.0;
+}
+
+// Convert lat/lng to H3 index; 0 when H3 rejects the input
 H3Index latlng_to_h3(double lat, double lng, int resolution) {
     LatLng coord;
     coord.lat = degsToRads(lat);
     coord.lng = degsToRads(lng);
     H3Index h3Index;
-    latLngToCell(&coord, resolution, &h3Index);
+    if (latLngToCell(&coord, resolution, &h3Index) != E_SUCCESS) {
+        return 0;
+    }
     return h3Index;
 }
 
@@ -176,60 +521,11 @@ double calculate_h3_distance(const char* user1_id, const char* user2_id) {
         return -1;
     }
     
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return -1;
-    }
-    
-    // Get user locations from database
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = %s;", user1_id);
-    
-    PGresult *res1 = PQexec(conn, query);
-    if (PQresultStatus(res1) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query for user1 failed: %s", PQerrorMessage(conn));
-        PQclear(res1);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    if (PQntuples(res1) == 0) {
-        // User1 location not found
-        PQclear(res1);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    double lat1 = atof(PQgetvalue(res1, 0, 1));
-    double lon1 = atof(PQgetvalue(res1, 0, 0));
-    PQclear(res1);
-    
-    snprintf(query, sizeof(query), 
-             "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = %s;", user2_id);
-    
-    PGresult *res2 = PQexec(conn, query);
-    if (PQresultStatus(res2) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query for user2 failed: %s", PQerrorMessage(conn));
-        PQclear(res2);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    if (PQntuples(res2) == 0) {
-        // User2 location not found
-        PQclear(res2);
-        PQfinish(conn);
-        return -1;
+    double lat1, lon1, lat2, lon2;
+    if (get_user_position_pair(user1_id, user2_id, &lat1, &lon1, &lat2, &lon2) != 0) {
+        return -1; // One of the users has no known location
     }
     
-    double lat2 = atof(PQgetvalue(res2, 0, 1));
-    double lon2 = atof(PQgetvalue(res2, 0, 0));
-    PQclear(res2);
-    PQfinish(conn);
-    
     // Haversine formula
     double dlat = (lat2 - lat1) * 3.14159265358979323846 / 180.0;
     double dlon = (lon2 - lon1) * 3.14159265358979323846 / 180.0;
@@ -243,107 +539,135 @@ double calculate_h3_distance(const char* user1_id, const char* user2_id) {
 }
 
 // Calculate distance between two users using A* on H3 grid
-double calculate_astar_distance(const char* user1_id, const char* user2_id) {
+double calculate_astar_distance(arena_t *arena, const char* user1_id, const char* user2_id) {
     if (!user1_id || !user2_id) {
         fprintf(stderr, "User IDs are NULL\n");
         return -1;
     }
     
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return -1;
-    }
-    
-    // Get user locations from database
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = %s;", user1_id);
-    
-    PGresult *res1 = PQexec(conn, query);
-    if (PQresultStatus(res1) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query for user1 failed: %s", PQerrorMessage(conn));
-        PQclear(res1);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    if (PQntuples(res1) == 0) {
-        // User1 location not found
-        PQclear(res1);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    double lat1 = atof(PQgetvalue(res1, 0, 1));
-    double lon1 = atof(PQgetvalue(res1, 0, 0));
-    PQclear(res1);
-    
-    snprintf(query, sizeof(query), 
-             "SELECT ST_X(location), ST_Y(location) FROM user_locations WHERE user_id = %s;", user2_id);
-    
-    PGresult *res2 = PQexec(conn, query);
-    if (PQresultStatus(res2) != PGRES_TUPLES_OK) {
-        fprintf(stderr, "Query for user2 failed: %s", PQerrorMessage(conn));
-        PQclear(res2);
-        PQfinish(conn);
-        return -1;
+    double lat1, lon1, lat2, lon2;
+    if (get_user_position_pair(user1_id, user2_id, &lat1, &lon1, &lat2, &lon2) != 0) {
+        return -1; // One of the users has no known location
     }
     
-    if (PQntuples(res2) == 0) {
-        // User2 location not found
-        PQclear(res2);
-        PQfinish(conn);
-        return -1;
-    }
-    
-    double lat2 = atof(PQgetvalue(res2, 0, 1));
-    double lon2 = atof(PQgetvalue(res2, 0, 0));
-    PQclear(res2);
-    PQfinish(conn);
-    
     // Convert coordinates to H3 indexes
     H3Index h3_1 = latlng_to_h3(lat1, lon1, 9);
     H3Index h3_2 = latlng_to_h3(lat2, lon2, 9);
     
     // Get A* path between the two H3 indexes
     H3Index *path = NULL;
-    int pathSize = get_astar_path(h3_1, h3_2, &path);
+    int pathSize = get_astar_path(arena, h3_1, h3_2, &path);
     
     if (pathSize < 0) {
         fprintf(stderr, "Failed to calculate A* path\n");
         return -1;
     }
     
-    // Calculate total distance along the path
+    // Length of the path, center to center
     double totalDistance = 0.0;
     for (int i = 0; i < pathSize - 1; i++) {
-        int64_t distance;
-        gridDistance(path[i], path[i + 1], &distance);
-        totalDistance += distance;
+        totalDistance += h3_distance(path[i], path[i + 1]);
     }
     
     // Clean up
-    free(path);
+    if (!arena) {
+        free(path);
+    }
     
     // Convert to meters
     return totalDistance * 1000.0;
 }
 
-// A* pathfinding implementation (simplified version)
-int get_astar_path(H3Index start, H3Index end, H3Index** path) {
-    // This is a simplified A* implementation
-    // In a real application, you would implement a full A* algorithm
-    // For now, we'll just return a direct path
+// get_astar_path(); *by_astar says whether A* itself answered, and `search` (may be NULL)
+// is then its search
+static int find_h3_path(arena_t *arena, H3Index start, H3Index end, H3Index **path,
+                        astar_search_t *search, int *by_astar) {
+    int size;
+    *by_astar = 0;
+    if (h3_distance(start, end) <= HIER_DIRECT_KM) {
+        size = astar_h3_path(arena, start, end, 0, path, search);
+        if (size != ASTAR_BUDGET_EXCEEDED) {
+            *by_astar = size > 0;
+            return size > 0 ? size : -1;
+        }
+    }
+    size = hier_h3_path(arena, start, end, path, NULL);
+    if (size > 0) {
+        return size;
+    }
     
-    *path = malloc(2 * sizeof(H3Index));
+    int64_t line_size;
+    if (gridPathCellsSize(start, end, &line_size) != E_SUCCESS) {
+        return -1;
+    }
+    *path = arena_alloc(arena, (size_t)line_size * sizeof(H3Index));
     if (!*path) {
         return -1;
     }
-    
-    (*path)[0] = start;
-    (*path)[1] = end;
-    
-    return 2; // Path size
+    if (gridPathCells(start, end, *path) != E_SUCCESS) {
+        if (!arena) {
+            free(*path);
+        }
+        *path = NULL;
+        return -1;
+    }
+    return (int)line_size;
+}
+
+double calculate_alt_distance(arena_t *arena, const char* user1_id, const char* user2_id,
+                              int *used_alt, size_t *expanded) {
+    *used_alt = 0;
+    *expanded = 0;
+    if (!user1_id || !user2_id) {
+        fprintf(stderr, "User IDs are NULL\n");
+        return -1;
+    }
+
+    double lat1, lon1, lat2, lon2;
+    if (get_user_position_pair(user1_id, user2_id, &lat1, &lon1, &lat2, &lon2) != 0) {
+        return -1; // One of the users has no known location
+    }
+
+    H3Index h3_1 = latlng_to_h3(lat1, lon1, 9);
+    H3Index h3_2 = latlng_to_h3(lat2, lon2, 9);
+
+    H3Index *path = NULL;
+    astar_search_t search;
+    int pathSize = alt_h3_path(arena, h3_1, h3_2, 0, &path, &search);
+    if (pathSize > 0) {
+        *used_alt = 1;
+        *expanded = search.expanded;
+    } else {
+        // A*'s own count when it answers; the planner behind it is not counted
+        int by_astar;
+        pathSize = find_h3_path(arena, h3_1, h3_2, &path, &search, &by_astar);
+        if (by_astar) {
+            *expanded = search.expanded;
+        } else {
+            *used_alt = -1;
+        }
+    }
+
+    if (pathSize < 0) {
+        fprintf(stderr, "Failed to calculate ALT path\n");
+        return -1;
+    }
+
+    double totalDistance = 0.0;
+    for (int i = 0; i < pathSize - 1; i++) {
+        totalDistance += h3_distance(path[i], path[i + 1]);
+    }
+    if (!arena) {
+        free(path);
+    }
+    return totalDistance * 1000.0;
+}
+
+// Shortest path over the H3 grid (see routing/astar.h). Past the expansion budget the
+// coarse-to-fine planner (routing/hier_path.h) takes over, so long routes still get an
+// answer; the straight grid line is the last resort. Routes past HIER_DIRECT_KM go
+// to the planner directly.
+int get_astar_path(arena_t *arena, H3Index start, H3Index end, H3Index** path) {
+    int by_astar;
+    return find_h3_path(arena, start, end, path, NULL, &by_astar);
 }
@@ -1,20 +1,72 @@
 #ifndef LOCATION_H
 #define LOCATION_H
 
+#include <stddef.h>
+#include <stdint.h>
 #include <json-c/json.h>
+#include <libpq-fe.h>
 #include <h3/h3api.h>
+#include "../utils/json_writer.h"
+#include "../utils/arena.h"
+
+#define LOCATION_SAVE_BUSY -2 // Write-behind buffer full; ask the client to retry later
 
 // Location management functions
+// Returns 0 once the update is accepted (buffered when the location writer runs),
+// -1 on error, LOCATION_SAVE_BUSY under backpressure
 int save_user_location(const char* user_id, double latitude, double longitude, int accuracy);
+
+// One point of a batched upload. Points the caller could not parse are passed in as
+// LOCATION_POINT_INVALID and skipped; save_user_locations() sets the others' status.
+typedef struct {
+    int32_t user_id;
+    int accuracy;
+    double latitude;
+    double longitude;
+    double ts;          // Epoch seconds when the point was taken
+    int status;
+} location_point_t;
+
+#define LOCATION_POINT_ACCEPTED 0
+#define LOCATION_POINT_SUPERSEDED 1   // A newer point for the same user in the batch was kept instead
+#define LOCATION_POINT_FAILED -1
+#define LOCATION_POINT_INVALID -2
+
+// Store a batch with one multi-row upsert. user_locations keeps one row per user, so only
+// each user's newest point is written. Returns the number of rows written, or -1 if the
+// statement failed (every accepted point is then marked failed).
+int save_user_locations(location_point_t* points, size_t count);
+
 json_object* get_user_locations_from_db(void);
-json_object* get_friends_locations_from_db(const char* user_id);
+
+// Latest position of a user (live store when enabled, else user_locations); 0 on success
+int get_user_position(const char* user_id, double* latitude, double* longitude);
+// Both users' positions, with the two database lookups pipelined into one round trip;
+// 0 when both are known
+int get_user_position_pair(const char* user1_id, const char* user2_id,
+                           double* lat1, double* lon1, double* lat2, double* lon2);
+// Write friends' recent positions to `out` as a JSON array, newest first; 0 on success
+int write_friends_locations(json_writer_t *out, const char* user_id);
+// Same, from a STMT_FRIENDS_LOCATIONS result the caller ran (e.g. through db_async)
+int write_friends_locations_result(json_writer_t *out, const PGresult *res);
 
 // Distance calculation functions
 double calculate_h3_distance(const char* user1_id, const char* user2_id);
-double calculate_astar_distance(const char* user1_id, const char* user2_id);
+double calculate_astar_distance(arena_t *arena, const char* user1_id, const char* user2_id);
+// Same route searched with landmark bounds (routing/alt.h), falling back to A* when
+// either user is outside the landmark table's region or it finds nothing there.
+// *used_alt is 1 for ALT and 0 for A*, with *expanded the cells that search took; -1
+// when get_astar_path()'s planner or grid line answered instead, leaving *expanded 0.
+double calculate_alt_distance(arena_t *arena, const char* user1_id, const char* user2_id,
+                              int *used_alt, size_t *expanded);
+
+// Nonzero when latitude and longitude are finite and within range
+int location_coordinates_valid(double latitude, double longitude);
 
 // H3 utility functions
+// Returns 0 (not a valid cell) when the coordinates or resolution are rejected
 H3Index latlng_to_h3(double lat, double lng, int resolution);
-int get_astar_path(H3Index start, H3Index end, H3Index** path);
+// *path is allocated from `arena`, or from the heap when arena is NULL
+int get_astar_path(arena_t *arena, H3Index start, H3Index end, H3Index** path);
 
 #endif // LOCATION_H
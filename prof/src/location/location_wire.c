@@ -0,0 +1,96 @@
+#include "location_wire.h"
+#include <string.h>
+
+static const unsigned char batch_magic[4] = { 'G', 'L', 'B', '1' };
+
+// Byte-wise loads and stores, so records need no alignment and the host byte order
+// does not matter
+static inline uint16_t load_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t load_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint64_t load_u64(const unsigned char *p) {
+    return (uint64_t)load_u32(p) | ((uint64_t)load_u32(p + 4) << 32);
+}
+
+static inline double load_f64(const unsigned char *p) {
+    uint64_t bits = load_u64(p);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static inline void store_u16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static inline void store_u32(unsigned char *p, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        p[i] = (unsigned char)(v >> (8 * i));
+    }
+}
+
+static inline void store_u64(unsigned char *p, uint64_t v) {
+    store_u32(p, (uint32_t)v);
+    store_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static inline void store_f64(unsigned char *p, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    store_u64(p, bits);
+}
+
+int location_wire_parse(const void *message, size_t len, const unsigned char **records) {
+    const unsigned char *p = message;
+    if (len == LOCATION_WIRE_RECORD_SIZE && p[0] == LOCATION_WIRE_VERSION) {
+        *records = p;
+        return 1;
+    }
+
+    if (len < LOCATION_WIRE_HEADER_SIZE || memcmp(p, batch_magic, sizeof(batch_magic)) != 0 ||
+        load_u16(p + 6) != 0) {
+        return -1;
+    }
+    size_t count = load_u16(p + 4);
+    if (count == 0 || len != LOCATION_WIRE_HEADER_SIZE + count * LOCATION_WIRE_RECORD_SIZE) {
+        return -1;
+    }
+    *records = p + LOCATION_WIRE_HEADER_SIZE;
+    return (int)count;
+}
+
+int location_wire_decode(const unsigned char *record, location_wire_record_t *out) {
+    if (record[0] != LOCATION_WIRE_VERSION || (record[1] & ~LOCATION_WIRE_FLAG_TS)) {
+        return -1;
+    }
+    out->accuracy = load_u16(record + 2);
+    out->user_id = (int32_t)load_u32(record + 4);
+    out->latitude = load_f64(record + 8);
+    out->longitude = load_f64(record + 16);
+    out->ts_ms = (record[1] & LOCATION_WIRE_FLAG_TS) ? (int64_t)load_u64(record + 24) : 0;
+    return 0;
+}
+
+size_t location_wire_encode(const location_wire_record_t *record, unsigned char *out) {
+    out[0] = LOCATION_WIRE_VERSION;
+    out[1] = record->ts_ms ? LOCATION_WIRE_FLAG_TS : 0;
+    store_u16(out + 2, (uint16_t)(record->accuracy < 0 ? 0 : record->accuracy > 0xFFFF ? 0xFFFF : record->accuracy));
+    store_u32(out + 4, (uint32_t)record->user_id);
+    store_f64(out + 8, record->latitude);
+    store_f64(out + 16, record->longitude);
+    store_u64(out + 24, (uint64_t)record->ts_ms);
+    return LOCATION_WIRE_RECORD_SIZE;
+}
+
+size_t location_wire_encode_header(uint16_t count, unsigned char *out) {
+    memcpy(out, batch_magic, sizeof(batch_magic));
+    store_u16(out + 4, count);
+    store_u16(out + 6, 0);
+    return LOCATION_WIRE_HEADER_SIZE;
+}
@@ -0,0 +1,48 @@
+#ifndef LOCATION_WIRE_H
+#define LOCATION_WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary location reports. All integers and doubles are little-endian.
+//
+// Record (32 bytes):
+//   0  u8   version (LOCATION_WIRE_VERSION)
+//   1  u8   flags (LOCATION_WIRE_FLAG_*; other bits must be zero)
+//   2  u16  accuracy in meters
+//   4  i32  user id (0 for the signed-in user; any other id must be that user)
+//   8  f64  latitude
+//   16 f64  longitude
+//   24 i64  epoch milliseconds when the point was taken (used with LOCATION_WIRE_FLAG_TS)
+//
+// A message is either one bare record, or a batch header followed by `count` records:
+//   0  4 bytes "GLB1" magic
+//   4  u16  count
+//   6  u16  reserved, zero
+
+#define LOCATION_WIRE_VERSION 1
+#define LOCATION_WIRE_RECORD_SIZE 32
+#define LOCATION_WIRE_HEADER_SIZE 8
+#define LOCATION_WIRE_FLAG_TS 0x01
+
+typedef struct {
+    int32_t user_id;
+    int accuracy;
+    double latitude;
+    double longitude;
+    int64_t ts_ms;      // 0 when the record carries no timestamp
+} location_wire_record_t;
+
+// Check the framing of a message; returns the number of records it holds and points
+// *records at the first one, or -1 when the message is malformed
+int location_wire_parse(const void *message, size_t len, const unsigned char **records);
+
+// Decode the record at `record`; returns 0, or -1 for an unknown version or flags.
+// Records are located with location_wire_parse() and are LOCATION_WIRE_RECORD_SIZE apart.
+int location_wire_decode(const unsigned char *record, location_wire_record_t *out);
+
+// Encoders for clients and benchmarks; each returns the number of bytes written
+size_t location_wire_encode(const location_wire_record_t *record, unsigned char *out);
+size_t location_wire_encode_header(uint16_t count, unsigned char *out);
+
+#endif // LOCATION_WIRE_H
@@ -0,0 +1,384 @@
+#define _GNU_SOURCE
+#include "location_writer.h"
+#include "../api.h"
+#include "../db/db_pool.h"
+#include "../db/db_statements.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <time.h>
+#include <pthread.h>
+
+// Pending updates (the newest position per user) live in a dense array indexed by an
+// open-addressing table keyed on user id. The flusher swaps the array out under the lock
+// and writes it without holding it.
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_wake;
+static pthread_t writer_thread;
+static int writer_running = 0;
+static int writer_stopping = 0;
+
+static location_row_t *pending = NULL;
+static location_row_t *flushing = NULL;
+static uint32_t *pending_slots = NULL; // Index table slot of each pending row, cleared on swap
+static size_t pending_count = 0;
+static size_t writer_capacity = 0;
+static int32_t *index_slots = NULL;    // -1 = empty, else index into pending
+static uint32_t index_mask = 0;
+static unsigned int flush_interval_ms = LOCATION_WRITER_FLUSH_INTERVAL_MS;
+static size_t flush_threshold = LOCATION_WRITER_FLUSH_THRESHOLD;
+static location_writer_stats_t writer_stats;
+
+static double now_seconds(int clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t hash_user(int user_id) {
+    uint32_t h = (uint32_t)user_id;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+// Find the index slot for user_id: either the one holding it or the empty one to claim
+static uint32_t find_slot(int user_id) {
+    uint32_t slot = hash_user(user_id) & index_mask;
+    while (index_slots[slot] >= 0 && pending[index_slots[slot]].user_id != user_id) {
+        slot = (slot + 1) & index_mask;
+    }
+    return slot;
+}
+
+// Insert or replace under writer_lock; returns -1 if a new user does not fit
+static int buffer_put(const location_row_t *update, int count_coalesced) {
+    uint32_t slot = find_slot(update->user_id);
+    if (index_slots[slot] >= 0) {
+        location_row_t *entry = &pending[index_slots[slot]];
+        if (entry->updated_at > update->updated_at) {
+            return 0; // Already holding something newer (a requeued row lost the race)
+        }
+        *entry = *update;
+        if (count_coalesced) {
+            writer_stats.coalesced++;
+        }
+        return 0;
+    }
+
+    if (pending_count >= writer_capacity) {
+        return -1;
+    }
+    pending[pending_count] = *update;
+    pending_slots[pending_count] = slot;
+    index_slots[slot] = (int32_t)pending_count;
+    pending_count++;
+    return 0;
+}
+
+static void append_format(char **cursor, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+static void append_format(char **cursor, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    *cursor += vsprintf(*cursor, fmt, args);
+    va_end(args);
+}
+
+int location_upsert_rows(PGconn *conn, const location_row_t *rows, size_t count) {
+    // Array literals for unnest(): every element is numeric or hex, so nothing needs quoting
+    char *ids = malloc(count * 12 + 3);
+    char *lons = malloc(count * 26 + 3);
+    char *lats = malloc(count * 26 + 3);
+    char *cells = malloc(count * 18 + 3);
+    char *accuracies = malloc(count * 12 + 3);
+    char *times = malloc(count * 26 + 3);
+    int result = -1;
+
+    if (ids && lons && lats && cells && accuracies && times) {
+        char *p_ids = ids, *p_lons = lons, *p_lats = lats;
+        char *p_cells = cells, *p_acc = accuracies, *p_times = times;
+        for (size_t i = 0; i < count; i++) {
+            const char *sep = i == 0 ? "{" : ",";
+            char cell[17];
+            h3ToString(rows[i].h3_index, cell, sizeof(cell));
+            append_format(&p_ids, "%s%d", sep, rows[i].user_id);
+            append_format(&p_lons, "%s%.17g", sep, rows[i].longitude);
+            append_format(&p_lats, "%s%.17g", sep, rows[i].latitude);
+            append_format(&p_cells, "%s%s", sep, cell);
+            append_format(&p_acc, "%s%d", sep, rows[i].accuracy);
+            append_format(&p_times, "%s%.6f", sep, rows[i].updated_at);
+        }
+        strcpy(p_ids, "}");
+        strcpy(p_lons, "}");
+        strcpy(p_lats, "}");
+        strcpy(p_cells, "}");
+        strcpy(p_acc, "}");
+        strcpy(p_times, "}");
+
+        const char *params[6] = { ids, lons, lats, cells, accuracies, times };
+        PGresult *res = db_exec_prepared(conn, STMT_LOCATION_UPSERT_BATCH, params);
+        if (PQresultStatus(res) == PGRES_COMMAND_OK) {
+            result = 0;
+        } else {
+            fprintf(stderr, "Batched location upsert failed: %s", PQerrorMessage(conn));
+        }
+        PQclear(res);
+    }
+
+    free(ids);
+    free(lons);
+    free(lats);
+    free(cells);
+    free(accuracies);
+    free(times);
+    return result;
+}
+
+// Swap out the pending buffer and write it. Called with writer_lock held; drops it while writing.
+static void flush_locked(void) {
+    size_t count = pending_count;
+    if (count == 0) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        index_slots[pending_slots[i]] = -1;
+    }
+    location_row_t *rows = pending;
+    pending = flushing;
+    flushing = rows;
+    pending_count = 0;
+    pthread_mutex_unlock(&writer_lock);
+
+    double start = now_seconds(CLOCK_MONOTONIC);
+    size_t written = 0;
+    PGconn *conn = db_pool_acquire();
+    if (conn) {
+        while (written < count) {
+            size_t batch = count - written;
+            if (batch > LOCATION_WRITER_BATCH_ROWS) {
+                batch = LOCATION_WRITER_BATCH_ROWS;
+            }
+            if (location_upsert_rows(conn, rows + written, batch) != 0) {
+                break;
+            }
+            written += batch;
+        }
+        db_pool_release(conn);
+    }
+    double elapsed_ms = (now_seconds(CLOCK_MONOTONIC) - start) * 1000.0;
+
+    pthread_mutex_lock(&writer_lock);
+    writer_stats.flushes++;
+    writer_stats.rows_written += written;
+    writer_stats.last_flush_ms = elapsed_ms;
+    writer_stats.total_flush_ms += elapsed_ms;
+    if (elapsed_ms > writer_stats.max_flush_ms) {
+        writer_stats.max_flush_ms = elapsed_ms;
+    }
+    if (written < count) {
+        // Keep unwritten rows for the next attempt unless a newer update already replaced them
+        writer_stats.flush_failures++;
+        for (size_t i = written; i < count; i++) {
+            if (buffer_put(&rows[i], 0) != 0) {
+                writer_stats.rejected += count - i;
+                break;
+            }
+        }
+    }
+}
+
+static void* writer_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&writer_lock);
+    while (!writer_stopping) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += flush_interval_ms / 1000;
+        deadline.tv_nsec += (long)(flush_interval_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (!writer_stopping && pending_count < flush_threshold) {
+            if (pthread_cond_timedwait(&writer_wake, &writer_lock, &deadline) != 0) {
+                break; // Interval elapsed
+            }
+        }
+        if (writer_stopping) {
+            break;
+        }
+        flush_locked();
+    }
+    pthread_mutex_unlock(&writer_lock);
+    return NULL;
+}
+
+int location_writer_start(size_t capacity, unsigned int interval_ms, size_t threshold) {
+    pthread_mutex_lock(&writer_lock);
+    if (writer_running) {
+        pthread_mutex_unlock(&writer_lock);
+        return 0;
+    }
+
+    if (capacity == 0) {
+        capacity = LOCATION_WRITER_CAPACITY;
+    }
+    uint32_t slots = 2;
+    while (slots < capacity * 2) {
+        slots <<= 1;
+    }
+
+    pending = malloc(capacity * sizeof(location_row_t));
+    flushing = malloc(capacity * sizeof(location_row_t));
+    pending_slots = malloc(capacity * sizeof(uint32_t));
+    index_slots = malloc(slots * sizeof(int32_t));
+    if (!pending || !flushing || !pending_slots || !index_slots) {
+        fprintf(stderr, "Failed to allocate location write buffer\n");
+        free(pending);
+        free(flushing);
+        free(pending_slots);
+        free(index_slots);
+        pending = flushing = NULL;
+        pending_slots = NULL;
+        index_slots = NULL;
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    memset(index_slots, 0xff, slots * sizeof(int32_t));
+    index_mask = slots - 1;
+    writer_capacity = capacity;
+    pending_count = 0;
+    flush_interval_ms = interval_ms > 0 ? interval_ms : LOCATION_WRITER_FLUSH_INTERVAL_MS;
+    flush_threshold = threshold > 0 && threshold <= capacity ? threshold : capacity;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&writer_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    writer_stopping = 0;
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start location writer thread\n");
+        pthread_cond_destroy(&writer_wake);
+        free(pending);
+        free(flushing);
+        free(pending_slots);
+        free(index_slots);
+        pending = flushing = NULL;
+        pending_slots = NULL;
+        index_slots = NULL;
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    writer_running = 1;
+    pthread_mutex_unlock(&writer_lock);
+    return 0;
+}
+
+int location_writer_enabled(void) {
+    pthread_mutex_lock(&writer_lock);
+    int running = writer_running && !writer_stopping;
+    pthread_mutex_unlock(&writer_lock);
+    return running;
+}
+
+int location_writer_submit(int user_id, double latitude, double longitude, H3Index h3_index, int accuracy) {
+    location_row_t update = {
+        .user_id = user_id,
+        .accuracy = accuracy,
+        .latitude = latitude,
+        .longitude = longitude,
+        .updated_at = now_seconds(CLOCK_REALTIME),
+        .h3_index = h3_index,
+    };
+
+    pthread_mutex_lock(&writer_lock);
+    if (!writer_running || writer_stopping) {
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    if (buffer_put(&update, 1) != 0) {
+        writer_stats.rejected++;
+        pthread_cond_signal(&writer_wake);
+        pthread_mutex_unlock(&writer_lock);
+        return -1;
+    }
+    writer_stats.submitted++;
+    if (pending_count >= flush_threshold) {
+        pthread_cond_signal(&writer_wake);
+    }
+    pthread_mutex_unlock(&writer_lock);
+    return 0;
+}
+
+void location_writer_stop(void) {
+    pthread_mutex_lock(&writer_lock);
+    if (!writer_running) {
+        pthread_mutex_unlock(&writer_lock);
+        return;
+    }
+    writer_stopping = 1;
+    pthread_cond_signal(&writer_wake);
+    pthread_mutex_unlock(&writer_lock);
+
+    pthread_join(writer_thread, NULL);
+
+    // New submissions are refused from here on; write out what is left
+    pthread_mutex_lock(&writer_lock);
+    flush_locked();
+    if (pending_count > 0) {
+        fprintf(stderr, "Dropping %zu unwritten location updates at shutdown\n", pending_count);
+    }
+    writer_running = 0;
+    pthread_cond_destroy(&writer_wake);
+    free(pending);
+    free(flushing);
+    free(pending_slots);
+    free(index_slots);
+    pending = flushing = NULL;
+    pending_slots = NULL;
+    index_slots = NULL;
+    pending_count = 0;
+    pthread_mutex_unlock(&writer_lock);
+}
+
+void location_writer_get_stats(location_writer_stats_t *stats) {
+    pthread_mutex_lock(&writer_lock);
+    *stats = writer_stats;
+    stats->pending = pending_count;
+    stats->capacity = writer_capacity;
+    pthread_mutex_unlock(&writer_lock);
+}
+
+json_object* location_writer_stats_to_json(void) {
+    location_writer_stats_t stats;
+    location_writer_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(location_writer_enabled()));
+    json_object_object_add(obj, "submitted", json_object_new_int64((int64_t)stats.submitted));
+    json_object_object_add(obj, "coalesced", json_object_new_int64((int64_t)stats.coalesced));
+    json_object_object_add(obj, "rejected", json_object_new_int64((int64_t)stats.rejected));
+    json_object_object_add(obj, "pending", json_object_new_int64((int64_t)stats.pending));
+    json_object_object_add(obj, "capacity", json_object_new_int64((int64_t)stats.capacity));
+    json_object_object_add(obj, "flushes", json_object_new_int64((int64_t)stats.flushes));
+    json_object_object_add(obj, "rows_written", json_object_new_int64((int64_t)stats.rows_written));
+    json_object_object_add(obj, "flush_failures", json_object_new_int64((int64_t)stats.flush_failures));
+    json_object_object_add(obj, "last_flush_ms", json_object_new_double(stats.last_flush_ms));
+    json_object_object_add(obj, "max_flush_ms", json_object_new_double(stats.max_flush_ms));
+    json_object_object_add(obj, "avg_flush_ms",
+        json_object_new_double(stats.flushes > 0 ? stats.total_flush_ms / stats.flushes : 0.0));
+    // Client updates per row written: how much the buffer saves the database
+    json_object_object_add(obj, "coalescing_ratio",
+        json_object_new_double(stats.rows_written > 0 ? (double)stats.submitted / stats.rows_written : 0.0));
+    return obj;
+}
@@ -0,0 +1,55 @@
+#ifndef LOCATION_WRITER_H
+#define LOCATION_WRITER_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+#include <h3/h3api.h>
+#include <libpq-fe.h>
+
+// One row of a batched user_locations upsert
+typedef struct {
+    int user_id;
+    int accuracy;
+    double latitude;
+    double longitude;
+    double updated_at;     // Epoch seconds; stored as updated_at so the row reflects when it was taken
+    H3Index h3_index;
+} location_row_t;
+
+// Counters reported by location_writer_get_stats()
+typedef struct {
+    unsigned long submitted;       // Updates accepted from clients
+    unsigned long coalesced;       // Updates that replaced a still-pending one for the same user
+    unsigned long rejected;        // Updates refused because the buffer was full
+    unsigned long flushes;
+    unsigned long rows_written;
+    unsigned long flush_failures;
+    unsigned long pending;         // Users waiting for the next flush
+    unsigned long capacity;
+    double last_flush_ms;
+    double max_flush_ms;
+    double total_flush_ms;
+} location_writer_stats_t;
+
+// Start the write-behind stage. At most `capacity` users are buffered; the flusher
+// runs every flush_interval_ms, or sooner once flush_threshold users are pending.
+int location_writer_start(size_t capacity, unsigned int flush_interval_ms, size_t flush_threshold);
+
+// Non-zero once location_writer_start() succeeded and until location_writer_stop()
+int location_writer_enabled(void);
+
+// Buffer the newest position for a user, replacing any pending one.
+// Returns 0 on success, -1 when the buffer is full and the caller should back off.
+int location_writer_submit(int user_id, double latitude, double longitude, H3Index h3_index, int accuracy);
+
+// Write rows[0..count) with one multi-row upsert (user ids must be distinct). A row never
+// replaces one with a later updated_at. Returns 0 on success.
+int location_upsert_rows(PGconn *conn, const location_row_t *rows, size_t count);
+
+// Stop the flusher and write out everything still pending
+void location_writer_stop(void);
+
+void location_writer_get_stats(location_writer_stats_t *stats);
+json_object* location_writer_stats_to_json(void);
+
+#endif // LOCATION_WRITER_H
@@ -1,18 +1,31 @@
 #include "api_server.h"
 #include "api.h"
+#include "db/db_pool.h"
+#include "db/db_async.h"
+#include "auth/session_cache.h"
+#include "auth/session_sweeper.h"
+#include "auth/friend_graph.h"
+#include "location/location_writer.h"
+#include "location/live_store.h"
+#include "stream/location_hub.h"
+#include "stream/ws_channel.h"
+#include "routing/cost_map.h"
+#include "routing/alt.h"
+#include "routing/road_graph.h"
+#include "utils/static_files.h"
+#include "utils/compress.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <unistd.h>
 
 static struct MHD_Daemon *daemon = NULL;
+static volatile sig_atomic_t running = 1;
 
-// Signal handler for graceful shutdown
+// Signal handler for graceful shutdown; main() does the actual teardown
 void signal_handler(int sig) {
-    printf("\nReceived signal %d, shutting down gracefully...\n", sig);
-    if (daemon) {
-        MHD_stop_daemon(daemon);
-    }
-    exit(0);
+    (void)sig;
+    running = 0;
 }
 
 int main() {
@@ -20,33 +33,167 @@ int main() {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    // Share a bounded pool of database connections across all worker threads
+    const char *pool_size = getenv("GEO_DB_POOL_SIZE");
+    const char *pool_timeout = getenv("GEO_DB_POOL_TIMEOUT_MS");
+    db_pool_init(CONN_STR,
+                 pool_size ? (unsigned int)atoi(pool_size) : DB_POOL_SIZE,
+                 pool_timeout ? (unsigned int)atoi(pool_timeout) : DB_POOL_ACQUIRE_TIMEOUT_MS);
+
+    session_cache_init(SESSION_CACHE_CAPACITY, SESSION_CACHE_TTL_SEC);
+
+    // Purge expired sessions in the background instead of on the request path
+    const char *sweep_interval = getenv("GEO_SESSION_SWEEP_INTERVAL");
+    const char *sweep_batch = getenv("GEO_SESSION_SWEEP_BATCH");
+    session_sweeper_start(sweep_interval ? (unsigned int)atoi(sweep_interval) : SESSION_SWEEP_INTERVAL_SEC,
+                          sweep_batch ? (unsigned int)atoi(sweep_batch) : SESSION_SWEEP_BATCH_SIZE);
+
+    // Answer friend fan-out from an in-memory graph; GEO_FRIEND_GRAPH=0 queries friendships instead
+    const char *graph_enabled = getenv("GEO_FRIEND_GRAPH");
+    if (!graph_enabled || atoi(graph_enabled) != 0) {
+        if (friend_graph_load_from_db() != 0) {
+            fprintf(stderr, "Friend graph not loaded; friend lists will be queried from the database\n");
+        }
+    }
+
+    // Serve location reads from memory; GEO_LIVE_STORE=0 reads user_locations instead
+    const char *live_enabled = getenv("GEO_LIVE_STORE");
+    if (!live_enabled || atoi(live_enabled) != 0) {
+        const char *live_capacity = getenv("GEO_LIVE_STORE_CAPACITY");
+        if (live_store_init(live_capacity ? (size_t)atol(live_capacity) : LIVE_STORE_CAPACITY) == 0) {
+            long loaded = live_store_load_from_db();
+            if (loaded < 0) {
+                fprintf(stderr, "Live location store starts empty: could not load user_locations\n");
+            } else {
+                printf("Loaded %ld locations into the live store\n", loaded);
+            }
+        }
+    }
+
+    // Buffer location updates and write them in batches; GEO_LOCATION_WRITER=0 writes inline
+    const char *writer_enabled = getenv("GEO_LOCATION_WRITER");
+    if (!writer_enabled || atoi(writer_enabled) != 0) {
+        const char *flush_ms = getenv("GEO_LOCATION_FLUSH_MS");
+        const char *writer_capacity = getenv("GEO_LOCATION_BUFFER");
+        location_writer_start(writer_capacity ? (size_t)atol(writer_capacity) : LOCATION_WRITER_CAPACITY,
+                              flush_ms ? (unsigned int)atoi(flush_ms) : LOCATION_WRITER_FLUSH_INTERVAL_MS,
+                              LOCATION_WRITER_FLUSH_THRESHOLD);
+    }
+
+    // Compress large JSON responses for clients that accept it; GEO_COMPRESS_LEVEL=0 disables it
+    const char *compress_level = getenv("GEO_COMPRESS_LEVEL");
+    const char *compress_min_size = getenv("GEO_COMPRESS_MIN_SIZE");
+    compress_configure(compress_level ? atoi(compress_level) : COMPRESS_LEVEL,
+                       compress_min_size ? (size_t)atol(compress_min_size) : COMPRESS_MIN_SIZE);
+
+    // Weight hex-grid routes by terrain; without a map every cell costs the same
+    const char *cost_map_path = getenv("GEO_COST_MAP");
+    if (cost_map_path && cost_map_path[0] != '\0') {
+        if (cost_map_load(cost_map_path) != 0) {
+            fprintf(stderr, "Cost map not loaded; routes will treat every cell alike\n");
+        }
+    } else if (access(COST_MAP_PATH, R_OK) == 0) {
+        cost_map_load(COST_MAP_PATH);
+    }
+
+    // Landmark bounds for /api/distance/alt; checked against the cost map, so load it after
+    const char *alt_table_path = getenv("GEO_ALT_TABLE");
+    if (alt_table_path && alt_table_path[0] != '\0') {
+        if (alt_load(alt_table_path) != 0) {
+            fprintf(stderr, "Landmark table not loaded; /api/distance/alt will answer with plain A*\n");
+        }
+    } else if (access(ALT_TABLE_PATH, R_OK) == 0) {
+        alt_load(ALT_TABLE_PATH);
+    }
+
+    // Road routes (/api/route?mode=road) need a contracted road graph
+    const char *road_graph_path = getenv("GEO_ROAD_GRAPH");
+    if (road_graph_path && road_graph_path[0] != '\0') {
+        if (road_graph_load(road_graph_path) != 0) {
+            fprintf(stderr, "Road graph not loaded; /api/route?mode=road is unavailable\n");
+        }
+    } else if (access(ROAD_GRAPH_PATH, R_OK) == 0) {
+        road_graph_load(ROAD_GRAPH_PATH);
+    }
+
     // Initialize the API server
-    daemon = start_api_server();
+    http_engine_config_t config;
+    http_engine_config_defaults(&config);
+    http_engine_config_from_env(&config);
+
+    // Push friend location deltas over SSE; fan-out needs the in-memory friend graph
+    const char *stream_enabled = getenv("GEO_LOCATION_STREAM");
+    if ((!stream_enabled || atoi(stream_enabled) != 0) && friend_graph_enabled()) {
+        location_hub_init(config.mode == HTTP_ENGINE_THREAD_PER_CONNECTION);
+    }
+
+    // One socket per client for position reports and friend updates; GEO_WEBSOCKET=0 disables it
+    const char *ws_enabled = getenv("GEO_WEBSOCKET");
+    if (!ws_enabled || atoi(ws_enabled) != 0) {
+        ws_channel_start();
+    }
+
+    // Hot read queries park their request instead of a worker; needs suspendable connections
+    const char *async_connections = getenv("GEO_DB_ASYNC_CONNECTIONS");
+    int async_count = async_connections ? atoi(async_connections) : DB_ASYNC_CONNECTIONS;
+    if (async_count > 0 && config.mode != HTTP_ENGINE_THREAD_PER_CONNECTION) {
+        db_async_start(CONN_STR, (unsigned int)async_count);
+    }
+
+    daemon = start_api_server_with_config(&config);
     if (daemon == NULL) {
         fprintf(stderr, "Failed to start API server\n");
+        db_async_stop();
+        ws_channel_stop();
+        location_hub_shutdown();
+        location_writer_stop();
+        session_sweeper_stop();
+        db_pool_shutdown();
         return 1;
     }
 
     printf("Location Sharing System Server\n");
     printf("==============================\n");
-    printf("Server running on port %d\n", PORT);
-    printf("Web interface: http://localhost:%d/\n", PORT);
+    printf("Server running on port %u\n", config.port);
+    printf("Threading: %s (%u workers, max %u connections, %us timeout)\n",
+           http_engine_mode_name(config.mode), http_engine_worker_count(&config),
+           config.connection_limit, config.connection_timeout);
+    printf("Web interface: http://localhost:%u/\n", config.port);
     printf("API endpoints:\n");
     printf("  - POST /api/register - User registration\n");
     printf("  - POST /api/login - User login\n");
     printf("  - POST /api/logout - User logout\n");
     printf("  - POST /api/save-location - Save user location\n");
+    printf("  - POST /api/save-locations - Save a batch of locations (JSON array or NDJSON)\n");
+    printf("  - POST /api/save-locations-bin - Save locations in the binary record format\n");
     printf("  - GET  /api/friends - Get friends list\n");
     printf("  - GET  /api/friends/locations - Get friends locations\n");
-    printf("  - GET  /api/route - Calculate route between points\n");
+    printf("  - GET  /api/friends/stream - Stream friends locations (SSE)\n");
+    printf("  - GET  /api/ws - WebSocket for location reports and friend updates\n");
+    printf("  - GET  /api/route - Calculate route between points (mode=hex or road)\n");
     printf("  - GET  /api/distance/h3 - H3 distance calculation\n");
     printf("  - GET  /api/distance/astar - A* distance calculation\n");
+    printf("  - GET  /api/distance/alt - A* distance with landmark bounds\n");
+    printf("  - GET  /api/stats - Connection pool and cache statistics\n");
     printf("\nPress Ctrl+C to stop the server...\n");
 
     // Keep the server running
-    while (1) {
+    while (running) {
         sleep(1);
     }
 
+    printf("\nShutting down gracefully...\n");
+    ws_channel_stop();       // MHD requires upgraded sockets to be closed before it stops
+    location_hub_shutdown(); // Resume parked streams so the daemon can close them
+    db_async_stop();         // Likewise for requests waiting on a query
+    MHD_stop_daemon(daemon);
+    static_files_shutdown();
+    location_writer_stop(); // Flush buffered locations before the pool goes away
+    session_sweeper_stop();
+    db_pool_shutdown();
+    cost_map_unload();
+    alt_unload();
+    road_graph_unload();
+
     return 0;
 }
@@ -0,0 +1,103 @@
+#include "request_context.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define REQUEST_CONTEXT_MIN_CAPACITY 1024
+
+request_context_t* request_context_create(size_t limit, size_t expected_size) {
+    arena_t arena;
+    arena_init(&arena);
+    request_context_t *ctx = arena_calloc(&arena, 1, sizeof(request_context_t));
+    if (!ctx) {
+        arena_release(&arena);
+        return NULL;
+    }
+    ctx->arena = arena;
+    ctx->limit = limit;
+    if (limit == 0) {
+        return ctx;
+    }
+
+    // Reserve room for the terminator up front; a declared size over the limit is
+    // rejected by the caller before we get here, but clamp anyway
+    size_t initial = expected_size > 0 ? expected_size + 1 : REQUEST_CONTEXT_MIN_CAPACITY;
+    if (initial > limit + 1) {
+        initial = limit + 1;
+    }
+    ctx->body = malloc(initial);
+    if (!ctx->body) {
+        request_context_free(ctx);
+        return NULL;
+    }
+    ctx->capacity = initial;
+    ctx->body[0] = '\0';
+    return ctx;
+}
+
+int request_context_append(request_context_t *ctx, const char *data, size_t size) {
+    if (ctx->status != 0) {
+        return -1;
+    }
+    if (size > ctx->limit - ctx->size) {
+        ctx->status = MHD_HTTP_PAYLOAD_TOO_LARGE;
+        return -1;
+    }
+
+    size_t needed = ctx->size + size + 1;
+    if (needed > ctx->capacity) {
+        size_t capacity = ctx->capacity;
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        if (capacity > ctx->limit + 1) {
+            capacity = ctx->limit + 1;
+        }
+        char *body = realloc(ctx->body, capacity);
+        if (!body) {
+            ctx->status = MHD_HTTP_INTERNAL_SERVER_ERROR;
+            return -1;
+        }
+        ctx->body = body;
+        ctx->capacity = capacity;
+    }
+
+    memcpy(ctx->body + ctx->size, data, size);
+    ctx->size += size;
+    ctx->body[ctx->size] = '\0';
+    return 0;
+}
+
+void request_context_free(request_context_t *ctx) {
+    if (ctx) {
+        if (ctx->state_free && ctx->handler_state) {
+            ctx->state_free(ctx->handler_state);
+        }
+        free(ctx->body);
+        arena_t arena = ctx->arena; // ctx itself lives in the arena
+        arena_release(&arena);
+    }
+}
+
+size_t request_content_length(struct MHD_Connection *connection) {
+    const char *value = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                    MHD_HTTP_HEADER_CONTENT_LENGTH);
+    if (!value) {
+        return 0;
+    }
+    char *end = NULL;
+    unsigned long long length = strtoull(value, &end, 10);
+    if (end == value || *end != '\0') {
+        return 0;
+    }
+    return length > (unsigned long long)SIZE_MAX ? SIZE_MAX : (size_t)length;
+}
+
+void request_context_completed(void *cls, struct MHD_Connection *connection,
+                               void **con_cls, enum MHD_RequestTerminationCode toe) {
+    (void)cls;
+    (void)connection;
+    (void)toe;
+    request_context_free(*con_cls);
+    *con_cls = NULL;
+}
@@ -0,0 +1,43 @@
+#ifndef REQUEST_CONTEXT_H
+#define REQUEST_CONTEXT_H
+
+#include <stddef.h>
+#include <microhttpd.h>
+#include "utils/arena.h"
+#include "router.h"
+
+// Per-request state kept in con_cls from the first callback until the request completes
+typedef struct {
+    arena_t arena;        // Scratch memory for the handler; holds this struct too
+    char *body;           // NUL-terminated so JSON parsers can read it in place; NULL without a body
+    size_t size;
+    size_t capacity;
+    size_t limit;         // Largest body accepted for this request
+    unsigned int status;  // Non-zero once the request has been rejected (e.g. 413)
+    const route_t *route; // Matched on the first callback
+    char *user_id;        // Set by the auth stage for ROUTE_AUTH routes (arena memory)
+    const char *session_token;
+    char *username;       // Set by the auth stage when a session cache miss fetched it
+    void *handler_state;  // Kept by a handler across a suspend/resume (see route_request_t)
+    void (*state_free)(void *state); // Run on handler_state when the request ends
+} request_context_t;
+
+// Allocate a context inside a fresh arena. A limit of 0 means the request has no body;
+// otherwise expected_size (from Content-Length, 0 if unknown) sizes the first body
+// allocation so well-behaved clients never trigger a regrow.
+request_context_t* request_context_create(size_t limit, size_t expected_size);
+
+// Append an upload chunk, growing the buffer geometrically.
+// Returns -1 and marks the request 413 if the body would exceed the limit.
+int request_context_append(request_context_t *ctx, const char *data, size_t size);
+
+void request_context_free(request_context_t *ctx);
+
+// Parse the Content-Length header; returns 0 when absent (e.g. chunked uploads)
+size_t request_content_length(struct MHD_Connection *connection);
+
+// MHD_OPTION_NOTIFY_COMPLETED callback: frees the context and releases its arena
+void request_context_completed(void *cls, struct MHD_Connection *connection,
+                               void **con_cls, enum MHD_RequestTerminationCode toe);
+
+#endif // REQUEST_CONTEXT_H
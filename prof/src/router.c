@@ -0,0 +1,220 @@
+#include "router.h"
+#include "auth/auth.h"
+#include "utils/utils.h"
+#include "utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define ROUTER_MAX_SLOTS 65536
+#define ROUTER_SEED_TRIES 4096
+
+// Exact routes indexed by hash; prefix routes are few and checked in order after a miss
+static const route_t **slots = NULL;
+static uint32_t slot_mask = 0;
+static uint32_t hash_seed = 0;
+static const route_t **prefix_routes = NULL;
+static size_t prefix_count = 0;
+static const route_t *all_routes = NULL;  // The whole table, for the Allow header after a miss
+static size_t route_count = 0;
+static router_stats_t router_stats;
+
+// Seeded FNV-1a over "METHOD path", finished with a mixer so the low bits depend on every byte
+static uint32_t route_hash(uint32_t seed, const char *method, const char *path) {
+    uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+    for (const char *p = method; *p; p++) {
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    }
+    h = (h ^ ' ') * 16777619u;
+    for (const char *p = path; *p; p++) {
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    }
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    return h;
+}
+
+// Try to place every exact route in its own slot with this seed
+static int place_routes(const route_t *routes, size_t count, const route_t **table, uint32_t mask, uint32_t seed) {
+    memset(table, 0, (mask + 1) * sizeof(*table));
+    for (size_t i = 0; i < count; i++) {
+        if (routes[i].flags & ROUTE_PREFIX) {
+            continue;
+        }
+        uint32_t slot = route_hash(seed, routes[i].method, routes[i].path) & mask;
+        if (table[slot]) {
+            return -1;
+        }
+        table[slot] = &routes[i];
+    }
+    return 0;
+}
+
+int router_init(const route_t *routes, size_t count) {
+    size_t exact = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (!routes[i].method || !routes[i].path || !routes[i].handler) {
+            fprintf(stderr, "Route %zu is incomplete\n", i);
+            return -1;
+        }
+        if (!(routes[i].flags & ROUTE_PREFIX)) {
+            exact++;
+        }
+    }
+
+    const route_t **prefixes = malloc((count - exact + 1) * sizeof(*prefixes));
+    if (!prefixes) {
+        fprintf(stderr, "Failed to allocate prefix routes\n");
+        return -1;
+    }
+    size_t prefixes_found = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (routes[i].flags & ROUTE_PREFIX) {
+            prefixes[prefixes_found++] = &routes[i];
+        }
+    }
+
+    // Start at twice as many slots as routes and grow until some seed is collision free
+    uint32_t size = 16;
+    while (size < exact * 2) {
+        size <<= 1;
+    }
+    for (; size <= ROUTER_MAX_SLOTS; size <<= 1) {
+        const route_t **table = malloc(size * sizeof(*table));
+        if (!table) {
+            break;
+        }
+        for (uint32_t seed = 1; seed <= ROUTER_SEED_TRIES; seed++) {
+            if (place_routes(routes, count, table, size - 1, seed) == 0) {
+                free(slots);
+                free(prefix_routes);
+                slots = table;
+                slot_mask = size - 1;
+                hash_seed = seed;
+                prefix_routes = prefixes;
+                prefix_count = prefixes_found;
+                all_routes = routes;
+                route_count = count;
+                router_stats.slots = size;
+                router_stats.seed = seed;
+                return 0;
+            }
+        }
+        free(table);
+    }
+
+    // Also reached when two routes share a method and path, which no seed can separate
+    fprintf(stderr, "Failed to build route table for %zu routes\n", exact);
+    free(prefixes);
+    return -1;
+}
+
+const route_t* router_lookup(const char *method, const char *path) {
+    stat_add(&router_stats.lookups, 1);
+    if (slots && method && path) {
+        const route_t *route = slots[route_hash(hash_seed, method, path) & slot_mask];
+        if (route && strcmp(route->path, path) == 0 && strcmp(route->method, method) == 0) {
+            return route;
+        }
+        for (size_t i = 0; i < prefix_count; i++) {
+            route = prefix_routes[i];
+            if (strcmp(route->method, method) == 0 && strncmp(path, route->path, strlen(route->path)) == 0) {
+                return route;
+            }
+        }
+    }
+    stat_add(&router_stats.misses, 1);
+    return NULL;
+}
+
+static int route_matches_path(const route_t *route, const char *path) {
+    if (route->flags & ROUTE_PREFIX) {
+        return strncmp(path, route->path, strlen(route->path)) == 0;
+    }
+    return strcmp(path, route->path) == 0;
+}
+
+// Only runs on a miss, so a scan of the table is fine
+size_t router_allowed_methods(const char *path, char *allow, size_t size) {
+    size_t matched = 0, used = 0;
+    allow[0] = '\0';
+    for (size_t i = 0; path && i < route_count; i++) {
+        const route_t *route = &all_routes[i];
+        if (!route_matches_path(route, path)) {
+            continue;
+        }
+        matched++;
+        int listed = 0;
+        for (size_t j = 0; j < i && !listed; j++) {
+            listed = strcmp(all_routes[j].method, route->method) == 0 && route_matches_path(&all_routes[j], path);
+        }
+        if (!listed) {
+            int n = snprintf(allow + used, size - used, "%s, ", route->method);
+            if (n < 0 || (size_t)n >= size - used) {
+                allow[used] = '\0';
+                break;
+            }
+            used += (size_t)n;
+        }
+    }
+    // Preflight is answered for every path; a list that ran out of room loses its
+    // trailing ", " rather than ending in a cut-off method
+    if (matched > 0 && size - used > strlen("OPTIONS")) {
+        strcpy(allow + used, "OPTIONS");
+    } else if (used >= 2) {
+        allow[used - 2] = '\0';
+    }
+    return matched;
+}
+
+const char* router_authenticate(struct MHD_Connection *connection, const route_t *route, arena_t *arena,
+                                char **user_id, char **username, const char **session_token) {
+    const char *token = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Authorization");
+    if (token && strncmp(token, "Bearer ", 7) == 0) {
+        token += 7; // Skip "Bearer " prefix
+    } else if (route->flags & ROUTE_QUERY_TOKEN) {
+        token = MHD_lookup_connection_value(connection, MHD_GET_ARGUMENT_KIND, "token");
+    } else {
+        token = NULL;
+    }
+
+    if (!token || token[0] == '\0') {
+        stat_add(&router_stats.auth_failures, 1);
+        return route->flags & ROUTE_QUERY_TOKEN ? "Missing session token" : "Missing or invalid Authorization header";
+    }
+    if (validate_session_token(arena, token, user_id, username) != 0) {
+        stat_add(&router_stats.auth_failures, 1);
+        return "Invalid or expired session token";
+    }
+    *session_token = token;
+    return NULL;
+}
+
+enum MHD_Result route_queue_response(route_request_t *req, unsigned int status, struct MHD_Response *response) {
+    if (req->route && (req->route->flags & ROUTE_NO_STORE)) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, "no-store");
+    }
+    return queue_response_with_cors(req->connection, status, response);
+}
+
+void router_get_stats(router_stats_t *stats) {
+    stats->lookups = __atomic_load_n(&router_stats.lookups, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&router_stats.misses, __ATOMIC_RELAXED);
+    stats->auth_failures = __atomic_load_n(&router_stats.auth_failures, __ATOMIC_RELAXED);
+    stats->slots = router_stats.slots;
+    stats->seed = router_stats.seed;
+}
+
+json_object* router_stats_to_json(void) {
+    router_stats_t stats;
+    router_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "lookups", json_object_new_int64((int64_t)stats.lookups));
+    json_object_object_add(obj, "misses", json_object_new_int64((int64_t)stats.misses));
+    json_object_object_add(obj, "auth_failures", json_object_new_int64((int64_t)stats.auth_failures));
+    json_object_object_add(obj, "slots", json_object_new_int((int)stats.slots));
+    json_object_object_add(obj, "seed", json_object_new_int((int)stats.seed));
+    return obj;
+}
@@ -0,0 +1,81 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <stddef.h>
+#include <microhttpd.h>
+#include <json-c/json.h>
+#include "utils/arena.h"
+
+// Per-route flags
+#define ROUTE_AUTH          0x01  // Needs a valid session; rejected with 401 before the handler runs
+#define ROUTE_QUERY_TOKEN   0x02  // The token may also come as ?token= (EventSource and WebSocket cannot set headers)
+#define ROUTE_NO_STORE      0x04  // Responses carry Cache-Control: no-store
+#define ROUTE_PREFIX        0x08  // Matches every path starting with `path`
+
+typedef struct route route_t;
+
+// Everything a handler needs; built by the dispatcher once the request is complete
+typedef struct {
+    struct MHD_Connection *connection;
+    const route_t *route;
+    const char *url;
+    const char *body;             // NUL-terminated POST body; NULL for bodiless requests
+    size_t body_size;
+    arena_t *arena;               // Released when the request completes
+    const char *user_id;          // Set for ROUTE_AUTH routes
+    const char *session_token;    // The token user_id was resolved from
+    const char *username;         // The user's name when the auth stage already has it, else NULL
+    void **state;                 // Survives a suspend/resume: a handler that parks the request
+                                  // finds what it stored here when MHD calls it again
+    void (**state_free)(void *state);
+} route_request_t;
+
+typedef enum MHD_Result (*route_handler_t)(route_request_t *req);
+
+struct route {
+    const char *method;
+    const char *path;
+    route_handler_t handler;
+    unsigned int flags;
+    size_t max_body;              // Largest POST body; 0 uses the server limit
+};
+
+typedef struct {
+    unsigned long lookups;
+    unsigned long misses;
+    unsigned long auth_failures;
+    unsigned int slots;           // Hash table size
+    unsigned int seed;            // Hash seed that placed every route in its own slot
+} router_stats_t;
+
+// Build the lookup table for a static route table, which must outlive the router.
+// Exact routes are placed with a perfect hash on method + path (a seed is searched for
+// until no two routes share a slot), so a lookup is one hash and one string compare
+// however many endpoints there are. Returns -1 on error.
+int router_init(const route_t *routes, size_t count);
+
+// Find the route for a request; NULL when nothing matches
+const route_t* router_lookup(const char *method, const char *path);
+
+// Room for an Allow header listing every method in the route table
+#define ROUTER_ALLOW_MAX 64
+
+// After a lookup miss: write the methods `path` does accept to `allow` as an Allow
+// header value ("GET, OPTIONS"), and return how many routes matched the path. 0 means
+// the path is unknown (404); otherwise the method was wrong (405).
+size_t router_allowed_methods(const char *path, char *allow, size_t size);
+
+// Auth middleware for ROUTE_AUTH routes: resolves the Bearer token (or ?token= for
+// ROUTE_QUERY_TOKEN routes) into *user_id (and *username when the session lookup
+// brought it along), allocated from `arena`. Returns NULL on success, otherwise the
+// message for the 401.
+const char* router_authenticate(struct MHD_Connection *connection, const route_t *route, arena_t *arena,
+                                char **user_id, char **username, const char **session_token);
+
+// Queue a handler's response with CORS headers and the route's cache policy
+enum MHD_Result route_queue_response(route_request_t *req, unsigned int status, struct MHD_Response *response);
+
+void router_get_stats(router_stats_t *stats);
+json_object* router_stats_to_json(void);
+
+#endif // ROUTER_H
@@ -0,0 +1,569 @@
+#define _GNU_SOURCE
+#include "alt.h"
+#include "cell_search.h"
+#include "cost_map.h"
+#include "../api.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ALT_INITIAL_SLOTS 1024       // Visited-table slots to start with; doubles at half full
+#define ALT_BOUND_SLACK 1e-6         // Relative; absorbs float rounding in stored distances so bounds stay below the truth
+#define ALT_NO_INDEX UINT32_MAX
+
+typedef struct {
+    void *base;
+    size_t size;
+    const alt_header_t *header;
+    const uint64_t *cells;
+    const uint64_t *landmarks;
+    const float *km;
+} alt_table_t;
+
+static alt_table_t table;
+static int table_loaded = 0;
+static alt_stats_t alt_stats;
+
+// Cell reached by either direction; index 0 is the forward search from the start,
+// 1 the backward search from the end
+typedef struct {
+    H3Index cell;                     // Key, as cell_table_t wants it
+    H3Index parent[2];
+    double g[2];
+    int closed[2];
+    double lat, lng;                  // Radians
+    float weight;
+    double potential;                 // Forward key offset; the backward search uses its negation
+} alt_node_t;
+
+// What every potential needs: the two ends and their landmark rows
+typedef struct {
+    const float *start_row;
+    const float *end_row;
+    LatLng start;
+    LatLng end;
+    double h_scale;
+    uint32_t landmarks;
+} alt_ends_t;
+
+// Cost between neighbouring cells. The table builder and the search both use this, so
+// landmark distances are exact for the graph being searched.
+static inline double edge_km(double lat1, double lng1, double w1, double lat2, double lng2, double w2) {
+    return cell_great_circle_km(lat1, lng1, lat2, lng2) * (w1 + w2) / 2;
+}
+
+// Position of `cell` in a sorted array, or ALT_NO_INDEX
+static uint32_t find_cell(const uint64_t *cells, uint64_t count, H3Index cell) {
+    size_t i = cell_index(cells, (size_t)count, cell);
+    return i < count ? (uint32_t)i : ALT_NO_INDEX;
+}
+
+// Best triangle-inequality bound between two cells from their landmark rows. A landmark
+// that cannot reach one of them says nothing.
+static double landmark_bound(const float *a, const float *b, uint32_t landmarks) {
+    double best = 0;
+    for (uint32_t i = 0; i < landmarks; i++) {
+        double x = a[i], y = b[i];
+        if (isinf(x) || isinf(y)) {
+            continue;
+        }
+        double bound = fabs(x - y) - ALT_BOUND_SLACK * (x + y);
+        if (bound > best) {
+            best = bound;
+        }
+    }
+    return best;
+}
+
+int alt_load(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Landmark table %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(alt_header_t)) {
+        fprintf(stderr, "Landmark table %s is too short\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Landmark table %s: mmap failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const alt_header_t *header = base;
+    uint64_t count = header->cell_count;
+    uint32_t landmarks = header->landmark_count;
+    size_t row = sizeof(uint64_t) + landmarks * sizeof(float);
+    if (memcmp(header->magic, ALT_MAGIC, sizeof(header->magic)) != 0 || header->version != ALT_VERSION ||
+        header->resolution > 15 || landmarks == 0 || landmarks > ALT_MAX_LANDMARKS ||
+        count > (size - sizeof(*header)) / row ||
+        size != sizeof(*header) + landmarks * sizeof(uint64_t) + count * row) {
+        fprintf(stderr, "Landmark table %s is not a version %d landmark table\n", path, ALT_VERSION);
+        munmap(base, size);
+        return -1;
+    }
+
+    cost_map_stats_t costs;
+    cost_map_get_stats(&costs);
+    if (header->cost_map_cells != costs.cells || header->cost_map_min != costs.min_cost ||
+        header->cost_map_default != costs.default_cost) {
+        fprintf(stderr, "Landmark table %s was built over a different cost map\n", path);
+        munmap(base, size);
+        return -1;
+    }
+
+    alt_table_t loaded;
+    loaded.base = base;
+    loaded.size = size;
+    loaded.header = header;
+    loaded.cells = (const uint64_t *)(header + 1);
+    loaded.landmarks = loaded.cells + count;
+    loaded.km = (const float *)(loaded.landmarks + landmarks);
+    for (uint64_t i = 1; i < count; i++) {
+        if (loaded.cells[i - 1] >= loaded.cells[i]) {
+            fprintf(stderr, "Landmark table %s is corrupt\n", path);
+            munmap(base, size);
+            return -1;
+        }
+    }
+    madvise(base, size, MADV_RANDOM);
+
+    alt_unload();
+    table = loaded;
+    table_loaded = 1;
+    printf("Landmark table %s: %llu cells at resolution %u, %u landmarks\n", path, (unsigned long long)count,
+           header->resolution, landmarks);
+    return 0;
+}
+
+int alt_loaded(void) {
+    return table_loaded;
+}
+
+void alt_unload(void) {
+    if (table_loaded) {
+        munmap(table.base, table.size);
+        memset(&table, 0, sizeof(table));
+        table_loaded = 0;
+    }
+}
+
+// Find or add `cell`, which sits at `index` in the table. A new node is unreached in
+// both directions and gets its potential: half the difference between its lower bound
+// to the end and from the start, which keeps both directions' keys consistent.
+static alt_node_t* nodes_upsert(cell_table_t *nodes, H3Index cell, uint32_t index, const alt_ends_t *ends) {
+    int added;
+    alt_node_t *node = cell_table_upsert(nodes, cell, &added);
+    if (!node || !added) {
+        return node;
+    }
+    node->g[0] = node->g[1] = INFINITY;
+    LatLng center;
+    cellToLatLng(cell, &center);
+    node->lat = center.lat;
+    node->lng = center.lng;
+    node->weight = cost_map_lookup(cell);
+
+    const float *row = table.km + (size_t)index * ends->landmarks;
+    double to_end = ends->h_scale * cell_great_circle_km(center.lat, center.lng, ends->end.lat, ends->end.lng);
+    double bound = landmark_bound(row, ends->end_row, ends->landmarks);
+    if (bound > to_end) {
+        to_end = bound;
+    }
+    double from_start = ends->h_scale * cell_great_circle_km(ends->start.lat, ends->start.lng,
+                                                             center.lat, center.lng);
+    bound = landmark_bound(ends->start_row, row, ends->landmarks);
+    if (bound > from_start) {
+        from_start = bound;
+    }
+    node->potential = (to_end - from_start) / 2;
+    return node;
+}
+
+// start ... meet ... end, joining the two parent chains at `meet`
+static int build_path(arena_t *arena, const cell_table_t *nodes, H3Index meet, H3Index **path) {
+    size_t forward_parent = offsetof(alt_node_t, parent);
+    size_t backward_parent = forward_parent + sizeof(H3Index);
+    size_t forward = cell_table_chain(nodes, meet, forward_parent, NULL);
+    size_t backward = cell_table_chain(nodes, meet, backward_parent, NULL) - 1;
+    *path = arena_alloc(arena, (forward + backward) * sizeof(H3Index));
+    if (!*path) {
+        return ALT_NO_MEMORY;
+    }
+    // The forward chain runs meet ... start; turn it round, then append meet ... end over meet
+    cell_table_chain(nodes, meet, forward_parent, *path);
+    for (size_t i = 0; i < forward / 2; i++) {
+        H3Index cell = (*path)[i];
+        (*path)[i] = (*path)[forward - 1 - i];
+        (*path)[forward - 1 - i] = cell;
+    }
+    cell_table_chain(nodes, meet, backward_parent, *path + forward - 1);
+    return (int)(forward + backward);
+}
+
+int alt_h3_path(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                H3Index **path, astar_search_t *search) {
+    astar_search_t local;
+    if (!search) {
+        search = &local;
+    }
+    memset(search, 0, sizeof(*search));
+    *path = NULL;
+    if (!isValidCell(start) || !isValidCell(end) || getResolution(start) != getResolution(end)) {
+        return ALT_NO_PATH;
+    }
+    uint32_t start_index = ALT_NO_INDEX, end_index = ALT_NO_INDEX;
+    if (table_loaded && (uint32_t)getResolution(start) == table.header->resolution) {
+        start_index = find_cell(table.cells, table.header->cell_count, start);
+        end_index = find_cell(table.cells, table.header->cell_count, end);
+    }
+    if (start_index == ALT_NO_INDEX || end_index == ALT_NO_INDEX) {
+        stat_add(&alt_stats.not_covered, 1);
+        return ALT_NOT_COVERED;
+    }
+    if (max_expansions == 0) {
+        max_expansions = ASTAR_MAX_EXPANSIONS;
+    }
+    stat_add(&alt_stats.searches, 1);
+
+    alt_ends_t ends;
+    ends.landmarks = table.header->landmark_count;
+    ends.start_row = table.km + (size_t)start_index * ends.landmarks;
+    ends.end_row = table.km + (size_t)end_index * ends.landmarks;
+    cellToLatLng(start, &ends.start);
+    cellToLatLng(end, &ends.end);
+    ends.h_scale = cost_map_min_cost();
+
+    cell_table_t nodes;
+    cell_heap_t heaps[2] = { CELL_HEAP_INIT, CELL_HEAP_INIT };
+    if (cell_table_init(&nodes, sizeof(alt_node_t), ALT_INITIAL_SLOTS) != 0) {
+        return ALT_NO_MEMORY;
+    }
+    int result = ALT_NO_MEMORY;
+    alt_node_t *first = nodes_upsert(&nodes, start, start_index, &ends);
+    if (!first) {
+        goto done;
+    }
+    first->g[0] = 0;
+    double start_potential = first->potential;
+    alt_node_t *last = nodes_upsert(&nodes, end, end_index, &ends);
+    if (!last) {
+        goto done;
+    }
+    last->g[1] = 0;
+    if (cell_heap_push(&heaps[0], start_potential, 0, start) != 0 ||
+        cell_heap_push(&heaps[1], -last->potential, 0, end) != 0) {
+        goto done;
+    }
+    search->pushed = 2;
+
+    // Best start-to-end cost through a cell both directions have reached. With consistent
+    // potentials it is optimal once the two heads' keys add up to at least it.
+    double best = start == end ? 0 : INFINITY;
+    H3Index meet = start == end ? start : 0;
+    result = ALT_NO_PATH;
+    while (heaps[0].size > 0 && heaps[1].size > 0 && heaps[0].entries[0].key + heaps[1].entries[0].key < best) {
+        int side = heaps[0].entries[0].key <= heaps[1].entries[0].key ? 0 : 1;
+        cell_heap_entry_t top = cell_heap_pop(&heaps[side]);
+        alt_node_t *current = cell_table_find(&nodes, top.cell);
+        if (current->closed[side] || top.g > current->g[side]) {
+            continue; // Stale
+        }
+        if (search->expanded >= max_expansions) {
+            result = ALT_BUDGET_EXCEEDED;
+            goto done;
+        }
+        current->closed[side] = 1;
+        search->expanded++;
+
+        // Inserting neighbours may grow the table and move `current`
+        H3Index cell = current->cell;
+        double g = current->g[side], lat = current->lat, lng = current->lng, weight = current->weight;
+        H3Index neighbours[7] = { 0 };
+        if (gridDisk(cell, 1, neighbours) != E_SUCCESS) {
+            continue;
+        }
+        for (int i = 0; i < 7; i++) {
+            if (neighbours[i] == 0 || neighbours[i] == cell) {
+                continue;
+            }
+            // Impassable cells and cells past the region are not in the table
+            uint32_t index = find_cell(table.cells, table.header->cell_count, neighbours[i]);
+            if (index == ALT_NO_INDEX) {
+                continue;
+            }
+            alt_node_t *next = nodes_upsert(&nodes, neighbours[i], index, &ends);
+            if (!next) {
+                result = ALT_NO_MEMORY;
+                goto done;
+            }
+            if (next->closed[side]) {
+                continue;
+            }
+            double tentative = g + edge_km(lat, lng, weight, next->lat, next->lng, next->weight);
+            if (tentative < next->g[side]) {
+                next->g[side] = tentative;
+                next->parent[side] = cell;
+                double key = tentative + (side == 0 ? next->potential : -next->potential);
+                if (cell_heap_push(&heaps[side], key, tentative, neighbours[i]) != 0) {
+                    result = ALT_NO_MEMORY;
+                    goto done;
+                }
+                search->pushed++;
+            }
+            if (next->g[0] + next->g[1] < best) {
+                best = next->g[0] + next->g[1];
+                meet = next->cell;
+            }
+        }
+    }
+    if (meet != 0) {
+        search->cost_km = best;
+        result = build_path(arena, &nodes, meet, path);
+    }
+
+done:
+    stat_add(&alt_stats.expanded, search->expanded);
+    if (result > 0) {
+        stat_add(&alt_stats.found, 1);
+    } else if (result == ALT_BUDGET_EXCEEDED) {
+        stat_add(&alt_stats.budget_exceeded, 1);
+    }
+    cell_table_free(&nodes);
+    cell_heap_free(&heaps[0]);
+    cell_heap_free(&heaps[1]);
+    return result;
+}
+
+// Region being tabled: sorted cells, their centers and weights, and six neighbour
+// indices each (ALT_NO_INDEX where a neighbour is missing or outside)
+typedef struct {
+    H3Index *cells;
+    uint32_t count;
+    double *lat;
+    double *lng;
+    float *weight;
+    uint32_t *neighbours;
+    cell_heap_t heap;                 // Keyed by distance, with region indices for cells
+} region_t;
+
+// Exact cost from `source` to every cell of the region; -1 when out of memory
+static int region_dijkstra(region_t *region, uint32_t source, double *dist) {
+    for (uint32_t i = 0; i < region->count; i++) {
+        dist[i] = INFINITY;
+    }
+    dist[source] = 0;
+    region->heap.size = 0;
+    if (cell_heap_push(&region->heap, 0, 0, source) != 0) {
+        return -1;
+    }
+    while (region->heap.size > 0) {
+        cell_heap_entry_t top = cell_heap_pop(&region->heap);
+        uint32_t u = (uint32_t)top.cell;
+        if (top.key > dist[u]) {
+            continue;
+        }
+        for (int k = 0; k < 6; k++) {
+            uint32_t v = region->neighbours[(size_t)u * 6 + k];
+            if (v == ALT_NO_INDEX) {
+                continue;
+            }
+            double tentative = top.key + edge_km(region->lat[u], region->lng[u], region->weight[u],
+                                                  region->lat[v], region->lng[v], region->weight[v]);
+            if (tentative < dist[v]) {
+                dist[v] = tentative;
+                if (cell_heap_push(&region->heap, tentative, 0, v) != 0) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int alt_build_table(const char *path, H3Index center, int k, int landmarks) {
+    if (!isValidCell(center) || k < 0 || landmarks < 1 || landmarks > ALT_MAX_LANDMARKS) {
+        fprintf(stderr, "Landmark table needs a valid center, k >= 0 and 1 to %d landmarks\n", ALT_MAX_LANDMARKS);
+        return -1;
+    }
+    int64_t disk_size;
+    if (maxGridDiskSize(k, &disk_size) != E_SUCCESS || disk_size > UINT32_MAX / 6) {
+        fprintf(stderr, "Landmark region of %d rings is too large\n", k);
+        return -1;
+    }
+
+    region_t region;
+    memset(&region, 0, sizeof(region));
+    double *dist = NULL, *nearest = NULL;
+    float *km = NULL;
+    H3Index chosen[ALT_MAX_LANDMARKS];
+    int result = -1;
+    region.cells = calloc((size_t)disk_size, sizeof(H3Index));
+    if (!region.cells || gridDisk(center, k, region.cells) != E_SUCCESS) {
+        fprintf(stderr, "Could not list the %d rings around the landmark center\n", k);
+        goto done;
+    }
+    for (int64_t i = 0; i < disk_size; i++) {
+        if (region.cells[i] != 0 && !isinf(cost_map_lookup(region.cells[i]))) {
+            region.cells[region.count++] = region.cells[i];
+        }
+    }
+    qsort(region.cells, region.count, sizeof(H3Index), cell_compare);
+    if (region.count < (uint32_t)landmarks) {
+        fprintf(stderr, "Landmark region has only %u passable cells\n", region.count);
+        goto done;
+    }
+
+    size_t n = region.count;
+    region.lat = malloc(n * sizeof(double));
+    region.lng = malloc(n * sizeof(double));
+    region.weight = malloc(n * sizeof(float));
+    region.neighbours = malloc(n * 6 * sizeof(uint32_t));
+    dist = malloc(n * sizeof(double));
+    nearest = malloc(n * sizeof(double));
+    km = malloc(n * (size_t)landmarks * sizeof(float));
+    if (!region.lat || !region.lng || !region.weight || !region.neighbours || !dist || !nearest || !km) {
+        fprintf(stderr, "Out of memory for %zu landmark cells\n", n);
+        goto done;
+    }
+    for (size_t i = 0; i < n; i++) {
+        LatLng c;
+        cellToLatLng(region.cells[i], &c);
+        region.lat[i] = c.lat;
+        region.lng[i] = c.lng;
+        region.weight[i] = cost_map_lookup(region.cells[i]);
+        H3Index around[7] = { 0 };
+        gridDisk(region.cells[i], 1, around);
+        int filled = 0;
+        for (int j = 0; j < 7; j++) {
+            if (around[j] != 0 && around[j] != region.cells[i]) {
+                region.neighbours[i * 6 + filled++] = find_cell(region.cells, n, around[j]);
+            }
+        }
+        while (filled < 6) {
+            region.neighbours[i * 6 + filled++] = ALT_NO_INDEX; // Pentagon
+        }
+    }
+
+    // Farthest-first: start from the cell farthest from the center, then repeatedly
+    // take the cell farthest from every landmark chosen so far. Landmarks end up on the
+    // region's rim, "behind" most start-end pairs, where their bounds are tightest.
+    uint32_t origin = find_cell(region.cells, n, center);
+    if (region_dijkstra(&region, origin == ALT_NO_INDEX ? 0 : origin, dist) != 0) {
+        fprintf(stderr, "Out of memory for %zu landmark cells\n", n);
+        goto done;
+    }
+    uint32_t next = 0;
+    for (size_t i = 0; i < n; i++) {
+        nearest[i] = INFINITY;
+        if (!isinf(dist[i]) && dist[i] > dist[next]) {
+            next = (uint32_t)i;
+        }
+    }
+    for (int l = 0; l < landmarks; l++) {
+        chosen[l] = region.cells[next];
+        if (region_dijkstra(&region, next, dist) != 0) {
+            fprintf(stderr, "Out of memory for %zu landmark cells\n", n);
+            goto done;
+        }
+        for (size_t i = 0; i < n; i++) {
+            km[i * landmarks + l] = (float)dist[i];
+            if (dist[i] < nearest[i]) {
+                nearest[i] = dist[i];
+            }
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (!isinf(nearest[i]) && (isinf(nearest[next]) || nearest[i] > nearest[next])) {
+                next = (uint32_t)i;
+            }
+        }
+    }
+
+    alt_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ALT_MAGIC, sizeof(header.magic));
+    header.version = ALT_VERSION;
+    header.resolution = (uint32_t)getResolution(center);
+    header.landmark_count = (uint32_t)landmarks;
+    header.cell_count = n;
+    cost_map_stats_t costs;
+    cost_map_get_stats(&costs);
+    header.cost_map_cells = costs.cells;
+    header.cost_map_min = costs.min_cost;
+    header.cost_map_default = costs.default_cost;
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Landmark table %s: %s\n", path, strerror(errno));
+        goto done;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+             fwrite(region.cells, sizeof(H3Index), n, f) == n &&
+             fwrite(chosen, sizeof(H3Index), (size_t)landmarks, f) == (size_t)landmarks &&
+             fwrite(km, sizeof(float) * landmarks, n, f) == n;
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write landmark table %s\n", path);
+        goto done;
+    }
+    result = 0;
+
+done:
+    free(region.cells);
+    free(region.lat);
+    free(region.lng);
+    free(region.weight);
+    free(region.neighbours);
+    cell_heap_free(&region.heap);
+    free(dist);
+    free(nearest);
+    free(km);
+    return result;
+}
+
+void alt_get_stats(alt_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (table_loaded) {
+        stats->loaded = 1;
+        stats->cells = (unsigned long)table.header->cell_count;
+        stats->landmarks = table.header->landmark_count;
+        stats->resolution = (int)table.header->resolution;
+        stats->file_size = table.size;
+    }
+    stats->searches = __atomic_load_n(&alt_stats.searches, __ATOMIC_RELAXED);
+    stats->found = __atomic_load_n(&alt_stats.found, __ATOMIC_RELAXED);
+    stats->not_covered = __atomic_load_n(&alt_stats.not_covered, __ATOMIC_RELAXED);
+    stats->budget_exceeded = __atomic_load_n(&alt_stats.budget_exceeded, __ATOMIC_RELAXED);
+    stats->expanded = __atomic_load_n(&alt_stats.expanded, __ATOMIC_RELAXED);
+}
+
+json_object* alt_stats_to_json(void) {
+    alt_stats_t stats;
+    alt_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "loaded", json_object_new_boolean(stats.loaded));
+    json_object_object_add(obj, "cells", json_object_new_int64((int64_t)stats.cells));
+    json_object_object_add(obj, "landmarks", json_object_new_int((int)stats.landmarks));
+    json_object_object_add(obj, "resolution", json_object_new_int(stats.resolution));
+    json_object_object_add(obj, "file_bytes", json_object_new_int64((int64_t)stats.file_size));
+    json_object_object_add(obj, "searches", json_object_new_int64((int64_t)stats.searches));
+    json_object_object_add(obj, "found", json_object_new_int64((int64_t)stats.found));
+    json_object_object_add(obj, "not_covered", json_object_new_int64((int64_t)stats.not_covered));
+    json_object_object_add(obj, "budget_exceeded", json_object_new_int64((int64_t)stats.budget_exceeded));
+    json_object_object_add(obj, "expanded", json_object_new_int64((int64_t)stats.expanded));
+    return obj;
+}
@@ -0,0 +1,81 @@
+#ifndef ALT_H
+#define ALT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <h3/h3api.h>
+#include <json-c/json.h>
+#include "astar.h"
+#include "../utils/arena.h"
+
+// Bidirectional A* over the H3 grid with ALT (A*, Landmarks, Triangle inequality)
+// lower bounds. For a handful of landmark cells the exact cost to every cell of a
+// region is computed offline. Then d(v, t) >= |d(L, t) - d(L, v)| for any landmark L,
+// which is much tighter than the straight-line bound on grids with costly or
+// impassable areas, and both search directions use it.
+//
+// The table covers one region (a gridDisk at one resolution) and is mapped read-only:
+//   alt_header_t | uint64_t cells[cell_count] (sorted) | uint64_t landmarks[landmark_count]
+//   | float km[cell_count][landmark_count]
+// Distances are measured the way the search measures them: neighbouring cells cost
+// the great-circle distance between centers times their mean cost_map weight, and
+// impassable cells are left out of the region. A table is only valid for the cost map
+// it was computed with, so the header records that map's shape and loading checks it.
+// Paths never leave the region: build it with a margin around the area served, or a
+// detour around an obstacle near the rim is missed.
+#define ALT_MAGIC "GEOALT01"
+#define ALT_VERSION 1
+#define ALT_MAX_LANDMARKS 16
+
+#define ALT_NO_PATH -1                // Same codes as astar.h, plus:
+#define ALT_BUDGET_EXCEEDED -2
+#define ALT_NO_MEMORY -3
+#define ALT_NOT_COVERED -4            // No table, or start or end outside it
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t resolution;
+    uint32_t landmark_count;
+    uint32_t reserved0;
+    uint64_t cell_count;
+    uint64_t cost_map_cells;          // cost_map_get_stats() when built; 0, 1, 1 without a map
+    float cost_map_min;
+    float cost_map_default;
+    uint8_t reserved[16];
+} alt_header_t;
+
+typedef struct {
+    int loaded;
+    unsigned long cells;
+    unsigned int landmarks;
+    int resolution;
+    size_t file_size;
+    unsigned long searches;
+    unsigned long found;
+    unsigned long not_covered;
+    unsigned long budget_exceeded;
+    unsigned long expanded;           // Summed over both directions of all searches
+} alt_stats_t;
+
+// Map a landmark table and make it the one searches use. Load the cost map first: a
+// table built over a different map is refused. Returns -1 (keeping any previous table)
+// on failure.
+int alt_load(const char *path);
+int alt_loaded(void);
+void alt_unload(void);
+
+// Shortest path from `start` to `end` inside the table's region, same cost model and
+// result conventions as astar_h3_path(); search->expanded counts both directions.
+// ALT_NOT_COVERED when either cell is outside the region or no table is loaded.
+int alt_h3_path(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                H3Index **path, astar_search_t *search);
+
+// Offline: the gridDisk of `k` rings around `center`, with `landmarks` landmarks picked
+// farthest-first over the currently loaded cost map, written to `path`
+int alt_build_table(const char *path, H3Index center, int k, int landmarks);
+
+void alt_get_stats(alt_stats_t *stats);
+json_object* alt_stats_to_json(void);
+
+#endif // ALT_H
@@ -0,0 +1,202 @@
+#include "astar.h"
+#include "cell_search.h"
+#include "cost_map.h"
+#include "../api.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define ASTAR_INITIAL_SLOTS 1024     // Visited-table slots to start with; doubles at half full
+
+// Visited cell: best known cost from the start and where it came from. The center and
+// the cost-map weight are kept so each cell is converted with cellToLatLng() and looked
+// up in the cost map once, not once per edge.
+typedef struct {
+    H3Index cell;                     // Key, as cell_table_t wants it
+    H3Index parent;
+    double g;
+    double lat, lng;                  // Radians
+    float weight;                     // cost_map_lookup(); INFINITY for impassable cells
+    int closed;
+} visited_t;
+
+static astar_stats_t astar_stats;
+
+// Find or add `cell`; a new entry starts with an infinite cost. NULL when out of memory.
+static visited_t* visited_upsert(cell_table_t *table, H3Index cell) {
+    int added;
+    visited_t *entry = cell_table_upsert(table, cell, &added);
+    if (entry && added) {
+        entry->g = INFINITY;
+        LatLng center;
+        cellToLatLng(cell, &center);
+        entry->lat = center.lat;
+        entry->lng = center.lng;
+        entry->weight = cost_map_lookup(cell);
+    }
+    return entry;
+}
+
+// Walk the parent links back from `end` into a start-first array
+static int build_path(arena_t *arena, const cell_table_t *table, H3Index end, H3Index **path) {
+    size_t length = cell_table_chain(table, end, offsetof(visited_t, parent), NULL);
+    *path = arena_alloc(arena, length * sizeof(H3Index));
+    if (!*path) {
+        return ASTAR_NO_MEMORY;
+    }
+    cell_table_chain(table, end, offsetof(visited_t, parent), *path);
+    for (size_t i = 0; i < length / 2; i++) {
+        H3Index cell = (*path)[i];
+        (*path)[i] = (*path)[length - 1 - i];
+        (*path)[length - 1 - i] = cell;
+    }
+    return (int)length;
+}
+
+static int in_corridor(const astar_corridor_t *corridor, H3Index cell) {
+    H3Index key = cell;
+    if (getResolution(cell) > corridor->res && cellToParent(cell, corridor->res, &key) != E_SUCCESS) {
+        return 0;
+    }
+    return cell_index(corridor->cells, corridor->count, key) < corridor->count;
+}
+
+int astar_h3_path(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                  H3Index **path, astar_search_t *search) {
+    return astar_h3_path_within(arena, start, end, max_expansions, NULL, path, search);
+}
+
+int astar_h3_path_within(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                         const astar_corridor_t *corridor, H3Index **path, astar_search_t *search) {
+    astar_search_t local;
+    if (!search) {
+        search = &local;
+    }
+    memset(search, 0, sizeof(*search));
+    *path = NULL;
+    if (!isValidCell(start) || !isValidCell(end) || getResolution(start) != getResolution(end)) {
+        return ASTAR_NO_PATH;
+    }
+    if (max_expansions == 0) {
+        max_expansions = ASTAR_MAX_EXPANSIONS;
+    }
+    stat_add(&astar_stats.searches, 1);
+
+    cell_table_t table;
+    cell_heap_t heap = CELL_HEAP_INIT;
+    if (cell_table_init(&table, sizeof(visited_t), ASTAR_INITIAL_SLOTS) != 0) {
+        return ASTAR_NO_MEMORY;
+    }
+
+    int result = ASTAR_NO_MEMORY;
+    LatLng goal;
+    cellToLatLng(end, &goal);
+    // No edge is cheaper per km than the smallest weight, so the scaled distance never overestimates
+    double h_scale = cost_map_min_cost();
+    visited_t *first = visited_upsert(&table, start);
+    if (!first) {
+        goto done;
+    }
+    first->g = 0;
+    if (cell_heap_push(&heap, h_scale * cell_great_circle_km(first->lat, first->lng, goal.lat, goal.lng), 0,
+                       start) != 0) {
+        goto done;
+    }
+    search->pushed++;
+
+    result = ASTAR_NO_PATH;
+    while (heap.size > 0) {
+        cell_heap_entry_t top = cell_heap_pop(&heap);
+        visited_t *current = cell_table_find(&table, top.cell);
+        if (current->closed || top.g > current->g) {
+            continue; // Stale: the cell was reached more cheaply after this entry was pushed
+        }
+        if (top.cell == end) {
+            search->cost_km = current->g;
+            result = build_path(arena, &table, end, path);
+            break;
+        }
+        if (search->expanded >= max_expansions) {
+            result = ASTAR_BUDGET_EXCEEDED;
+            break;
+        }
+        current->closed = 1;
+        search->expanded++;
+
+        // Copy what is needed: inserting neighbours may grow the table and move `current`
+        H3Index cell = current->cell;
+        double g = current->g, lat = current->lat, lng = current->lng, weight = current->weight;
+        H3Index neighbours[7] = { 0 };
+        if (gridDisk(cell, 1, neighbours) != E_SUCCESS) {
+            continue;
+        }
+        for (int i = 0; i < 7; i++) {
+            if (neighbours[i] == 0 || neighbours[i] == cell) {
+                continue; // Pentagons have five neighbours
+            }
+            if (corridor && !in_corridor(corridor, neighbours[i])) {
+                continue;
+            }
+            visited_t *next = visited_upsert(&table, neighbours[i]);
+            if (!next) {
+                result = ASTAR_NO_MEMORY;
+                goto done;
+            }
+            if (next->closed || (isinf(next->weight) && neighbours[i] != end)) {
+                continue;
+            }
+            // An edge's length is split between the two cells it crosses. The start or the
+            // goal may sit in an impassable cell; its half then costs like the other half.
+            double from = isinf(weight) ? next->weight : weight;
+            double to = isinf(next->weight) ? from : next->weight;
+            if (isinf(from)) {
+                from = to = h_scale;
+            }
+            double tentative = g + cell_great_circle_km(lat, lng, next->lat, next->lng) * (from + to) / 2;
+            if (tentative >= next->g) {
+                continue;
+            }
+            next->g = tentative;
+            next->parent = cell;
+            double f = tentative + h_scale * cell_great_circle_km(next->lat, next->lng, goal.lat, goal.lng);
+            if (cell_heap_push(&heap, f, tentative, neighbours[i]) != 0) {
+                result = ASTAR_NO_MEMORY;
+                goto done;
+            }
+            search->pushed++;
+        }
+    }
+
+done:
+    stat_add(&astar_stats.expanded, search->expanded);
+    if (result > 0) {
+        stat_add(&astar_stats.found, 1);
+    } else if (result == ASTAR_BUDGET_EXCEEDED) {
+        stat_add(&astar_stats.budget_exceeded, 1);
+    }
+    cell_table_free(&table);
+    cell_heap_free(&heap);
+    return result;
+}
+
+void astar_get_stats(astar_stats_t *stats) {
+    stats->searches = __atomic_load_n(&astar_stats.searches, __ATOMIC_RELAXED);
+    stats->found = __atomic_load_n(&astar_stats.found, __ATOMIC_RELAXED);
+    stats->budget_exceeded = __atomic_load_n(&astar_stats.budget_exceeded, __ATOMIC_RELAXED);
+    stats->expanded = __atomic_load_n(&astar_stats.expanded, __ATOMIC_RELAXED);
+}
+
+json_object* astar_stats_to_json(void) {
+    astar_stats_t stats;
+    astar_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "searches", json_object_new_int64((int64_t)stats.searches));
+    json_object_object_add(obj, "found", json_object_new_int64((int64_t)stats.found));
+    json_object_object_add(obj, "budget_exceeded", json_object_new_int64((int64_t)stats.budget_exceeded));
+    json_object_object_add(obj, "expanded", json_object_new_int64((int64_t)stats.expanded));
+    json_object_object_add(obj, "max_expansions", json_object_new_int(ASTAR_MAX_EXPANSIONS));
+    return obj;
+}
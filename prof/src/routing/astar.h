@@ -0,0 +1,54 @@
+#ifndef ASTAR_H
+#define ASTAR_H
+
+#include <stddef.h>
+#include <h3/h3api.h>
+#include <json-c/json.h>
+#include "../utils/arena.h"
+
+#define ASTAR_NO_PATH -1          // Cells invalid, of different resolutions, or unreachable
+#define ASTAR_BUDGET_EXCEEDED -2  // Gave up after max_expansions cells
+#define ASTAR_NO_MEMORY -3
+
+// What one search did
+typedef struct {
+    size_t expanded;              // Cells taken off the open set and whose neighbours were scored
+    size_t pushed;                // Heap insertions, counting stale entries left by lazy deletion
+    double cost_km;               // Cost of the path found: center-to-center km, weighted by the cost map
+} astar_search_t;
+
+typedef struct {
+    unsigned long searches;
+    unsigned long found;
+    unsigned long budget_exceeded;
+    unsigned long expanded;       // Summed over all searches
+} astar_stats_t;
+
+// A* over the H3 grid from `start` to `end` (same resolution), stepping to the six
+// gridDisk(cell, 1) neighbours. Edges cost the great-circle distance between cell
+// centers, times the mean cost_map weight of the two cells when a cost map is loaded
+// (impassable cells are never entered). The heuristic is the great-circle distance to
+// `end` scaled by the smallest weight, which never overestimates, so the path is the
+// cheapest center-to-center chain. At most `max_expansions` cells are expanded (0 =
+// ASTAR_MAX_EXPANSIONS). On success *path (start first, end last) is allocated from
+// `arena` (the heap when NULL) and the number of cells is returned; otherwise one of
+// the ASTAR_* codes. `search` may be NULL.
+int astar_h3_path(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                  H3Index **path, astar_search_t *search);
+
+// Cells a search may enter: those whose ancestor at `res` is in `cells` (sorted, no
+// duplicates). Lets a coarse route bound a fine search; see hier_path.h.
+typedef struct {
+    const H3Index *cells;
+    size_t count;
+    int res;
+} astar_corridor_t;
+
+// astar_h3_path() confined to `corridor` (everywhere when NULL). Start and end must lie in it.
+int astar_h3_path_within(arena_t *arena, H3Index start, H3Index end, size_t max_expansions,
+                         const astar_corridor_t *corridor, H3Index **path, astar_search_t *search);
+
+void astar_get_stats(astar_stats_t *stats);
+json_object* astar_stats_to_json(void);
+
+#endif // ASTAR_H
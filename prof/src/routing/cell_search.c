@@ -0,0 +1,189 @@
+#include "cell_search.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define EARTH_RADIUS_KM 6371.0
+#define CELL_HEAP_INITIAL 256
+
+double cell_great_circle_km(double lat1, double lng1, double lat2, double lng2) {
+    double s_lat = sin((lat2 - lat1) / 2);
+    double s_lng = sin((lng2 - lng1) / 2);
+    double a = s_lat * s_lat + cos(lat1) * cos(lat2) * s_lng * s_lng;
+    return 2 * EARTH_RADIUS_KM * atan2(sqrt(a), sqrt(1 - a));
+}
+
+int cell_compare(const void *a, const void *b) {
+    H3Index x = *(const H3Index *)a, y = *(const H3Index *)b;
+    return (x > y) - (x < y);
+}
+
+size_t cell_index(const H3Index *cells, size_t count, H3Index cell) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cells[mid] < cell) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo < count && cells[lo] == cell ? lo : count;
+}
+
+static inline size_t hash_cell(H3Index cell) {
+    uint64_t h = cell;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return (size_t)h;
+}
+
+static inline H3Index slot_cell(const cell_table_t *table, size_t i) {
+    H3Index cell;
+    memcpy(&cell, table->slots + i * table->entry_size, sizeof(cell));
+    return cell;
+}
+
+int cell_table_init(cell_table_t *table, size_t entry_size, size_t slots) {
+    table->slots = calloc(slots, entry_size);
+    table->entry_size = entry_size;
+    table->mask = slots - 1;
+    table->count = 0;
+    return table->slots ? 0 : -1;
+}
+
+void cell_table_free(cell_table_t *table) {
+    free(table->slots);
+    table->slots = NULL;
+    table->count = 0;
+}
+
+void* cell_table_find(const cell_table_t *table, H3Index cell) {
+    size_t i = hash_cell(cell) & table->mask;
+    H3Index found;
+    while ((found = slot_cell(table, i)) != 0) {
+        if (found == cell) {
+            return table->slots + i * table->entry_size;
+        }
+        i = (i + 1) & table->mask;
+    }
+    return NULL;
+}
+
+static int cell_table_grow(cell_table_t *table) {
+    cell_table_t bigger;
+    if (cell_table_init(&bigger, table->entry_size, (table->mask + 1) * 2) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i <= table->mask; i++) {
+        H3Index cell = slot_cell(table, i);
+        if (cell == 0) {
+            continue;
+        }
+        size_t j = hash_cell(cell) & bigger.mask;
+        while (slot_cell(&bigger, j) != 0) {
+            j = (j + 1) & bigger.mask;
+        }
+        memcpy(bigger.slots + j * bigger.entry_size, table->slots + i * table->entry_size, table->entry_size);
+    }
+    bigger.count = table->count;
+    free(table->slots);
+    *table = bigger;
+    return 0;
+}
+
+void* cell_table_upsert(cell_table_t *table, H3Index cell, int *added) {
+    *added = 0;
+    if ((table->count + 1) * 2 > table->mask + 1 && cell_table_grow(table) != 0) {
+        return NULL;
+    }
+    size_t i = hash_cell(cell) & table->mask;
+    H3Index found;
+    while ((found = slot_cell(table, i)) != 0) {
+        if (found == cell) {
+            return table->slots + i * table->entry_size;
+        }
+        i = (i + 1) & table->mask;
+    }
+    unsigned char *entry = table->slots + i * table->entry_size;
+    memcpy(entry, &cell, sizeof(cell)); // The rest is still zero from calloc()
+    table->count++;
+    *added = 1;
+    return entry;
+}
+
+size_t cell_table_chain(const cell_table_t *table, H3Index cell, size_t parent_offset, H3Index *out) {
+    size_t length = 0;
+    const unsigned char *entry = cell_table_find(table, cell);
+    while (entry) {
+        if (out) {
+            out[length] = cell;
+        }
+        length++;
+        memcpy(&cell, entry + parent_offset, sizeof(cell));
+        entry = cell != 0 ? cell_table_find(table, cell) : NULL;
+    }
+    return length;
+}
+
+// Lower key first; on a tie the deeper entry, which is closer to the goal
+static inline int heap_before(const cell_heap_entry_t *a, double key, double g) {
+    return a->key < key || (a->key == key && a->g >= g);
+}
+
+int cell_heap_push(cell_heap_t *heap, double key, double g, H3Index cell) {
+    if (heap->size == heap->capacity) {
+        size_t capacity = heap->capacity ? heap->capacity * 2 : CELL_HEAP_INITIAL;
+        cell_heap_entry_t *entries = realloc(heap->entries, capacity * sizeof(*entries));
+        if (!entries) {
+            return -1;
+        }
+        heap->entries = entries;
+        heap->capacity = capacity;
+    }
+
+    size_t i = heap->size++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (heap_before(&heap->entries[parent], key, g)) {
+            break;
+        }
+        heap->entries[i] = heap->entries[parent];
+        i = parent;
+    }
+    heap->entries[i] = (cell_heap_entry_t){ key, g, cell };
+    return 0;
+}
+
+cell_heap_entry_t cell_heap_pop(cell_heap_t *heap) {
+    cell_heap_entry_t top = heap->entries[0];
+    cell_heap_entry_t last = heap->entries[--heap->size];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap->size) {
+            break;
+        }
+        if (child + 1 < heap->size &&
+            !heap_before(&heap->entries[child], heap->entries[child + 1].key, heap->entries[child + 1].g)) {
+            child++;
+        }
+        if (!heap_before(&heap->entries[child], last.key, last.g)) {
+            break;
+        }
+        heap->entries[i] = heap->entries[child];
+        i = child;
+    }
+    if (heap->size > 0) {
+        heap->entries[i] = last;
+    }
+    return top;
+}
+
+void cell_heap_free(cell_heap_t *heap) {
+    free(heap->entries);
+    heap->entries = NULL;
+    heap->size = heap->capacity = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef CELL_SEARCH_H
+#define CELL_SEARCH_H
+
+#include <stddef.h>
+#include <h3/h3api.h>
+
+// Pieces shared by the H3 grid searches (astar.c, alt.c, hier_path.c): the edge
+// length, sorted cell arrays, a table of reached cells and the open heap. Internal to
+// routing/; callers keep their own per-cell state and result codes.
+
+// Great-circle distance in km between two points given in radians. Same formula as
+// haversine_distance().
+double cell_great_circle_km(double lat1, double lng1, double lat2, double lng2);
+
+// qsort() comparator for H3Index arrays
+int cell_compare(const void *a, const void *b);
+
+// Position of `cell` in a sorted array, or `count` when it is missing
+size_t cell_index(const H3Index *cells, size_t count, H3Index cell);
+
+// Open-addressing table of fixed-size entries keyed by H3Index, linear probing. Every
+// entry type must start with its H3Index; 0 marks an empty slot (no valid index is 0).
+// Doubles at half full, so entries move: don't hold a pointer across an upsert.
+typedef struct {
+    unsigned char *slots;
+    size_t entry_size;
+    size_t mask;
+    size_t count;
+} cell_table_t;
+
+// `slots` must be a power of two. Returns -1 when out of memory, with nothing to free.
+int cell_table_init(cell_table_t *table, size_t entry_size, size_t slots);
+void cell_table_free(cell_table_t *table);
+void* cell_table_find(const cell_table_t *table, H3Index cell);
+// Find or add `cell`. A new entry is zeroed apart from its cell and *added is set;
+// NULL when out of memory.
+void* cell_table_upsert(cell_table_t *table, H3Index cell, int *added);
+
+// Follow the parent links stored `parent_offset` bytes into each entry, starting at
+// `cell` and stopping at a 0 parent. Writes the cells in walk order to `out` when it is
+// not NULL; returns how many there are.
+size_t cell_table_chain(const cell_table_t *table, H3Index cell, size_t parent_offset, H3Index *out);
+
+// Min-heap of open cells. Improving a cell pushes it again rather than moving the old
+// entry (lazy deletion); callers skip stale entries when they pop them.
+typedef struct {
+    double key;
+    double g;                         // Cost so far; breaks ties in favour of deeper entries
+    H3Index cell;
+} cell_heap_entry_t;
+
+typedef struct {
+    cell_heap_entry_t *entries;
+    size_t size;
+    size_t capacity;
+} cell_heap_t;
+
+#define CELL_HEAP_INIT { NULL, 0, 0 }
+
+int cell_heap_push(cell_heap_t *heap, double key, double g, H3Index cell);
+cell_heap_entry_t cell_heap_pop(cell_heap_t *heap);
+void cell_heap_free(cell_heap_t *heap);
+
+#endif // CELL_SEARCH_H
@@ -0,0 +1,755 @@
+#define _GNU_SOURCE
+#include "ch_build.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <time.h>
+
+#define CH_WITNESS_SETTLE_LIMIT 500   // Witness searches give up here and keep the shortcut
+#define CH_ESTIMATE_SETTLE_LIMIT 50   // Lighter searches for ordering, where an overcount only costs rank quality
+#define CH_MAX_FIELDS 8
+#define CH_INITIAL_ARCS 4
+
+// Growable arc list of one node
+typedef struct {
+    road_arc_t *arcs;
+    uint32_t count;
+    uint32_t capacity;
+} arc_list_t;
+
+typedef struct {
+    int32_t priority;
+    uint32_t node;
+} order_entry_t;
+
+typedef struct {
+    uint64_t dist;
+    uint32_t node;
+} witness_entry_t;
+
+typedef struct {
+    uint32_t n;
+    // Live graph among the nodes not yet contracted; `in` arcs hold the tail in `node`
+    arc_list_t *out;
+    arc_list_t *in;
+    // Each node's arcs at the moment it was contracted: every one leads to a higher rank
+    arc_list_t *up;
+    arc_list_t *down;
+    uint8_t *contracted;
+    uint32_t *deleted_neighbours;
+    // Witness search scratch; dist[] is reset through touched[] after each search
+    uint64_t *dist;
+    uint32_t *touched;
+    size_t touched_count;
+    witness_entry_t *heap;
+    size_t heap_size;
+    size_t heap_capacity;
+} ch_t;
+
+// Input node ids to dense indices
+typedef struct {
+    uint64_t *ids;                // Stored id + 1; 0 marks an empty slot
+    uint32_t *indices;
+    size_t mask;
+    size_t count;
+} id_map_t;
+
+typedef struct {
+    double *lat;
+    double *lng;
+    uint32_t count;
+    uint32_t capacity;
+} node_table_t;
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    uint32_t weight;
+} segment_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int list_push(arc_list_t *list, uint32_t node, uint32_t weight, uint32_t mid) {
+    if (list->count == list->capacity) {
+        uint32_t capacity = list->capacity ? list->capacity * 2 : CH_INITIAL_ARCS;
+        road_arc_t *arcs = realloc(list->arcs, capacity * sizeof(*arcs));
+        if (!arcs) {
+            return -1;
+        }
+        list->arcs = arcs;
+        list->capacity = capacity;
+    }
+    list->arcs[list->count++] = (road_arc_t){ node, weight, mid };
+    return 0;
+}
+
+static road_arc_t* list_find(arc_list_t *list, uint32_t node) {
+    for (uint32_t i = 0; i < list->count; i++) {
+        if (list->arcs[i].node == node) {
+            return &list->arcs[i];
+        }
+    }
+    return NULL;
+}
+
+static void list_remove(arc_list_t *list, uint32_t node) {
+    road_arc_t *arc = list_find(list, node);
+    if (arc) {
+        *arc = list->arcs[--list->count];
+    }
+}
+
+// Add u -> x, or lower the weight of the one already there. Parallel arcs never exist,
+// which is what lets a shortcut's halves be found by node alone when unpacking.
+static int connect(ch_t *ch, uint32_t u, uint32_t x, uint32_t weight, uint32_t mid) {
+    road_arc_t *existing = list_find(&ch->out[u], x);
+    if (existing) {
+        if (weight < existing->weight) {
+            road_arc_t *reverse = list_find(&ch->in[x], u);
+            existing->weight = reverse->weight = weight;
+            existing->mid = reverse->mid = mid;
+        }
+        return 0;
+    }
+    if (list_push(&ch->out[u], x, weight, mid) != 0 || list_push(&ch->in[x], u, weight, mid) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int witness_push(ch_t *ch, uint64_t dist, uint32_t node) {
+    if (ch->heap_size == ch->heap_capacity) {
+        size_t capacity = ch->heap_capacity ? ch->heap_capacity * 2 : 256;
+        witness_entry_t *heap = realloc(ch->heap, capacity * sizeof(*heap));
+        if (!heap) {
+            return -1;
+        }
+        ch->heap = heap;
+        ch->heap_capacity = capacity;
+    }
+    size_t i = ch->heap_size++;
+    while (i > 0 && ch->heap[(i - 1) / 2].dist > dist) {
+        ch->heap[i] = ch->heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    ch->heap[i] = (witness_entry_t){ dist, node };
+    return 0;
+}
+
+static witness_entry_t witness_pop(ch_t *ch) {
+    witness_entry_t top = ch->heap[0];
+    witness_entry_t last = ch->heap[--ch->heap_size];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= ch->heap_size) {
+            break;
+        }
+        if (child + 1 < ch->heap_size && ch->heap[child + 1].dist < ch->heap[child].dist) {
+            child++;
+        }
+        if (ch->heap[child].dist >= last.dist) {
+            break;
+        }
+        ch->heap[i] = ch->heap[child];
+        i = child;
+    }
+    if (ch->heap_size > 0) {
+        ch->heap[i] = last;
+    }
+    return top;
+}
+
+static void witness_touch(ch_t *ch, uint32_t node, uint64_t dist) {
+    if (ch->dist[node] == UINT64_MAX) {
+        ch->touched[ch->touched_count++] = node;
+    }
+    ch->dist[node] = dist;
+}
+
+// Dijkstra from `source` that never passes through `skip`, settling at most `limit`
+// nodes; afterwards dist[x] is an upper bound on the shortest skip-free distance to x
+// (UINT64_MAX if unreached)
+static int witness_search(ch_t *ch, uint32_t source, uint32_t skip, uint64_t max_dist, unsigned int limit) {
+    for (size_t i = 0; i < ch->touched_count; i++) {
+        ch->dist[ch->touched[i]] = UINT64_MAX;
+    }
+    ch->touched_count = 0;
+    ch->heap_size = 0;
+    witness_touch(ch, source, 0);
+    if (witness_push(ch, 0, source) != 0) {
+        return -1;
+    }
+    unsigned int settled = 0;
+    while (ch->heap_size > 0 && settled < limit) {
+        witness_entry_t top = witness_pop(ch);
+        if (top.dist > ch->dist[top.node]) {
+            continue;
+        }
+        if (top.dist > max_dist) {
+            break;
+        }
+        settled++;
+        arc_list_t *out = &ch->out[top.node];
+        for (uint32_t i = 0; i < out->count; i++) {
+            uint32_t next = out->arcs[i].node;
+            uint64_t tentative = top.dist + out->arcs[i].weight;
+            if (next == skip || tentative >= ch->dist[next]) {
+                continue;
+            }
+            witness_touch(ch, next, tentative);
+            if (witness_push(ch, tentative, next) != 0) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Shortcuts contracting `v` needs: one u -> x for every pair whose shortest path runs
+// through v. With `apply` they are added. Returns the count, or -1 when out of memory.
+static long process_node(ch_t *ch, uint32_t v, int apply) {
+    arc_list_t *in = &ch->in[v], *out = &ch->out[v];
+    uint64_t max_out = 0;
+    for (uint32_t j = 0; j < out->count; j++) {
+        if (out->arcs[j].weight > max_out) {
+            max_out = out->arcs[j].weight;
+        }
+    }
+    long shortcuts = 0;
+    for (uint32_t i = 0; i < in->count; i++) {
+        uint32_t u = in->arcs[i].node;
+        uint64_t to_v = in->arcs[i].weight;
+        if (witness_search(ch, u, v, to_v + max_out,
+                           apply ? CH_WITNESS_SETTLE_LIMIT : CH_ESTIMATE_SETTLE_LIMIT) != 0) {
+            return -1;
+        }
+        for (uint32_t j = 0; j < out->count; j++) {
+            uint32_t x = out->arcs[j].node;
+            uint64_t via_v = to_v + out->arcs[j].weight;
+            if (x == u || ch->dist[x] <= via_v) {
+                continue; // A path at least as short avoids v
+            }
+            shortcuts++;
+            if (apply && connect(ch, u, x, (uint32_t)via_v, v) != 0) {
+                return -1;
+            }
+        }
+    }
+    return shortcuts;
+}
+
+// Shortcuts added (counted twice) minus arcs removed, plus contracted neighbours so
+// contraction spreads evenly over the map
+static long node_priority(ch_t *ch, uint32_t v) {
+    long shortcuts = process_node(ch, v, 0);
+    if (shortcuts < 0) {
+        return LONG_MIN;
+    }
+    return 2 * shortcuts - (long)ch->in[v].count - (long)ch->out[v].count + (long)ch->deleted_neighbours[v];
+}
+
+static int contract_node(ch_t *ch, uint32_t v) {
+    if (process_node(ch, v, 1) < 0) {
+        return -1;
+    }
+    ch->contracted[v] = 1;
+    // What is left of v's arcs all lead to nodes contracted later: its upward arcs
+    ch->up[v] = ch->out[v];
+    ch->down[v] = ch->in[v];
+    memset(&ch->out[v], 0, sizeof(arc_list_t));
+    memset(&ch->in[v], 0, sizeof(arc_list_t));
+    for (uint32_t i = 0; i < ch->up[v].count; i++) {
+        uint32_t x = ch->up[v].arcs[i].node;
+        list_remove(&ch->in[x], v);
+        ch->deleted_neighbours[x]++;
+    }
+    for (uint32_t i = 0; i < ch->down[v].count; i++) {
+        uint32_t u = ch->down[v].arcs[i].node;
+        list_remove(&ch->out[u], v);
+        ch->deleted_neighbours[u]++;
+    }
+    return 0;
+}
+
+static void order_sift_down(order_entry_t *heap, size_t size, size_t i) {
+    order_entry_t item = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= size) {
+            break;
+        }
+        if (child + 1 < size && heap[child + 1].priority < heap[child].priority) {
+            child++;
+        }
+        if (heap[child].priority >= item.priority) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+// Contract every node, cheapest first. Priorities go stale as neighbours are
+// contracted, so the popped node is re-scored and put back if it is no longer cheapest.
+static int contract_all(ch_t *ch) {
+    order_entry_t *heap = malloc(ch->n * sizeof(*heap));
+    if (!heap) {
+        return -1;
+    }
+    for (uint32_t v = 0; v < ch->n; v++) {
+        long priority = node_priority(ch, v);
+        if (priority == LONG_MIN) {
+            free(heap);
+            return -1;
+        }
+        heap[v] = (order_entry_t){ (int32_t)priority, v };
+    }
+    size_t size = ch->n;
+    for (size_t i = size / 2; i-- > 0;) {
+        order_sift_down(heap, size, i);
+    }
+    while (size > 0) {
+        uint32_t v = heap[0].node;
+        long priority = node_priority(ch, v);
+        if (priority == LONG_MIN) {
+            free(heap);
+            return -1;
+        }
+        if (size > 1) {
+            int32_t next = heap[1].priority;
+            if (size > 2 && heap[2].priority < next) {
+                next = heap[2].priority;
+            }
+            if (priority > next) {
+                heap[0].priority = (int32_t)priority;
+                order_sift_down(heap, size, 0);
+                continue;
+            }
+        }
+        heap[0] = heap[--size];
+        if (size > 0) {
+            order_sift_down(heap, size, 0);
+        }
+        if (contract_node(ch, v) != 0) {
+            free(heap);
+            return -1;
+        }
+    }
+    free(heap);
+    return 0;
+}
+
+static inline size_t hash_id(uint64_t id) {
+    id ^= id >> 33;
+    id *= 0xff51afd7ed558ccdULL;
+    id ^= id >> 33;
+    return (size_t)id;
+}
+
+static int id_map_init(id_map_t *map, size_t slots) {
+    map->ids = calloc(slots, sizeof(*map->ids));
+    map->indices = malloc(slots * sizeof(*map->indices));
+    map->mask = slots - 1;
+    map->count = 0;
+    return map->ids && map->indices ? 0 : -1;
+}
+
+static void id_map_free(id_map_t *map) {
+    free(map->ids);
+    free(map->indices);
+}
+
+// Index of `id`, adding it as `next` when new; *added says which. -1 when out of memory.
+static int64_t id_map_get(id_map_t *map, uint64_t id, uint32_t next, int *added) {
+    *added = 0;
+    if ((map->count + 1) * 2 > map->mask + 1) {
+        id_map_t bigger;
+        if (id_map_init(&bigger, (map->mask + 1) * 2) != 0) {
+            id_map_free(&bigger);
+            return -1;
+        }
+        for (size_t i = 0; i <= map->mask; i++) {
+            if (map->ids[i] == 0) {
+                continue;
+            }
+            size_t j = hash_id(map->ids[i] - 1) & bigger.mask;
+            while (bigger.ids[j] != 0) {
+                j = (j + 1) & bigger.mask;
+            }
+            bigger.ids[j] = map->ids[i];
+            bigger.indices[j] = map->indices[i];
+        }
+        bigger.count = map->count;
+        id_map_free(map);
+        *map = bigger;
+    }
+    size_t i = hash_id(id) & map->mask;
+    while (map->ids[i] != 0) {
+        if (map->ids[i] == id + 1) {
+            return map->indices[i];
+        }
+        i = (i + 1) & map->mask;
+    }
+    map->ids[i] = id + 1;
+    map->indices[i] = next;
+    map->count++;
+    *added = 1;
+    return next;
+}
+
+static int node_add(node_table_t *nodes, double lat, double lng) {
+    if (nodes->count == nodes->capacity) {
+        uint32_t capacity = nodes->capacity ? nodes->capacity * 2 : 1024;
+        double *more_lat = realloc(nodes->lat, capacity * sizeof(double));
+        if (more_lat) {
+            nodes->lat = more_lat;
+        }
+        double *more_lng = more_lat ? realloc(nodes->lng, capacity * sizeof(double)) : NULL;
+        if (!more_lng) {
+            return -1;
+        }
+        nodes->lng = more_lng;
+        nodes->capacity = capacity;
+    }
+    nodes->lat[nodes->count] = lat;
+    nodes->lng[nodes->count] = lng;
+    nodes->count++;
+    return 0;
+}
+
+// Split a CSV line in place; returns the number of fields
+static int split_fields(char *line, char **fields) {
+    int count = 0;
+    line[strcspn(line, "\r\n")] = '\0';
+    char *field = line;
+    while (count < CH_MAX_FIELDS) {
+        fields[count++] = field;
+        char *comma = strchr(field, ',');
+        if (!comma) {
+            break;
+        }
+        *comma = '\0';
+        field = comma + 1;
+    }
+    return count;
+}
+
+static int parse_double(const char *text, double *value) {
+    char *end;
+    errno = 0;
+    *value = strtod(text, &end);
+    return end != text && *end == '\0' && errno == 0;
+}
+
+// Read the edge list; node indices follow first appearance
+static int read_segments(const char *path, id_map_t *ids, node_table_t *nodes,
+                         segment_t **segments_out, size_t *segment_count) {
+    FILE *in = fopen(path, "r");
+    if (!in) {
+        fprintf(stderr, "Road edges %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    size_t count = 0, capacity = 1 << 16;
+    segment_t *segments = malloc(capacity * sizeof(*segments));
+    char line[512];
+    unsigned long line_no = 0;
+    int result = -1;
+    while (segments && fgets(line, sizeof(line), in)) {
+        line_no++;
+        char *fields[CH_MAX_FIELDS];
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '\0') {
+            continue;
+        }
+        int field_count = split_fields(line, fields);
+        double coords[4], length = 0, oneway = 0;
+        char *end_from, *end_to = NULL;
+        uint64_t from_id = strtoull(fields[0], &end_from, 10);
+        uint64_t to_id = field_count > 3 ? strtoull(fields[3], &end_to, 10) : 0;
+        int ok = field_count >= 6 && end_from != fields[0] && *end_from == '\0' &&
+                 end_to != fields[3] && *end_to == '\0' &&
+                 parse_double(fields[1], &coords[0]) && parse_double(fields[2], &coords[1]) &&
+                 parse_double(fields[4], &coords[2]) && parse_double(fields[5], &coords[3]) &&
+                 (field_count < 7 || fields[6][0] == '\0' || parse_double(fields[6], &length)) &&
+                 (field_count < 8 || fields[7][0] == '\0' || parse_double(fields[7], &oneway)) &&
+                 fabs(coords[0]) <= 90 && fabs(coords[2]) <= 90 && fabs(coords[1]) <= 180 && fabs(coords[3]) <= 180 &&
+                 length >= 0;
+        if (!ok) {
+            if (line_no == 1) {
+                continue; // Column header
+            }
+            fprintf(stderr, "%s:%lu: expected from_id,from_lat,from_lng,to_id,to_lat,to_lng[,length_m[,oneway]]\n",
+                    path, line_no);
+            goto done;
+        }
+
+        uint32_t ends[2];
+        for (int e = 0; e < 2; e++) {
+            int added;
+            int64_t index = id_map_get(ids, e ? to_id : from_id, nodes->count, &added);
+            if (index < 0 || (added && node_add(nodes, coords[2 * e], coords[2 * e + 1]) != 0)) {
+                fprintf(stderr, "Out of memory after %lu lines\n", line_no);
+                goto done;
+            }
+            ends[e] = (uint32_t)index;
+        }
+        if (ends[0] == ends[1]) {
+            continue;
+        }
+        if (length == 0) {
+            LatLng a = { degsToRads(nodes->lat[ends[0]]), degsToRads(nodes->lng[ends[0]]) };
+            LatLng b = { degsToRads(nodes->lat[ends[1]]), degsToRads(nodes->lng[ends[1]]) };
+            length = greatCircleDistanceM(&a, &b);
+        }
+        uint32_t weight = (uint32_t)llround(length * 10.0);
+        for (int direction = 0; direction < (oneway == 1 ? 1 : 2); direction++) {
+            if (count == capacity) {
+                capacity *= 2;
+                segment_t *more = realloc(segments, capacity * sizeof(*segments));
+                if (!more) {
+                    fprintf(stderr, "Out of memory after %lu lines\n", line_no);
+                    goto done;
+                }
+                segments = more;
+            }
+            segments[count++] = (segment_t){ ends[direction], ends[1 - direction], weight };
+        }
+    }
+    if (!segments) {
+        fprintf(stderr, "Out of memory\n");
+        goto done;
+    }
+    if (nodes->count == 0) {
+        fprintf(stderr, "Road edges %s has no segments\n", path);
+        goto done;
+    }
+    result = 0;
+
+done:
+    fclose(in);
+    if (result != 0) {
+        free(segments);
+        segments = NULL;
+    }
+    *segments_out = segments;
+    *segment_count = count;
+    return result;
+}
+
+typedef struct {
+    uint64_t cell;
+    uint32_t node;
+} cell_order_t;
+
+static int compare_cell_order(const void *a, const void *b) {
+    const cell_order_t *x = a, *y = b;
+    if (x->cell != y->cell) {
+        return x->cell < y->cell ? -1 : 1;
+    }
+    return (x->node > y->node) - (x->node < y->node);
+}
+
+static int write_section(FILE *f, const void *data, size_t size, size_t count) {
+    return count == 0 || fwrite(data, size, count, f) == count;
+}
+
+// first[] and arcs[] of one CSR section from per-node lists
+static int write_lists(FILE *f, const arc_list_t *lists, uint32_t n) {
+    uint32_t offset = 0;
+    for (uint32_t v = 0; v <= n; v++) {
+        if (!write_section(f, &offset, sizeof(offset), 1)) {
+            return 0;
+        }
+        if (v < n) {
+            offset += lists[v].count;
+        }
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        if (!write_section(f, lists[v].arcs, sizeof(road_arc_t), lists[v].count)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t total_arcs(const arc_list_t *lists, uint32_t n) {
+    uint32_t total = 0;
+    for (uint32_t v = 0; v < n; v++) {
+        total += lists[v].count;
+    }
+    return total;
+}
+
+// Every arc of the final graph sits in exactly one up or down list, so this counts each
+// shortcut once
+static unsigned long count_shortcuts(const arc_list_t *lists, uint32_t n) {
+    unsigned long total = 0;
+    for (uint32_t v = 0; v < n; v++) {
+        for (uint32_t i = 0; i < lists[v].count; i++) {
+            total += lists[v].arcs[i].mid != ROAD_ARC_ORIGINAL;
+        }
+    }
+    return total;
+}
+
+static void free_lists(arc_list_t *lists, uint32_t n) {
+    if (!lists) {
+        return;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        free(lists[v].arcs);
+    }
+    free(lists);
+}
+
+int ch_build_from_csv(const char *csv_path, const char *out_path, int snap_res, ch_build_stats_t *stats) {
+    id_map_t ids;
+    node_table_t nodes = { NULL, NULL, 0, 0 };
+    segment_t *segments = NULL;
+    size_t segment_count = 0;
+    cell_order_t *order = NULL;
+    uint32_t *renumber = NULL;
+    arc_list_t *base = NULL;
+    ch_t ch;
+    memset(&ch, 0, sizeof(ch));
+    int result = -1;
+
+    if (id_map_init(&ids, 1 << 16) != 0 ||
+        read_segments(csv_path, &ids, &nodes, &segments, &segment_count) != 0) {
+        goto done;
+    }
+    uint32_t n = nodes.count;
+
+    // Number nodes by snap cell: the snap index is then the cells[] array itself, and
+    // nodes that are close on the map are close in memory
+    order = malloc(n * sizeof(*order));
+    renumber = malloc(n * sizeof(*renumber));
+    if (!order || !renumber) {
+        fprintf(stderr, "Out of memory numbering %u nodes\n", n);
+        goto done;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        LatLng point = { degsToRads(nodes.lat[v]), degsToRads(nodes.lng[v]) };
+        order[v].node = v;
+        if (latLngToCell(&point, snap_res, &order[v].cell) != E_SUCCESS) {
+            fprintf(stderr, "Node at %f,%f has no resolution %d cell\n", nodes.lat[v], nodes.lng[v], snap_res);
+            goto done;
+        }
+    }
+    qsort(order, n, sizeof(*order), compare_cell_order);
+    for (uint32_t v = 0; v < n; v++) {
+        renumber[order[v].node] = v;
+    }
+
+    ch.n = n;
+    ch.out = calloc(n, sizeof(arc_list_t));
+    ch.in = calloc(n, sizeof(arc_list_t));
+    ch.up = calloc(n, sizeof(arc_list_t));
+    ch.down = calloc(n, sizeof(arc_list_t));
+    ch.contracted = calloc(n, 1);
+    ch.deleted_neighbours = calloc(n, sizeof(uint32_t));
+    ch.dist = malloc(n * sizeof(uint64_t));
+    ch.touched = malloc(n * sizeof(uint32_t));
+    base = calloc(n, sizeof(arc_list_t));
+    if (!ch.out || !ch.in || !ch.up || !ch.down || !ch.contracted || !ch.deleted_neighbours ||
+        !ch.dist || !ch.touched || !base) {
+        fprintf(stderr, "Out of memory for %u nodes\n", n);
+        goto done;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+        ch.dist[v] = UINT64_MAX;
+    }
+    for (size_t i = 0; i < segment_count; i++) {
+        if (connect(&ch, renumber[segments[i].from], renumber[segments[i].to], segments[i].weight,
+                    ROAD_ARC_ORIGINAL) != 0) {
+            fprintf(stderr, "Out of memory adding road segments\n");
+            goto done;
+        }
+    }
+    // The merged input graph, kept for plain Dijkstra
+    for (uint32_t v = 0; v < n; v++) {
+        for (uint32_t i = 0; i < ch.out[v].count; i++) {
+            if (list_push(&base[v], ch.out[v].arcs[i].node, ch.out[v].arcs[i].weight, ROAD_ARC_ORIGINAL) != 0) {
+                fprintf(stderr, "Out of memory copying road segments\n");
+                goto done;
+            }
+        }
+    }
+
+    double started = now_seconds();
+    if (contract_all(&ch) != 0) {
+        fprintf(stderr, "Out of memory contracting the road graph\n");
+        goto done;
+    }
+    double seconds = now_seconds() - started;
+
+    road_graph_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ROAD_GRAPH_MAGIC, sizeof(header.magic));
+    header.version = ROAD_GRAPH_VERSION;
+    header.snap_res = (uint32_t)snap_res;
+    header.node_count = n;
+    header.up_count = total_arcs(ch.up, n);
+    header.down_count = total_arcs(ch.down, n);
+    header.base_count = total_arcs(base, n);
+
+    FILE *f = fopen(out_path, "wb");
+    if (!f) {
+        fprintf(stderr, "Road graph %s: %s\n", out_path, strerror(errno));
+        goto done;
+    }
+    int ok = write_section(f, &header, sizeof(header), 1);
+    for (uint32_t v = 0; ok && v < n; v++) {
+        ok = write_section(f, &order[v].cell, sizeof(uint64_t), 1);
+    }
+    for (int axis = 0; axis < 2; axis++) {
+        for (uint32_t v = 0; ok && v < n; v++) {
+            double degrees = axis == 0 ? nodes.lat[order[v].node] : nodes.lng[order[v].node];
+            int32_t e7 = (int32_t)llround(degrees * 1e7);
+            ok = write_section(f, &e7, sizeof(e7), 1);
+        }
+    }
+    ok = ok && write_lists(f, ch.up, n) && write_lists(f, ch.down, n) && write_lists(f, base, n);
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    if (!ok) {
+        fprintf(stderr, "Failed to write road graph %s\n", out_path);
+        goto done;
+    }
+
+    if (stats) {
+        stats->nodes = n;
+        stats->segments = header.base_count;
+        stats->shortcuts = count_shortcuts(ch.up, n) + count_shortcuts(ch.down, n);
+        stats->seconds = seconds;
+    }
+    result = 0;
+
+done:
+    id_map_free(&ids);
+    free(nodes.lat);
+    free(nodes.lng);
+    free(segments);
+    free(order);
+    free(renumber);
+    free_lists(ch.out, ch.n);
+    free_lists(ch.in, ch.n);
+    free_lists(ch.up, ch.n);
+    free_lists(ch.down, ch.n);
+    free_lists(base, ch.n);
+    free(ch.contracted);
+    free(ch.deleted_neighbours);
+    free(ch.dist);
+    free(ch.touched);
+    free(ch.heap);
+    return result;
+}
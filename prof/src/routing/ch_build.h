@@ -0,0 +1,26 @@
+#ifndef CH_BUILD_H
+#define CH_BUILD_H
+
+#include "road_graph.h"
+
+// Offline preprocessing for road_graph: read an OSM-derived edge list, contract it
+// into a hierarchy and write the file road_graph_load() maps. Not linked into the server.
+//
+// One road segment per line:
+//   from_id,from_lat,from_lng,to_id,to_lat,to_lng[,length_m[,oneway]]
+// Ids are the source's node ids (OSM ids fit), coordinates are degrees. Without a
+// length the segment costs the great-circle distance between its ends. oneway=1 only
+// allows from -> to; otherwise the segment is driveable both ways. A first line that
+// does not parse (a column header) and blank lines are skipped.
+
+typedef struct {
+    unsigned long nodes;
+    unsigned long segments;        // Directed arcs after merging duplicates
+    unsigned long shortcuts;
+    double seconds;                // Contraction only, not reading or writing
+} ch_build_stats_t;
+
+// Returns 0, or -1 after printing why. `stats` may be NULL.
+int ch_build_from_csv(const char *csv_path, const char *out_path, int snap_res, ch_build_stats_t *stats);
+
+#endif // CH_BUILD_H
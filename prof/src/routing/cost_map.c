@@ -0,0 +1,249 @@
+#define _GNU_SOURCE
+#include "cost_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define H3_RES_COUNT 16
+#define H3_CELL_MODE_BITS (1ULL << 59)   // Mode 1 (cell); other modes never appear in a map
+#define H3_RES_SHIFT 52
+
+typedef struct {
+    void *base;
+    size_t size;
+    const cost_map_header_t *header;
+    const uint64_t *cells;
+    const float *costs;
+    size_t first[H3_RES_COUNT + 1];      // Cells of resolution r are [first[r], first[r + 1])
+} cost_map_t;
+
+static cost_map_t map;
+static int map_loaded = 0;
+
+// First position whose cell is >= key
+static size_t lower_bound(const uint64_t *cells, size_t count, uint64_t key) {
+    size_t lo = 0, hi = count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cells[mid] < key) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int cost_map_load(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Cost map %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(cost_map_header_t)) {
+        fprintf(stderr, "Cost map %s is too short\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Cost map %s: mmap failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const cost_map_header_t *header = base;
+    uint64_t count = header->count;
+    if (memcmp(header->magic, COST_MAP_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != COST_MAP_VERSION ||
+        count > (size - sizeof(*header)) / (sizeof(uint64_t) + sizeof(float)) ||
+        size != sizeof(*header) + count * (sizeof(uint64_t) + sizeof(float)) ||
+        !(header->min_cost > 0)) {
+        fprintf(stderr, "Cost map %s is not a version %d cost map\n", path, COST_MAP_VERSION);
+        munmap(base, size);
+        return -1;
+    }
+
+    cost_map_t loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    loaded.base = base;
+    loaded.size = size;
+    loaded.header = header;
+    loaded.cells = (const uint64_t *)(header + 1);
+    loaded.costs = (const float *)(loaded.cells + count);
+    // Sorting puts the resolution field ahead of the rest of the index, so each
+    // resolution is one contiguous run
+    for (int r = 0; r <= H3_RES_COUNT; r++) {
+        loaded.first[r] = lower_bound(loaded.cells, count, H3_CELL_MODE_BITS | ((uint64_t)r << H3_RES_SHIFT));
+    }
+    if (count > 0 && (loaded.first[0] != 0 || loaded.first[H3_RES_COUNT] != count)) {
+        fprintf(stderr, "Cost map %s holds entries that are not H3 cells\n", path);
+        munmap(base, size);
+        return -1;
+    }
+    madvise(base, size, MADV_RANDOM);
+
+    cost_map_unload();
+    map = loaded;
+    map_loaded = 1;
+    printf("Cost map %s: %llu cells, default cost %.2f\n", path, (unsigned long long)count,
+           (double)header->default_cost);
+    return 0;
+}
+
+int cost_map_loaded(void) {
+    return map_loaded;
+}
+
+float cost_map_lookup(H3Index cell) {
+    if (!map_loaded) {
+        return 1.0f;
+    }
+    int res = getResolution(cell);
+    for (int r = res; r >= 0; r--) {
+        if (!(map.header->resolutions & (1u << r))) {
+            continue;
+        }
+        H3Index key = cell;
+        if (r < res && cellToParent(cell, r, &key) != E_SUCCESS) {
+            break;
+        }
+        size_t lo = map.first[r], hi = map.first[r + 1];
+        size_t i = lo + lower_bound(map.cells + lo, hi - lo, key);
+        if (i < hi && map.cells[i] == key) {
+            return map.costs[i];
+        }
+    }
+    return map.header->default_cost;
+}
+
+float cost_map_min_cost(void) {
+    if (!map_loaded) {
+        return 1.0f;
+    }
+    return map.header->min_cost;
+}
+
+void cost_map_unload(void) {
+    if (map_loaded) {
+        munmap(map.base, map.size);
+        memset(&map, 0, sizeof(map));
+        map_loaded = 0;
+    }
+}
+
+typedef struct {
+    uint64_t cell;
+    float cost;
+} cost_entry_t;
+
+static int compare_entries(const void *a, const void *b) {
+    uint64_t x = ((const cost_entry_t *)a)->cell, y = ((const cost_entry_t *)b)->cell;
+    return (x > y) - (x < y);
+}
+
+int cost_map_write(const char *path, H3Index *cells, float *costs, size_t count, float default_cost) {
+    if (!(default_cost > 0)) {
+        fprintf(stderr, "Cost map default cost must be positive\n");
+        return -1;
+    }
+    cost_entry_t *entries = malloc((count ? count : 1) * sizeof(*entries));
+    if (!entries) {
+        fprintf(stderr, "Failed to allocate %zu cost map entries\n", count);
+        return -1;
+    }
+
+    cost_map_header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COST_MAP_MAGIC, sizeof(header.magic));
+    header.version = COST_MAP_VERSION;
+    header.count = count;
+    header.default_cost = default_cost;
+    header.min_cost = default_cost;
+    for (size_t i = 0; i < count; i++) {
+        if (!isValidCell(cells[i]) || !(costs[i] > 0)) {
+            fprintf(stderr, "Cost map entry %zu is not a valid cell with a positive cost\n", i);
+            free(entries);
+            return -1;
+        }
+        entries[i].cell = cells[i];
+        entries[i].cost = costs[i];
+        header.resolutions |= 1u << getResolution(cells[i]);
+        if (costs[i] < header.min_cost) {
+            header.min_cost = costs[i];
+        }
+    }
+    qsort(entries, count, sizeof(*entries), compare_entries);
+    for (size_t i = 1; i < count; i++) {
+        if (entries[i].cell == entries[i - 1].cell) {
+            fprintf(stderr, "Cost map lists cell %llx twice\n", (unsigned long long)entries[i].cell);
+            free(entries);
+            return -1;
+        }
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cost map %s: %s\n", path, strerror(errno));
+        free(entries);
+        return -1;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = fwrite(&entries[i].cell, sizeof(uint64_t), 1, f) == 1;
+    }
+    for (size_t i = 0; ok && i < count; i++) {
+        ok = fwrite(&entries[i].cost, sizeof(float), 1, f) == 1;
+    }
+    if (fclose(f) != 0) {
+        ok = 0;
+    }
+    free(entries);
+    if (!ok) {
+        fprintf(stderr, "Failed to write cost map %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+void cost_map_get_stats(cost_map_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->min_cost = 1.0f;
+    stats->default_cost = 1.0f;
+    if (!map_loaded) {
+        return;
+    }
+    stats->loaded = 1;
+    stats->cells = (unsigned long)map.header->count;
+    stats->resolutions = map.header->resolutions;
+    stats->min_cost = map.header->min_cost;
+    stats->default_cost = map.header->default_cost;
+    stats->file_size = map.size;
+}
+
+json_object* cost_map_stats_to_json(void) {
+    cost_map_stats_t stats;
+    cost_map_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "loaded", json_object_new_boolean(stats.loaded));
+    json_object_object_add(obj, "cells", json_object_new_int64((int64_t)stats.cells));
+    json_object *resolutions = json_object_new_array();
+    for (int r = 0; r < H3_RES_COUNT; r++) {
+        if (stats.resolutions & (1u << r)) {
+            json_object_array_add(resolutions, json_object_new_int(r));
+        }
+    }
+    json_object_object_add(obj, "resolutions", resolutions);
+    json_object_object_add(obj, "min_cost", json_object_new_double(stats.min_cost));
+    json_object_object_add(obj, "default_cost", json_object_new_double(stats.default_cost));
+    json_object_object_add(obj, "file_bytes", json_object_new_int64((int64_t)stats.file_size));
+    return obj;
+}
@@ -0,0 +1,64 @@
+#ifndef COST_MAP_H
+#define COST_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <h3/h3api.h>
+#include <json-c/json.h>
+
+// Per-cell traversal costs for hex-grid routing. A cost multiplies the length of every
+// edge into or out of the cell: 1 is open ground, more is slower (parks, water, dense
+// blocks), less is faster (highways), INFINITY is impassable.
+//
+// The file is mapped read-only; the kernel pages it in as routes touch it. It holds
+// a header, then every cell sorted by H3Index, then the costs in the same order:
+//   cost_map_header_t | uint64_t cells[count] | float costs[count]
+// Cells may be at several resolutions. A lookup tries the cell itself and then each
+// coarser ancestor present in the file, so coarse cells give regional defaults that
+// fine cells override.
+#define COST_MAP_MAGIC "GEOCOST1"
+#define COST_MAP_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t resolutions;     // Bit r set when the file has cells at resolution r
+    uint64_t count;
+    float min_cost;           // Smallest cost present, default included; scales the A* heuristic so it stays admissible
+    float default_cost;       // For cells with no entry at any resolution
+    uint8_t reserved[32];
+} cost_map_header_t;
+
+typedef struct {
+    int loaded;
+    unsigned long cells;
+    unsigned int resolutions;
+    float min_cost;
+    float default_cost;
+    size_t file_size;
+} cost_map_stats_t;
+
+// Map a cost file and make it the one routing consults. Call before worker threads
+// start. Returns -1 (keeping any previous map) if the file is missing or malformed.
+int cost_map_load(const char *path);
+
+// Non-zero while a map is loaded
+int cost_map_loaded(void);
+
+// Cost of a cell: its own entry, else its nearest ancestor's, else the default; 1 when
+// no map is loaded. O(log n) per resolution tried.
+float cost_map_lookup(H3Index cell);
+
+// Lower bound on any cost lookup (1 without a map)
+float cost_map_min_cost(void);
+
+void cost_map_unload(void);
+
+// Sort `count` cells and write them with their costs; used by the CSV converter and
+// the benchmark. Costs must be positive (INFINITY allowed); cells must be unique.
+int cost_map_write(const char *path, H3Index *cells, float *costs, size_t count, float default_cost);
+
+void cost_map_get_stats(cost_map_stats_t *stats);
+json_object* cost_map_stats_to_json(void);
+
+#endif // COST_MAP_H
@@ -0,0 +1,130 @@
+#include "hier_path.h"
+#include "cell_search.h"
+#include "../api.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+static hier_stats_t hier_stats;
+
+// The path's cells and `rings` rings around them, sorted and unique, as
+// astar_corridor_t wants them. Returns the count, or 0 when out of memory.
+static size_t build_corridor(const H3Index *path, int length, int rings, H3Index **corridor) {
+    int64_t disk_size;
+    if (maxGridDiskSize(rings, &disk_size) != E_SUCCESS) {
+        return 0;
+    }
+    H3Index *cells = calloc((size_t)length * (size_t)disk_size, sizeof(H3Index));
+    *corridor = cells;
+    if (!cells) {
+        return 0;
+    }
+    for (int i = 0; i < length; i++) {
+        gridDisk(path[i], rings, cells + (size_t)i * disk_size); // Leaves 0s next to pentagons
+    }
+    size_t total = (size_t)length * (size_t)disk_size;
+    qsort(cells, total, sizeof(H3Index), cell_compare);
+    size_t count = 0;
+    for (size_t i = 0; i < total; i++) {
+        if (cells[i] != 0 && (count == 0 || cells[count - 1] != cells[i])) {
+            cells[count++] = cells[i];
+        }
+    }
+    return count;
+}
+
+int hier_h3_path(arena_t *arena, H3Index start, H3Index end, H3Index **path, hier_search_t *search) {
+    hier_search_t local;
+    if (!search) {
+        search = &local;
+    }
+    memset(search, 0, sizeof(*search));
+    *path = NULL;
+    if (!isValidCell(start) || !isValidCell(end) || getResolution(start) != getResolution(end)) {
+        return HIER_NO_PATH;
+    }
+    stat_add(&hier_stats.searches, 1);
+
+    int target = getResolution(start);
+    int res = target < HIER_COARSE_RES ? target : HIER_COARSE_RES;
+    H3Index *previous = NULL;         // Path one level up, which bounds this level
+    int previous_length = 0, previous_res = 0;
+    int rings = HIER_CORRIDOR_RINGS;
+    int result;
+    for (;;) {
+        H3Index from = start, to = end;
+        if (res < target) {
+            cellToParent(start, res, &from);
+            cellToParent(end, res, &to);
+        }
+        astar_corridor_t bounds = { NULL, 0, previous_res };
+        H3Index *corridor = NULL;
+        if (previous) {
+            bounds.count = build_corridor(previous, previous_length, rings, &corridor);
+            bounds.cells = corridor;
+            if (bounds.count == 0) {
+                result = HIER_NO_MEMORY;
+                break;
+            }
+            search->corridor_cells += bounds.count;
+        }
+        // Only the finest level's path is returned; the others just shape the next corridor
+        int final = res == target;
+        astar_search_t level;
+        H3Index *level_path = NULL;
+        result = astar_h3_path_within(final ? arena : NULL, from, to, 0, previous ? &bounds : NULL,
+                                      &level_path, &level);
+        search->levels++;
+        search->expanded += level.expanded;
+        free(corridor);
+        // Something the coarser level could not see blocks the corridor: widen it
+        if (result == HIER_NO_PATH && previous && rings < HIER_CORRIDOR_MAX_RINGS) {
+            rings = rings * 2 < HIER_CORRIDOR_MAX_RINGS ? rings * 2 : HIER_CORRIDOR_MAX_RINGS;
+            continue;
+        }
+        free(previous);
+        previous = NULL;
+        if (result <= 0) {
+            break;
+        }
+        if (final) {
+            search->cost_km = level.cost_km;
+            *path = level_path;
+            break;
+        }
+        previous = level_path;
+        previous_length = result;
+        previous_res = res;
+        rings = HIER_CORRIDOR_RINGS;
+        res = res + HIER_RES_STEP < target ? res + HIER_RES_STEP : target;
+    }
+    free(previous);
+
+    stat_add(&hier_stats.expanded, search->expanded);
+    stat_add(&hier_stats.corridor_cells, search->corridor_cells);
+    stat_add(result > 0 ? &hier_stats.found : &hier_stats.failed, 1);
+    return result;
+}
+
+void hier_path_get_stats(hier_stats_t *stats) {
+    stats->searches = __atomic_load_n(&hier_stats.searches, __ATOMIC_RELAXED);
+    stats->found = __atomic_load_n(&hier_stats.found, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&hier_stats.failed, __ATOMIC_RELAXED);
+    stats->expanded = __atomic_load_n(&hier_stats.expanded, __ATOMIC_RELAXED);
+    stats->corridor_cells = __atomic_load_n(&hier_stats.corridor_cells, __ATOMIC_RELAXED);
+}
+
+json_object* hier_path_stats_to_json(void) {
+    hier_stats_t stats;
+    hier_path_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "searches", json_object_new_int64((int64_t)stats.searches));
+    json_object_object_add(obj, "found", json_object_new_int64((int64_t)stats.found));
+    json_object_object_add(obj, "failed", json_object_new_int64((int64_t)stats.failed));
+    json_object_object_add(obj, "expanded", json_object_new_int64((int64_t)stats.expanded));
+    json_object_object_add(obj, "corridor_cells", json_object_new_int64((int64_t)stats.corridor_cells));
+    json_object_object_add(obj, "coarse_res", json_object_new_int(HIER_COARSE_RES));
+    return obj;
+}
@@ -0,0 +1,50 @@
+#ifndef HIER_PATH_H
+#define HIER_PATH_H
+
+#include <stddef.h>
+#include <h3/h3api.h>
+#include <json-c/json.h>
+#include "astar.h"
+#include "../utils/arena.h"
+
+// Coarse-to-fine path planning over the H3 hierarchy, for routes too long to search
+// cell by cell at the target resolution. A* first runs between the start's and end's
+// ancestors at HIER_COARSE_RES. Each following level, HIER_RES_STEP resolutions finer,
+// searches only the children of the previous level's path plus HIER_CORRIDOR_RINGS
+// rings around it, widened up to HIER_CORRIDOR_MAX_RINGS when that is blocked. So work
+// per level grows with path length times corridor width, not with the area between
+// the ends, and the final path is the only full-resolution array. Every level steps
+// between gridDisk neighbours, which works across pentagons and icosahedron faces
+// where gridPathCells() fails.
+//
+// The path is optimal within the corridor, not globally: a detour wider than the
+// widest corridor around something only visible at fine resolution is not found.
+#define HIER_NO_PATH ASTAR_NO_PATH       // Invalid cells, or some level found no path in its corridor
+#define HIER_BUDGET_EXCEEDED ASTAR_BUDGET_EXCEEDED  // Some level expanded ASTAR_MAX_EXPANSIONS cells
+#define HIER_NO_MEMORY ASTAR_NO_MEMORY
+
+typedef struct {
+    int levels;                       // Searches run, coarse one included
+    size_t expanded;                  // Cells expanded, all levels
+    size_t corridor_cells;            // Coarse cells bounding the levels, all levels
+    double cost_km;                   // Cost of the final path, as astar_search_t
+} hier_search_t;
+
+typedef struct {
+    unsigned long searches;
+    unsigned long found;
+    unsigned long failed;
+    unsigned long expanded;
+    unsigned long corridor_cells;
+} hier_stats_t;
+
+// Path from `start` to `end` (same resolution). On success *path (start first, end
+// last) comes from `arena` (the heap when NULL) and the number of cells is returned;
+// otherwise one of the HIER_* codes. Cells no finer than HIER_COARSE_RES are
+// searched directly. `search` may be NULL.
+int hier_h3_path(arena_t *arena, H3Index start, H3Index end, H3Index **path, hier_search_t *search);
+
+void hier_path_get_stats(hier_stats_t *stats);
+json_object* hier_path_stats_to_json(void);
+
+#endif // HIER_PATH_H
@@ -0,0 +1,728 @@
+#define _GNU_SOURCE
+#include "road_graph.h"
+#include "../api.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ROAD_INITIAL_SLOTS 256        // Search-table slots to start with; doubles at half full
+#define ROAD_INITIAL_HEAP 128
+#define ROAD_INITIAL_PATH 256
+#define ROAD_NO_NODE UINT32_MAX
+
+typedef struct {
+    void *base;
+    size_t size;
+    const road_graph_header_t *header;
+    const uint64_t *cells;
+    const int32_t *lat_e7;
+    const int32_t *lng_e7;
+    const uint32_t *up_first;
+    const road_arc_t *up;
+    const uint32_t *down_first;
+    const road_arc_t *down;
+    const uint32_t *base_first;
+    const road_arc_t *base_arcs;
+    unsigned long shortcuts;
+} road_graph_t;
+
+static road_graph_t graph;
+static int graph_loaded = 0;
+
+// Node reached by one search direction
+typedef struct {
+    uint32_t key;                     // Node + 1; 0 marks an empty slot
+    uint32_t parent;                  // ROAD_NO_NODE at the search's origin
+    uint32_t arc;                     // Index of the arc from parent, in the list the search reads
+    int settled;
+    uint64_t dist;
+} reached_t;
+
+typedef struct {
+    reached_t *slots;
+    size_t mask;
+    size_t count;
+} reached_table_t;
+
+// Lazy deletion as in astar.c: improving a node pushes it again
+typedef struct {
+    uint64_t dist;
+    uint32_t node;
+} queue_entry_t;
+
+typedef struct {
+    queue_entry_t *entries;
+    size_t size;
+    size_t capacity;
+} queue_t;
+
+// One search direction over one arc list
+typedef struct {
+    reached_table_t table;
+    queue_t queue;
+    const uint32_t *first;
+    const road_arc_t *arcs;
+} search_t;
+
+// Unpacked node sequence
+typedef struct {
+    uint32_t *nodes;
+    size_t count;
+    size_t capacity;
+} node_list_t;
+
+static road_graph_stats_t road_stats;
+
+// Byte offset of each section for the counts in `header`; returns the file size they imply
+static size_t section_offsets(const road_graph_header_t *header, size_t offsets[6]) {
+    size_t n = header->node_count;
+    size_t sizes[6] = {
+        n * sizeof(uint64_t),
+        n * sizeof(int32_t),
+        n * sizeof(int32_t),
+        (n + 1) * sizeof(uint32_t) + (size_t)header->up_count * sizeof(road_arc_t),
+        (n + 1) * sizeof(uint32_t) + (size_t)header->down_count * sizeof(road_arc_t),
+        (n + 1) * sizeof(uint32_t) + (size_t)header->base_count * sizeof(road_arc_t)
+    };
+    size_t offset = sizeof(road_graph_header_t);
+    for (int i = 0; i < 6; i++) {
+        offsets[i] = offset;
+        offset += sizes[i];
+    }
+    return offset;
+}
+
+// Offsets ascending and ending at count, heads in range
+static int arcs_valid(const uint32_t *first, const road_arc_t *arcs, uint32_t count, uint32_t nodes) {
+    if (first[0] != 0 || first[nodes] != count) {
+        return 0;
+    }
+    for (uint32_t v = 0; v < nodes; v++) {
+        if (first[v] > first[v + 1]) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (arcs[i].node >= nodes || (arcs[i].mid != ROAD_ARC_ORIGINAL && arcs[i].mid >= nodes)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int road_graph_load(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "Road graph %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(road_graph_header_t)) {
+        fprintf(stderr, "Road graph %s is too short\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Road graph %s: mmap failed: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    const road_graph_header_t *header = base;
+    size_t offsets[6];
+    if (memcmp(header->magic, ROAD_GRAPH_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != ROAD_GRAPH_VERSION || header->snap_res > 15 || header->node_count == 0 ||
+        section_offsets(header, offsets) != size) {
+        fprintf(stderr, "Road graph %s is not a version %d road graph\n", path, ROAD_GRAPH_VERSION);
+        munmap(base, size);
+        return -1;
+    }
+
+    road_graph_t loaded;
+    const char *bytes = base;
+    uint32_t n = header->node_count;
+    loaded.base = base;
+    loaded.size = size;
+    loaded.header = header;
+    loaded.cells = (const uint64_t *)(bytes + offsets[0]);
+    loaded.lat_e7 = (const int32_t *)(bytes + offsets[1]);
+    loaded.lng_e7 = (const int32_t *)(bytes + offsets[2]);
+    loaded.up_first = (const uint32_t *)(bytes + offsets[3]);
+    loaded.up = (const road_arc_t *)(loaded.up_first + n + 1);
+    loaded.down_first = (const uint32_t *)(bytes + offsets[4]);
+    loaded.down = (const road_arc_t *)(loaded.down_first + n + 1);
+    loaded.base_first = (const uint32_t *)(bytes + offsets[5]);
+    loaded.base_arcs = (const road_arc_t *)(loaded.base_first + n + 1);
+
+    // A bad offset would send a query outside the mapping, so check them all once here
+    int valid = arcs_valid(loaded.up_first, loaded.up, header->up_count, n) &&
+                arcs_valid(loaded.down_first, loaded.down, header->down_count, n) &&
+                arcs_valid(loaded.base_first, loaded.base_arcs, header->base_count, n);
+    for (uint32_t v = 1; valid && v < n; v++) {
+        valid = loaded.cells[v - 1] <= loaded.cells[v];
+    }
+    loaded.shortcuts = 0;
+    for (uint32_t i = 0; i < header->up_count; i++) {
+        loaded.shortcuts += loaded.up[i].mid != ROAD_ARC_ORIGINAL;
+    }
+    for (uint32_t i = 0; i < header->down_count; i++) {
+        loaded.shortcuts += loaded.down[i].mid != ROAD_ARC_ORIGINAL;
+    }
+    if (!valid) {
+        fprintf(stderr, "Road graph %s is corrupt\n", path);
+        munmap(base, size);
+        return -1;
+    }
+    madvise(base, size, MADV_RANDOM);
+
+    road_graph_unload();
+    graph = loaded;
+    graph_loaded = 1;
+    printf("Road graph %s: %u nodes, %u road segments, %u hierarchy arcs\n", path, n, header->base_count,
+           header->up_count + header->down_count);
+    return 0;
+}
+
+int road_graph_loaded(void) {
+    return graph_loaded;
+}
+
+void road_graph_unload(void) {
+    if (graph_loaded) {
+        munmap(graph.base, graph.size);
+        memset(&graph, 0, sizeof(graph));
+        graph_loaded = 0;
+    }
+}
+
+void road_graph_node_latlng(uint32_t node, double *lat, double *lng) {
+    *lat = graph.lat_e7[node] / 1e7;
+    *lng = graph.lng_e7[node] / 1e7;
+}
+
+static double node_distance_m(uint32_t node, double lat, double lng) {
+    LatLng a = { degsToRads(graph.lat_e7[node] / 1e7), degsToRads(graph.lng_e7[node] / 1e7) };
+    LatLng b = { degsToRads(lat), degsToRads(lng) };
+    return greatCircleDistanceM(&a, &b);
+}
+
+// First node whose cell is >= cell
+static uint32_t lower_bound(uint64_t cell) {
+    uint32_t lo = 0, hi = graph.header->node_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (graph.cells[mid] < cell) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int road_graph_snap(double lat, double lng, uint32_t *node, double *distance_m) {
+    if (!graph_loaded) {
+        return ROAD_GRAPH_NOT_LOADED;
+    }
+    LatLng point = { degsToRads(lat), degsToRads(lng) };
+    H3Index center;
+    if (latLngToCell(&point, (int)graph.header->snap_res, &center) != E_SUCCESS) {
+        return ROAD_GRAPH_NO_SNAP;
+    }
+
+    uint32_t best = ROAD_NO_NODE;
+    double best_m = 0;
+    int found_ring = -1;
+    H3Index ring[6 * ROAD_GRAPH_SNAP_RINGS];
+    for (int k = 0; k <= ROAD_GRAPH_SNAP_RINGS; k++) {
+        // A node in ring k can be farther than one in ring k + 1, never than one in k + 2
+        if (found_ring >= 0 && k > found_ring + 1) {
+            break;
+        }
+        int cells = 1;
+        if (k == 0) {
+            ring[0] = center;
+        } else {
+            memset(ring, 0, 6 * (size_t)k * sizeof(H3Index));
+            if (gridRing(center, k, ring) != E_SUCCESS) {
+                continue;
+            }
+            cells = 6 * k;
+        }
+        for (int c = 0; c < cells; c++) {
+            if (ring[c] == 0) {
+                continue;
+            }
+            for (uint32_t i = lower_bound(ring[c]); i < graph.header->node_count && graph.cells[i] == ring[c]; i++) {
+                double m = node_distance_m(i, lat, lng);
+                if (best == ROAD_NO_NODE || m < best_m) {
+                    best = i;
+                    best_m = m;
+                    if (found_ring < 0) {
+                        found_ring = k;
+                    }
+                }
+            }
+        }
+    }
+    if (best == ROAD_NO_NODE) {
+        return ROAD_GRAPH_NO_SNAP;
+    }
+    *node = best;
+    *distance_m = best_m;
+    return 0;
+}
+
+static inline size_t hash_node(uint32_t node) {
+    uint64_t h = node;
+    h *= 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 32);
+}
+
+static int table_init(reached_table_t *table, size_t slots) {
+    table->slots = calloc(slots, sizeof(reached_t));
+    table->mask = slots - 1;
+    table->count = 0;
+    return table->slots ? 0 : -1;
+}
+
+static reached_t* table_find(const reached_table_t *table, uint32_t node) {
+    size_t i = hash_node(node) & table->mask;
+    while (table->slots[i].key != 0) {
+        if (table->slots[i].key == node + 1) {
+            return &table->slots[i];
+        }
+        i = (i + 1) & table->mask;
+    }
+    return NULL;
+}
+
+static int table_grow(reached_table_t *table) {
+    reached_table_t bigger;
+    if (table_init(&bigger, (table->mask + 1) * 2) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i <= table->mask; i++) {
+        if (table->slots[i].key == 0) {
+            continue;
+        }
+        size_t j = hash_node(table->slots[i].key - 1) & bigger.mask;
+        while (bigger.slots[j].key != 0) {
+            j = (j + 1) & bigger.mask;
+        }
+        bigger.slots[j] = table->slots[i];
+    }
+    bigger.count = table->count;
+    free(table->slots);
+    *table = bigger;
+    return 0;
+}
+
+// Find or add `node`; a new entry starts unreached. NULL when out of memory.
+static reached_t* table_upsert(reached_table_t *table, uint32_t node) {
+    if ((table->count + 1) * 2 > table->mask + 1 && table_grow(table) != 0) {
+        return NULL;
+    }
+    size_t i = hash_node(node) & table->mask;
+    while (table->slots[i].key != 0) {
+        if (table->slots[i].key == node + 1) {
+            return &table->slots[i];
+        }
+        i = (i + 1) & table->mask;
+    }
+    reached_t *entry = &table->slots[i];
+    entry->key = node + 1;
+    entry->parent = ROAD_NO_NODE;
+    entry->arc = 0;
+    entry->settled = 0;
+    entry->dist = UINT64_MAX;
+    table->count++;
+    return entry;
+}
+
+static int queue_push(queue_t *queue, uint64_t dist, uint32_t node) {
+    if (queue->size == queue->capacity) {
+        size_t capacity = queue->capacity ? queue->capacity * 2 : ROAD_INITIAL_HEAP;
+        queue_entry_t *entries = realloc(queue->entries, capacity * sizeof(*entries));
+        if (!entries) {
+            return -1;
+        }
+        queue->entries = entries;
+        queue->capacity = capacity;
+    }
+    size_t i = queue->size++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (queue->entries[parent].dist <= dist) {
+            break;
+        }
+        queue->entries[i] = queue->entries[parent];
+        i = parent;
+    }
+    queue->entries[i] = (queue_entry_t){ dist, node };
+    return 0;
+}
+
+static queue_entry_t queue_pop(queue_t *queue) {
+    queue_entry_t top = queue->entries[0];
+    queue_entry_t last = queue->entries[--queue->size];
+    size_t i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= queue->size) {
+            break;
+        }
+        if (child + 1 < queue->size && queue->entries[child + 1].dist < queue->entries[child].dist) {
+            child++;
+        }
+        if (queue->entries[child].dist >= last.dist) {
+            break;
+        }
+        queue->entries[i] = queue->entries[child];
+        i = child;
+    }
+    if (queue->size > 0) {
+        queue->entries[i] = last;
+    }
+    return top;
+}
+
+static void search_free(search_t *search) {
+    free(search->table.slots);
+    free(search->queue.entries);
+}
+
+// On failure nothing is left allocated, so callers only free searches that started
+static int search_init(search_t *search, uint32_t origin, const uint32_t *first, const road_arc_t *arcs) {
+    memset(search, 0, sizeof(*search));
+    search->first = first;
+    search->arcs = arcs;
+    if (table_init(&search->table, ROAD_INITIAL_SLOTS) != 0) {
+        return -1;
+    }
+    reached_t *entry = table_upsert(&search->table, origin);
+    entry->dist = 0;
+    if (queue_push(&search->queue, 0, origin) != 0) {
+        search_free(search);
+        memset(search, 0, sizeof(*search));
+        return -1;
+    }
+    return 0;
+}
+
+// Relax the arcs out of `node`, settled at `dist`
+static int search_relax(search_t *search, uint32_t node, uint64_t dist) {
+    for (uint32_t i = search->first[node]; i < search->first[node + 1]; i++) {
+        const road_arc_t *arc = &search->arcs[i];
+        uint64_t tentative = dist + arc->weight;
+        reached_t *next = table_upsert(&search->table, arc->node);
+        if (!next) {
+            return -1;
+        }
+        if (next->settled || tentative >= next->dist) {
+            continue;
+        }
+        next->dist = tentative;
+        next->parent = node;
+        next->arc = i;
+        if (queue_push(&search->queue, tentative, arc->node) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Take the next live entry off the queue: its node, or ROAD_NO_NODE when the queue is
+// empty or its smallest distance is not below `bound`
+static uint32_t search_settle(search_t *search, uint64_t bound, uint64_t *dist) {
+    while (search->queue.size > 0) {
+        if (search->queue.entries[0].dist >= bound) {
+            search->queue.size = 0;
+            break;
+        }
+        queue_entry_t top = queue_pop(&search->queue);
+        reached_t *entry = table_find(&search->table, top.node);
+        if (entry->settled || top.dist > entry->dist) {
+            continue; // Stale
+        }
+        entry->settled = 1;
+        *dist = entry->dist;
+        return top.node;
+    }
+    return ROAD_NO_NODE;
+}
+
+// Stall-on-demand: a node reached more cheaply through a higher neighbour (an arc the
+// other way round) is not on any shortest upward path, so its arcs need no relaxing
+static int search_stalled(const search_t *search, uint32_t node, uint64_t dist,
+                          const uint32_t *first, const road_arc_t *arcs) {
+    for (uint32_t i = first[node]; i < first[node + 1]; i++) {
+        const reached_t *other = table_find(&search->table, arcs[i].node);
+        if (other && other->dist != UINT64_MAX && other->dist + arcs[i].weight < dist) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int path_push(node_list_t *path, uint32_t node) {
+    if (path->count == path->capacity) {
+        size_t capacity = path->capacity ? path->capacity * 2 : ROAD_INITIAL_PATH;
+        uint32_t *nodes = realloc(path->nodes, capacity * sizeof(*nodes));
+        if (!nodes) {
+            return -1;
+        }
+        path->nodes = nodes;
+        path->capacity = capacity;
+    }
+    path->nodes[path->count++] = node;
+    return 0;
+}
+
+static const road_arc_t* find_arc(const uint32_t *first, const road_arc_t *arcs, uint32_t node, uint32_t other) {
+    for (uint32_t i = first[node]; i < first[node + 1]; i++) {
+        if (arcs[i].node == other) {
+            return &arcs[i];
+        }
+    }
+    return NULL;
+}
+
+// Append the road nodes after `from` on the arc from -> to
+static int unpack_arc(node_list_t *path, uint32_t from, uint32_t to, uint32_t mid) {
+    if (mid == ROAD_ARC_ORIGINAL) {
+        return path_push(path, to);
+    }
+    const road_arc_t *first_half = find_arc(graph.down_first, graph.down, mid, from);
+    const road_arc_t *second_half = find_arc(graph.up_first, graph.up, mid, to);
+    if (!first_half || !second_half) {
+        return -1;
+    }
+    if (unpack_arc(path, from, mid, first_half->mid) != 0) {
+        return -1;
+    }
+    return unpack_arc(path, mid, to, second_half->mid);
+}
+
+// Copy the unpacked path into `arena` memory
+static int finish_path(arena_t *arena, node_list_t *path, road_route_t *route) {
+    route->nodes = arena_alloc(arena, path->count * sizeof(uint32_t));
+    if (!route->nodes) {
+        return ROAD_GRAPH_NO_MEMORY;
+    }
+    memcpy(route->nodes, path->nodes, path->count * sizeof(uint32_t));
+    route->node_count = path->count;
+    return 0;
+}
+
+// Forward search up from the start, backward search up from the end (reading down
+// arcs, whose `node` is the tail), alternating on the smaller queue head. Each side
+// stops once its head reaches the best meeting distance found so far.
+static int query_ch(arena_t *arena, uint32_t start, uint32_t end, road_route_t *route) {
+    search_t forward, backward;
+    node_list_t path = { NULL, 0, 0 };
+    int result = ROAD_GRAPH_NO_MEMORY;
+    int backward_ready = 0;
+    if (search_init(&forward, start, graph.up_first, graph.up) != 0) {
+        goto done;
+    }
+    if (search_init(&backward, end, graph.down_first, graph.down) != 0) {
+        goto done;
+    }
+    backward_ready = 1;
+
+    uint64_t best = UINT64_MAX;
+    uint32_t meet = ROAD_NO_NODE;
+    while (forward.queue.size > 0 || backward.queue.size > 0) {
+        int go_forward = backward.queue.size == 0 ||
+                         (forward.queue.size > 0 && forward.queue.entries[0].dist <= backward.queue.entries[0].dist);
+        search_t *self = go_forward ? &forward : &backward;
+        search_t *other = go_forward ? &backward : &forward;
+        uint64_t dist;
+        uint32_t node = search_settle(self, best, &dist);
+        if (node == ROAD_NO_NODE) {
+            continue;
+        }
+        route->settled++;
+        const reached_t *met = table_find(&other->table, node);
+        if (met && met->dist != UINT64_MAX && dist + met->dist < best) {
+            best = dist + met->dist;
+            meet = node;
+        }
+        if (search_stalled(self, node, dist, other->first, other->arcs)) {
+            continue;
+        }
+        if (search_relax(self, node, dist) != 0) {
+            goto done;
+        }
+    }
+    if (meet == ROAD_NO_NODE) {
+        result = ROAD_GRAPH_NO_PATH;
+        goto done;
+    }
+
+    // Forward half: collect the upward chain meet <- ... <- start, then unpack it start first
+    size_t up_hops = 0;
+    for (const reached_t *r = table_find(&forward.table, meet); r->parent != ROAD_NO_NODE;
+         r = table_find(&forward.table, r->parent)) {
+        up_hops++;
+    }
+    const road_arc_t **chain = malloc((up_hops ? up_hops : 1) * sizeof(*chain));
+    uint32_t *tails = malloc((up_hops ? up_hops : 1) * sizeof(*tails));
+    if (!chain || !tails) {
+        free(chain);
+        free(tails);
+        goto done;
+    }
+    size_t i = up_hops;
+    for (const reached_t *r = table_find(&forward.table, meet); r->parent != ROAD_NO_NODE;
+         r = table_find(&forward.table, r->parent)) {
+        chain[--i] = &graph.up[r->arc];
+        tails[i] = r->parent;
+    }
+    int ok = path_push(&path, start) == 0;
+    for (i = 0; ok && i < up_hops; i++) {
+        ok = unpack_arc(&path, tails[i], chain[i]->node, chain[i]->mid) == 0;
+    }
+    free(chain);
+    free(tails);
+
+    // Backward half: each down arc runs from the node toward its parent, the end side
+    for (const reached_t *r = table_find(&backward.table, meet); ok && r->parent != ROAD_NO_NODE;
+         r = table_find(&backward.table, r->parent)) {
+        const road_arc_t *arc = &graph.down[r->arc];
+        ok = unpack_arc(&path, arc->node, r->parent, arc->mid) == 0;
+    }
+    if (!ok) {
+        goto done;
+    }
+    route->distance_m = best / 10.0;
+    result = finish_path(arena, &path, route);
+
+done:
+    search_free(&forward);
+    if (backward_ready) {
+        search_free(&backward);
+    }
+    free(path.nodes);
+    return result;
+}
+
+static int query_dijkstra(arena_t *arena, uint32_t start, uint32_t end, road_route_t *route) {
+    search_t search;
+    node_list_t path = { NULL, 0, 0 };
+    int result = ROAD_GRAPH_NO_MEMORY;
+    if (search_init(&search, start, graph.base_first, graph.base_arcs) != 0) {
+        goto done;
+    }
+    uint64_t dist;
+    uint32_t node;
+    while ((node = search_settle(&search, UINT64_MAX, &dist)) != ROAD_NO_NODE) {
+        route->settled++;
+        if (node == end) {
+            break;
+        }
+        if (search_relax(&search, node, dist) != 0) {
+            goto done;
+        }
+    }
+    if (node != end) {
+        result = ROAD_GRAPH_NO_PATH;
+        goto done;
+    }
+
+    for (const reached_t *r = table_find(&search.table, end); r; r = r->parent != ROAD_NO_NODE ?
+         table_find(&search.table, r->parent) : NULL) {
+        if (path_push(&path, r->key - 1) != 0) {
+            goto done;
+        }
+    }
+    for (size_t i = 0; i < path.count / 2; i++) {
+        uint32_t swap = path.nodes[i];
+        path.nodes[i] = path.nodes[path.count - 1 - i];
+        path.nodes[path.count - 1 - i] = swap;
+    }
+    route->distance_m = dist / 10.0;
+    result = finish_path(arena, &path, route);
+
+done:
+    search_free(&search);
+    free(path.nodes);
+    return result;
+}
+
+int road_graph_query(arena_t *arena, uint32_t start, uint32_t end, road_query_t algorithm, road_route_t *route) {
+    memset(route, 0, sizeof(*route));
+    if (!graph_loaded) {
+        return ROAD_GRAPH_NOT_LOADED;
+    }
+    if (start >= graph.header->node_count || end >= graph.header->node_count) {
+        return ROAD_GRAPH_NO_PATH;
+    }
+    stat_add(&road_stats.queries, 1);
+    int result = algorithm == ROAD_QUERY_DIJKSTRA ? query_dijkstra(arena, start, end, route)
+                                                  : query_ch(arena, start, end, route);
+    stat_add(&road_stats.settled, route->settled);
+    if (result == 0) {
+        stat_add(&road_stats.found, 1);
+    }
+    return result;
+}
+
+int road_graph_route(arena_t *arena, double start_lat, double start_lng, double end_lat, double end_lng,
+                     road_route_t *route) {
+    memset(route, 0, sizeof(*route));
+    uint32_t start, end;
+    double start_m, end_m;
+    int result = road_graph_snap(start_lat, start_lng, &start, &start_m);
+    if (result == 0) {
+        result = road_graph_snap(end_lat, end_lng, &end, &end_m);
+    }
+    if (result == ROAD_GRAPH_NO_SNAP) {
+        stat_add(&road_stats.snap_failures, 1);
+    }
+    if (result != 0) {
+        return result;
+    }
+    result = road_graph_query(arena, start, end, ROAD_QUERY_CH, route);
+    route->snap_start_m = start_m;
+    route->snap_end_m = end_m;
+    return result;
+}
+
+void road_graph_get_stats(road_graph_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (graph_loaded) {
+        stats->loaded = 1;
+        stats->nodes = graph.header->node_count;
+        stats->shortcuts = graph.shortcuts;
+        stats->file_size = graph.size;
+    }
+    stats->queries = __atomic_load_n(&road_stats.queries, __ATOMIC_RELAXED);
+    stats->found = __atomic_load_n(&road_stats.found, __ATOMIC_RELAXED);
+    stats->snap_failures = __atomic_load_n(&road_stats.snap_failures, __ATOMIC_RELAXED);
+    stats->settled = __atomic_load_n(&road_stats.settled, __ATOMIC_RELAXED);
+}
+
+json_object* road_graph_stats_to_json(void) {
+    road_graph_stats_t stats;
+    road_graph_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "loaded", json_object_new_boolean(stats.loaded));
+    json_object_object_add(obj, "nodes", json_object_new_int64((int64_t)stats.nodes));
+    json_object_object_add(obj, "shortcuts", json_object_new_int64((int64_t)stats.shortcuts));
+    json_object_object_add(obj, "file_bytes", json_object_new_int64((int64_t)stats.file_size));
+    json_object_object_add(obj, "queries", json_object_new_int64((int64_t)stats.queries));
+    json_object_object_add(obj, "found", json_object_new_int64((int64_t)stats.found));
+    json_object_object_add(obj, "snap_failures", json_object_new_int64((int64_t)stats.snap_failures));
+    json_object_object_add(obj, "settled", json_object_new_int64((int64_t)stats.settled));
+    return obj;
+}
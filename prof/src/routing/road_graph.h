@@ -0,0 +1,107 @@
+#ifndef ROAD_GRAPH_H
+#define ROAD_GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <h3/h3api.h>
+#include <json-c/json.h>
+#include "../utils/arena.h"
+
+// Road network routing over a contraction hierarchy. The graph is built offline from an
+// OSM-derived edge list (see ch_build.h) and mapped read-only at startup. Every node has
+// a rank; contracting nodes in rank order added shortcut arcs that skip the lower ones,
+// so a query only ever climbs: forward from the start over arcs to higher-ranked nodes,
+// backward from the end the same way, meeting at the top.
+//
+// File layout, all sections in node order (nodes are numbered by their snap cell, so
+// nearby nodes sit close together in every section):
+//   road_graph_header_t
+//   uint64_t cells[node_count]        snap_res cell of each node, sorted: the snap index
+//   int32_t  lat_e7[node_count], lng_e7[node_count]
+//   uint32_t up_first[node_count + 1],   road_arc_t up[up_count]      arcs to higher-ranked nodes
+//   uint32_t down_first[node_count + 1], road_arc_t down[down_count]  arcs from higher-ranked nodes
+//   uint32_t base_first[node_count + 1], road_arc_t base[base_count]  the input graph, for plain Dijkstra
+#define ROAD_GRAPH_MAGIC "GEOROAD1"
+#define ROAD_GRAPH_VERSION 1
+#define ROAD_ARC_ORIGINAL UINT32_MAX      // road_arc_t.mid of an arc that is a real road segment
+
+// Failures; below -1 so write_road_route() can keep -1 for a missing user position
+#define ROAD_GRAPH_NO_PATH -2             // Start and end are not connected
+#define ROAD_GRAPH_NO_SNAP -3             // No node near the start or end point
+#define ROAD_GRAPH_NO_MEMORY -4
+#define ROAD_GRAPH_NOT_LOADED -5
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t snap_res;
+    uint32_t node_count;
+    uint32_t up_count;
+    uint32_t down_count;
+    uint32_t base_count;
+    uint8_t reserved[32];
+} road_graph_header_t;
+
+// Weights are decimetres. In `up` arcs `node` is the head; in `down` arcs it is the
+// tail, so both searches read their own node's list. A shortcut's `mid` is the node it
+// skips: a -> b via m unpacks to a -> m (in down[m]) and m -> b (in up[m]).
+typedef struct {
+    uint32_t node;
+    uint32_t weight;
+    uint32_t mid;
+} road_arc_t;
+
+typedef enum {
+    ROAD_QUERY_CH,                 // Bidirectional search over the hierarchy
+    ROAD_QUERY_DIJKSTRA            // Plain Dijkstra over the input graph; for comparison
+} road_query_t;
+
+typedef struct {
+    uint32_t *nodes;               // Start node first, end node last
+    size_t node_count;
+    double distance_m;             // Along the road, between the snapped nodes
+    double snap_start_m;           // From the requested points to the nodes they snapped to
+    double snap_end_m;
+    size_t settled;                // Nodes taken off the queues, both directions
+} road_route_t;
+
+typedef struct {
+    int loaded;
+    unsigned long nodes;
+    unsigned long shortcuts;       // Hierarchy arcs that are not road segments
+    size_t file_size;
+    unsigned long queries;
+    unsigned long found;
+    unsigned long snap_failures;
+    unsigned long settled;         // Summed over all queries
+} road_graph_stats_t;
+
+// Map a graph file written by ch_build and make it the one routes use. Call before
+// worker threads start. Returns -1 (keeping any previous graph) if the file is missing
+// or malformed.
+int road_graph_load(const char *path);
+
+// Non-zero while a graph is loaded
+int road_graph_loaded(void);
+
+void road_graph_unload(void);
+
+// Nearest node within ROAD_GRAPH_SNAP_RINGS cells of the point (degrees); *distance_m
+// is how far it is. Returns ROAD_GRAPH_NO_SNAP when the area has no roads.
+int road_graph_snap(double lat, double lng, uint32_t *node, double *distance_m);
+
+// Position of a node, in degrees
+void road_graph_node_latlng(uint32_t node, double *lat, double *lng);
+
+// Shortest route between two nodes. route->nodes comes from `arena` (the heap when
+// NULL). Returns 0 or one of the ROAD_GRAPH_* codes.
+int road_graph_query(arena_t *arena, uint32_t start, uint32_t end, road_query_t algorithm, road_route_t *route);
+
+// Snap both points and route between them with the hierarchy
+int road_graph_route(arena_t *arena, double start_lat, double start_lng, double end_lat, double end_lng,
+                     road_route_t *route);
+
+void road_graph_get_stats(road_graph_stats_t *stats);
+json_object* road_graph_stats_to_json(void);
+
+#endif // ROAD_GRAPH_H
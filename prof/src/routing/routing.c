@@ -1,85 +1,125 @@
 #include "routing.h"
 #include "../api.h"
 #include "../location/location.h"
+#include "../coordinate_logger.h"
+#include "road_graph.h"
+#include "../utils/json_writer.h"
+#include "../utils/arena.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <libpq-fe.h>
 
-// Calculate route between two points
-json_object* calculate_route(double start_lat, double start_lon, const char* end_user_id) {
+// Write the route between two points to `out` as {"path": [...], "distance": meters}
+int write_route(arena_t *arena, json_writer_t *out, double start_lat, double start_lon, const char* end_user_id) {
     if (!end_user_id) {
-        return NULL;
-    }
-    
-    // Get end user's location from database
-    PGconn *conn = PQconnectdb(CONN_STR);
-    if (PQstatus(conn) != CONNECTION_OK) {
-        fprintf(stderr, "Database connection failed: %s", PQerrorMessage(conn));
-        PQfinish(conn);
-        return NULL;
+        return -1;
     }
     
-    char query[512];
-    snprintf(query, sizeof(query), 
-             "SELECT ST_Y(location), ST_X(location) FROM user_locations WHERE user_id = '%s' ORDER BY updated_at DESC LIMIT 1;", end_user_id);
-    
-    PGresult *res = PQexec(conn, query);
-    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0) {
-        PQclear(res);
-        PQfinish(conn);
-        return NULL;
+    // Get end user's latest location
+    double end_lat, end_lon;
+    if (get_user_position(end_user_id, &end_lat, &end_lon) != 0) {
+        return -1;
     }
     
-    double end_lat = atof(PQgetvalue(res, 0, 0));
-    double end_lon = atof(PQgetvalue(res, 0, 1));
-    PQclear(res);
-    PQfinish(conn);
-    
     // Convert coordinates to H3 indexes
     H3Index start_h3 = latlng_to_h3(start_lat, start_lon, 9);
     H3Index end_h3 = latlng_to_h3(end_lat, end_lon, 9);
     
     // Get A* path between the two H3 indexes
     H3Index *path = NULL;
-    int pathSize = get_astar_path(start_h3, end_h3, &path);
+    int pathSize = get_astar_path(arena, start_h3, end_h3, &path);
     
     if (pathSize < 0) {
-        return NULL;
+        return -1;
     }
     
     // Calculate total distance along the path
     double totalDistance = 0.0;
-    json_object *path_array = json_object_new_array();
+    json_writer_begin_object(out);
+    json_writer_key(out, "path");
+    json_writer_begin_array(out);
     
     for (int i = 0; i < pathSize; i++) {
         LatLng coord;
         cellToLatLng(path[i], &coord);
         
         // Add point to path array
-        json_object *point_obj = json_object_new_object();
-        json_object_object_add(point_obj, "lat", json_object_new_double(radsToDegs(coord.lat)));
-        json_object_object_add(point_obj, "lng", json_object_new_double(radsToDegs(coord.lng)));
-        json_object_array_add(path_array, point_obj);
+        json_writer_begin_object(out);
+        json_writer_key(out, "lat");
+        json_writer_double(out, radsToDegs(coord.lat));
+        json_writer_key(out, "lng");
+        json_writer_double(out, radsToDegs(coord.lng));
+        json_writer_end_object(out);
         
         // Calculate distance to next point
         if (i < pathSize - 1) {
-            int64_t distance;
-            gridDistance(path[i], path[i + 1], &distance);
-            totalDistance += distance;
+            totalDistance += h3_distance(path[i], path[i + 1]);
         }
     }
+    json_writer_end_array(out);
     
-    // Create response with path and distance
-    json_object *response_obj = json_object_new_object();
-    json_object_object_add(response_obj, "path", path_array);
-    json_object_object_add(response_obj, "distance", json_object_new_double(totalDistance * 1000.0)); // Convert to meters
+    // Distance follows the path
+    json_writer_key(out, "distance");
+    json_writer_double(out, totalDistance * 1000.0); // Convert to meters
+    json_writer_end_object(out);
     
     // Clean up
-    free(path);
+    if (!arena) {
+        free(path);
+    }
     
-    return response_obj;
+    return 0;
+}
+
+// Write the road route between a point and a user to `out`: the path of road nodes,
+// the distance along them in meters, how far each end snapped, and the search size
+int write_road_route(arena_t *arena, json_writer_t *out, double start_lat, double start_lon, const char* end_user_id) {
+    if (!end_user_id) {
+        return -1;
+    }
+    double end_lat, end_lon;
+    if (get_user_position(end_user_id, &end_lat, &end_lon) != 0) {
+        return -1;
+    }
+
+    road_route_t route;
+    int result = road_graph_route(arena, start_lat, start_lon, end_lat, end_lon, &route);
+    if (result != 0) {
+        return result;
+    }
+
+    json_writer_begin_object(out);
+    json_writer_key(out, "path");
+    json_writer_begin_array(out);
+    for (size_t i = 0; i < route.node_count; i++) {
+        double lat, lng;
+        road_graph_node_latlng(route.nodes[i], &lat, &lng);
+        json_writer_begin_object(out);
+        json_writer_key(out, "lat");
+        json_writer_double(out, lat);
+        json_writer_key(out, "lng");
+        json_writer_double(out, lng);
+        json_writer_end_object(out);
+    }
+    json_writer_end_array(out);
+    json_writer_key(out, "distance");
+    json_writer_double(out, route.distance_m);
+    json_writer_key(out, "mode");
+    json_writer_string(out, "road");
+    json_writer_key(out, "snap_start_m");
+    json_writer_double(out, route.snap_start_m);
+    json_writer_key(out, "snap_end_m");
+    json_writer_double(out, route.snap_end_m);
+    json_writer_key(out, "settled");
+    json_writer_int(out, (int64_t)route.settled);
+    json_writer_end_object(out);
+
+    if (!arena) {
+        free(route.nodes);
+    }
+    return 0;
 }
 
 // Calculate H3 route distance
@@ -116,7 +156,7 @@ json_object* get_h3_route_path(H3Index start, H3Index end) {
 // Calculate A* route distance
 double calculate_astar_route_distance(H3Index start, H3Index end) {
     H3Index *path = NULL;
-    int pathSize = get_astar_path(start, end, &path);
+    int pathSize = get_astar_path(NULL, start, end, &path);
     
     if (pathSize < 0) {
         return -1;
@@ -134,7 +174,7 @@ double calculate_astar_route_distance(H3Index start, H3Index end) {
 // Get A* route path
 json_object* get_astar_route_path(H3Index start, H3Index end) {
     H3Index *path = NULL;
-    int pathSize = get_astar_path(start, end, &path);
+    int pathSize = get_astar_path(NULL, start, end, &path);
     
     if (pathSize < 0) {
         return NULL;
@@ -157,7 +197,7 @@ json_object* get_astar_route_path(H3Index start, H3Index end) {
 }
 
 // Find nearby places using Kring algorithm
-json_object* find_nearby_places(double lat, double lon, int radius_km) {
+int write_nearby_places(arena_t *arena, json_writer_t *out, double lat, double lon, int radius_km) {
     // Convert to H3 index
     H3Index center = latlng_to_h3(lat, lon, 9);
     
@@ -167,22 +207,22 @@ json_object* find_nearby_places(double lat, double lon, int radius_km) {
     if (k < 1) k = 1;
     if (k > 10) k = 10; // Limit to reasonable range
     
-    return get_kring_cells(center, k);
+    return write_kring_cells(arena, out, center, k);
 }
 
-// Get Kring cells around a center point
-json_object* get_kring_cells(H3Index center, int k) {
+// Write the cells k steps around a center point to `out` as a JSON array
+int write_kring_cells(arena_t *arena, json_writer_t *out, H3Index center, int k) {
     int64_t maxCells;
     maxGridRingSize(k, &maxCells);
-    H3Index* kring = malloc(maxCells * sizeof(H3Index));
+    H3Index* kring = arena_alloc(arena, maxCells * sizeof(H3Index));
     
     if (!kring) {
-        return NULL;
+        return -1;
     }
     
     gridRing(center, k, kring);
     
-    json_object *cells_array = json_object_new_array();
+    json_writer_begin_array(out);
     
     for (int i = 0; i < maxCells; i++) {
         if (kring[i] == 0) break; // End of valid cells
@@ -190,13 +230,21 @@ json_object* get_kring_cells(H3Index center, int k) {
         LatLng coord;
         cellToLatLng(kring[i], &coord);
         
-        json_object *cell_obj = json_object_new_object();
-        json_object_object_add(cell_obj, "h3_index", json_object_new_string("")); // You'd convert to string
-        json_object_object_add(cell_obj, "lat", json_object_new_double(radsToDegs(coord.lat)));
-        json_object_object_add(cell_obj, "lng", json_object_new_double(radsToDegs(coord.lng)));
-        json_object_array_add(cells_array, cell_obj);
+        char h3_str[17];
+        h3ToString(kring[i], h3_str, sizeof(h3_str));
+        json_writer_begin_object(out);
+        json_writer_key(out, "h3_index");
+        json_writer_string(out, h3_str);
+        json_writer_key(out, "lat");
+        json_writer_double(out, radsToDegs(coord.lat));
+        json_writer_key(out, "lng");
+        json_writer_double(out, radsToDegs(coord.lng));
+        json_writer_end_object(out);
     }
+    json_writer_end_array(out);
     
-    free(kring);
-    return cells_array;
+    if (!arena) {
+        free(kring);
+    }
+    return 0;
 }
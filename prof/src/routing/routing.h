@@ -3,9 +3,16 @@
 
 #include <json-c/json.h>
 #include <h3/h3api.h>
+#include "../utils/json_writer.h"
+#include "../utils/arena.h"
 
-// Route calculation functions
-json_object* calculate_route(double start_lat, double start_lon, const char* end_user_id);
+// Route calculation functions; write JSON to `out` and return 0 on success. Scratch
+// memory comes from `arena` (the heap when NULL).
+int write_route(arena_t *arena, json_writer_t *out, double start_lat, double start_lon, const char* end_user_id);
+
+// Same, along the road graph (road_graph.h); returns 0, -1 when the user has no
+// position, or a ROAD_GRAPH_* code
+int write_road_route(arena_t *arena, json_writer_t *out, double start_lat, double start_lon, const char* end_user_id);
 
 // H3 routing functions
 double calculate_h3_route_distance(H3Index start, H3Index end);
@@ -16,7 +23,7 @@ double calculate_astar_route_distance(H3Index start, H3Index end);
 json_object* get_astar_route_path(H3Index start, H3Index end);
 
 // Kring routing functions (for finding nearby places)
-json_object* find_nearby_places(double lat, double lon, int radius_km);
-json_object* get_kring_cells(H3Index center, int k);
+int write_nearby_places(arena_t *arena, json_writer_t *out, double lat, double lon, int radius_km);
+int write_kring_cells(arena_t *arena, json_writer_t *out, H3Index center, int k);
 
 #endif // ROUTING_H
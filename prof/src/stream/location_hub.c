@@ -0,0 +1,525 @@
+#define _GNU_SOURCE
+#include "location_hub.h"
+#include "../api.h"
+#include "../auth/friend_graph.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define HUB_SHARDS 64          // Power of two
+#define HUB_BUCKETS_PER_SHARD 256
+#define HUB_EVENT_TEXT_MAX 512
+
+typedef enum {
+    HUB_EVENT_LOCATION,
+    HUB_EVENT_FRIENDS_CHANGED
+} hub_event_type_t;
+
+// Queued events are small fixed records; text is produced by the stream's own reader
+typedef struct {
+    hub_event_type_t type;
+    int32_t user_id;
+    int accuracy;
+    double latitude;
+    double longitude;
+    int64_t updated_at_ms;
+} hub_event_t;
+
+struct location_hub_subscriber {
+    struct location_hub_subscriber *next; // Bucket chain, guarded by the shard lock
+    int32_t user_id;
+    struct MHD_Connection *connection;    // SSE streams
+    void (*wake)(void *ctx);              // Other transports
+    void *wake_ctx;
+
+    pthread_mutex_t lock;              // Guards the queue and flags below
+    pthread_cond_t ready;              // Blocking mode only
+    hub_event_t queue[STREAM_QUEUE_DEPTH];
+    unsigned int head;
+    unsigned int count;
+    int suspended;
+    int overflowed;
+    int keepalive_due;
+
+    // Only the stream's reader touches these, and MHD never runs it twice at once
+    char *snapshot;
+    size_t snapshot_len;
+    size_t snapshot_pos;
+    char out[HUB_EVENT_TEXT_MAX];      // Event being written, possibly across reader calls
+    size_t out_len;
+    size_t out_pos;
+};
+
+typedef struct location_hub_subscriber subscriber_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    subscriber_t *buckets[HUB_BUCKETS_PER_SHARD];
+} hub_shard_t;
+
+static hub_shard_t shards[HUB_SHARDS];
+static int hub_enabled = 0;
+static int hub_closing = 0;
+static int hub_blocking = 0;
+static pthread_t keepalive_thread;
+static pthread_mutex_t keepalive_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t keepalive_wake;
+static location_hub_stats_t hub_stats;
+
+static inline uint32_t mix(int32_t user_id) {
+    uint32_t h = (uint32_t)user_id * 0x9e3779b1U;
+    return h ^ (h >> 16);
+}
+
+static hub_shard_t* shard_for(int32_t user_id) {
+    return &shards[mix(user_id) & (HUB_SHARDS - 1)];
+}
+
+static subscriber_t** bucket_for(hub_shard_t *shard, int32_t user_id) {
+    return &shard->buckets[(mix(user_id) >> 8) & (HUB_BUCKETS_PER_SHARD - 1)];
+}
+
+// Wake a subscriber's reader. Caller holds sub->lock.
+static void wake_locked(subscriber_t *sub) {
+    if (sub->wake) {
+        sub->wake(sub->wake_ctx);
+    } else if (hub_blocking) {
+        pthread_cond_signal(&sub->ready);
+    } else if (sub->suspended) {
+        sub->suspended = 0;
+        MHD_resume_connection(sub->connection);
+    }
+}
+
+// Queue an event for one subscriber; a full queue marks it as a slow consumer to be dropped
+static void enqueue_locked(subscriber_t *sub, const hub_event_t *event) {
+    if (sub->overflowed) {
+        return;
+    }
+    if (sub->count == STREAM_QUEUE_DEPTH) {
+        sub->overflowed = 1;
+        stat_add(&hub_stats.dropped_slow, 1);
+    } else {
+        sub->queue[(sub->head + sub->count) % STREAM_QUEUE_DEPTH] = *event;
+        sub->count++;
+        stat_add(&hub_stats.enqueued, 1);
+    }
+    wake_locked(sub);
+}
+
+// Deliver an event to every stream the user has open. Caller holds the shard lock.
+static void deliver_to_user_locked(hub_shard_t *shard, int32_t user_id, const hub_event_t *event) {
+    for (subscriber_t *sub = *bucket_for(shard, user_id); sub; sub = sub->next) {
+        if (sub->user_id == user_id) {
+            pthread_mutex_lock(&sub->lock);
+            enqueue_locked(sub, event);
+            pthread_mutex_unlock(&sub->lock);
+        }
+    }
+}
+
+static void deliver_to_friend(int32_t friend_id, const char *username, void *ctx) {
+    (void)username;
+    hub_shard_t *shard = shard_for(friend_id);
+    pthread_mutex_lock(&shard->lock);
+    deliver_to_user_locked(shard, friend_id, ctx);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void location_hub_publish(int32_t user_id, double latitude, double longitude, int accuracy,
+                          int64_t updated_at_ms) {
+    if (!hub_enabled || __atomic_load_n(&hub_stats.subscribers, __ATOMIC_RELAXED) == 0) {
+        return;
+    }
+    stat_add(&hub_stats.published, 1);
+
+    hub_event_t event = {
+        .type = HUB_EVENT_LOCATION,
+        .user_id = user_id,
+        .accuracy = accuracy,
+        .latitude = latitude,
+        .longitude = longitude,
+        .updated_at_ms = updated_at_ms,
+    };
+    friend_graph_for_each(user_id, deliver_to_friend, &event);
+}
+
+void location_hub_notify_friends_changed(int32_t user_id) {
+    if (!hub_enabled) {
+        return;
+    }
+    hub_event_t event = { .type = HUB_EVENT_FRIENDS_CHANGED, .user_id = user_id };
+    hub_shard_t *shard = shard_for(user_id);
+    pthread_mutex_lock(&shard->lock);
+    deliver_to_user_locked(shard, user_id, &event);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Render an event's JSON payload; returns its length, or 0 if it did not fit
+static size_t format_payload(const hub_event_t *event, char *buf, size_t size) {
+    if (event->type == HUB_EVENT_FRIENDS_CHANGED) {
+        return (size_t)snprintf(buf, size, "{}");
+    }
+
+    char username[64], timestamp[32];
+    friend_graph_username(event->user_id, username, sizeof(username));
+    time_t seconds = (time_t)(event->updated_at_ms / 1000);
+    struct tm tm_utc;
+    gmtime_r(&seconds, &tm_utc);
+    size_t n = strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%S", &tm_utc);
+    snprintf(timestamp + n, sizeof(timestamp) - n, ".%03dZ", (int)(event->updated_at_ms % 1000));
+
+    // Usernames are validated at registration, but escape the JSON specials regardless
+    json_object *name = json_object_new_string(username);
+    int len = snprintf(buf, size,
+        "{\"user_id\":\"%d\",\"username\":%s,\"latitude\":%.7f,\"longitude\":%.7f,"
+        "\"accuracy\":%d,\"timestamp\":\"%s\",\"updated_at_ms\":%lld}",
+        event->user_id, json_object_to_json_string(name), event->latitude, event->longitude,
+        event->accuracy, timestamp, (long long)event->updated_at_ms);
+    json_object_put(name);
+    return len > 0 && (size_t)len < size ? (size_t)len : 0;
+}
+
+static const char* event_name(const hub_event_t *event) {
+    return event->type == HUB_EVENT_FRIENDS_CHANGED ? "friends" : "location";
+}
+
+// Render one queued event as SSE text into sub->out
+static void format_event(subscriber_t *sub, const hub_event_t *event) {
+    char payload[HUB_EVENT_TEXT_MAX - 32];
+    size_t len = format_payload(event, payload, sizeof(payload));
+    int n = len ? snprintf(sub->out, sizeof(sub->out), "event: %s\ndata: %s\n\n", event_name(event), payload) : 0;
+    sub->out_len = n > 0 && (size_t)n < sizeof(sub->out) ? (size_t)n : 0;
+    sub->out_pos = 0;
+}
+
+// Copy as much already rendered text as fits into buf: the event being written, then
+// the snapshot
+static size_t fill_text(subscriber_t *sub, char *buf, size_t max) {
+    size_t written = 0;
+    while (written < max) {
+        if (sub->out_pos < sub->out_len) {
+            size_t n = sub->out_len - sub->out_pos;
+            if (n > max - written) {
+                n = max - written;
+            }
+            memcpy(buf + written, sub->out + sub->out_pos, n);
+            sub->out_pos += n;
+            written += n;
+        } else if (sub->snapshot) {
+            size_t n = sub->snapshot_len - sub->snapshot_pos;
+            if (n > max - written) {
+                n = max - written;
+            }
+            memcpy(buf + written, sub->snapshot + sub->snapshot_pos, n);
+            sub->snapshot_pos += n;
+            written += n;
+            if (sub->snapshot_pos == sub->snapshot_len) {
+                free(sub->snapshot);
+                sub->snapshot = NULL;
+            }
+        } else {
+            break;
+        }
+    }
+    return written;
+}
+
+static ssize_t stream_reader(void *cls, uint64_t pos, char *buf, size_t max) {
+    (void)pos;
+    subscriber_t *sub = cls;
+
+    size_t written = 0;
+    for (;;) {
+        written += fill_text(sub, buf + written, max - written);
+        if (written == max) {
+            return (ssize_t)written;
+        }
+
+        pthread_mutex_lock(&sub->lock);
+        if (sub->overflowed || __atomic_load_n(&hub_closing, __ATOMIC_ACQUIRE)) {
+            // Slow consumers are cut off; EventSource reconnects and gets a fresh snapshot
+            pthread_mutex_unlock(&sub->lock);
+            return MHD_CONTENT_READER_END_OF_STREAM;
+        }
+        if (sub->count > 0) {
+            hub_event_t event = sub->queue[sub->head];
+            sub->head = (sub->head + 1) % STREAM_QUEUE_DEPTH;
+            sub->count--;
+            pthread_mutex_unlock(&sub->lock);
+
+            // Formatting looks up the username under the friend graph lock, which publishers
+            // hold while taking sub->lock, so it must happen outside the subscriber lock
+            format_event(sub, &event);
+            continue;
+        }
+        if (sub->keepalive_due) {
+            sub->keepalive_due = 0;
+            pthread_mutex_unlock(&sub->lock);
+            sub->out_len = (size_t)snprintf(sub->out, sizeof(sub->out), ": keepalive\n\n");
+            sub->out_pos = 0;
+            continue;
+        }
+        if (written > 0) {
+            pthread_mutex_unlock(&sub->lock);
+            return (ssize_t)written;
+        }
+
+        if (!hub_blocking) {
+            // Nothing to send: park the connection until an event or keepalive resumes it
+            sub->suspended = 1;
+            MHD_suspend_connection(sub->connection);
+            pthread_mutex_unlock(&sub->lock);
+            return 0;
+        }
+        pthread_cond_wait(&sub->ready, &sub->lock);
+        pthread_mutex_unlock(&sub->lock);
+    }
+}
+
+// Reserve a subscriber slot and allocate it; NULL when the hub is closed or full
+static subscriber_t* subscriber_new(int32_t user_id) {
+    if (!hub_enabled || __atomic_load_n(&hub_closing, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    unsigned long current = __atomic_add_fetch(&hub_stats.subscribers, 1, __ATOMIC_RELAXED);
+    if (current > STREAM_MAX_SUBSCRIBERS) {
+        __atomic_fetch_sub(&hub_stats.subscribers, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    subscriber_t *sub = calloc(1, sizeof(subscriber_t));
+    if (!sub) {
+        __atomic_fetch_sub(&hub_stats.subscribers, 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+    sub->user_id = user_id;
+    pthread_mutex_init(&sub->lock, NULL);
+    pthread_cond_init(&sub->ready, NULL);
+
+    unsigned long peak = __atomic_load_n(&hub_stats.peak_subscribers, __ATOMIC_RELAXED);
+    while (current > peak && !__atomic_compare_exchange_n(&hub_stats.peak_subscribers, &peak, current, 1,
+                                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+    return sub;
+}
+
+// Make a subscriber visible to publishers
+static void subscriber_link(subscriber_t *sub) {
+    hub_shard_t *shard = shard_for(sub->user_id);
+    pthread_mutex_lock(&shard->lock);
+    subscriber_t **bucket = bucket_for(shard, sub->user_id);
+    sub->next = *bucket;
+    *bucket = sub;
+    pthread_mutex_unlock(&shard->lock);
+    stat_add(&hub_stats.opened, 1);
+}
+
+// Unlink (if linked) and free; no publisher can reach the subscriber afterwards
+static void subscriber_free(subscriber_t *sub) {
+    hub_shard_t *shard = shard_for(sub->user_id);
+
+    pthread_mutex_lock(&shard->lock);
+    for (subscriber_t **link = bucket_for(shard, sub->user_id); *link; link = &(*link)->next) {
+        if (*link == sub) {
+            *link = sub->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+    __atomic_fetch_sub(&hub_stats.subscribers, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_destroy(&sub->lock);
+    pthread_cond_destroy(&sub->ready);
+    free(sub->snapshot);
+    free(sub);
+}
+
+static void stream_free(void *cls) {
+    subscriber_free(cls);
+}
+
+struct MHD_Response* location_hub_open_stream(struct MHD_Connection *connection, int32_t user_id,
+                                              char *snapshot) {
+    subscriber_t *sub = subscriber_new(user_id);
+    if (!sub) {
+        free(snapshot);
+        return NULL;
+    }
+    sub->connection = connection;
+    sub->snapshot = snapshot;
+    sub->snapshot_len = snapshot ? strlen(snapshot) : 0;
+
+    struct MHD_Response *response = MHD_create_response_from_callback(MHD_SIZE_UNKNOWN, 4096,
+                                                                      &stream_reader, sub, &stream_free);
+    if (!response) {
+        subscriber_free(sub);
+        return NULL;
+    }
+    MHD_add_response_header(response, "Content-Type", "text/event-stream");
+    MHD_add_response_header(response, "Cache-Control", "no-cache");
+    MHD_add_response_header(response, "X-Accel-Buffering", "no"); // Stop proxies from buffering events
+
+    subscriber_link(sub);
+    return response;
+}
+
+location_hub_subscriber_t* location_hub_subscribe(int32_t user_id, void (*wake)(void *ctx), void *ctx) {
+    subscriber_t *sub = subscriber_new(user_id);
+    if (!sub) {
+        return NULL;
+    }
+    sub->wake = wake;
+    sub->wake_ctx = ctx;
+    subscriber_link(sub);
+    return sub;
+}
+
+int location_hub_next_message(location_hub_subscriber_t *sub, char *buf, size_t size) {
+    pthread_mutex_lock(&sub->lock);
+    if (sub->overflowed || __atomic_load_n(&hub_closing, __ATOMIC_ACQUIRE)) {
+        pthread_mutex_unlock(&sub->lock);
+        return -1;
+    }
+    if (sub->count == 0) {
+        pthread_mutex_unlock(&sub->lock);
+        return 0;
+    }
+    hub_event_t event = sub->queue[sub->head];
+    sub->head = (sub->head + 1) % STREAM_QUEUE_DEPTH;
+    sub->count--;
+    pthread_mutex_unlock(&sub->lock);
+
+    // Formatting looks up the username, so do it outside the subscriber lock
+    char payload[HUB_EVENT_TEXT_MAX - 32];
+    size_t len = format_payload(&event, payload, sizeof(payload));
+    int n = len ? snprintf(buf, size, "{\"event\":\"%s\",\"data\":%s}", event_name(&event), payload) : 0;
+    return n > 0 && (size_t)n < size ? n : 0;
+}
+
+void location_hub_unsubscribe(location_hub_subscriber_t *sub) {
+    if (sub) {
+        subscriber_free(sub);
+    }
+}
+
+// Apply fn to every open stream with its lock held
+static void for_each_subscriber(void (*fn)(subscriber_t *sub)) {
+    for (int i = 0; i < HUB_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        for (int b = 0; b < HUB_BUCKETS_PER_SHARD; b++) {
+            for (subscriber_t *sub = shards[i].buckets[b]; sub; sub = sub->next) {
+                pthread_mutex_lock(&sub->lock);
+                fn(sub);
+                pthread_mutex_unlock(&sub->lock);
+            }
+        }
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+}
+
+static void send_keepalive(subscriber_t *sub) {
+    // Streams with queued events are about to write anyway; other transports ping themselves
+    if (!sub->wake && sub->count == 0 && !sub->keepalive_due) {
+        sub->keepalive_due = 1;
+        stat_add(&hub_stats.keepalives, 1);
+        wake_locked(sub);
+    }
+}
+
+static void close_stream(subscriber_t *sub) {
+    wake_locked(sub);
+}
+
+static void* keepalive_main(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&keepalive_lock);
+    while (!hub_closing) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += STREAM_KEEPALIVE_SEC;
+        while (!hub_closing && pthread_cond_timedwait(&keepalive_wake, &keepalive_lock, &deadline) == 0) {
+        }
+        if (hub_closing) {
+            break;
+        }
+        pthread_mutex_unlock(&keepalive_lock);
+        for_each_subscriber(send_keepalive);
+        pthread_mutex_lock(&keepalive_lock);
+    }
+    pthread_mutex_unlock(&keepalive_lock);
+    return NULL;
+}
+
+int location_hub_init(int blocking_reads) {
+    if (hub_enabled) {
+        return 0;
+    }
+    for (int i = 0; i < HUB_SHARDS; i++) {
+        pthread_mutex_init(&shards[i].lock, NULL);
+        memset(shards[i].buckets, 0, sizeof(shards[i].buckets));
+    }
+    hub_blocking = blocking_reads;
+    hub_closing = 0;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&keepalive_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&keepalive_thread, NULL, keepalive_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start stream keepalive thread\n");
+        pthread_cond_destroy(&keepalive_wake);
+        return -1;
+    }
+    hub_enabled = 1;
+    return 0;
+}
+
+int location_hub_enabled(void) {
+    return hub_enabled && !__atomic_load_n(&hub_closing, __ATOMIC_ACQUIRE);
+}
+
+void location_hub_shutdown(void) {
+    if (!hub_enabled) {
+        return;
+    }
+    pthread_mutex_lock(&keepalive_lock);
+    __atomic_store_n(&hub_closing, 1, __ATOMIC_RELEASE);
+    pthread_cond_signal(&keepalive_wake);
+    pthread_mutex_unlock(&keepalive_lock);
+    pthread_join(keepalive_thread, NULL);
+
+    // Resume every parked stream so its reader sees hub_closing and ends it
+    for_each_subscriber(close_stream);
+}
+
+void location_hub_get_stats(location_hub_stats_t *stats) {
+    stats->subscribers = __atomic_load_n(&hub_stats.subscribers, __ATOMIC_RELAXED);
+    stats->peak_subscribers = __atomic_load_n(&hub_stats.peak_subscribers, __ATOMIC_RELAXED);
+    stats->opened = __atomic_load_n(&hub_stats.opened, __ATOMIC_RELAXED);
+    stats->published = __atomic_load_n(&hub_stats.published, __ATOMIC_RELAXED);
+    stats->enqueued = __atomic_load_n(&hub_stats.enqueued, __ATOMIC_RELAXED);
+    stats->dropped_slow = __atomic_load_n(&hub_stats.dropped_slow, __ATOMIC_RELAXED);
+    stats->keepalives = __atomic_load_n(&hub_stats.keepalives, __ATOMIC_RELAXED);
+}
+
+json_object* location_hub_stats_to_json(void) {
+    location_hub_stats_t stats;
+    location_hub_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(location_hub_enabled()));
+    json_object_object_add(obj, "subscribers", json_object_new_int64((int64_t)stats.subscribers));
+    json_object_object_add(obj, "peak_subscribers", json_object_new_int64((int64_t)stats.peak_subscribers));
+    json_object_object_add(obj, "opened", json_object_new_int64((int64_t)stats.opened));
+    json_object_object_add(obj, "published", json_object_new_int64((int64_t)stats.published));
+    json_object_object_add(obj, "enqueued", json_object_new_int64((int64_t)stats.enqueued));
+    json_object_object_add(obj, "dropped_slow", json_object_new_int64((int64_t)stats.dropped_slow));
+    json_object_object_add(obj, "keepalives", json_object_new_int64((int64_t)stats.keepalives));
+    return obj;
+}
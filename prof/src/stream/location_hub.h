@@ -0,0 +1,56 @@
+#ifndef LOCATION_HUB_H
+#define LOCATION_HUB_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+#include <json-c/json.h>
+
+typedef struct {
+    unsigned long subscribers;       // Streams currently open
+    unsigned long peak_subscribers;
+    unsigned long opened;
+    unsigned long published;         // Location updates offered to the hub
+    unsigned long enqueued;          // Events queued for a subscriber
+    unsigned long dropped_slow;      // Streams closed because their queue overflowed
+    unsigned long keepalives;
+} location_hub_stats_t;
+
+// Start the hub and its keepalive thread. With blocking_reads the stream reader waits
+// on a condition variable (thread-per-connection mode); otherwise idle streams are
+// parked with MHD_suspend_connection() and resumed when an event arrives.
+int location_hub_init(int blocking_reads);
+
+// Non-zero between location_hub_init() and location_hub_shutdown()
+int location_hub_enabled(void);
+
+// Build a text/event-stream response for user_id. `snapshot` is a malloc'd event block
+// sent before any updates; the hub takes ownership of it. Returns NULL when full.
+struct MHD_Response* location_hub_open_stream(struct MHD_Connection *connection, int32_t user_id,
+                                              char *snapshot);
+
+// Subscribers that are not SSE responses, e.g. WebSocket connections. wake(ctx) runs with
+// hub locks held whenever an event is queued or the subscriber must close; it should only
+// signal the owning thread, which then drains events with location_hub_next_message().
+typedef struct location_hub_subscriber location_hub_subscriber_t;
+location_hub_subscriber_t* location_hub_subscribe(int32_t user_id, void (*wake)(void *ctx), void *ctx);
+
+// Copy the next event into buf as {"event": ..., "data": ...}. Returns its length, 0 when
+// nothing is queued, or -1 once the subscriber was dropped as too slow or the hub is closing.
+int location_hub_next_message(location_hub_subscriber_t *sub, char *buf, size_t size);
+
+void location_hub_unsubscribe(location_hub_subscriber_t *sub);
+
+// Push a user's new position to every subscribed friend
+void location_hub_publish(int32_t user_id, double latitude, double longitude, int accuracy,
+                          int64_t updated_at_ms);
+
+// Tell a user's open streams that their friend list changed
+void location_hub_notify_friends_changed(int32_t user_id);
+
+// End every stream so the daemon can be stopped (suspended connections must be resumed first)
+void location_hub_shutdown(void);
+
+void location_hub_get_stats(location_hub_stats_t *stats);
+json_object* location_hub_stats_to_json(void);
+
+#endif // LOCATION_HUB_H
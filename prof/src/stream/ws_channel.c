@@ -0,0 +1,762 @@
+#define _GNU_SOURCE
+#include "ws_channel.h"
+#include "location_hub.h"
+#include "../api.h"
+#include "../location/location.h"
+#include "../location/location_wire.h"
+#include "../location/location_writer.h"
+#include "../utils/json_writer.h"
+#include "../utils/stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <openssl/evp.h>
+
+#define WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define WS_FRAME_HEADER_MAX 14       // 2 + 8 byte length + 4 byte mask
+#define WS_EPOLL_BATCH 256
+#define WS_EVENTS_PER_PUMP 64        // Hub events framed per connection before yielding to others
+#define WS_READY_PER_LOOP 4096       // Woken connections served between epoll_wait() calls
+
+enum {
+    WS_OP_CONTINUATION = 0x0,
+    WS_OP_TEXT = 0x1,
+    WS_OP_BINARY = 0x2,
+    WS_OP_CLOSE = 0x8,
+    WS_OP_PING = 0x9,
+    WS_OP_PONG = 0xA
+};
+
+enum {
+    WS_CLOSE_NORMAL = 1000,
+    WS_CLOSE_GOING_AWAY = 1001,
+    WS_CLOSE_PROTOCOL_ERROR = 1002,
+    WS_CLOSE_UNSUPPORTED = 1003,
+    WS_CLOSE_TOO_BIG = 1009,
+    WS_CLOSE_TRY_AGAIN = 1013
+};
+
+typedef struct ws_conn {
+    int fd;
+    struct MHD_UpgradeResponseHandle *urh;
+    int32_t user_id;
+    char user_id_str[16];
+    location_hub_subscriber_t *sub;
+
+    unsigned char in[WS_FRAME_HEADER_MAX + WS_MAX_MESSAGE_SIZE]; // At most one whole frame
+    size_t in_len;
+    char message[WS_MAX_MESSAGE_SIZE + 1];  // Fragmented message being reassembled
+    size_t message_len;
+    int message_opcode;                     // 0 when no message is in progress
+
+    unsigned char *out;                     // Frames the socket has not accepted yet
+    size_t out_len;
+    size_t out_pos;
+    size_t out_capacity;
+    uint32_t polled;                        // Events registered with epoll
+    int closing;                            // Close frame queued; drop the socket once flushed
+    time_t last_seen;
+
+    int queued;                             // On the ready list; guarded by ready_lock
+    struct ws_conn *ready_next;             // Ready or incoming list
+    struct ws_conn *prev;                   // Attached connections, I/O thread only
+    struct ws_conn *next;
+} ws_conn_t;
+
+static int ws_running = 0;
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static pthread_t io_thread;
+static pthread_mutex_t ready_lock = PTHREAD_MUTEX_INITIALIZER;
+static ws_conn_t *ready_head = NULL;     // Connections with hub events to send
+static ws_conn_t *incoming_head = NULL;  // Upgraded sockets not yet picked up by the I/O thread
+static ws_conn_t *conns = NULL;
+static ws_channel_stats_t ws_stats;
+
+static void signal_io_thread(void) {
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "WebSocket wakeup failed: %s\n", strerror(errno));
+    }
+}
+
+// Hub callback: runs with hub locks held, so only queue the connection for the I/O thread
+static void conn_wake(void *ctx) {
+    ws_conn_t *c = ctx;
+    int was_empty = 0;
+    pthread_mutex_lock(&ready_lock);
+    if (!c->queued) {
+        c->queued = 1;
+        was_empty = ready_head == NULL;
+        c->ready_next = ready_head;
+        ready_head = c;
+    }
+    pthread_mutex_unlock(&ready_lock);
+    if (was_empty) {
+        signal_io_thread();
+    }
+}
+
+static int out_reserve(ws_conn_t *c, size_t extra) {
+    if (c->out_pos == c->out_len) {
+        c->out_pos = c->out_len = 0;
+    }
+    if (c->out_len + extra <= c->out_capacity) {
+        return 0;
+    }
+    size_t capacity = c->out_capacity ? c->out_capacity : 1024;
+    while (capacity < c->out_len + extra) {
+        capacity *= 2;
+    }
+    unsigned char *out = realloc(c->out, capacity);
+    if (!out) {
+        return -1;
+    }
+    c->out = out;
+    c->out_capacity = capacity;
+    return 0;
+}
+
+// Append one unmasked, unfragmented server frame to the output buffer
+static int queue_frame(ws_conn_t *c, int opcode, const void *payload, size_t len) {
+    if (out_reserve(c, len + 10) != 0) {
+        return -1;
+    }
+    unsigned char *p = c->out + c->out_len;
+    size_t header = 2;
+    p[0] = (unsigned char)(0x80 | opcode);
+    if (len < 126) {
+        p[1] = (unsigned char)len;
+    } else if (len <= 0xFFFF) {
+        p[1] = 126;
+        p[2] = (unsigned char)(len >> 8);
+        p[3] = (unsigned char)len;
+        header = 4;
+    } else {
+        p[1] = 127;
+        for (int i = 0; i < 8; i++) {
+            p[2 + i] = (unsigned char)((uint64_t)len >> (56 - 8 * i));
+        }
+        header = 10;
+    }
+    memcpy(p + header, payload, len);
+    c->out_len += header + len;
+    return 0;
+}
+
+static void queue_close(ws_conn_t *c, int code) {
+    if (c->closing) {
+        return;
+    }
+    unsigned char payload[2] = { (unsigned char)(code >> 8), (unsigned char)code };
+    queue_frame(c, WS_OP_CLOSE, payload, sizeof(payload));
+    c->closing = 1;
+}
+
+// Write what the socket accepts. Returns 1 once a close frame has gone out, -1 on error.
+static int flush_out(ws_conn_t *c) {
+    while (c->out_pos < c->out_len) {
+        ssize_t n = send(c->fd, c->out + c->out_pos, c->out_len - c->out_pos, MSG_NOSIGNAL);
+        if (n > 0) {
+            c->out_pos += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return -1;
+        }
+    }
+
+    // Stop reading once closing, or level-triggered EPOLLIN would spin on unread input
+    int pending = c->out_pos < c->out_len;
+    uint32_t wanted = (c->closing ? 0 : EPOLLIN) | (pending ? EPOLLOUT : 0);
+    if (wanted != c->polled) {
+        struct epoll_event ev = { .events = wanted, .data.ptr = c };
+        epoll_ctl(epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->polled = wanted;
+    }
+    return !pending && c->closing ? 1 : 0;
+}
+
+static void conn_close(ws_conn_t *c) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    location_hub_unsubscribe(c->sub); // No wakeups after this returns
+
+    pthread_mutex_lock(&ready_lock);
+    if (c->queued) {
+        for (ws_conn_t **link = &ready_head; *link; link = &(*link)->ready_next) {
+            if (*link == c) {
+                *link = c->ready_next;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&ready_lock);
+
+    if (c->prev) {
+        c->prev->next = c->next;
+    } else {
+        conns = c->next;
+    }
+    if (c->next) {
+        c->next->prev = c->prev;
+    }
+
+    MHD_upgrade_action(c->urh, MHD_UPGRADE_ACTION_CLOSE);
+    __atomic_fetch_sub(&ws_stats.connections, 1, __ATOMIC_RELAXED);
+    free(c->out);
+    free(c);
+}
+
+// Move queued hub events into the output buffer while it has room
+static void pump_events(ws_conn_t *c) {
+    if (!c->sub || c->closing) {
+        return;
+    }
+    char message[512];
+    for (int i = 0; i < WS_EVENTS_PER_PUMP; i++) {
+        if (c->out_len - c->out_pos >= WS_OUT_BUFFER_SIZE) {
+            return; // EPOLLOUT pumps again once the client catches up
+        }
+        int n = location_hub_next_message(c->sub, message, sizeof(message));
+        if (n < 0) {
+            // The hub dropped this client as too slow; it reconnects for a fresh snapshot
+            stat_add(&ws_stats.closed_slow, 1);
+            queue_close(c, WS_CLOSE_TRY_AGAIN);
+            return;
+        }
+        if (n == 0) {
+            return;
+        }
+        queue_frame(c, WS_OP_TEXT, message, (size_t)n);
+        stat_add(&ws_stats.messages_out, 1);
+    }
+    conn_wake(c); // More may be queued; let other connections go first
+}
+
+static void reply(ws_conn_t *c, const char *message) {
+    queue_frame(c, WS_OP_TEXT, message, strlen(message));
+}
+
+// Store one position for the socket's user; replies and returns -1 when it was refused
+static int save_report(ws_conn_t *c, double latitude, double longitude, int accuracy) {
+    int result = save_user_location(c->user_id_str, latitude, longitude, accuracy);
+    if (result == LOCATION_SAVE_BUSY) {
+        stat_add(&ws_stats.busy, 1);
+        reply(c, "{\"event\":\"busy\",\"data\":{\"retry_after\":1}}");
+        return -1;
+    }
+    if (result != 0) {
+        stat_add(&ws_stats.rejected, 1);
+        reply(c, "{\"event\":\"error\",\"data\":{\"error\":\"Failed to save location\"}}");
+        return -1;
+    }
+    return 0;
+}
+
+// A position report: {"latitude": .., "longitude": .., "accuracy": ..}. The user comes
+// from the handshake, so unlike /api/save-location no user_id or token is sent.
+static void handle_report(ws_conn_t *c, const char *text) {
+    stat_add(&ws_stats.messages_in, 1);
+
+    json_object *json_obj = json_tokener_parse(text);
+    json_object *lat_obj, *lon_obj, *accuracy_obj;
+    if (!json_obj ||
+        !json_object_object_get_ex(json_obj, "latitude", &lat_obj) ||
+        !json_object_object_get_ex(json_obj, "longitude", &lon_obj)) {
+        stat_add(&ws_stats.rejected, 1);
+        reply(c, "{\"event\":\"error\",\"data\":{\"error\":\"latitude and longitude required\"}}");
+        if (json_obj) {
+            json_object_put(json_obj);
+        }
+        return;
+    }
+
+    double latitude = json_object_get_double(lat_obj);
+    double longitude = json_object_get_double(lon_obj);
+    int accuracy = 50; // Default accuracy
+    if (json_object_object_get_ex(json_obj, "accuracy", &accuracy_obj)) {
+        accuracy = json_object_get_int(accuracy_obj);
+    }
+    json_object_put(json_obj);
+
+    if (!location_coordinates_valid(latitude, longitude)) {
+        stat_add(&ws_stats.rejected, 1);
+        reply(c, "{\"event\":\"error\",\"data\":{\"error\":\"Coordinates out of range\"}}");
+        return;
+    }
+    save_report(c, latitude, longitude, accuracy);
+}
+
+// Binary reports: one record or a batch in the location_wire format. Records must carry
+// user id 0 or the socket's own user; they are applied in order and timestamps are ignored.
+static void handle_binary_report(ws_conn_t *c, const unsigned char *data, size_t len) {
+    stat_add(&ws_stats.messages_in, 1);
+
+    const unsigned char *records;
+    int count = location_wire_parse(data, len, &records);
+    if (count < 0) {
+        stat_add(&ws_stats.rejected, 1);
+        reply(c, "{\"event\":\"error\",\"data\":{\"error\":\"Malformed binary location message\"}}");
+        return;
+    }
+
+    for (int i = 0; i < count; i++) {
+        location_wire_record_t record;
+        if (location_wire_decode(records + (size_t)i * LOCATION_WIRE_RECORD_SIZE, &record) != 0 ||
+            (record.user_id != 0 && record.user_id != c->user_id) ||
+            !location_coordinates_valid(record.latitude, record.longitude)) {
+            stat_add(&ws_stats.rejected, 1);
+            reply(c, "{\"event\":\"error\",\"data\":{\"error\":\"Invalid binary location record\"}}");
+            return;
+        }
+        if (save_report(c, record.latitude, record.longitude, record.accuracy) != 0) {
+            return;
+        }
+    }
+}
+
+// Parse every complete frame in the input buffer
+static void process_frames(ws_conn_t *c) {
+    while (c->in_len >= 2 && !c->closing) {
+        const unsigned char *p = c->in;
+        int fin = p[0] & 0x80;
+        int opcode = p[0] & 0x0F;
+        if ((p[0] & 0x70) || !(p[1] & 0x80)) {
+            // Reserved bits set, or an unmasked client frame
+            queue_close(c, WS_CLOSE_PROTOCOL_ERROR);
+            return;
+        }
+
+        uint64_t len = p[1] & 0x7F;
+        size_t header = 2;
+        if (len == 126) {
+            if (c->in_len < 4) {
+                return;
+            }
+            len = ((uint64_t)p[2] << 8) | p[3];
+            header = 4;
+        } else if (len == 127) {
+            if (c->in_len < 10) {
+                return;
+            }
+            len = 0;
+            for (int i = 0; i < 8; i++) {
+                len = (len << 8) | p[2 + i];
+            }
+            header = 10;
+        }
+        if (len > WS_MAX_MESSAGE_SIZE) {
+            queue_close(c, WS_CLOSE_TOO_BIG);
+            return;
+        }
+        size_t frame_len = header + 4 + (size_t)len;
+        if (c->in_len < frame_len) {
+            return;
+        }
+
+        const unsigned char *mask = p + header;
+        unsigned char *payload = c->in + header + 4;
+        for (size_t i = 0; i < len; i++) {
+            payload[i] ^= mask[i & 3];
+        }
+
+        if (opcode >= WS_OP_CLOSE) {
+            if (!fin || len > 125) {
+                queue_close(c, WS_CLOSE_PROTOCOL_ERROR);
+                return;
+            }
+            if (opcode == WS_OP_CLOSE) {
+                queue_close(c, len >= 2 ? (payload[0] << 8) | payload[1] : WS_CLOSE_NORMAL);
+                return;
+            }
+            if (opcode == WS_OP_PING) {
+                queue_frame(c, WS_OP_PONG, payload, (size_t)len);
+            } else if (opcode != WS_OP_PONG) {
+                queue_close(c, WS_CLOSE_PROTOCOL_ERROR);
+                return;
+            }
+        } else {
+            if (opcode == WS_OP_CONTINUATION ? c->message_opcode == 0
+                                              : (opcode > WS_OP_BINARY || c->message_opcode != 0)) {
+                queue_close(c, WS_CLOSE_PROTOCOL_ERROR);
+                return;
+            }
+            if (opcode != WS_OP_CONTINUATION) {
+                c->message_opcode = opcode;
+                c->message_len = 0;
+            }
+            if (c->message_len + len > WS_MAX_MESSAGE_SIZE) {
+                queue_close(c, WS_CLOSE_TOO_BIG);
+                return;
+            }
+            memcpy(c->message + c->message_len, payload, (size_t)len);
+            c->message_len += (size_t)len;
+
+            if (fin) {
+                int message_opcode = c->message_opcode;
+                c->message[c->message_len] = '\0';
+                c->message_opcode = 0;
+                if (message_opcode == WS_OP_BINARY) {
+                    handle_binary_report(c, (const unsigned char *)c->message, c->message_len);
+                } else {
+                    handle_report(c, c->message);
+                }
+            }
+        }
+
+        c->in_len -= frame_len;
+        memmove(c->in, c->in + frame_len, c->in_len);
+    }
+}
+
+// Read and handle everything available; returns -1 when the peer went away
+static int read_socket(ws_conn_t *c) {
+    while (!c->closing) {
+        size_t space = sizeof(c->in) - c->in_len;
+        if (space == 0) {
+            queue_close(c, WS_CLOSE_TOO_BIG);
+            return 0;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, space, 0);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            c->last_seen = time(NULL);
+            process_frames(c);
+        } else if (n == 0) {
+            return -1;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return 0;
+        } else if (errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void conn_attach(ws_conn_t *c) {
+    fcntl(c->fd, F_SETFL, fcntl(c->fd, F_GETFL, 0) | O_NONBLOCK);
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    c->polled = EPOLLIN;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c->fd, &ev) != 0) {
+        fprintf(stderr, "WebSocket epoll_ctl failed: %s\n", strerror(errno));
+        MHD_upgrade_action(c->urh, MHD_UPGRADE_ACTION_CLOSE);
+        __atomic_fetch_sub(&ws_stats.connections, 1, __ATOMIC_RELAXED);
+        free(c->out);
+        free(c);
+        return;
+    }
+    c->next = conns;
+    if (conns) {
+        conns->prev = c;
+    }
+    conns = c;
+
+    // Without the hub (no friend graph) the socket still carries position reports
+    c->sub = location_hub_subscribe(c->user_id, conn_wake, c);
+    c->last_seen = time(NULL);
+
+    process_frames(c); // Bytes that arrived with the handshake
+    if (flush_out(c) != 0) {
+        conn_close(c);
+    }
+}
+
+static void ping_all(time_t now) {
+    ws_conn_t *c = conns;
+    while (c) {
+        ws_conn_t *next = c->next;
+        if (now - c->last_seen > WS_IDLE_TIMEOUT_SEC) {
+            stat_add(&ws_stats.closed_idle, 1);
+            conn_close(c);
+        } else {
+            queue_frame(c, WS_OP_PING, "", 0);
+            if (flush_out(c) != 0) {
+                conn_close(c);
+            }
+        }
+        c = next;
+    }
+}
+
+static void* io_main(void *arg) {
+    (void)arg;
+    struct epoll_event events[WS_EPOLL_BATCH];
+    time_t last_ping = time(NULL);
+
+    while (__atomic_load_n(&ws_running, __ATOMIC_ACQUIRE)) {
+        int n = epoll_wait(epoll_fd, events, WS_EPOLL_BATCH, 1000);
+        for (int i = 0; i < n; i++) {
+            ws_conn_t *c = events[i].data.ptr;
+            if (!c) {
+                uint64_t count;
+                while (read(wake_fd, &count, sizeof(count)) > 0) {
+                }
+                continue;
+            }
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                conn_close(c);
+                continue;
+            }
+            if ((events[i].events & EPOLLIN) && read_socket(c) != 0) {
+                conn_close(c);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                pump_events(c);
+            }
+            if (flush_out(c) != 0) {
+                conn_close(c);
+            }
+        }
+
+        // Sockets handed over by MHD since the last pass
+        pthread_mutex_lock(&ready_lock);
+        ws_conn_t *incoming = incoming_head;
+        incoming_head = NULL;
+        pthread_mutex_unlock(&ready_lock);
+        while (incoming) {
+            ws_conn_t *next = incoming->ready_next;
+            incoming->ready_next = NULL;
+            conn_attach(incoming);
+            incoming = next;
+        }
+
+        // Connections with hub events waiting
+        for (int served = 0; served < WS_READY_PER_LOOP; served++) {
+            pthread_mutex_lock(&ready_lock);
+            ws_conn_t *c = ready_head;
+            if (c) {
+                ready_head = c->ready_next;
+                c->queued = 0;
+            }
+            pthread_mutex_unlock(&ready_lock);
+            if (!c) {
+                break;
+            }
+            pump_events(c);
+            if (flush_out(c) != 0) {
+                conn_close(c);
+            }
+        }
+
+        time_t now = time(NULL);
+        if (now - last_ping >= WS_PING_INTERVAL_SEC) {
+            last_ping = now;
+            ping_all(now);
+        }
+    }
+
+    // Say goodbye; clients that cannot take the frame right now just see the socket close
+    while (conns) {
+        ws_conn_t *c = conns;
+        queue_close(c, WS_CLOSE_GOING_AWAY);
+        flush_out(c);
+        conn_close(c);
+    }
+    return NULL;
+}
+
+// MHD hands over the socket once the 101 response is sent; cls carries the user id
+static void ws_upgraded(void *cls, struct MHD_Connection *connection, void *con_cls,
+                        const char *extra_in, size_t extra_in_size, MHD_socket sock,
+                        struct MHD_UpgradeResponseHandle *urh) {
+    (void)connection;
+    (void)con_cls;
+
+    ws_conn_t *c = calloc(1, sizeof(ws_conn_t));
+    if (!c || extra_in_size > sizeof(c->in)) {
+        free(c);
+        MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
+        return;
+    }
+    c->fd = sock;
+    c->urh = urh;
+    c->user_id = (int32_t)(intptr_t)cls;
+    snprintf(c->user_id_str, sizeof(c->user_id_str), "%d", c->user_id);
+    memcpy(c->in, extra_in, extra_in_size);
+    c->in_len = extra_in_size;
+
+    // Friends' current positions go first, built here on the MHD thread rather than the I/O thread
+    json_writer_t snapshot;
+    json_writer_init(&snapshot, JSON_WRITER_RESPONSE_CAPACITY);
+    json_writer_begin_object(&snapshot);
+    json_writer_key(&snapshot, "event");
+    json_writer_string(&snapshot, "snapshot");
+    json_writer_key(&snapshot, "data");
+    if (write_friends_locations(&snapshot, c->user_id_str) == 0) {
+        json_writer_end_object(&snapshot);
+        size_t len;
+        char *message = json_writer_finish(&snapshot, &len);
+        if (message) {
+            queue_frame(c, WS_OP_TEXT, message, len);
+            free(message);
+        }
+    }
+    json_writer_free(&snapshot);
+
+    pthread_mutex_lock(&ready_lock);
+    int running = __atomic_load_n(&ws_running, __ATOMIC_ACQUIRE);
+    if (running) {
+        c->ready_next = incoming_head;
+        incoming_head = c;
+    }
+    pthread_mutex_unlock(&ready_lock);
+
+    if (!running) {
+        free(c->out);
+        free(c);
+        MHD_upgrade_action(urh, MHD_UPGRADE_ACTION_CLOSE);
+        return;
+    }
+    stat_add(&ws_stats.opened, 1);
+    stat_add(&ws_stats.connections, 1);
+    signal_io_thread();
+}
+
+unsigned int ws_channel_check_handshake(struct MHD_Connection *connection) {
+    const char *upgrade = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_UPGRADE);
+    const char *conn_header = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Connection");
+    const char *version = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Version");
+    const char *key = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Key");
+
+    if (!upgrade || !strcasestr(upgrade, "websocket") || !conn_header || !strcasestr(conn_header, "upgrade")) {
+        return MHD_HTTP_UPGRADE_REQUIRED;
+    }
+    if (!version || strcmp(version, "13") != 0) {
+        return MHD_HTTP_UPGRADE_REQUIRED;
+    }
+    if (!key || strlen(key) != 24) { // Base64 of 16 random bytes
+        return MHD_HTTP_BAD_REQUEST;
+    }
+    return 0;
+}
+
+struct MHD_Response* ws_channel_create_response(struct MHD_Connection *connection, int32_t user_id) {
+    const char *key = MHD_lookup_connection_value(connection, MHD_HEADER_KIND, "Sec-WebSocket-Key");
+    if (!key) {
+        return NULL;
+    }
+
+    // Sec-WebSocket-Accept = base64(SHA-1(key + GUID))
+    char input[64];
+    int input_len = snprintf(input, sizeof(input), "%s%s", key, WS_GUID);
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digest_len = 0;
+    char accept[64];
+    if (input_len <= 0 || (size_t)input_len >= sizeof(input) ||
+        EVP_Digest(input, (size_t)input_len, digest, &digest_len, EVP_sha1(), NULL) != 1) {
+        return NULL;
+    }
+    EVP_EncodeBlock((unsigned char *)accept, digest, (int)digest_len);
+
+    struct MHD_Response *response = MHD_create_response_for_upgrade(&ws_upgraded, (void *)(intptr_t)user_id);
+    if (!response) {
+        return NULL;
+    }
+    // MHD adds "Connection: Upgrade" itself
+    MHD_add_response_header(response, MHD_HTTP_HEADER_UPGRADE, "websocket");
+    MHD_add_response_header(response, "Sec-WebSocket-Accept", accept);
+    return response;
+}
+
+int ws_channel_start(void) {
+    if (ws_running) {
+        return 0;
+    }
+    if (!location_writer_enabled()) {
+        fprintf(stderr, "WebSocket channel needs the location writer (GEO_LOCATION_WRITER); not started\n");
+        return -1;
+    }
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0) {
+        fprintf(stderr, "Failed to set up WebSocket polling: %s\n", strerror(errno));
+        if (epoll_fd >= 0) {
+            close(epoll_fd);
+        }
+        if (wake_fd >= 0) {
+            close(wake_fd);
+        }
+        epoll_fd = wake_fd = -1;
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = NULL };
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev);
+
+    ws_running = 1;
+    if (pthread_create(&io_thread, NULL, io_main, NULL) != 0) {
+        fprintf(stderr, "Failed to start WebSocket I/O thread\n");
+        ws_running = 0;
+        close(epoll_fd);
+        close(wake_fd);
+        epoll_fd = wake_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+int ws_channel_enabled(void) {
+    return __atomic_load_n(&ws_running, __ATOMIC_ACQUIRE);
+}
+
+void ws_channel_stop(void) {
+    if (!ws_running) {
+        return;
+    }
+    pthread_mutex_lock(&ready_lock);
+    __atomic_store_n(&ws_running, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&ready_lock);
+    signal_io_thread();
+    pthread_join(io_thread, NULL);
+
+    // Sockets upgraded after the I/O thread's last pass
+    while (incoming_head) {
+        ws_conn_t *c = incoming_head;
+        incoming_head = c->ready_next;
+        MHD_upgrade_action(c->urh, MHD_UPGRADE_ACTION_CLOSE);
+        __atomic_fetch_sub(&ws_stats.connections, 1, __ATOMIC_RELAXED);
+        free(c->out);
+        free(c);
+    }
+    close(epoll_fd);
+    close(wake_fd);
+    epoll_fd = wake_fd = -1;
+}
+
+void ws_channel_get_stats(ws_channel_stats_t *stats) {
+    stats->connections = __atomic_load_n(&ws_stats.connections, __ATOMIC_RELAXED);
+    stats->opened = __atomic_load_n(&ws_stats.opened, __ATOMIC_RELAXED);
+    stats->messages_in = __atomic_load_n(&ws_stats.messages_in, __ATOMIC_RELAXED);
+    stats->messages_out = __atomic_load_n(&ws_stats.messages_out, __ATOMIC_RELAXED);
+    stats->rejected = __atomic_load_n(&ws_stats.rejected, __ATOMIC_RELAXED);
+    stats->busy = __atomic_load_n(&ws_stats.busy, __ATOMIC_RELAXED);
+    stats->closed_slow = __atomic_load_n(&ws_stats.closed_slow, __ATOMIC_RELAXED);
+    stats->closed_idle = __atomic_load_n(&ws_stats.closed_idle, __ATOMIC_RELAXED);
+}
+
+json_object* ws_channel_stats_to_json(void) {
+    ws_channel_stats_t stats;
+    ws_channel_get_stats(&stats);
+
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "enabled", json_object_new_boolean(ws_channel_enabled()));
+    json_object_object_add(obj, "connections", json_object_new_int64((int64_t)stats.connections));
+    json_object_object_add(obj, "opened", json_object_new_int64((int64_t)stats.opened));
+    json_object_object_add(obj, "messages_in", json_object_new_int64((int64_t)stats.messages_in));
+    json_object_object_add(obj, "messages_out", json_object_new_int64((int64_t)stats.messages_out));
+    json_object_object_add(obj, "rejected", json_object_new_int64((int64_t)stats.rejected));
+    json_object_object_add(obj, "busy", json_object_new_int64((int64_t)stats.busy));
+    json_object_object_add(obj, "closed_slow", json_object_new_int64((int64_t)stats.closed_slow));
+    json_object_object_add(obj, "closed_idle", json_object_new_int64((int64_t)stats.closed_idle));
+    return obj;
+}
@@ -0,0 +1,42 @@
+#ifndef WS_CHANNEL_H
+#define WS_CHANNEL_H
+
+#include <stdint.h>
+#include <microhttpd.h>
+#include <json-c/json.h>
+
+typedef struct {
+    unsigned long connections;       // Sockets currently upgraded
+    unsigned long opened;
+    unsigned long messages_in;       // Position reports received
+    unsigned long messages_out;      // Events sent to clients
+    unsigned long rejected;          // Reports that failed to parse or save
+    unsigned long busy;              // Reports refused because the location writer was full
+    unsigned long closed_slow;       // Dropped by the location hub as too slow
+    unsigned long closed_idle;       // No traffic (not even a pong) within WS_IDLE_TIMEOUT_SEC
+} ws_channel_stats_t;
+
+// Start the WebSocket I/O thread. The daemon must be started with MHD_ALLOW_UPGRADE,
+// and the location writer must already be running: reports are saved on the I/O thread,
+// so without it every report would block all sockets on a database write.
+int ws_channel_start(void);
+
+// Non-zero while the channel accepts new connections
+int ws_channel_enabled(void);
+
+// Check the handshake headers; returns 0 when the request is a WebSocket upgrade
+// this server can accept, else an HTTP status to answer with
+unsigned int ws_channel_check_handshake(struct MHD_Connection *connection);
+
+// Build the 101 response for an authenticated handshake. Once MHD hands over the
+// socket the connection sends the user's friend snapshot, then streams hub events
+// and feeds incoming position reports to save_user_location().
+struct MHD_Response* ws_channel_create_response(struct MHD_Connection *connection, int32_t user_id);
+
+// Close every connection and stop the I/O thread; call before MHD_stop_daemon()
+void ws_channel_stop(void);
+
+void ws_channel_get_stats(ws_channel_stats_t *stats);
+json_object* ws_channel_stats_to_json(void);
+
+#endif // WS_CHANNEL_H
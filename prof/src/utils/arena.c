@@ -0,0 +1,200 @@
+#include "arena.h"
+#include "../api.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define ARENA_ALIGN 16
+
+struct arena_chunk {
+    arena_chunk_t *next;
+    size_t capacity;        // Payload bytes
+    size_t used;
+    int oversize;           // Sized for one allocation; never cached
+    unsigned char data[] __attribute__((aligned(ARENA_ALIGN)));
+};
+
+// Released chunks kept by one thread
+typedef struct {
+    arena_chunk_t *head;
+    size_t count;
+} chunk_cache_t;
+
+static __thread chunk_cache_t *thread_cache = NULL;
+static pthread_key_t cache_key;
+static pthread_once_t cache_key_once = PTHREAD_ONCE_INIT;
+static arena_stats_t arena_stats;
+
+// Thread exit: give the cached chunks back to malloc
+static void free_cache(void *arg) {
+    chunk_cache_t *cache = arg;
+    while (cache->head) {
+        arena_chunk_t *next = cache->head->next;
+        free(cache->head);
+        cache->head = next;
+    }
+    free(cache);
+}
+
+static void create_cache_key(void) {
+    if (pthread_key_create(&cache_key, free_cache) != 0) {
+        fprintf(stderr, "Failed to create arena cache key\n");
+    }
+}
+
+static chunk_cache_t* get_cache(void) {
+    if (!thread_cache) {
+        pthread_once(&cache_key_once, create_cache_key);
+        thread_cache = calloc(1, sizeof(chunk_cache_t));
+        if (thread_cache) {
+            pthread_setspecific(cache_key, thread_cache);
+        }
+    }
+    return thread_cache;
+}
+
+static arena_chunk_t* chunk_new(size_t capacity, int oversize) {
+    chunk_cache_t *cache = oversize ? NULL : get_cache();
+    arena_chunk_t *chunk = NULL;
+    if (cache && cache->head) {
+        chunk = cache->head;
+        cache->head = chunk->next;
+        cache->count--;
+        stat_add(&arena_stats.chunk_reuses, 1);
+    } else {
+        chunk = malloc(sizeof(arena_chunk_t) + capacity);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->capacity = capacity;
+        stat_add(oversize ? &arena_stats.oversize_allocs : &arena_stats.chunk_allocs, 1);
+    }
+    chunk->used = 0;
+    chunk->oversize = oversize;
+    chunk->next = NULL;
+    return chunk;
+}
+
+void arena_init(arena_t *arena) {
+    arena->head = NULL;
+}
+
+void* arena_alloc(arena_t *arena, size_t size) {
+    if (!arena) {
+        return malloc(size ? size : 1);
+    }
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    arena_chunk_t *head = arena->head;
+    if (head && !head->oversize && head->capacity - head->used >= size) {
+        void *p = head->data + head->used;
+        head->used += size;
+        return p;
+    }
+
+    // Large allocations get their own chunk behind the head, which keeps bumping
+    if (size > REQUEST_ARENA_CHUNK_SIZE / 4) {
+        arena_chunk_t *chunk = chunk_new(size, 1);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->used = size;
+        if (head) {
+            chunk->next = head->next;
+            head->next = chunk;
+        } else {
+            arena->head = chunk;
+        }
+        return chunk->data;
+    }
+
+    arena_chunk_t *chunk = chunk_new(REQUEST_ARENA_CHUNK_SIZE, 0);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->next = head;
+    arena->head = chunk;
+    chunk->used = size;
+    return chunk->data;
+}
+
+void* arena_calloc(arena_t *arena, size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    void *p = arena_alloc(arena, count * size);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+    return p;
+}
+
+char* arena_strdup(arena_t *arena, const char *s) {
+    size_t len = strlen(s) + 1;
+    char *copy = arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, s, len);
+    }
+    return copy;
+}
+
+char* arena_sprintf(arena_t *arena, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (len < 0) {
+        return NULL;
+    }
+
+    char *s = arena_alloc(arena, (size_t)len + 1);
+    if (s) {
+        va_start(args, format);
+        vsnprintf(s, (size_t)len + 1, format, args);
+        va_end(args);
+    }
+    return s;
+}
+
+void arena_release(arena_t *arena) {
+    if (!arena->head) {
+        return;
+    }
+    chunk_cache_t *cache = get_cache();
+    arena_chunk_t *chunk = arena->head;
+    while (chunk) {
+        arena_chunk_t *next = chunk->next;
+        if (!chunk->oversize && cache && cache->count < REQUEST_ARENA_THREAD_CACHE) {
+            chunk->next = cache->head;
+            cache->head = chunk;
+            cache->count++;
+        } else {
+            free(chunk);
+        }
+        chunk = next;
+    }
+    arena->head = NULL;
+    stat_add(&arena_stats.releases, 1);
+}
+
+void arena_get_stats(arena_stats_t *stats) {
+    stats->chunk_allocs = __atomic_load_n(&arena_stats.chunk_allocs, __ATOMIC_RELAXED);
+    stats->chunk_reuses = __atomic_load_n(&arena_stats.chunk_reuses, __ATOMIC_RELAXED);
+    stats->oversize_allocs = __atomic_load_n(&arena_stats.oversize_allocs, __ATOMIC_RELAXED);
+    stats->releases = __atomic_load_n(&arena_stats.releases, __ATOMIC_RELAXED);
+}
+
+json_object* arena_stats_to_json(void) {
+    arena_stats_t stats;
+    arena_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "chunk_allocs", json_object_new_int64((int64_t)stats.chunk_allocs));
+    json_object_object_add(obj, "chunk_reuses", json_object_new_int64((int64_t)stats.chunk_reuses));
+    json_object_object_add(obj, "oversize_allocs", json_object_new_int64((int64_t)stats.oversize_allocs));
+    json_object_object_add(obj, "releases", json_object_new_int64((int64_t)stats.releases));
+    return obj;
+}
@@ -0,0 +1,38 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+
+typedef struct arena_chunk arena_chunk_t;
+
+// Bump allocator whose memory is all released at once. Chunks come from a per-thread
+// free list, so a steady stream of requests on one thread does not touch malloc.
+// Every function also accepts a NULL arena and then allocates from the heap; the caller
+// frees such memory with free().
+typedef struct {
+    arena_chunk_t *head;    // Chunk being bumped; older and oversized chunks follow
+} arena_t;
+
+typedef struct {
+    unsigned long chunk_allocs;      // Chunks obtained from malloc
+    unsigned long chunk_reuses;      // Chunks taken from a thread's free list
+    unsigned long oversize_allocs;   // Allocations too large for a chunk, malloc'd on their own
+    unsigned long releases;
+} arena_stats_t;
+
+void arena_init(arena_t *arena);
+
+// 16-byte aligned; NULL when out of memory
+void* arena_alloc(arena_t *arena, size_t size);
+void* arena_calloc(arena_t *arena, size_t count, size_t size);
+char* arena_strdup(arena_t *arena, const char *s);
+char* arena_sprintf(arena_t *arena, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Return every chunk to the calling thread's free list (or to malloc once it is full)
+void arena_release(arena_t *arena);
+
+void arena_get_stats(arena_stats_t *stats);
+json_object* arena_stats_to_json(void);
+
+#endif // ARENA_H
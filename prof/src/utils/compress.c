@@ -0,0 +1,222 @@
+#define _GNU_SOURCE
+#include "compress.h"
+#include "../api.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#include <pthread.h>
+#include <zlib.h>
+
+// One deflate stream per encoding, kept for the life of the thread and reset between
+// responses; deflateInit2() allocates ~256KB, which is what reuse avoids
+typedef struct {
+    z_stream streams[2];
+    int ready[2];
+} compress_thread_t;
+
+static int compress_level = COMPRESS_LEVEL;
+static size_t compress_min = COMPRESS_MIN_SIZE;
+static __thread compress_thread_t *thread_state = NULL;
+static pthread_key_t state_key;
+static pthread_once_t state_key_once = PTHREAD_ONCE_INIT;
+static compress_stats_t compress_stats;
+
+// Thread exit: release the zlib state
+static void free_state(void *arg) {
+    compress_thread_t *state = arg;
+    for (int i = 0; i < 2; i++) {
+        if (state->ready[i]) {
+            deflateEnd(&state->streams[i]);
+        }
+    }
+    free(state);
+}
+
+static void create_state_key(void) {
+    if (pthread_key_create(&state_key, free_state) != 0) {
+        fprintf(stderr, "Failed to create compression state key\n");
+    }
+}
+
+void compress_configure(int level, size_t min_size) {
+    if (level > 9) {
+        level = 9;
+    }
+    compress_level = level < 0 ? 0 : level;
+    compress_min = min_size;
+}
+
+// q-values per coding from an Accept-Encoding header; -1 when the coding is not listed
+static void parse_accept_encoding(const char *header, double *gzip_q, double *deflate_q) {
+    double any_q = -1;
+    *gzip_q = -1;
+    *deflate_q = -1;
+    const char *p = header;
+    while (p && *p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        const char *name = p;
+        while (*p && *p != ',' && *p != ';' && *p != ' ' && *p != '\t') {
+            p++;
+        }
+        size_t name_len = (size_t)(p - name);
+        const char *end = strchr(p, ',');
+        if (!end) {
+            end = p + strlen(p);
+        }
+
+        double q = 1.0;
+        const char *q_param = strstr(p, "q=");
+        if (q_param && q_param < end) {
+            q = strtod(q_param + 2, NULL);
+        }
+
+        if ((name_len == 4 && strncasecmp(name, "gzip", 4) == 0) ||
+            (name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0)) {
+            *gzip_q = q;
+        } else if (name_len == 7 && strncasecmp(name, "deflate", 7) == 0) {
+            *deflate_q = q;
+        } else if (name_len == 1 && *name == '*') {
+            any_q = q;
+        }
+        p = end;
+    }
+    if (*gzip_q < 0) {
+        *gzip_q = any_q;
+    }
+    if (*deflate_q < 0) {
+        *deflate_q = any_q;
+    }
+}
+
+int compress_accepts(const char *accept_encoding, compress_encoding_t encoding) {
+    if (!accept_encoding || encoding == COMPRESS_NONE) {
+        return 0;
+    }
+    double gzip_q, deflate_q;
+    parse_accept_encoding(accept_encoding, &gzip_q, &deflate_q);
+    return (encoding == COMPRESS_GZIP ? gzip_q : deflate_q) > 0;
+}
+
+compress_encoding_t compress_select(const char *accept_encoding, size_t len) {
+    if (compress_level == 0) {
+        return COMPRESS_NONE;
+    }
+    if (len < compress_min) {
+        stat_add(&compress_stats.skipped_small, 1);
+        return COMPRESS_NONE;
+    }
+
+    double gzip_q = -1, deflate_q = -1;
+    if (accept_encoding) {
+        parse_accept_encoding(accept_encoding, &gzip_q, &deflate_q);
+    }
+    if (gzip_q > 0 && gzip_q >= deflate_q) {
+        return COMPRESS_GZIP;
+    }
+    if (deflate_q > 0) {
+        return COMPRESS_DEFLATE;
+    }
+    stat_add(&compress_stats.not_accepted, 1);
+    return COMPRESS_NONE;
+}
+
+const char* compress_encoding_name(compress_encoding_t encoding) {
+    switch (encoding) {
+        case COMPRESS_GZIP: return "gzip";
+        case COMPRESS_DEFLATE: return "deflate";
+        default: return "identity";
+    }
+}
+
+static z_stream* thread_stream(compress_encoding_t encoding) {
+    if (!thread_state) {
+        pthread_once(&state_key_once, create_state_key);
+        thread_state = calloc(1, sizeof(compress_thread_t));
+        if (!thread_state) {
+            return NULL;
+        }
+        pthread_setspecific(state_key, thread_state);
+    }
+
+    int i = encoding == COMPRESS_GZIP ? 0 : 1;
+    z_stream *zs = &thread_state->streams[i];
+    if (thread_state->ready[i]) {
+        return deflateReset(zs) == Z_OK ? zs : NULL;
+    }
+
+    // 15 window bits give the zlib wrapper HTTP calls "deflate"; +16 asks for gzip
+    int window_bits = encoding == COMPRESS_GZIP ? 15 + 16 : 15;
+    if (deflateInit2(zs, compress_level, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "Failed to initialize %s stream\n", compress_encoding_name(encoding));
+        return NULL;
+    }
+    thread_state->ready[i] = 1;
+    stat_add(&compress_stats.streams, 1);
+    return zs;
+}
+
+int compress_buffer(compress_encoding_t encoding, const void *in, size_t len, arena_t *arena,
+                    void **out, size_t *out_len) {
+    z_stream *zs = encoding != COMPRESS_NONE && len <= UINT_MAX / 2 ? thread_stream(encoding) : NULL;
+    if (!zs) {
+        stat_add(&compress_stats.failed, 1);
+        return -1;
+    }
+
+    // The bound covers incompressible input, so one deflate() call always finishes
+    uLong bound = deflateBound(zs, (uLong)len);
+    unsigned char *buf = arena_alloc(arena, bound);
+    if (!buf) {
+        stat_add(&compress_stats.failed, 1);
+        return -1;
+    }
+    zs->next_in = (Bytef *)in;
+    zs->avail_in = (uInt)len;
+    zs->next_out = buf;
+    zs->avail_out = (uInt)bound;
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END || zs->total_out >= len) {
+        if (!arena) {
+            free(buf);
+        }
+        stat_add(&compress_stats.failed, 1);
+        return -1;
+    }
+
+    *out = buf;
+    *out_len = zs->total_out;
+    stat_add(&compress_stats.compressed, 1);
+    stat_add(&compress_stats.bytes_in, len);
+    stat_add(&compress_stats.bytes_out, zs->total_out);
+    return 0;
+}
+
+void compress_get_stats(compress_stats_t *stats) {
+    stats->compressed = __atomic_load_n(&compress_stats.compressed, __ATOMIC_RELAXED);
+    stats->skipped_small = __atomic_load_n(&compress_stats.skipped_small, __ATOMIC_RELAXED);
+    stats->not_accepted = __atomic_load_n(&compress_stats.not_accepted, __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&compress_stats.failed, __ATOMIC_RELAXED);
+    stats->bytes_in = __atomic_load_n(&compress_stats.bytes_in, __ATOMIC_RELAXED);
+    stats->bytes_out = __atomic_load_n(&compress_stats.bytes_out, __ATOMIC_RELAXED);
+    stats->streams = __atomic_load_n(&compress_stats.streams, __ATOMIC_RELAXED);
+}
+
+json_object* compress_stats_to_json(void) {
+    compress_stats_t stats;
+    compress_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "level", json_object_new_int(compress_level));
+    json_object_object_add(obj, "min_size", json_object_new_int64((int64_t)compress_min));
+    json_object_object_add(obj, "compressed", json_object_new_int64((int64_t)stats.compressed));
+    json_object_object_add(obj, "skipped_small", json_object_new_int64((int64_t)stats.skipped_small));
+    json_object_object_add(obj, "not_accepted", json_object_new_int64((int64_t)stats.not_accepted));
+    json_object_object_add(obj, "failed", json_object_new_int64((int64_t)stats.failed));
+    json_object_object_add(obj, "bytes_in", json_object_new_int64((int64_t)stats.bytes_in));
+    json_object_object_add(obj, "bytes_out", json_object_new_int64((int64_t)stats.bytes_out));
+    json_object_object_add(obj, "streams", json_object_new_int64((int64_t)stats.streams));
+    return obj;
+}
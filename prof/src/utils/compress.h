@@ -0,0 +1,45 @@
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stddef.h>
+#include <json-c/json.h>
+#include "arena.h"
+
+typedef enum {
+    COMPRESS_NONE = 0,
+    COMPRESS_GZIP,
+    COMPRESS_DEFLATE       // zlib-wrapped, as HTTP's "deflate" is defined
+} compress_encoding_t;
+
+typedef struct {
+    unsigned long compressed;        // Responses sent compressed
+    unsigned long skipped_small;     // Below the size threshold
+    unsigned long not_accepted;      // Client accepted neither encoding
+    unsigned long failed;            // zlib errors or no gain; sent uncompressed
+    unsigned long bytes_in;
+    unsigned long bytes_out;
+    unsigned long streams;           // zlib streams created (one per thread and encoding)
+} compress_stats_t;
+
+// Set the zlib level (1-9; 0 turns compression off) and the smallest body worth
+// compressing. Call before the server starts.
+void compress_configure(int level, size_t min_size);
+
+// Pick an encoding for a `len`-byte body given the request's Accept-Encoding (may be NULL).
+// Honors q-values and "*"; gzip wins ties.
+compress_encoding_t compress_select(const char *accept_encoding, size_t len);
+
+// Non-zero when Accept-Encoding allows `encoding` (q > 0), regardless of size or level
+int compress_accepts(const char *accept_encoding, compress_encoding_t encoding);
+
+const char* compress_encoding_name(compress_encoding_t encoding);
+
+// Compress `in` with this thread's reusable zlib stream into memory from `arena` (the heap
+// when NULL). Returns -1 on error or when the output would not be smaller.
+int compress_buffer(compress_encoding_t encoding, const void *in, size_t len, arena_t *arena,
+                    void **out, size_t *out_len);
+
+void compress_get_stats(compress_stats_t *stats);
+json_object* compress_stats_to_json(void);
+
+#endif // COMPRESS_H
@@ -0,0 +1,214 @@
+#include "json_writer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+static int reserve(json_writer_t *w, size_t extra) {
+    if (w->failed) {
+        return -1;
+    }
+    if (w->len + extra + 1 <= w->capacity) {
+        return 0;
+    }
+
+    size_t capacity = w->capacity ? w->capacity : 256;
+    while (capacity < w->len + extra + 1) {
+        capacity *= 2;
+    }
+    char *buf;
+    if (w->arena) {
+        // Arena blocks cannot grow in place; the old one is reclaimed with the arena
+        buf = arena_alloc(w->arena, capacity);
+        if (buf && w->len) {
+            memcpy(buf, w->buf, w->len);
+        }
+    } else {
+        buf = realloc(w->buf, capacity);
+    }
+    if (!buf) {
+        w->failed = 1;
+        return -1;
+    }
+    w->buf = buf;
+    w->capacity = capacity;
+    return 0;
+}
+
+static inline void put(json_writer_t *w, const char *text, size_t len) {
+    if (reserve(w, len) == 0) {
+        memcpy(w->buf + w->len, text, len);
+        w->len += len;
+    }
+}
+
+static inline void put_char(json_writer_t *w, char c) {
+    if (reserve(w, 1) == 0) {
+        w->buf[w->len++] = c;
+    }
+}
+
+// Emit the separator a new value needs at the current level
+static void begin_value(json_writer_t *w) {
+    if (w->after_key) {
+        w->after_key = 0;
+        return;
+    }
+    uint64_t bit = 1ULL << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void put_string(json_writer_t *w, const char *s) {
+    static const char hex[] = "0123456789abcdef";
+    put_char(w, '"');
+    const char *run = s;
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        put(w, run, (size_t)(s - run));
+        run = s + 1;
+        switch (c) {
+            case '"': put(w, "\\\"", 2); break;
+            case '\\': put(w, "\\\\", 2); break;
+            case '\n': put(w, "\\n", 2); break;
+            case '\r': put(w, "\\r", 2); break;
+            case '\t': put(w, "\\t", 2); break;
+            default: {
+                char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xF] };
+                put(w, esc, sizeof(esc));
+            }
+        }
+    }
+    put(w, run, (size_t)(s - run));
+    put_char(w, '"');
+}
+
+int json_writer_init(json_writer_t *w, size_t initial_capacity) {
+    memset(w, 0, sizeof(*w));
+    return initial_capacity ? reserve(w, initial_capacity) : 0;
+}
+
+int json_writer_init_arena(json_writer_t *w, arena_t *arena, size_t initial_capacity) {
+    memset(w, 0, sizeof(*w));
+    w->arena = arena;
+    return initial_capacity ? reserve(w, initial_capacity) : 0;
+}
+
+void json_writer_free(json_writer_t *w) {
+    if (!w->arena) {
+        free(w->buf);
+    }
+    memset(w, 0, sizeof(*w));
+}
+
+static void open_container(json_writer_t *w, char c) {
+    begin_value(w);
+    put_char(w, c);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->failed = 1;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1ULL << w->depth);
+}
+
+static void close_container(json_writer_t *w, char c) {
+    put_char(w, c);
+    if (w->depth > 0) {
+        w->depth--;
+    }
+}
+
+void json_writer_begin_object(json_writer_t *w) {
+    open_container(w, '{');
+}
+
+void json_writer_end_object(json_writer_t *w) {
+    close_container(w, '}');
+}
+
+void json_writer_begin_array(json_writer_t *w) {
+    open_container(w, '[');
+}
+
+void json_writer_end_array(json_writer_t *w) {
+    close_container(w, ']');
+}
+
+void json_writer_key(json_writer_t *w, const char *key) {
+    begin_value(w);
+    put_string(w, key);
+    put_char(w, ':');
+    w->after_key = 1;
+}
+
+void json_writer_string(json_writer_t *w, const char *value) {
+    if (!value) {
+        json_writer_null(w);
+        return;
+    }
+    begin_value(w);
+    put_string(w, value);
+}
+
+void json_writer_int(json_writer_t *w, int64_t value) {
+    char num[24];
+    int len = snprintf(num, sizeof(num), "%" PRId64, value);
+    begin_value(w);
+    put(w, num, (size_t)len);
+}
+
+void json_writer_double(json_writer_t *w, double value) {
+    if (!isfinite(value)) {
+        json_writer_null(w);
+        return;
+    }
+    // Same precision json-c uses, so values round-trip exactly
+    char num[32];
+    int len = snprintf(num, sizeof(num), "%.17g", value);
+    begin_value(w);
+    put(w, num, (size_t)len);
+}
+
+void json_writer_bool(json_writer_t *w, int value) {
+    begin_value(w);
+    if (value) {
+        put(w, "true", 4);
+    } else {
+        put(w, "false", 5);
+    }
+}
+
+void json_writer_null(json_writer_t *w) {
+    begin_value(w);
+    put(w, "null", 4);
+}
+
+void json_writer_raw(json_writer_t *w, const char *json, size_t len) {
+    begin_value(w);
+    put(w, json, len);
+}
+
+void json_writer_append(json_writer_t *w, const char *text, size_t len) {
+    put(w, text, len);
+}
+
+char* json_writer_finish(json_writer_t *w, size_t *len) {
+    if (reserve(w, 0) != 0 || !w->buf) {
+        json_writer_free(w);
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    char *buf = w->buf;
+    if (len) {
+        *len = w->len;
+    }
+    memset(w, 0, sizeof(*w));
+    return buf;
+}
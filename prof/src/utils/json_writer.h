@@ -0,0 +1,52 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define JSON_WRITER_MAX_DEPTH 64
+
+// Append-only JSON serializer writing into one growable buffer. Commas are inserted
+// automatically; callers emit keys and values in document order. An allocation failure
+// is sticky: later calls do nothing and json_writer_finish() returns NULL.
+typedef struct {
+    char *buf;
+    size_t len;
+    size_t capacity;
+    int failed;
+    int depth;
+    uint64_t has_items;     // Bit per nesting level: that level already holds a value
+    int after_key;          // The next value completes a "key": pair
+    arena_t *arena;         // Buffer lives in this arena instead of the heap when set
+} json_writer_t;
+
+int json_writer_init(json_writer_t *w, size_t initial_capacity);
+// Grow inside `arena`; the finished buffer is valid until the arena is released
+int json_writer_init_arena(json_writer_t *w, arena_t *arena, size_t initial_capacity);
+void json_writer_free(json_writer_t *w);
+
+void json_writer_begin_object(json_writer_t *w);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w);
+void json_writer_end_array(json_writer_t *w);
+void json_writer_key(json_writer_t *w, const char *key);
+
+void json_writer_string(json_writer_t *w, const char *value);
+void json_writer_int(json_writer_t *w, int64_t value);
+void json_writer_double(json_writer_t *w, double value);   // Non-finite values become null
+void json_writer_bool(json_writer_t *w, int value);
+void json_writer_null(json_writer_t *w);
+
+// An already serialized JSON value, copied as is
+void json_writer_raw(json_writer_t *w, const char *json, size_t len);
+
+// Text outside the JSON grammar, such as SSE framing around a document
+void json_writer_append(json_writer_t *w, const char *text, size_t len);
+
+// NUL-terminate and hand over the buffer (free() it, or pass it to
+// create_json_response_owned(); arena buffers are not freed); returns NULL if any write
+// failed. The writer is left empty.
+char* json_writer_finish(json_writer_t *w, size_t *len);
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,382 @@
+#define _GNU_SOURCE
+#include "static_files.h"
+#include "utils.h"
+#include "compress.h"
+#include "../api.h"
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <pthread.h>
+
+#define STATIC_PATH_MAX 512
+
+typedef struct {
+    struct MHD_Response *response;  // Queued for every request of this variant; NULL if absent
+    char etag[64];
+} static_variant_t;
+
+typedef struct {
+    char path[STATIC_PATH_MAX];     // Empty while the slot is free; kept if the file disappears
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+    struct timespec gz_mtime;       // Of the .gz sibling, used or not; zero when there is none
+    char last_modified[32];
+    int64_t checked_ms;             // Monotonic time of the last stat()
+    static_variant_t identity;
+    static_variant_t gzip;
+} static_entry_t;
+
+// Open addressing keyed by path. Only files that existed when first requested take a
+// slot, so probing for missing paths cannot fill the table.
+static static_entry_t entries[STATIC_CACHE_ENTRIES];
+static pthread_rwlock_t cache_lock = PTHREAD_RWLOCK_INITIALIZER;
+static static_files_stats_t files_stats;
+
+static int64_t monotonic_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+static inline int timespec_equal(struct timespec a, struct timespec b) {
+    return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+
+// Slot holding `path`, or the free slot it would go in; NULL when the table is full
+static static_entry_t* find_slot(const char *path) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    for (size_t i = 0; i < STATIC_CACHE_ENTRIES; i++) {
+        static_entry_t *e = &entries[(hash + i) % STATIC_CACHE_ENTRIES];
+        if (e->path[0] == '\0' || strcmp(e->path, path) == 0) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+// Strong validator from the inode, size and mtime, so any rewrite changes it
+static void format_etag(char *etag, size_t size, const struct stat *st, const char *suffix) {
+    unsigned long long mtime_ns = (unsigned long long)st->st_mtim.tv_sec * 1000000000ULL +
+                                  (unsigned long long)st->st_mtim.tv_nsec;
+    snprintf(etag, size, "\"%llx-%llx-%llx%s\"", (unsigned long long)st->st_ino,
+             (unsigned long long)st->st_size, mtime_ns, suffix);
+}
+
+static void format_http_date(char *buf, size_t size, time_t t) {
+    struct tm tm_utc;
+    gmtime_r(&t, &tm_utc);
+    strftime(buf, size, "%a, %d %b %Y %H:%M:%S GMT", &tm_utc);
+}
+
+static void add_cache_headers(struct MHD_Response *response, const char *etag, const char *last_modified) {
+    char cache_control[48];
+    snprintf(cache_control, sizeof(cache_control), "public, max-age=%d", STATIC_CACHE_MAX_AGE_SEC);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_ETAG, etag);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_LAST_MODIFIED, last_modified);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CACHE_CONTROL, cache_control);
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+}
+
+// Build a response that sends the file with sendfile; takes ownership of fd. All headers,
+// CORS included, are set here because cached responses are shared between requests.
+static struct MHD_Response* create_file_response(int fd, const struct stat *st, const char *content_type,
+                                                 const char *etag, const char *last_modified, int gzip) {
+    struct MHD_Response *response = MHD_create_response_from_fd((size_t)st->st_size, fd);
+    if (!response) {
+        close(fd);
+        return NULL;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_TYPE, content_type);
+    if (gzip) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+    }
+    add_cache_headers(response, etag, last_modified);
+    add_cors_headers(response);
+    return response;
+}
+
+static void variant_clear(static_variant_t *v) {
+    if (v->response) {
+        // Requests already queued keep their reference; MHD closes the fd after the last one
+        MHD_destroy_response(v->response);
+        v->response = NULL;
+    }
+    v->etag[0] = '\0';
+}
+
+// Drop the open files but keep the path, so the slot's probe chain stays intact
+static void entry_clear(static_entry_t *e) {
+    variant_clear(&e->identity);
+    variant_clear(&e->gzip);
+    e->dev = 0;
+    e->ino = 0;
+    e->size = 0;
+    memset(&e->mtime, 0, sizeof(e->mtime));
+    memset(&e->gz_mtime, 0, sizeof(e->gz_mtime));
+    e->last_modified[0] = '\0';
+}
+
+// (Re)open the file and its .gz sibling; returns -1 and leaves the entry empty if it is gone
+static int entry_load(static_entry_t *e, const char *content_type) {
+    entry_clear(e);
+
+    int fd = open(e->path, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    e->dev = st.st_dev;
+    e->ino = st.st_ino;
+    e->size = st.st_size;
+    e->mtime = st.st_mtim;
+    format_http_date(e->last_modified, sizeof(e->last_modified), st.st_mtim.tv_sec);
+    format_etag(e->identity.etag, sizeof(e->identity.etag), &st, "");
+    e->identity.response = create_file_response(fd, &st, content_type, e->identity.etag, e->last_modified, 0);
+    if (!e->identity.response) {
+        entry_clear(e);
+        return -1;
+    }
+
+    // A precompressed sibling is only trusted while it is at least as new as the original.
+    // Seconds only: gzip -k copies the mtime, but not always to the nanosecond.
+    char gz_path[STATIC_PATH_MAX + 3];
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", e->path);
+    int gz_fd = open(gz_path, O_RDONLY | O_CLOEXEC);
+    if (gz_fd >= 0) {
+        struct stat gz_st;
+        if (fstat(gz_fd, &gz_st) == 0 && S_ISREG(gz_st.st_mode)) {
+            e->gz_mtime = gz_st.st_mtim;
+        }
+        if (e->gz_mtime.tv_sec != 0 && gz_st.st_mtim.tv_sec >= st.st_mtim.tv_sec) {
+            format_etag(e->gzip.etag, sizeof(e->gzip.etag), &gz_st, "-gz");
+            e->gzip.response = create_file_response(gz_fd, &gz_st, content_type, e->gzip.etag, e->last_modified, 1);
+        } else {
+            close(gz_fd);
+        }
+    }
+    return 0;
+}
+
+// Non-zero when the file or its .gz sibling changed since the entry was loaded
+static int entry_changed(const static_entry_t *e) {
+    struct stat st;
+    if (stat(e->path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return e->identity.response != NULL;
+    }
+    if (st.st_ino != e->ino || st.st_dev != e->dev || st.st_size != e->size ||
+        !timespec_equal(st.st_mtim, e->mtime)) {
+        return 1;
+    }
+
+    char gz_path[STATIC_PATH_MAX + 3];
+    snprintf(gz_path, sizeof(gz_path), "%s.gz", e->path);
+    struct timespec gz_mtime = { 0, 0 };
+    if (stat(gz_path, &st) == 0 && S_ISREG(st.st_mode)) {
+        gz_mtime = st.st_mtim;
+    }
+    return !timespec_equal(gz_mtime, e->gz_mtime);
+}
+
+// If-None-Match holds "*" or a comma-separated list of entity tags, possibly weak
+static int etag_matches(const char *header, const char *etag) {
+    size_t etag_len = strlen(etag);
+    const char *p = header;
+    while (*p) {
+        while (*p == ' ' || *p == '\t' || *p == ',') {
+            p++;
+        }
+        if (*p == '*') {
+            return 1;
+        }
+        if (strncmp(p, "W/", 2) == 0) {
+            p += 2;
+        }
+        const char *end = strchr(p, ',');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        while (len > 0 && (p[len - 1] == ' ' || p[len - 1] == '\t')) {
+            len--;
+        }
+        if (len == etag_len && memcmp(p, etag, len) == 0) {
+            return 1;
+        }
+        if (!end) {
+            break;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+// If-None-Match takes precedence; If-Modified-Since is only consulted without it
+static int not_modified(struct MHD_Connection *connection, const static_entry_t *e, const static_variant_t *v) {
+    const char *if_none_match = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                            MHD_HTTP_HEADER_IF_NONE_MATCH);
+    if (if_none_match) {
+        return etag_matches(if_none_match, v->etag);
+    }
+    const char *if_modified_since = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                                MHD_HTTP_HEADER_IF_MODIFIED_SINCE);
+    if (!if_modified_since) {
+        return 0;
+    }
+    struct tm tm_utc;
+    memset(&tm_utc, 0, sizeof(tm_utc));
+    if (!strptime(if_modified_since, "%a, %d %b %Y %H:%M:%S GMT", &tm_utc)) {
+        return 0;
+    }
+    return e->mtime.tv_sec <= timegm(&tm_utc);
+}
+
+static enum MHD_Result queue_not_found(struct MHD_Connection *connection) {
+    stat_add(&files_stats.not_found, 1);
+    struct MHD_Response *response = create_error_response("File not found", MHD_HTTP_NOT_FOUND);
+    enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_FOUND, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+// Queue the cached response, or a 304; the caller holds cache_lock so it cannot be replaced
+static enum MHD_Result queue_entry(struct MHD_Connection *connection, const static_entry_t *e, int gzip_ok) {
+    if (!e->identity.response) {
+        return queue_not_found(connection);
+    }
+    const static_variant_t *v = gzip_ok && e->gzip.response ? &e->gzip : &e->identity;
+
+    if (not_modified(connection, e, v)) {
+        stat_add(&files_stats.not_modified, 1);
+        struct MHD_Response *response = MHD_create_response_from_buffer(0, NULL, MHD_RESPMEM_PERSISTENT);
+        add_cache_headers(response, v->etag, e->last_modified);
+        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_NOT_MODIFIED, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+
+    stat_add(&files_stats.hits, 1);
+    if (v == &e->gzip) {
+        stat_add(&files_stats.gzip, 1);
+    }
+    return MHD_queue_response(connection, MHD_HTTP_OK, v->response);
+}
+
+// The table is full: open the file for this request only, still sent with sendfile
+static enum MHD_Result serve_uncached(struct MHD_Connection *connection, const char *filepath,
+                                      const char *content_type) {
+    int fd = open(filepath, O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return queue_not_found(connection);
+    }
+
+    char etag[64], last_modified[32];
+    format_etag(etag, sizeof(etag), &st, "");
+    format_http_date(last_modified, sizeof(last_modified), st.st_mtim.tv_sec);
+    struct MHD_Response *response = create_file_response(fd, &st, content_type, etag, last_modified, 0);
+    if (!response) {
+        response = create_error_response("Internal server error", MHD_HTTP_INTERNAL_SERVER_ERROR);
+        enum MHD_Result ret = queue_response_with_cors(connection, MHD_HTTP_INTERNAL_SERVER_ERROR, response);
+        MHD_destroy_response(response);
+        return ret;
+    }
+    stat_add(&files_stats.uncached, 1);
+    enum MHD_Result ret = MHD_queue_response(connection, MHD_HTTP_OK, response);
+    MHD_destroy_response(response);
+    return ret;
+}
+
+enum MHD_Result static_files_serve(struct MHD_Connection *connection, const char *filepath,
+                                   const char *content_type) {
+    if (strlen(filepath) >= STATIC_PATH_MAX || strstr(filepath, "..")) {
+        return queue_not_found(connection);
+    }
+    int gzip_ok = compress_accepts(MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                               MHD_HTTP_HEADER_ACCEPT_ENCODING), COMPRESS_GZIP);
+    int64_t now = monotonic_ms();
+
+    // Fast path: a fresh entry is queued under the read lock, without touching the disk
+    pthread_rwlock_rdlock(&cache_lock);
+    static_entry_t *e = find_slot(filepath);
+    if (e && e->path[0] != '\0' && now - e->checked_ms < STATIC_CACHE_CHECK_MS) {
+        enum MHD_Result ret = queue_entry(connection, e, gzip_ok);
+        pthread_rwlock_unlock(&cache_lock);
+        return ret;
+    }
+    pthread_rwlock_unlock(&cache_lock);
+
+    pthread_rwlock_wrlock(&cache_lock);
+    e = find_slot(filepath);
+    if (!e) {
+        pthread_rwlock_unlock(&cache_lock);
+        return serve_uncached(connection, filepath, content_type);
+    }
+    if (e->path[0] == '\0') {
+        struct stat st;
+        if (stat(filepath, &st) != 0 || !S_ISREG(st.st_mode)) {
+            pthread_rwlock_unlock(&cache_lock);
+            return queue_not_found(connection);
+        }
+        snprintf(e->path, sizeof(e->path), "%s", filepath);
+        e->checked_ms = now;
+        if (entry_load(e, content_type) == 0) {
+            stat_add(&files_stats.loads, 1);
+        }
+    } else if (now - e->checked_ms >= STATIC_CACHE_CHECK_MS) {
+        // Another thread may have refreshed it while we waited for the lock
+        e->checked_ms = now;
+        if (entry_changed(e) && entry_load(e, content_type) == 0) {
+            stat_add(&files_stats.reloads, 1);
+        }
+    }
+    enum MHD_Result ret = queue_entry(connection, e, gzip_ok);
+    pthread_rwlock_unlock(&cache_lock);
+    return ret;
+}
+
+void static_files_shutdown(void) {
+    pthread_rwlock_wrlock(&cache_lock);
+    for (size_t i = 0; i < STATIC_CACHE_ENTRIES; i++) {
+        entry_clear(&entries[i]);
+        entries[i].path[0] = '\0';
+    }
+    pthread_rwlock_unlock(&cache_lock);
+}
+
+void static_files_get_stats(static_files_stats_t *stats) {
+    stats->hits = __atomic_load_n(&files_stats.hits, __ATOMIC_RELAXED);
+    stats->loads = __atomic_load_n(&files_stats.loads, __ATOMIC_RELAXED);
+    stats->reloads = __atomic_load_n(&files_stats.reloads, __ATOMIC_RELAXED);
+    stats->not_modified = __atomic_load_n(&files_stats.not_modified, __ATOMIC_RELAXED);
+    stats->gzip = __atomic_load_n(&files_stats.gzip, __ATOMIC_RELAXED);
+    stats->uncached = __atomic_load_n(&files_stats.uncached, __ATOMIC_RELAXED);
+    stats->not_found = __atomic_load_n(&files_stats.not_found, __ATOMIC_RELAXED);
+}
+
+json_object* static_files_stats_to_json(void) {
+    static_files_stats_t stats;
+    static_files_get_stats(&stats);
+    json_object *obj = json_object_new_object();
+    json_object_object_add(obj, "hits", json_object_new_int64((int64_t)stats.hits));
+    json_object_object_add(obj, "loads", json_object_new_int64((int64_t)stats.loads));
+    json_object_object_add(obj, "reloads", json_object_new_int64((int64_t)stats.reloads));
+    json_object_object_add(obj, "not_modified", json_object_new_int64((int64_t)stats.not_modified));
+    json_object_object_add(obj, "gzip", json_object_new_int64((int64_t)stats.gzip));
+    json_object_object_add(obj, "uncached", json_object_new_int64((int64_t)stats.uncached));
+    json_object_object_add(obj, "not_found", json_object_new_int64((int64_t)stats.not_found));
+    return obj;
+}
@@ -0,0 +1,29 @@
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H
+
+#include <microhttpd.h>
+#include <json-c/json.h>
+
+typedef struct {
+    unsigned long hits;              // Served from an already open file
+    unsigned long loads;             // Files opened into the cache
+    unsigned long reloads;           // Cached files reopened after their mtime, size or inode changed
+    unsigned long not_modified;      // 304 answers to If-None-Match / If-Modified-Since
+    unsigned long gzip;              // Responses sent from a precompressed .gz variant
+    unsigned long uncached;          // Served without caching because the table was full
+    unsigned long not_found;
+} static_files_stats_t;
+
+// Answer a GET for `filepath` from the open-file cache. Bodies go out with sendfile from
+// a cached descriptor; a sibling `filepath.gz` that is at least as new is sent instead to
+// clients accepting gzip. Cached files are re-stat'ed at most every STATIC_CACHE_CHECK_MS.
+enum MHD_Result static_files_serve(struct MHD_Connection *connection, const char *filepath,
+                                   const char *content_type);
+
+// Close every cached file; call after MHD_stop_daemon()
+void static_files_shutdown(void);
+
+void static_files_get_stats(static_files_stats_t *stats);
+json_object* static_files_stats_to_json(void);
+
+#endif // STATIC_FILES_H
@@ -0,0 +1,11 @@
+#ifndef STATS_H
+#define STATS_H
+
+// Counters behind the *_stats_to_json() sections of /api/stats. Each one is bumped
+// without ordering and read with __atomic_load_n(..., __ATOMIC_RELAXED); the totals
+// only need to be exact eventually, not consistent with each other.
+static inline void stat_add(unsigned long *counter, unsigned long value) {
+    __atomic_fetch_add(counter, value, __ATOMIC_RELAXED);
+}
+
+#endif // STATS_H
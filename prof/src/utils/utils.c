@@ -1,32 +1,9 @@
 #include "utils.h"
+#include "compress.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-// Helper function to read file content
-char* read_file_content(const char *filepath) {
-    FILE *file = fopen(filepath, "rb");
-    if (!file) {
-        return NULL;
-    }
-    
-    fseek(file, 0, SEEK_END);
-    long length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    
-    char *content = malloc(length + 1);
-    if (!content) {
-        fclose(file);
-        return NULL;
-    }
-    
-    fread(content, 1, length, file);
-    content[length] = '\0';
-    fclose(file);
-    
-    return content;
-}
-
 // Helper function to get content type based on file extension
 const char* get_content_type(const char *url) {
     const char *dot = strrchr(url, '.');
@@ -43,16 +20,19 @@ const char* get_content_type(const char *url) {
     return "text/plain";
 }
 
-// Helper function to queue HTTP responses with CORS headers
-enum MHD_Result queue_response_with_cors(struct MHD_Connection *connection, 
-                                        unsigned int status, 
-                                        struct MHD_Response *response) {
-    // Add CORS headers to allow requests from any origin
+// Add CORS headers to allow requests from any origin
+void add_cors_headers(struct MHD_Response *response) {
     MHD_add_response_header(response, "Access-Control-Allow-Origin", "*");
     MHD_add_response_header(response, "Access-Control-Allow-Methods", "GET, POST, PUT, DELETE, OPTIONS");
     MHD_add_response_header(response, "Access-Control-Allow-Headers", "Content-Type, Authorization");
     MHD_add_response_header(response, "Access-Control-Allow-Credentials", "true");
-    
+}
+
+// Helper function to queue HTTP responses with CORS headers
+enum MHD_Result queue_response_with_cors(struct MHD_Connection *connection, 
+                                        unsigned int status, 
+                                        struct MHD_Response *response) {
+    add_cors_headers(response);
     return MHD_queue_response(connection, status, response);
 }
 
@@ -65,6 +45,60 @@ struct MHD_Response* create_json_response(const char* json_str, int status_code)
     return response;
 }
 
+// Create a JSON response that frees json_str once it has been sent
+struct MHD_Response* create_json_response_owned(char* json_str, size_t len, int status_code) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(len, json_str, MHD_RESPMEM_MUST_FREE);
+    if (!response) {
+        free(json_str);
+        return NULL;
+    }
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    return response;
+}
+
+// Create a JSON response over a buffer that outlives it, such as request arena memory
+struct MHD_Response* create_json_response_borrowed(const char* json_str, size_t len, int status_code) {
+    struct MHD_Response *response = MHD_create_response_from_buffer(len, (void *)json_str,
+                                                                   MHD_RESPMEM_PERSISTENT);
+    if (!response) {
+        return NULL;
+    }
+    MHD_add_response_header(response, "Content-Type", "application/json");
+    return response;
+}
+
+// Create a JSON response compressed as the client's Accept-Encoding allows, when the body is
+// large enough to be worth it. json_str lives in `arena`, or is a malloc'd buffer the
+// response takes over when arena is NULL.
+struct MHD_Response* create_json_response_negotiated(struct MHD_Connection *connection, arena_t *arena,
+                                                     char* json_str, size_t len, int status_code) {
+    const char *accept_encoding = MHD_lookup_connection_value(connection, MHD_HEADER_KIND,
+                                                              MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    compress_encoding_t encoding = compress_select(accept_encoding, len);
+    void *packed = NULL;
+    size_t packed_len = 0;
+    if (encoding != COMPRESS_NONE && compress_buffer(encoding, json_str, len, arena, &packed, &packed_len) == 0) {
+        if (!arena) {
+            free(json_str);
+        }
+        json_str = packed;
+        len = packed_len;
+    } else {
+        encoding = COMPRESS_NONE;
+    }
+
+    struct MHD_Response *response = arena ? create_json_response_borrowed(json_str, len, status_code)
+                                          : create_json_response_owned(json_str, len, status_code);
+    if (!response) {
+        return NULL;
+    }
+    MHD_add_response_header(response, MHD_HTTP_HEADER_VARY, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+    if (encoding != COMPRESS_NONE) {
+        MHD_add_response_header(response, MHD_HTTP_HEADER_CONTENT_ENCODING, compress_encoding_name(encoding));
+    }
+    return response;
+}
+
 // Create an error response
 struct MHD_Response* create_error_response(const char* error_msg, int status_code) {
     char json_error[256];
@@ -3,18 +3,27 @@
 
 #include <microhttpd.h>
 #include <json-c/json.h>
+#include "arena.h"
 
 // File utility functions
-char* read_file_content(const char *filepath);
 const char* get_content_type(const char *url);
 
 // HTTP response utility functions
+void add_cors_headers(struct MHD_Response *response);
 enum MHD_Result queue_response_with_cors(struct MHD_Connection *connection, 
                                         unsigned int status, 
                                         struct MHD_Response *response);
 
 // JSON response utility functions
 struct MHD_Response* create_json_response(const char* json_str, int status_code);
+// Takes ownership of a malloc'd body (e.g. from json_writer_finish()) instead of copying it
+struct MHD_Response* create_json_response_owned(char* json_str, size_t len, int status_code);
+// Sends the buffer in place; it must stay valid until the request completes
+struct MHD_Response* create_json_response_borrowed(const char* json_str, size_t len, int status_code);
+// Compresses for the connection's Accept-Encoding above COMPRESS_MIN_SIZE; json_str is
+// arena memory, or a malloc'd buffer that is taken over when arena is NULL
+struct MHD_Response* create_json_response_negotiated(struct MHD_Connection *connection, arena_t *arena,
+                                                     char* json_str, size_t len, int status_code);
 struct MHD_Response* create_error_response(const char* error_msg, int status_code);
 struct MHD_Response* create_success_response(const char* success_msg, int status_code);
 
@@ -0,0 +1,59 @@
+// Precompute the landmark table /api/distance/alt searches with.
+//
+// Covers every resolution 9 cell within radius_km of lat,lng (the resolution
+// /api/distance/* routes at) and picks the landmarks farthest-first. Distances follow
+// the cost map the server will load: the one given, else GEO_COST_MAP, else
+// COST_MAP_PATH when present; rebuild the table whenever that map changes. Leave a
+// margin around the area served, since routes never leave the region. Run with:
+//   make tools && ./build/alt_build data/alt_landmarks.bin 52.52 13.40 40 [landmarks] [cost_map.bin]
+
+#include "../src/api.h"
+#include "../src/routing/alt.h"
+#include "../src/routing/cost_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+
+#define ALT_BUILD_RES 9
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s output.bin lat lng radius_km [landmarks] [cost_map.bin]\n", argv[0]);
+        return 2;
+    }
+    double radius_km = atof(argv[4]);
+    int landmarks = argc > 5 ? atoi(argv[5]) : ALT_DEFAULT_LANDMARKS;
+    const char *cost_map_path = argc > 6 ? argv[6] : getenv("GEO_COST_MAP");
+    if (!cost_map_path || cost_map_path[0] == '\0') {
+        cost_map_path = access(COST_MAP_PATH, R_OK) == 0 ? COST_MAP_PATH : NULL;
+    }
+    if (cost_map_path && cost_map_load(cost_map_path) != 0) {
+        return 1;
+    }
+
+    LatLng point = { degsToRads(atof(argv[2])), degsToRads(atof(argv[3])) };
+    H3Index center;
+    double edge_km;
+    if (radius_km <= 0 || latLngToCell(&point, ALT_BUILD_RES, &center) != E_SUCCESS ||
+        getHexagonEdgeLengthAvgKm(ALT_BUILD_RES, &edge_km) != E_SUCCESS) {
+        fprintf(stderr, "Expected a valid lat, lng and a positive radius\n");
+        return 2;
+    }
+    // Neighbouring centers are edge * sqrt(3) apart
+    int k = (int)ceil(radius_km / (edge_km * sqrt(3.0)));
+    if (alt_build_table(argv[1], center, k, landmarks) != 0) {
+        return 1;
+    }
+
+    alt_stats_t stats;
+    if (alt_load(argv[1]) != 0) {
+        return 1;
+    }
+    alt_get_stats(&stats);
+    printf("Wrote %s: %lu cells in %d rings, %u landmarks, %zu bytes%s\n", argv[1], stats.cells, k,
+           stats.landmarks, stats.file_size, cost_map_path ? "" : " (no cost map)");
+    alt_unload();
+    cost_map_unload();
+    return 0;
+}
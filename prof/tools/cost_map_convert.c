@@ -0,0 +1,84 @@
+// Convert a CSV of per-cell traversal costs into the binary file routing maps in.
+//
+// Each line is "h3_index,cost": the index as H3 hex text, the cost a positive
+// multiplier of edge length ("inf" for impassable). Cells may be at any resolution;
+// coarse cells act as defaults for the fine cells inside them. A first line that does
+// not parse (a column header) and blank lines are skipped. Run with:
+//   make tools && ./build/cost_map_convert costs.csv cost_map.bin [default_cost]
+
+#include "../src/routing/cost_map.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s input.csv output.bin [default_cost]\n", argv[0]);
+        return 2;
+    }
+    float default_cost = argc > 3 ? strtof(argv[3], NULL) : 1.0f;
+
+    FILE *in = fopen(argv[1], "r");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    size_t count = 0, capacity = 1 << 20;
+    H3Index *cells = malloc(capacity * sizeof(*cells));
+    float *costs = malloc(capacity * sizeof(*costs));
+    char line[256];
+    unsigned long line_no = 0;
+    while (cells && costs && fgets(line, sizeof(line), in)) {
+        line_no++;
+        char *comma = strchr(line, ',');
+        if (line[0] == '\n' || line[0] == '\r' || line[0] == '\0') {
+            continue;
+        }
+        H3Index cell = 0;
+        char *end = NULL;
+        float cost = 0;
+        if (comma) {
+            *comma = '\0';
+            cost = strtof(comma + 1, &end);
+        }
+        if (!comma || end == comma + 1 || stringToH3(line, &cell) != E_SUCCESS || !isValidCell(cell)) {
+            if (line_no == 1) {
+                continue; // Column header
+            }
+            fprintf(stderr, "%s:%lu: expected h3_index,cost\n", argv[1], line_no);
+            fclose(in);
+            return 1;
+        }
+
+        if (count == capacity) {
+            capacity *= 2;
+            H3Index *more_cells = realloc(cells, capacity * sizeof(*cells));
+            float *more_costs = more_cells ? realloc(costs, capacity * sizeof(*costs)) : NULL;
+            if (!more_cells || !more_costs) {
+                cells = more_cells ? more_cells : cells;
+                fprintf(stderr, "Out of memory after %zu cells\n", count);
+                fclose(in);
+                return 1;
+            }
+            cells = more_cells;
+            costs = more_costs;
+        }
+        cells[count] = cell;
+        costs[count] = cost;
+        count++;
+    }
+    fclose(in);
+    if (!cells || !costs) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (cost_map_write(argv[2], cells, costs, count, default_cost) != 0) {
+        return 1;
+    }
+    printf("Wrote %zu cells to %s\n", count, argv[2]);
+    free(cells);
+    free(costs);
+    return 0;
+}
@@ -0,0 +1,23 @@
+// Contract an OSM-derived road edge list into the graph file road routes map in.
+//
+// See src/routing/ch_build.h for the input format. Nodes are bucketed for snapping at
+// ROAD_GRAPH_SNAP_RES. Run with:
+//   make tools && ./build/road_graph_build edges.csv data/road_graph.ch
+
+#include "../src/api.h"
+#include "../src/routing/ch_build.h"
+#include <stdio.h>
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s edges.csv output.ch\n", argv[0]);
+        return 2;
+    }
+    ch_build_stats_t stats;
+    if (ch_build_from_csv(argv[1], argv[2], ROAD_GRAPH_SNAP_RES, &stats) != 0) {
+        return 1;
+    }
+    printf("Wrote %s: %lu nodes, %lu road segments, %lu shortcuts (contracted in %.1f s)\n",
+           argv[2], stats.nodes, stats.segments, stats.shortcuts, stats.seconds);
+    return 0;
+}